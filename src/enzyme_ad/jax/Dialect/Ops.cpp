@@ -1140,6 +1140,15 @@ LogicalResult enzymexla::MemcpyOp::verify() {
   return success();
 }
 
+LogicalResult enzymexla::MPIWaitOp::verify() {
+  bool persistent = getRequest().getType().getElementType().isInteger(64);
+  if (persistent && !getWaited())
+    return emitOpError("waiting on a persistent request must yield it");
+  if (!persistent && (getWaited() || getOutbuf()))
+    return emitOpError("only persistent requests are yielded and own a buffer");
+  return success();
+}
+
 LogicalResult enzymexla::SyrkOp::verify() {
   auto CType = cast<RankedTensorType>(getC().getType());
   bool isComplex = false;
@@ -21,6 +21,7 @@
 #include "mlir/Analysis/TopologicalSortUtils.h"
 
 #include "llvm/ADT/PointerUnion.h"
+#include "llvm/ADT/StringSwitch.h"
 
 #include "mlir/IR/DialectRegistry.h"
 #include "mlir/Support/LogicalResult.h"
@@ -481,16 +482,161 @@ public:
   }
 };
 
+// Columns of a Revolve action: restore the loop state from snapshot `SLOT`,
+// advance it from iteration `FROM` to iteration `TO`, store it in snapshot
+// `SHOT`, and if `TURN` is set run the adjoint of iteration `TO`.
+enum RevolveColumn { SLOT, FROM, TO, SHOT, TURN, kRevolveColumns };
+
+// Number of iterations that can be reversed with `snapshots` free snapshots
+// when every iteration is recomputed at most `repeats` times, C(s + r, r).
+static int64_t revolveSteps(int64_t snapshots, int64_t repeats) {
+  int64_t steps = 1;
+  for (int64_t i = 1; i <= repeats; i++)
+    steps = steps * (snapshots + i) / i;
+  return steps;
+}
+
+// Appends the binomial checkpointing (Revolve) schedule reversing iterations
+// [begin, end), whose initial state is held in snapshot `slot`, with
+// `freeSnapshots` more snapshots available above it. Snapshot `scratch` is
+// written by actions that do not keep their state.
+static void appendRevolveSchedule(int64_t begin, int64_t end, int64_t slot,
+                                  int64_t freeSnapshots, int64_t scratch,
+                                  SmallVectorImpl<int64_t> &actions) {
+  int64_t numIters = end - begin;
+  if (freeSnapshots == 0 || numIters == 1) {
+    for (int64_t iter = end - 1; iter >= begin; iter--)
+      actions.append({slot, begin, iter, scratch, 1});
+    return;
+  }
+
+  int64_t repeats = 1;
+  while (revolveSteps(freeSnapshots, repeats) < numIters)
+    repeats++;
+  int64_t split =
+      begin + std::min(revolveSteps(freeSnapshots, repeats - 1), numIters - 1);
+
+  actions.append({slot, begin, split, slot + 1, 0});
+  appendRevolveSchedule(split, end, slot + 1, freeSnapshots - 1, scratch,
+                        actions);
+  appendRevolveSchedule(begin, split, slot, freeSnapshots, scratch, actions);
+}
+
+// Size in bytes of a loop-carried state of the given types, or -1 if it is
+// not statically known.
+static int64_t getStateBytes(TypeRange types) {
+  int64_t bytes = 0;
+  for (auto type : types) {
+    auto tensorType = dyn_cast<RankedTensorType>(type);
+    if (!tensorType || !tensorType.hasStaticShape())
+      return -1;
+    Type elemType = tensorType.getElementType();
+    int64_t bits;
+    if (auto complexType = dyn_cast<ComplexType>(elemType))
+      bits = 2 * complexType.getElementType().getIntOrFloatBitWidth();
+    else if (elemType.isIntOrFloat())
+      bits = elemType.getIntOrFloatBitWidth();
+    else
+      return -1;
+    bytes += tensorType.getNumElements() * llvm::divideCeil(bits, 8);
+  }
+  return bytes;
+}
+
+// Number of snapshots of a loop state of `stateBytes` bytes requested on `op`,
+// either directly or as a memory budget, or 0 if none was requested.
+static int64_t getSnapshotBudget(Operation *op, int64_t stateBytes) {
+  if (stateBytes < 0)
+    return 0;
+  auto snapshots =
+      op->getAttrOfType<IntegerAttr>("enzymexla.checkpoint_snapshots");
+  if (snapshots && snapshots.getInt() > 0)
+    return snapshots.getInt();
+  // One extra slot is used as scratch space by the reverse pass.
+  auto memory = op->getAttrOfType<IntegerAttr>("enzymexla.checkpoint_memory");
+  if (memory && memory.getInt() > 0)
+    return std::max<int64_t>(
+        1, memory.getInt() / std::max<int64_t>(stateBytes, 1) - 1);
+  return 0;
+}
+
+// Storage requested for the reverse-mode caches of `op` with an
+// `enzymexla.cache_storage` attribute on it or on any op enclosing it.
+static StringAttr getCacheStorageAttr(Operation *op) {
+  for (; op; op = op->getParentOp())
+    if (auto attr = op->getAttrOfType<StringAttr>("enzymexla.cache_storage"))
+      return attr;
+  return nullptr;
+}
+
+// Type of a buffer holding `count` snapshots of a value of type `type`.
+static RankedTensorType getSnapshotBufferType(RankedTensorType type,
+                                              int64_t count) {
+  SmallVector<int64_t> shape = {count};
+  llvm::append_range(shape, type.getShape());
+  return type.clone(shape);
+}
+
+// Buffer of `count` snapshots, all initialized with `value`.
+static Value makeSnapshotBuffer(OpBuilder &builder, Location loc, Value value,
+                                int64_t count) {
+  auto type = cast<RankedTensorType>(value.getType());
+  return stablehlo::BroadcastInDimOp::create(
+      builder, loc, getSnapshotBufferType(type, count), value,
+      builder.getDenseI64ArrayAttr(
+          llvm::to_vector(llvm::seq<int64_t>(1, type.getRank() + 1))));
+}
+
+static SmallVector<Value> getSnapshotIndices(OpBuilder &builder, Location loc,
+                                             Value slot, int64_t rank) {
+  SmallVector<Value> indices(rank + 1, makeI64Constant(loc, builder, 0));
+  indices[0] = slot;
+  return indices;
+}
+
+// Reads the snapshot at index `slot` of `buffer`.
+static Value readSnapshot(OpBuilder &builder, Location loc, Value buffer,
+                          Value slot) {
+  auto bufferType = cast<RankedTensorType>(buffer.getType());
+  auto type = RankedTensorType::get(bufferType.getShape().drop_front(),
+                                    bufferType.getElementType());
+  auto sliceType = getSnapshotBufferType(type, 1);
+  Value slice = stablehlo::DynamicSliceOp::create(
+      builder, loc, sliceType, buffer,
+      getSnapshotIndices(builder, loc, slot, type.getRank()),
+      sliceType.getShape());
+  return stablehlo::ReshapeOp::create(builder, loc, type, slice);
+}
+
+// Writes `value` to the snapshot at index `slot` of `buffer`.
+static Value writeSnapshot(OpBuilder &builder, Location loc, Value buffer,
+                           Value value, Value slot) {
+  auto type = cast<RankedTensorType>(value.getType());
+  Value update = stablehlo::ReshapeOp::create(
+      builder, loc, getSnapshotBufferType(type, 1), value);
+  return stablehlo::DynamicUpdateSliceOp::create(
+      builder, loc, buffer, update,
+      getSnapshotIndices(builder, loc, slot, type.getRank()));
+}
+
 class AutoDiffWhileRev
     : public ReverseAutoDiffOpInterface::ExternalModel<AutoDiffWhileRev,
                                                        WhileOp> {
 
-  enum ReverseMode { CONSTANT, CONSTANT_CHECKPOINTING, UNKNOWN };
+  enum ReverseMode {
+    CONSTANT,
+    CONSTANT_CHECKPOINTING,
+    REVOLVE,
+    ONLINE_CHECKPOINTING,
+    UNKNOWN
+  };
   struct ReverseModeInfo {
     enum ReverseMode mode = UNKNOWN;
     WhileLoopInfo info;
     int64_t checkpointPeriod =
         0; // Used for CONSTANT_CHECKPOINTING (the M value)
+    // Used for REVOLVE and ONLINE_CHECKPOINTING, including the initial state
+    int64_t numSnapshots = 0;
 
     ReverseModeInfo(stablehlo::WhileOp op) : info(op) {}
   };
@@ -507,7 +653,17 @@ class AutoDiffWhileRev
       auto checkpointPeriod =
           orig->getAttrOfType<IntegerAttr>(periodicCheckpointAttrName);
 
-      if (enableCheckpointing && enableCheckpointing.getValue()) {
+      // REVOLVE: binomial checkpointing within a budget given either as a
+      // number of snapshots or as bytes of snapshot memory.
+      int64_t snapshots = getSnapshotBudget(
+          orig, getStateBytes(orig->getResultTypes().drop_front()));
+      bool hasConstantIV = revInfo.info.getConstantStart().has_value() &&
+                           revInfo.info.getConstantStep().has_value();
+
+      if (snapshots > 0 && hasConstantIV) {
+        revInfo.mode = REVOLVE;
+        revInfo.numSnapshots = snapshots;
+      } else if (enableCheckpointing && enableCheckpointing.getValue()) {
         // CONSTANT_CHECKPOINTING: use provided period or default to sqrt(N).
         revInfo.mode = CONSTANT_CHECKPOINTING;
         if (checkpointPeriod && checkpointPeriod.getInt() > 0) {
@@ -524,6 +680,22 @@ class AutoDiffWhileRev
       } else {
         revInfo.mode = CONSTANT;
       }
+    } else {
+      // ONLINE_CHECKPOINTING: the trip count is only known at runtime, so
+      // snapshots are thinned out as the loop runs. The whole loop-carried
+      // state is snapshotted; the budget is rounded down to an even number.
+      // Thinning needs at least two snapshots, a smaller budget cannot be
+      // honored and falls back to caching every iteration.
+      int64_t snapshots =
+          getSnapshotBudget(orig, getStateBytes(orig->getResultTypes()));
+      if (snapshots >= 2) {
+        revInfo.mode = ONLINE_CHECKPOINTING;
+        revInfo.numSnapshots = snapshots & ~int64_t(1);
+      } else if (snapshots == 1) {
+        orig->emitRemark()
+            << "snapshot budget only fits one snapshot but online "
+               "checkpointing needs two, caching every iteration instead";
+      }
     }
 
     return revInfo;
@@ -817,6 +989,582 @@ class AutoDiffWhileRev
     return success(!anyFailed);
   }
 
+  // Copies the attributes of `orig` to a loop recomputing part of it, minus
+  // the ones selecting how `orig` itself is checkpointed.
+  static void copyRecomputeAttrs(stablehlo::WhileOp orig, Operation *loop) {
+    loop->setAttrs(orig->getAttrs());
+    loop->removeAttr("enzymexla.enable_checkpointing");
+    loop->removeAttr("enzymexla.checkpoint_period");
+    loop->removeAttr("enzymexla.checkpoint_snapshots");
+    loop->removeAttr("enzymexla.checkpoint_memory");
+    if (auto storage = getCacheStorageAttr(orig))
+      loop->setAttr("enzymexla.cache_storage", storage);
+  }
+
+  // Clones the body of `orig` into `body`, the body of a loop created by
+  // makeForLoop over the state of `orig`. When `iv` is null the loop carries
+  // all of the operands of `orig`, otherwise all but the induction variable,
+  // which is mapped to `iv`.
+  static void cloneLoopBody(stablehlo::WhileOp orig, Block *body, Value iv,
+                            IRMapping &mapping, OpBuilder &builder,
+                            MGradientUtilsReverse *gutils,
+                            bool registerClones) {
+    Block *origBody = &orig.getBody().front();
+    auto args = iv ? body->getArguments() : body->getArguments().drop_front();
+    for (auto &&[origarg, arg] :
+         llvm::zip_equal(origBody->getArguments(), args)) {
+      mapping.map(origarg, arg);
+      if (registerClones)
+        gutils->originalToNewFn.map(origarg, arg);
+    }
+    if (iv) {
+      mapping.map(origBody->getArgument(0), iv);
+      if (registerClones)
+        gutils->originalToNewFn.map(origBody->getArgument(0), iv);
+    }
+
+    for (Operation &op : origBody->without_terminator()) {
+      auto newOp = builder.clone(op, mapping);
+      if (!registerClones)
+        continue;
+      gutils->originalToNewFnOps[&op] = newOp;
+      for (auto &&[oldv, newv] :
+           llvm::zip(op.getResults(), newOp->getResults()))
+        gutils->originalToNewFn.map(oldv, newv);
+    }
+
+    auto oldTerm = cast<stablehlo::ReturnOp>(origBody->getTerminator());
+    auto newTerm = cast<stablehlo::ReturnOp>(body->getTerminator());
+    auto results = oldTerm.getResults();
+    SmallVector<Value> vals;
+    for (auto v : iv ? results.drop_front() : results)
+      vals.push_back(mapping.lookupOrDefault(v));
+    newTerm.getResultsMutable()
+        .slice(1, newTerm.getResultsMutable().size() - 1)
+        .assign(vals);
+  }
+
+  // Emits an if that, when `pred` holds, reverses a single iteration of
+  // `orig` from its initial `state` (see cloneLoopBody for `iv`). The if
+  // yields the adjoints of the loop-carried values.
+  static stablehlo::IfOp reverseIterationIf(stablehlo::WhileOp orig,
+                                            Value pred, ValueRange state,
+                                            Value iv, ValueRange adjoints,
+                                            IRMapping &mapping,
+                                            OpBuilder &builder,
+                                            MGradientUtilsReverse *gutils,
+                                            ArrayRef<bool> operandsActive,
+                                            bool &anyFailed) {
+    OpBuilder::InsertionGuard guard(builder);
+    auto loc = orig.getLoc();
+
+    auto turnIf =
+        stablehlo::IfOp::create(builder, loc, adjoints.getTypes(), pred);
+    builder.createBlock(&turnIf.getFalseBranch());
+    stablehlo::ReturnOp::create(builder, loc, adjoints);
+    builder.createBlock(&turnIf.getTrueBranch());
+
+    auto revInner = makeForLoop(builder, loc, 0, 1, 1, state);
+    Block *revInnerBody = &revInner.getBody().front();
+    copyRecomputeAttrs(orig, revInner);
+
+    auto revLoop = makeForLoop(builder, loc, 0, 1, 1, adjoints);
+    Block *revLoopBody = &revLoop.getBody().front();
+    stablehlo::ReturnOp::create(builder, loc,
+                                revLoop.getResults().drop_front());
+
+    builder.setInsertionPointToStart(revInnerBody);
+    cloneLoopBody(orig, revInnerBody, iv, mapping, builder, gutils,
+                  /*registerClones=*/true);
+    gutils->originalToNewFnOps[orig] = revInner;
+
+    builder.setInsertionPointToStart(revLoopBody);
+
+    Block *origBody = &orig.getBody().front();
+    int revIdx = 1;
+    for (auto &&[active, operand] : llvm::zip_equal(
+             operandsActive, origBody->getTerminator()->getOperands())) {
+      if (active) {
+        gutils->addToDiffe(operand, revLoopBody->getArgument(revIdx), builder);
+        revIdx++;
+      }
+    }
+
+    {
+      OpBuilder cacheBuilder(revInner);
+      auto cacheCreator = [&](Type t) {
+        Value cache = enzyme::InitOp::create(cacheBuilder, loc, t);
+        return std::make_pair(cache, cache);
+      };
+      gutils->registerCacheCreatorHook(cacheCreator);
+
+      auto rstart = origBody->rbegin(), rend = origBody->rend();
+      rstart++;
+      for (auto it = rstart; it != rend; it++) {
+        Operation *op = &*it;
+        anyFailed |= gutils->Logic.visitChild(op, builder, gutils).failed();
+      }
+      gutils->deregisterCacheCreatorHook(cacheCreator);
+    }
+
+    SmallVector<Value> newResults;
+    for (auto &&[active, arg] :
+         llvm::zip_equal(operandsActive, origBody->getArguments())) {
+      if (active) {
+        newResults.push_back(gutils->diffe(arg, builder));
+        if (!gutils->isConstantValue(arg))
+          gutils->zeroDiffe(arg, builder);
+      }
+    }
+
+    cast<stablehlo::ReturnOp>(revLoopBody->getTerminator())
+        .getResultsMutable()
+        .slice(1, revLoop.getNumResults() - 1)
+        .assign(newResults);
+
+    return turnIf;
+  }
+
+  // Reverse pass for REVOLVE. The forward pass only saves the initial state
+  // of the loop. The reverse pass replays a binomial checkpointing schedule,
+  // computed here from the trip count and the snapshot budget, from a table
+  // of actions: restoring a snapshot, advancing the state without taping,
+  // storing a snapshot, and reversing a single iteration.
+  static LogicalResult reverseWithRevolve(stablehlo::WhileOp orig,
+                                          struct ReverseModeInfo revInfo,
+                                          OpBuilder &builder,
+                                          MGradientUtilsReverse *gutils,
+                                          SmallVector<Value> caches,
+                                          ArrayRef<bool> operandsActive) {
+    auto loc = orig.getLoc();
+    int64_t numIters = revInfo.info.getConstantNumIters();
+    int64_t numSnapshots = revInfo.numSnapshots;
+
+    SetVector<Value> outsideRefs;
+    getUsedValuesDefinedAbove(orig->getRegions(), outsideRefs);
+
+    int numOutsideRefs = outsideRefs.size();
+    int nargs = caches.size() + 1;
+    int nrets = nargs - numOutsideRefs;
+
+    SmallVector<Value> operands;
+    for (auto [active, res] : llvm::zip(operandsActive, orig->getResults())) {
+      if (active) {
+        operands.push_back(gutils->diffe(res, builder));
+        if (!gutils->isConstantValue(res))
+          gutils->zeroDiffe(res, builder);
+      }
+    }
+
+    OpBuilder::InsertionGuard guard(builder);
+
+    // Nothing to reverse, the loop forwards its operands unchanged.
+    if (numIters <= 0) {
+      for (auto cache : caches)
+        (void)gutils->popCache(cache, builder);
+      int revIdx = 0;
+      for (auto &&[active, arg] :
+           llvm::zip_equal(operandsActive, orig->getOperands())) {
+        if (active) {
+          if (!gutils->isConstantValue(arg))
+            gutils->addToDiffe(arg, operands[revIdx], builder);
+          revIdx++;
+        }
+      }
+      return success();
+    }
+
+    SmallVector<int64_t> actions;
+    appendRevolveSchedule(0, numIters, /*slot=*/0, numSnapshots - 1,
+                          /*scratch=*/numSnapshots, actions);
+    int64_t numActions = actions.size() / kRevolveColumns;
+
+    SmallVector<Value> initial;
+    for (int i = 0; i < nrets - 1; ++i)
+      initial.push_back(gutils->popCache(caches[i], builder));
+
+    IRMapping mapping;
+    for (int i = nrets - 1, refIdx = 0; i < nargs - 1; ++i, ++refIdx)
+      mapping.map(outsideRefs[refIdx], gutils->popCache(caches[i], builder));
+
+    auto i64Type = RankedTensorType::get({}, builder.getI64Type());
+    Value zero = makeI64Constant(loc, builder, 0);
+
+    // Snapshot buffers, one slot per snapshot plus a scratch slot, all
+    // starting out with the initial state.
+    SmallVector<Value> loopOperands;
+    for (auto value : initial)
+      loopOperands.push_back(
+          makeSnapshotBuffer(builder, loc, value, numSnapshots + 1));
+    int64_t numBuffers = loopOperands.size();
+    llvm::append_range(loopOperands, operands);
+
+    auto tableType = RankedTensorType::get({numActions, kRevolveColumns},
+                                           builder.getI64Type());
+    Value table = stablehlo::ConstantOp::create(
+        builder, loc, tableType, DenseIntElementsAttr::get(tableType, actions));
+
+    stablehlo::WhileOp revOuter =
+        makeForLoop(builder, loc, 0, numActions, 1, loopOperands);
+    Block *revOuterBody = &revOuter.getBody().front();
+    auto buffers = revOuterBody->getArguments().slice(1, numBuffers);
+    auto adjoints = revOuterBody->getArguments().drop_front(1 + numBuffers);
+    builder.setInsertionPointToStart(revOuterBody);
+
+    Value action = stablehlo::DynamicSliceOp::create(
+        builder, loc,
+        RankedTensorType::get({1, kRevolveColumns}, builder.getI64Type()),
+        table, ValueRange{revOuterBody->getArgument(0), zero},
+        ArrayRef<int64_t>{1, kRevolveColumns});
+    auto column = [&](int64_t idx) -> Value {
+      Value v = stablehlo::SliceOp::create(
+          builder, loc, action, ArrayRef<int64_t>{0, idx},
+          ArrayRef<int64_t>{1, idx + 1}, ArrayRef<int64_t>{1, 1});
+      return stablehlo::ReshapeOp::create(builder, loc, i64Type, v);
+    };
+    Value slot = column(SLOT), from = column(FROM), to = column(TO),
+          shot = column(SHOT), turn = column(TURN);
+
+    auto iterationIV = [&](Value step) -> Value {
+      return stablehlo::AddOp::create(
+          builder, loc,
+          makeI64Constant(loc, builder,
+                          revInfo.info.getConstantStart().value()),
+          stablehlo::MulOp::create(
+              builder, loc,
+              makeI64Constant(loc, builder,
+                              revInfo.info.getConstantStep().value()),
+              step));
+    };
+
+    SmallVector<Value> restored;
+    for (auto buffer : buffers)
+      restored.push_back(readSnapshot(builder, loc, buffer, slot));
+
+    // Advance from `from` to `to` without taping.
+    auto advance = makeForLoop(
+        builder, loc, 0,
+        stablehlo::SubtractOp::create(builder, loc, to, from).getResult(), 1,
+        restored);
+    copyRecomputeAttrs(orig, advance);
+    {
+      OpBuilder::InsertionGuard advanceGuard(builder);
+      Block *advanceBody = &advance.getBody().front();
+      builder.setInsertionPointToStart(advanceBody);
+      IRMapping advanceMapping = mapping;
+      cloneLoopBody(orig, advanceBody,
+                    iterationIV(stablehlo::AddOp::create(
+                        builder, loc, from, advanceBody->getArgument(0))),
+                    advanceMapping, builder, gutils, /*registerClones=*/false);
+    }
+    auto state = advance.getResults().drop_front();
+
+    SmallVector<Value> newBuffers;
+    for (auto [buffer, value] : llvm::zip_equal(buffers, state))
+      newBuffers.push_back(writeSnapshot(builder, loc, buffer, value, shot));
+
+    // Reverse iteration `to` from the advanced state when the action turns.
+    bool anyFailed = false;
+    Value isTurn = stablehlo::CompareOp::create(builder, loc, turn, zero,
+                                                ComparisonDirection::NE);
+    auto turnIf = reverseIterationIf(orig, isTurn, state, iterationIV(to),
+                                     adjoints, mapping, builder, gutils,
+                                     operandsActive, anyFailed);
+
+    SmallVector<Value> outerResults(newBuffers);
+    llvm::append_range(outerResults, turnIf.getResults());
+    cast<stablehlo::ReturnOp>(revOuterBody->getTerminator())
+        .getResultsMutable()
+        .slice(1, revOuter.getNumResults() - 1)
+        .assign(outerResults);
+
+    builder.setInsertionPointAfter(revOuter);
+
+    int revIdx = 1 + numBuffers;
+    for (auto &&[active, arg] :
+         llvm::zip_equal(operandsActive, orig->getOperands())) {
+      if (active) {
+        if (!gutils->isConstantValue(arg)) {
+          gutils->addToDiffe(arg, revOuter->getResult(revIdx), builder);
+        }
+        revIdx++;
+      }
+    }
+
+    return success(!anyFailed);
+  }
+
+  // Forward pass for ONLINE_CHECKPOINTING. The trip count is unknown until the
+  // loop exits, so the loop is augmented to carry a buffer of snapshots of its
+  // state together with the iterations they were taken at. A snapshot is
+  // taken every `interval` iterations; once the buffer is full every other
+  // snapshot is dropped and the interval doubles, which keeps the snapshots
+  // evenly spread over the iterations run so far.
+  static SmallVector<Value>
+  cacheOnlineCheckpoints(Operation *orig, stablehlo::WhileOp newWhile,
+                         int64_t numSnapshots, MGradientUtilsReverse *gutils) {
+    auto loc = orig->getLoc();
+    OpBuilder builder(newWhile);
+    unsigned numState = newWhile->getNumOperands();
+
+    // Slot `numSnapshots` is scratch space written by iterations that do not
+    // take a snapshot.
+    SmallVector<Value> extra;
+    for (auto operand : newWhile->getOperands())
+      extra.push_back(
+          makeSnapshotBuffer(builder, loc, operand, numSnapshots + 1));
+    extra.push_back(makeSnapshotBuffer(
+        builder, loc, makeI64Constant(loc, builder, 0), numSnapshots + 1));
+    extra.push_back(makeI64Constant(loc, builder, 0)); // count
+    extra.push_back(makeI64Constant(loc, builder, 1)); // interval
+    extra.push_back(makeI64Constant(loc, builder, 0)); // iteration
+
+    Block *cond = &newWhile.getCond().front();
+    Block *body = &newWhile.getBody().front();
+    newWhile->insertOperands(numState, extra);
+    for (auto value : extra) {
+      cond->addArgument(value.getType(), loc);
+      body->addArgument(value.getType(), loc);
+    }
+
+    builder.setInsertionPointToStart(body);
+    auto state = body->getArguments().take_front(numState);
+    auto args = body->getArguments().drop_front(numState);
+    Value count = args[numState + 1], interval = args[numState + 2],
+          iter = args[numState + 3];
+    Value zero = makeI64Constant(loc, builder, 0);
+    Value full = makeI64Constant(loc, builder, numSnapshots);
+
+    Value store = stablehlo::CompareOp::create(
+        builder, loc, stablehlo::RemOp::create(builder, loc, iter, interval),
+        zero, ComparisonDirection::EQ);
+    Value compact = stablehlo::AndOp::create(
+        builder, loc, store,
+        stablehlo::CompareOp::create(builder, loc, count, full,
+                                     ComparisonDirection::EQ));
+
+    SmallVector<Value> kept(args.take_front(numState + 3));
+    auto compactIf = stablehlo::IfOp::create(
+        builder, loc, ValueRange(kept).getTypes(), compact);
+    {
+      OpBuilder::InsertionGuard guard(builder);
+      builder.createBlock(&compactIf.getFalseBranch());
+      stablehlo::ReturnOp::create(builder, loc, kept);
+
+      // Keep the even snapshots at the front of the buffers.
+      builder.createBlock(&compactIf.getTrueBranch());
+      SmallVector<Value> compacted;
+      for (auto buffer : args.take_front(numState + 1)) {
+        auto type = cast<RankedTensorType>(buffer.getType());
+        SmallVector<int64_t> start(type.getRank(), 0),
+            limit(type.getShape()), strides(type.getRank(), 1);
+        limit[0] = numSnapshots;
+        strides[0] = 2;
+        Value even = stablehlo::SliceOp::create(builder, loc, buffer, start,
+                                                limit, strides);
+        start[0] = numSnapshots / 2;
+        limit[0] = numSnapshots + 1;
+        strides[0] = 1;
+        Value rest = stablehlo::SliceOp::create(builder, loc, buffer, start,
+                                                limit, strides);
+        compacted.push_back(stablehlo::ConcatenateOp::create(
+            builder, loc, ValueRange{even, rest}, 0));
+      }
+      compacted.push_back(makeI64Constant(loc, builder, numSnapshots / 2));
+      compacted.push_back(stablehlo::MulOp::create(
+          builder, loc, interval, makeI64Constant(loc, builder, 2)));
+      stablehlo::ReturnOp::create(builder, loc, compacted);
+    }
+    count = compactIf.getResult(numState + 1);
+
+    Value slot = stablehlo::SelectOp::create(builder, loc, store, count, full);
+    SmallVector<Value> newArgs;
+    for (auto [buffer, value] :
+         llvm::zip_equal(compactIf.getResults().take_front(numState), state))
+      newArgs.push_back(writeSnapshot(builder, loc, buffer, value, slot));
+    newArgs.push_back(writeSnapshot(
+        builder, loc, compactIf.getResult(numState), iter, slot));
+    newArgs.push_back(stablehlo::AddOp::create(
+        builder, loc, count,
+        stablehlo::ConvertOp::create(builder, loc, store,
+                                     builder.getI64Type())));
+    newArgs.push_back(compactIf.getResult(numState + 2));
+    newArgs.push_back(stablehlo::AddOp::create(
+        builder, loc, iter, makeI64Constant(loc, builder, 1)));
+
+    auto term = body->getTerminator();
+    term->insertOperands(term->getNumOperands(), newArgs);
+
+    builder.setInsertionPoint(newWhile);
+    auto newnewWhile = stablehlo::WhileOp::create(
+        builder, loc, newWhile->getOperands().getTypes(),
+        newWhile->getOperands());
+    newnewWhile.getCond().takeBody(newWhile.getCond());
+    newnewWhile.getBody().takeBody(newWhile.getBody());
+
+    gutils->replaceOrigOpWith(orig,
+                              newnewWhile->getResults().take_front(numState));
+    gutils->erase(newWhile);
+    gutils->originalToNewFnOps[orig] = newnewWhile;
+
+    // Everything but the interval is needed by the reverse pass.
+    builder.setInsertionPointAfter(newnewWhile);
+    SmallVector<Value> caches;
+    auto results = newnewWhile->getResults().drop_front(numState);
+    for (auto result : results.take_front(numState + 2))
+      caches.push_back(gutils->initAndPushCache(result, builder));
+    caches.push_back(gutils->initAndPushCache(results.back(), builder));
+
+    SetVector<Value> outsideRefs;
+    getUsedValuesDefinedAbove(orig->getRegions(), outsideRefs);
+    for (auto ref : outsideRefs)
+      caches.push_back(gutils->initAndPushCache(
+          gutils->getNewFromOriginal(ref), builder));
+    return caches;
+  }
+
+  // Reverse pass for ONLINE_CHECKPOINTING. Iterations are reversed from the
+  // last one down. Each step restores the latest snapshot, taken at
+  // iteration `from`, and either advances it halfway to the iteration being
+  // reversed and stores it, while snapshots are free, or advances it all the
+  // way there and reverses that iteration. A snapshot is dropped once its own
+  // iteration has been reversed.
+  static LogicalResult reverseWithOnlineCheckpointing(
+      stablehlo::WhileOp orig, struct ReverseModeInfo revInfo,
+      OpBuilder &builder, MGradientUtilsReverse *gutils,
+      SmallVector<Value> caches, ArrayRef<bool> operandsActive) {
+    auto loc = orig.getLoc();
+    int64_t numSnapshots = revInfo.numSnapshots;
+    unsigned numState = orig->getNumOperands();
+
+    SetVector<Value> outsideRefs;
+    getUsedValuesDefinedAbove(orig->getRegions(), outsideRefs);
+
+    SmallVector<Value> operands;
+    for (auto [active, res] : llvm::zip(operandsActive, orig->getResults())) {
+      if (active) {
+        operands.push_back(gutils->diffe(res, builder));
+        if (!gutils->isConstantValue(res))
+          gutils->zeroDiffe(res, builder);
+      }
+    }
+
+    OpBuilder::InsertionGuard guard(builder);
+
+    // Snapshot buffers, iterations of the snapshots, number of snapshots and
+    // the iteration to reverse next.
+    SmallVector<Value> loopOperands;
+    for (unsigned i = 0; i < numState + 3; ++i)
+      loopOperands.push_back(gutils->popCache(caches[i], builder));
+    loopOperands.back() = stablehlo::SubtractOp::create(
+        builder, loc, loopOperands.back(), makeI64Constant(loc, builder, 1));
+    llvm::append_range(loopOperands, operands);
+
+    IRMapping mapping;
+    for (auto [idx, ref] : llvm::enumerate(outsideRefs))
+      mapping.map(ref, gutils->popCache(caches[numState + 3 + idx], builder));
+
+    auto types = ValueRange(loopOperands).getTypes();
+    SmallVector<Location> locs(loopOperands.size(), loc);
+    auto revOuter =
+        stablehlo::WhileOp::create(builder, loc, types, loopOperands);
+    Block *revOuterCond =
+        builder.createBlock(&revOuter.getCond(), {}, types, locs);
+    stablehlo::ReturnOp::create(
+        builder, loc,
+        ValueRange(stablehlo::CompareOp::create(
+            builder, loc, revOuterCond->getArgument(numState + 2),
+            makeI64Constant(loc, builder, 0), ComparisonDirection::GE)));
+    Block *revOuterBody =
+        builder.createBlock(&revOuter.getBody(), {}, types, locs);
+
+    auto buffers = revOuterBody->getArguments().take_front(numState);
+    Value positions = revOuterBody->getArgument(numState),
+          count = revOuterBody->getArgument(numState + 1),
+          iter = revOuterBody->getArgument(numState + 2);
+    auto adjoints = revOuterBody->getArguments().drop_front(numState + 3);
+    Value one = makeI64Constant(loc, builder, 1);
+    Value full = makeI64Constant(loc, builder, numSnapshots);
+
+    Value top = stablehlo::SubtractOp::create(builder, loc, count, one);
+    Value from = readSnapshot(builder, loc, positions, top);
+    SmallVector<Value> restored;
+    for (auto buffer : buffers)
+      restored.push_back(readSnapshot(builder, loc, buffer, top));
+
+    Value free = stablehlo::CompareOp::create(builder, loc, count, full,
+                                              ComparisonDirection::LT);
+    Value mid = stablehlo::AddOp::create(
+        builder, loc, from,
+        stablehlo::DivOp::create(
+            builder, loc,
+            stablehlo::AddOp::create(
+                builder, loc,
+                stablehlo::SubtractOp::create(builder, loc, iter, from), one),
+            makeI64Constant(loc, builder, 2)));
+    Value to = stablehlo::SelectOp::create(builder, loc, free, mid, iter);
+
+    // Advance from `from` to `to` without taping.
+    auto advance = makeForLoop(
+        builder, loc, 0,
+        stablehlo::SubtractOp::create(builder, loc, to, from).getResult(), 1,
+        restored);
+    copyRecomputeAttrs(orig, advance);
+    {
+      OpBuilder::InsertionGuard advanceGuard(builder);
+      Block *advanceBody = &advance.getBody().front();
+      builder.setInsertionPointToStart(advanceBody);
+      IRMapping advanceMapping = mapping;
+      cloneLoopBody(orig, advanceBody, /*iv=*/nullptr, advanceMapping, builder,
+                    gutils, /*registerClones=*/false);
+    }
+    auto state = advance.getResults().drop_front();
+
+    // Store the advanced state, in the scratch slot when it is only used to
+    // reverse iteration `to`.
+    Value isTurn = stablehlo::CompareOp::create(builder, loc, to, iter,
+                                                ComparisonDirection::EQ);
+    Value shot = stablehlo::SelectOp::create(builder, loc, isTurn, full, count);
+    SmallVector<Value> outerResults;
+    for (auto [buffer, value] : llvm::zip_equal(buffers, state))
+      outerResults.push_back(writeSnapshot(builder, loc, buffer, value, shot));
+    outerResults.push_back(writeSnapshot(builder, loc, positions, to, shot));
+
+    Value popped = stablehlo::SelectOp::create(
+        builder, loc,
+        stablehlo::CompareOp::create(builder, loc, from, iter,
+                                     ComparisonDirection::EQ),
+        top, count);
+    outerResults.push_back(stablehlo::SelectOp::create(
+        builder, loc, isTurn, popped,
+        stablehlo::AddOp::create(builder, loc, count, one)));
+    outerResults.push_back(stablehlo::SelectOp::create(
+        builder, loc, isTurn,
+        stablehlo::SubtractOp::create(builder, loc, iter, one), iter));
+
+    bool anyFailed = false;
+    auto turnIf =
+        reverseIterationIf(orig, isTurn, state, /*iv=*/nullptr, adjoints,
+                           mapping, builder, gutils, operandsActive, anyFailed);
+    llvm::append_range(outerResults, turnIf.getResults());
+    stablehlo::ReturnOp::create(builder, loc, outerResults);
+
+    builder.setInsertionPointAfter(revOuter);
+
+    int revIdx = numState + 3;
+    for (auto &&[active, arg] :
+         llvm::zip_equal(operandsActive, orig->getOperands())) {
+      if (active) {
+        if (!gutils->isConstantValue(arg)) {
+          gutils->addToDiffe(arg, revOuter->getResult(revIdx), builder);
+        }
+        revIdx++;
+      }
+    }
+
+    return success(!anyFailed);
+  }
+
 public:
   LogicalResult createReverseModeAdjoint(Operation *orig, OpBuilder &builder,
                                          MGradientUtilsReverse *gutils,
@@ -841,7 +1589,14 @@ public:
     // The reverse of the while loop is a for loop where the number
     // of iterations is either known or cached from the augmented primal.
     Value numIters;
-    if (revInfo.mode == CONSTANT_CHECKPOINTING) {
+    if (revInfo.mode == ONLINE_CHECKPOINTING) {
+      return reverseWithOnlineCheckpointing(cast<stablehlo::WhileOp>(orig),
+                                            revInfo, builder, gutils, caches,
+                                            operandsActive);
+    } else if (revInfo.mode == REVOLVE) {
+      return reverseWithRevolve(cast<stablehlo::WhileOp>(orig), revInfo,
+                                builder, gutils, caches, operandsActive);
+    } else if (revInfo.mode == CONSTANT_CHECKPOINTING) {
       return reverseWithCheckpointing(cast<stablehlo::WhileOp>(orig), revInfo,
                                       builder, gutils, caches, operandsActive);
     } else if (revInfo.mode == CONSTANT) {
@@ -1006,8 +1761,19 @@ public:
     auto newWhile = cast<WhileOp>(gutils->getNewFromOriginal(orig));
     OpBuilder revBuilder(newWhile);
 
+    // The caches are stacked on the loop in the derivative, which is not
+    // nested in the op that requested their storage.
+    auto cacheStorage = getCacheStorageAttr(orig);
+    if (cacheStorage)
+      newWhile->setAttr("enzymexla.cache_storage", cacheStorage);
+
     Type elementType = loopConditionVariableElementType(newWhile, revBuilder);
 
+    auto revModeInfo = getReverseMode(orig);
+    if (revModeInfo.mode == ONLINE_CHECKPOINTING)
+      return cacheOnlineCheckpoints(orig, newWhile, revModeInfo.numSnapshots,
+                                    gutils);
+
     Value numIters;
 
     WhileLoopInfo info(newWhile);
@@ -1018,7 +1784,21 @@ public:
         // for any value that is a reference from the outside we can hoist the
         // push/pop from outside the outer really.
 
-        auto revModeInfo = getReverseMode(orig);
+        if (revModeInfo.mode == REVOLVE) {
+          // REVOLVE only saves the initial state of the loop, everything
+          // else is recomputed from it in the reverse pass.
+          OpBuilder builder(newWhile);
+          SmallVector<Value> caches;
+          for (auto operand : newWhile->getOperands().drop_front())
+            caches.push_back(gutils->initAndPushCache(operand, builder));
+
+          SetVector<Value> outsideRefs;
+          getUsedValuesDefinedAbove(orig->getRegions(), outsideRefs);
+          for (auto ref : outsideRefs)
+            caches.push_back(gutils->initAndPushCache(
+                gutils->getNewFromOriginal(ref), builder));
+          return caches;
+        }
         if (revModeInfo.mode == CONSTANT_CHECKPOINTING) {
           // CONSTANT_CHECKPOINTING splits loop into outer and inner loops:
           // - nInner = checkpointPeriod (defaults to sqrt(N) if not specified)
@@ -1049,6 +1829,9 @@ public:
               builder, orig->getLoc(), 0, nOuter, 1,
               newWhile->getOperands().slice(1, newWhile->getNumOperands() - 1));
 
+          if (cacheStorage)
+            outer->setAttr("enzymexla.cache_storage", cacheStorage);
+
           Block *outerBody = &outer.getBody().front();
           builder.setInsertionPointToStart(outerBody);
 
@@ -1187,6 +1970,8 @@ public:
                                          resultTypes, newWhile->getOperands());
       newnewWhile.getCond().takeBody(newWhile.getCond());
       newnewWhile.getBody().takeBody(newWhile.getBody());
+      if (cacheStorage)
+        newnewWhile->setAttr("enzymexla.cache_storage", cacheStorage);
 
       SmallVector<Value> newResults(newnewWhile->getResults().begin(),
                                     --newnewWhile->getResults().end());
@@ -2944,6 +3729,142 @@ public:
                           MGradientUtilsReverse *gutils) const {}
 };
 
+// How the values pushed to a cache inside a loop are stored once stacked
+// across its iterations. With "lossless" storage, a value widened by a
+// convert is stored before the convert, which is redone where the cache is
+// popped. The "bf16", "f8E4M3FN" and "f8E5M2" storages additionally round
+// floating-point values to that type, scaling each pushed value by its
+// absolute maximum for the fp8 types. Decoding happens right where the cache
+// is popped so that it fuses into the reverse consumers.
+struct StackedCacheStorage {
+  Value stored;
+  Type cachedType;
+  FloatType roundedType = nullptr;
+  bool scaled = false;
+
+  StackedCacheStorage() = default;
+  StackedCacheStorage(Value pushed, Type cachedType)
+      : stored(pushed), cachedType(cachedType) {}
+
+  static StackedCacheStorage get(Operation *loop, Value pushed,
+                                 Type cachedType) {
+    StackedCacheStorage storage(pushed, cachedType);
+    auto attr = getCacheStorageAttr(loop);
+    if (!attr || !isa<RankedTensorType>(cachedType))
+      return storage;
+
+    MLIRContext *ctx = loop->getContext();
+    FloatType roundedType =
+        llvm::StringSwitch<FloatType>(attr.getValue())
+            .Case("bf16", BFloat16Type::get(ctx))
+            .Case("f8E4M3FN", Float8E4M3FNType::get(ctx))
+            .Case("f8E5M2", Float8E5M2Type::get(ctx))
+            .Default(nullptr);
+    if (!roundedType && attr.getValue() != "lossless")
+      return storage;
+
+    if (auto convert = pushed.getDefiningOp<stablehlo::ConvertOp>()) {
+      Type from = getElementTypeOrSelf(convert.getOperand().getType());
+      Type to = getElementTypeOrSelf(pushed.getType());
+      if (from.isIntOrFloat() && to.isIntOrFloat() &&
+          from.getIntOrFloatBitWidth() < to.getIntOrFloatBitWidth())
+        storage.stored = convert.getOperand();
+    }
+
+    // Only floating-point caches are rounded. A float stored ahead of a
+    // convert to an integer or index cache is kept exact.
+    auto cachedElemType =
+        dyn_cast<FloatType>(getElementTypeOrSelf(cachedType));
+    auto elemType =
+        dyn_cast<FloatType>(getElementTypeOrSelf(storage.stored.getType()));
+    if (roundedType && cachedElemType && elemType &&
+        cachedElemType.getWidth() > roundedType.getWidth() &&
+        elemType.getWidth() > roundedType.getWidth()) {
+      storage.roundedType = roundedType;
+      storage.scaled = roundedType.getWidth() == 8;
+    }
+    return storage;
+  }
+
+  // Types of the values stacked for each push.
+  SmallVector<Type> getPartTypes() const {
+    if (!roundedType)
+      return {stored.getType()};
+    auto type = cast<RankedTensorType>(stored.getType());
+    SmallVector<Type> types = {type.clone(roundedType)};
+    if (scaled)
+      types.push_back(RankedTensorType::get({}, type.getElementType()));
+    return types;
+  }
+
+  SmallVector<Value> encode(OpBuilder &builder, Location loc) const {
+    if (!roundedType)
+      return {stored};
+    auto type = cast<RankedTensorType>(stored.getType());
+    if (!scaled)
+      return {stablehlo::ConvertOp::create(builder, loc, stored, roundedType)};
+
+    auto scalarType = RankedTensorType::get({}, type.getElementType());
+    Value zero = stablehlo::ConstantOp::create(
+        builder, loc, scalarType, cast<ElementsAttr>(makeAttr(scalarType, 0)));
+    auto absMax = stablehlo::ReduceOp::create(
+        builder, loc, TypeRange{scalarType},
+        ValueRange{stablehlo::AbsOp::create(builder, loc, stored)},
+        ValueRange{zero},
+        builder.getDenseI64ArrayAttr(
+            llvm::to_vector(llvm::seq<int64_t>(0, type.getRank()))));
+    {
+      OpBuilder::InsertionGuard guard(builder);
+      Block *block = builder.createBlock(&absMax.getBody());
+      block->addArgument(scalarType, loc);
+      block->addArgument(scalarType, loc);
+      Value max = stablehlo::MaxOp::create(builder, loc, block->getArgument(0),
+                                           block->getArgument(1));
+      stablehlo::ReturnOp::create(builder, loc, ValueRange{max});
+    }
+
+    APFloat largest = APFloat::getLargest(roundedType.getFloatSemantics());
+    Value scale = stablehlo::DivOp::create(
+        builder, loc, absMax.getResult(0),
+        stablehlo::ConstantOp::create(
+            builder, loc, scalarType,
+            cast<ElementsAttr>(
+                makeAttr(scalarType, largest.convertToDouble()))));
+    scale = stablehlo::SelectOp::create(
+        builder, loc,
+        stablehlo::CompareOp::create(builder, loc, scale, zero,
+                                     ComparisonDirection::EQ),
+        stablehlo::ConstantOp::create(
+            builder, loc, scalarType,
+            cast<ElementsAttr>(makeAttr(scalarType, 1))),
+        scale);
+    Value scaled = stablehlo::DivOp::create(
+        builder, loc, stored,
+        stablehlo::BroadcastInDimOp::create(builder, loc, type, scale,
+                                            builder.getDenseI64ArrayAttr({})));
+    return {stablehlo::ConvertOp::create(builder, loc, scaled, roundedType),
+            scale};
+  }
+
+  Value decode(OpBuilder &builder, Location loc, ValueRange parts) const {
+    Value value = parts[0];
+    auto type = cast<RankedTensorType>(stored.getType());
+    if (roundedType) {
+      value = stablehlo::ConvertOp::create(builder, loc, value,
+                                           type.getElementType());
+      if (scaled) {
+        Value scale = stablehlo::BroadcastInDimOp::create(
+            builder, loc, type, parts[1], builder.getDenseI64ArrayAttr({}));
+        value = stablehlo::MulOp::create(builder, loc, value, scale);
+      }
+    }
+    if (value.getType() != cachedType)
+      value = stablehlo::ConvertOp::create(
+          builder, loc, value, getElementTypeOrSelf(cachedType));
+    return value;
+  }
+};
+
 struct WhileOpEnzymeOpsRemover
     : public EnzymeOpsRemoverOpInterface::ExternalModel<WhileOpEnzymeOpsRemover,
                                                         stablehlo::WhileOp> {
@@ -3117,7 +4038,68 @@ public:
 
     Value itersV = nullptr;
 
-    for (auto &cinfo : caches) {
+    auto getStackedType = [&](Type type) {
+      auto newType = cast<ShapedType>(
+          cast<AutoDiffTypeInterface>(type).getShadowType(numIters));
+      // dynamic_update_slice requires operand rank >= 1. For scalar cache use
+      // 1D.
+      if (newType.getRank() == 0) {
+        newType = RankedTensorType::get({numIters}, newType.getElementType());
+      }
+      return newType;
+    };
+
+    auto makeStackedInit = [&](ShapedType newType, Location loc) -> Value {
+      if (info.isConstant())
+        return cast<AutoDiffTypeInterface>(newType).createNullValue(rewriter,
+                                                                    loc);
+
+      if (!itersV)
+        itersV = info.getNumIters(rewriter);
+      SmallVector<int64_t> zeros = llvm::to_vector(newType.getShape());
+      for (auto &v : zeros) {
+        if (v == ShapedType::kDynamic)
+          v = 0;
+      }
+      auto op = cast<AutoDiffTypeInterface>(
+                    RankedTensorType::get(zeros, newType.getElementType()))
+                    .createNullValue(rewriter, loc);
+
+      auto zeroOp = cast<AutoDiffTypeInterface>(
+                        RankedTensorType::get(ArrayRef<int64_t>(),
+                                              newType.getElementType()))
+                        .createNullValue(rewriter, loc);
+
+      auto zeroInt = stablehlo::ConstantOp::create(
+          rewriter, loc, itersV.getType(),
+          cast<ElementsAttr>(makeAttr(itersV.getType(), 0)));
+
+      auto ST = RankedTensorType::get(
+          zeros.size(),
+          cast<RankedTensorType>(itersV.getType()).getElementType());
+      auto starts = stablehlo::ConstantOp::create(
+          rewriter, loc, ST, cast<ElementsAttr>(makeAttr(ST, 0)));
+      auto ints = starts;
+
+      int64_t padStart[] = {0};
+      int64_t padEnd[] = {(int64_t)zeros.size() - 1};
+      auto iterRS = stablehlo::ReshapeOp::create(
+          rewriter, loc,
+          RankedTensorType::get(
+              {1}, cast<TensorType>(itersV.getType()).getElementType()),
+          itersV);
+      Value ends =
+          stablehlo::PadOp::create(rewriter, loc, starts.getType(), iterRS,
+                                   zeroInt, padStart, padEnd, padStart);
+
+      return stablehlo::DynamicPadOp::create(rewriter, loc, newType, op,
+                                             zeroOp, starts, ends, ints);
+    };
+
+    // How each cache is stored once stacked, see getCacheStorageAttr.
+    SmallVector<StackedCacheStorage> storages(caches.size());
+
+    for (auto &&[cinfo, storage] : llvm::zip_equal(caches, storages)) {
       Value cache = cinfo.initOp.getResult();
 
       // push does not depend on a value inside the loop, we can hoist the
@@ -3148,98 +4130,52 @@ public:
             op, "WhileOp does not have induction variable for cache removal");
       }
 
-      auto newType =
-          cast<ShapedType>(cast<AutoDiffTypeInterface>(cinfo.cachedType())
-                               .getShadowType(numIters));
-      // dynamic_update_slice requires operand rank >= 1. For scalar cache use
-      // 1D.
-      if (newType.getRank() == 0) {
-        newType = RankedTensorType::get({numIters}, newType.getElementType());
-      }
-
-      Value initValue;
-      if (info.isConstant()) {
-        initValue = cast<AutoDiffTypeInterface>(newType).createNullValue(
-            rewriter, cinfo.initOp->getLoc());
-      } else {
-        if (!itersV)
-          itersV = info.getNumIters(rewriter);
-        SmallVector<int64_t> zeros = llvm::to_vector(newType.getShape());
-        for (auto &v : zeros) {
-          if (v == ShapedType::kDynamic)
-            v = 0;
-        }
-        auto op = cast<AutoDiffTypeInterface>(
-                      RankedTensorType::get(zeros, newType.getElementType()))
-                      .createNullValue(rewriter, cinfo.initOp->getLoc());
-
-        auto zeroOp = cast<AutoDiffTypeInterface>(
-                          RankedTensorType::get(ArrayRef<int64_t>(),
-                                                newType.getElementType()))
-                          .createNullValue(rewriter, cinfo.initOp->getLoc());
-
-        auto zeroInt = stablehlo::ConstantOp::create(
-            rewriter, cinfo.initOp->getLoc(), itersV.getType(),
-            cast<ElementsAttr>(makeAttr(itersV.getType(), 0)));
-
-        auto ST = RankedTensorType::get(
-            zeros.size(),
-            cast<RankedTensorType>(itersV.getType()).getElementType());
-        auto starts =
-            stablehlo::ConstantOp::create(rewriter, cinfo.initOp->getLoc(), ST,
-                                          cast<ElementsAttr>(makeAttr(ST, 0)));
-        auto ints = starts;
-
-        int64_t padStart[] = {0};
-        int64_t padEnd[] = {(int64_t)zeros.size() - 1};
-        auto iterRS = stablehlo::ReshapeOp::create(
-            rewriter, cinfo.initOp->getLoc(),
-            RankedTensorType::get(
-                {1}, cast<TensorType>(itersV.getType()).getElementType()),
-            itersV);
-        Value ends = stablehlo::PadOp::create(rewriter, cinfo.initOp->getLoc(),
-                                              starts.getType(), iterRS, zeroInt,
-                                              padStart, padEnd, padStart);
-
-        initValue = stablehlo::DynamicPadOp::create(
-            rewriter, cinfo.initOp->getLoc(), newType, op, zeroOp, starts, ends,
-            ints);
+      storage = StackedCacheStorage::get(whileOp, cinfo.pushedValue(),
+                                         cinfo.cachedType());
+
+      SmallVector<Value> cacheValues;
+      for (Type partType : storage.getPartTypes()) {
+        auto newType = getStackedType(partType);
+        newOperands.push_back(
+            makeStackedInit(newType, cinfo.initOp->getLoc()));
+        cacheValues.push_back(
+            body->addArgument(newType, cinfo.pushOp->getLoc()));
+        cond->addArgument(newType, cinfo.pushOp->getLoc());
       }
 
-      newOperands.push_back(initValue);
-
-      auto cacheValue = body->addArgument(newType, cinfo.pushOp->getLoc());
-      cond->addArgument(newType, cinfo.pushOp->getLoc());
-
       {
         OpBuilder::InsertionGuard guard(rewriter);
         rewriter.setInsertionPoint(cinfo.pushOp);
 
-        Value newCacheValue;
-        if (auto TT = dyn_cast<TensorType>(cinfo.cachedType())) {
-          auto shape = TT.getShape();
+        auto parts = storage.encode(rewriter, cinfo.pushOp->getLoc());
+        for (auto &&[part, cacheValue] : llvm::zip_equal(parts, cacheValues)) {
+          Value newCacheValue;
+          if (auto TT = dyn_cast<TensorType>(part.getType())) {
+            auto shape = TT.getShape();
+
+            SmallVector<Value> startIndices(shape.size() + 1, zero);
+            startIndices[0] = inductionVariable;
+
+            SmallVector<int64_t> updateShape;
+            updateShape.push_back(1);
+            updateShape.append(shape.begin(), shape.end());
+            Value reshapedUpdate = stablehlo::ReshapeOp::create(
+                rewriter, cinfo.pushOp->getLoc(), TT.clone(updateShape),
+                part);
+
+            newCacheValue = stablehlo::DynamicUpdateSliceOp::create(
+                rewriter, cinfo.pushOp->getLoc(), cacheValue, reshapedUpdate,
+                startIndices);
+          } else {
+            assert(false && "todo");
+            // newCacheValue = tensor::InsertOp::create(rewriter,
+            //     info.pushOp->getLoc(), info.pushOp.getValue(), cacheValue,
+            //     inductionVariable);
+          }
 
-          SmallVector<Value> startIndices(shape.size() + 1, zero);
-          startIndices[0] = inductionVariable;
-
-          SmallVector<int64_t> updateShape;
-          updateShape.push_back(1);
-          updateShape.append(shape.begin(), shape.end());
-          Value reshapedUpdate = stablehlo::ReshapeOp::create(
-              rewriter, cinfo.pushOp->getLoc(), TT.clone(updateShape),
-              cinfo.pushOp.getValue());
-
-          newCacheValue = stablehlo::DynamicUpdateSliceOp::create(
-              rewriter, cinfo.pushOp->getLoc(), cacheValue, reshapedUpdate,
-              startIndices);
-        } else {
-          assert(false && "todo");
-          // newCacheValue = tensor::InsertOp::create(rewriter,
-          //     info.pushOp->getLoc(), info.pushOp.getValue(), cacheValue,
-          //     inductionVariable);
+          term->insertOperands(term->getNumOperands(),
+                               ValueRange(newCacheValue));
         }
-
-        term->insertOperands(term->getNumOperands(), ValueRange(newCacheValue));
       }
     }
 
@@ -3328,41 +4264,33 @@ public:
     }
 
     // 5. Finally, replace pops with slices.
-    for (auto &info : caches) {
+    for (auto &&[info, storage] : llvm::zip_equal(caches, storages)) {
       if (info.pushedValue().getParentRegion() != &newWhile.getBody())
         continue;
 
       Value cache = info.initOp.getResult();
 
-      auto newType =
-          cast<ShapedType>(cast<AutoDiffTypeInterface>(info.cachedType())
-                               .getShadowType(numIters));
-      // Must match step 3: use 1D cache type for scalar so dynamic_update_slice
-      // is valid.
-      if (newType.getRank() == 0) {
-        newType = RankedTensorType::get({numIters}, newType.getElementType());
-      }
-      enzyme::InitOp newInit = ({
-        OpBuilder::InsertionGuard guard(rewriter);
-        rewriter.setInsertionPoint(info.initOp);
+      SmallVector<Value> parts;
+      for (Type partType : storage.getPartTypes()) {
+        // Must match step 3.
+        auto newType = getStackedType(partType);
+        enzyme::InitOp newInit = ({
+          OpBuilder::InsertionGuard guard(rewriter);
+          rewriter.setInsertionPoint(info.initOp);
 
-        enzyme::InitOp::create(
-            rewriter, info.initOp->getLoc(),
-            enzyme::CacheType::get(cache.getContext(), newType));
-      });
-      info.pushOp = ({
-        OpBuilder::InsertionGuard guard(rewriter);
-        rewriter.setInsertionPointAfter(newWhile);
-        auto newPush = enzyme::PushOp::create(rewriter, cache.getLoc(),
-                                              newInit.getResult(),
-                                              newWhile->getResult(resultIdx));
-        rewriter.eraseOp(info.pushOp);
-        newPush;
-      });
+          enzyme::InitOp::create(
+              rewriter, info.initOp->getLoc(),
+              enzyme::CacheType::get(cache.getContext(), newType));
+        });
+        {
+          OpBuilder::InsertionGuard guard(rewriter);
+          rewriter.setInsertionPointAfter(newWhile);
+          enzyme::PushOp::create(rewriter, cache.getLoc(), newInit.getResult(),
+                                 newWhile->getResult(resultIdx));
+        }
 
-      resultIdx++;
+        resultIdx++;
 
-      {
         OpBuilder::InsertionGuard guard(rewriter);
 
         rewriter.setInsertionPoint(otherWhileOp);
@@ -3377,7 +4305,7 @@ public:
             popBody->getArgument(popBody->getNumArguments() - 1);
 
         Value popValue;
-        if (auto TT = dyn_cast<TensorType>(info.cachedType())) {
+        if (auto TT = dyn_cast<TensorType>(partType)) {
           auto shape = TT.getShape();
           SmallVector<Value> startIndices(shape.size() + 1, zero);
           startIndices[0] = newInductionVariable;
@@ -3395,7 +4323,14 @@ public:
           assert(false && "todo");
           // popValue = tensor.extract(%popNewValue)
         }
+        parts.push_back(popValue);
+      }
+      rewriter.eraseOp(info.pushOp);
 
+      {
+        OpBuilder::InsertionGuard guard(rewriter);
+        rewriter.setInsertionPoint(info.popOp);
+        Value popValue = storage.decode(rewriter, info.popOp->getLoc(), parts);
         rewriter.replaceAllUsesWith(info.popOp, popValue);
         rewriter.eraseOp(info.popOp);
       }
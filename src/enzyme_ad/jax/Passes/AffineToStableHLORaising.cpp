@@ -1272,6 +1272,267 @@ template <> SmallVector<BlockArgument, 6> getIVs(affine::AffineForOp op) {
   return {op.getInductionVar()};
 }
 
+// Returns the kind of reduction `op` performs when used to combine a loop
+// accumulator with a new value. Unsigned and NaN-suppressing min/max have no
+// exact stablehlo counterpart and are not considered reductions.
+static std::optional<arith::AtomicRMWKind> getReductionKind(Operation *op) {
+  if (isa<arith::AddFOp>(op))
+    return arith::AtomicRMWKind::addf;
+  if (isa<arith::AddIOp>(op))
+    return arith::AtomicRMWKind::addi;
+  if (isa<arith::MulFOp>(op))
+    return arith::AtomicRMWKind::mulf;
+  if (isa<arith::MulIOp>(op))
+    return arith::AtomicRMWKind::muli;
+  if (isa<arith::MaximumFOp>(op))
+    return arith::AtomicRMWKind::maximumf;
+  if (isa<arith::MinimumFOp>(op))
+    return arith::AtomicRMWKind::minimumf;
+  if (isa<arith::MaxSIOp>(op))
+    return arith::AtomicRMWKind::maxs;
+  if (isa<arith::MinSIOp>(op))
+    return arith::AtomicRMWKind::mins;
+  return std::nullopt;
+}
+
+static Value emitReductionCombiner(OpBuilder &builder, Location loc,
+                                   arith::AtomicRMWKind kind, Value lhs,
+                                   Value rhs) {
+  switch (kind) {
+  case arith::AtomicRMWKind::addf:
+  case arith::AtomicRMWKind::addi:
+    return stablehlo::AddOp::create(builder, loc, lhs, rhs);
+  case arith::AtomicRMWKind::mulf:
+  case arith::AtomicRMWKind::muli:
+    return stablehlo::MulOp::create(builder, loc, lhs, rhs);
+  case arith::AtomicRMWKind::maximumf:
+  case arith::AtomicRMWKind::maxs:
+    return stablehlo::MaxOp::create(builder, loc, lhs, rhs);
+  case arith::AtomicRMWKind::minimumf:
+  case arith::AtomicRMWKind::mins:
+    return stablehlo::MinOp::create(builder, loc, lhs, rhs);
+  default:
+    llvm_unreachable("unhandled reduction kind");
+  }
+}
+
+// Returns the neutral element of `kind` as a rank-0 tensor constant.
+static Value emitReductionIdentity(OpBuilder &builder, Location loc,
+                                   arith::AtomicRMWKind kind,
+                                   Type elementType) {
+  auto unrankedTensorType = RankedTensorType::get({}, elementType);
+  auto identity =
+      arith::getIdentityValueAttr(kind, elementType, builder, loc);
+  return stablehlo::ConstantOp::create(
+      builder, loc,
+      DenseElementsAttr::get(unrankedTensorType,
+                             ArrayRef<Attribute>(identity)));
+}
+
+// Populates the body of a stablehlo.reduce or stablehlo.reduce_window
+// combining its elements with `kind`.
+static void buildReductionBody(Region &region, arith::AtomicRMWKind kind,
+                               Type elementType, Location loc) {
+  auto unrankedTensorType = RankedTensorType::get({}, elementType);
+  auto block = new Block();
+  region.push_back(block);
+  auto a = block->addArgument(unrankedTensorType, loc);
+  auto b = block->addArgument(unrankedTensorType, loc);
+  OpBuilder builder(block, block->end());
+  stablehlo::ReturnOp::create(
+      builder, loc, emitReductionCombiner(builder, loc, kind, a, b));
+}
+
+// Returns the induction variable indexing each dimension of a value with
+// access map `map`, or failure if some dimension is not indexed by exactly one
+// induction variable of its own.
+static FailureOr<SmallVector<Value>>
+getDimensionIVs(const affine::AffineValueMap &map) {
+  SmallVector<Value> ivs;
+  for (auto expr : map.getAffineMap().getResults()) {
+    auto dim = dyn_cast<AffineDimExpr>(expr);
+    if (!dim)
+      return failure();
+    Value iv = map.getOperands()[dim.getPosition()];
+    if (llvm::is_contained(ivs, iv))
+      return failure();
+    ivs.push_back(iv);
+  }
+  return ivs;
+}
+
+// Raises a reduction over `forOp` whose partial results are only observed
+// through the loop result. Instead of materializing every prefix with a
+// reduce_window, the loop dimension is reduced at once: a sum of products is
+// emitted as a stablehlo.dot_general contracting the loop dimension (so that
+// matmul nests become a single contraction), anything else as a
+// stablehlo.reduce. The reduced value is then combined with the initial value
+// of the accumulator.
+static void
+raiseLoopReduction(Operation *innerOp, affine::AffineForOp forOp,
+                   Value reducedVal, Value initVal, arith::AtomicRMWKind kind,
+                   bool isSub, IRMapping &mapping, OpBuilder &builder,
+                   llvm::DenseMap<Value, affine::AffineValueMap> &maps,
+                   ParallelContext pc) {
+  auto loc =
+      rewriteLocation(innerOp->getLoc(), pc.options.strip_llvm_debuginfo);
+  auto findLoopDim = [&](affine::AffineValueMap &map) -> int64_t {
+    for (auto &&[i, expr] : llvm::enumerate(map.getAffineMap().getResults())) {
+      auto dim = cast<AffineDimExpr>(expr);
+      if (map.getOperands()[dim.getPosition()] == forOp.getInductionVar())
+        return i;
+    }
+    return -1;
+  };
+
+  Value reduced;
+  affine::AffineValueMap reducedMap;
+  affine::AffineValueMap inputMap;
+  int64_t idx_to_reduce = -1;
+
+  Operation *mul = reducedVal.getDefiningOp();
+  bool isContraction =
+      mul && mul->getBlock() == forOp.getBody() && reducedVal.hasOneUse() &&
+      ((kind == arith::AtomicRMWKind::addf && isa<arith::MulFOp>(mul)) ||
+       (kind == arith::AtomicRMWKind::addi && isa<arith::MulIOp>(mul)));
+  if (isContraction) {
+    Value lhs = mapping.lookup(mul->getOperand(0));
+    Value rhs = mapping.lookup(mul->getOperand(1));
+    auto lhsMap = maps.lookup(lhs);
+    auto rhsMap = maps.lookup(rhs);
+
+    // When both operands are indexed by distinct induction variables, the
+    // contraction is emitted on them directly: induction variables indexing
+    // both operands are batch dimensions, the others free dimensions. A
+    // matmul nest then becomes a plain GEMM on the loaded operands.
+    auto lhsIVs = getDimensionIVs(lhsMap);
+    auto rhsIVs = getDimensionIVs(rhsMap);
+    Value loopIV = forOp.getInductionVar();
+    if (succeeded(lhsIVs) && succeeded(rhsIVs) &&
+        llvm::is_contained(*lhsIVs, loopIV) &&
+        llvm::is_contained(*rhsIVs, loopIV)) {
+      auto lhsType = cast<RankedTensorType>(lhs.getType());
+      auto rhsType = cast<RankedTensorType>(rhs.getType());
+      SmallVector<int64_t> lhsBatch, rhsBatch, lhsContract, rhsContract;
+      SmallVector<int64_t> shape, freeShape;
+      SmallVector<Value> resultIVs, freeIVs;
+      for (auto [i, iv] : llvm::enumerate(*lhsIVs)) {
+        auto rhsPos = llvm::find(*rhsIVs, iv);
+        if (iv == loopIV) {
+          lhsContract.push_back(i);
+          rhsContract.push_back(rhsPos - rhsIVs->begin());
+        } else if (rhsPos != rhsIVs->end()) {
+          lhsBatch.push_back(i);
+          rhsBatch.push_back(rhsPos - rhsIVs->begin());
+          resultIVs.push_back(iv);
+          shape.push_back(lhsType.getDimSize(i));
+        } else {
+          freeIVs.push_back(iv);
+          freeShape.push_back(lhsType.getDimSize(i));
+        }
+      }
+      for (auto [i, iv] : llvm::enumerate(*rhsIVs)) {
+        if (llvm::is_contained(*lhsIVs, iv))
+          continue;
+        freeIVs.push_back(iv);
+        freeShape.push_back(rhsType.getDimSize(i));
+      }
+      llvm::append_range(resultIVs, freeIVs);
+      llvm::append_range(shape, freeShape);
+
+      auto dotDims = stablehlo::DotDimensionNumbersAttr::get(
+          builder.getContext(), lhsBatch, rhsBatch, lhsContract, rhsContract);
+      reduced = stablehlo::DotGeneralOp::create(
+          builder, loc, lhsType.clone(shape), lhs, rhs, dotDims,
+          /*precision_config=*/nullptr, /*algorithm=*/nullptr);
+      reducedMap.reset(AffineMap::getMultiDimIdentityMap(resultIVs.size(),
+                                                         builder.getContext()),
+                       resultIVs);
+    }
+  }
+
+  if (isContraction && !reduced) {
+    Value lhs = mapping.lookup(mul->getOperand(0));
+    Value rhs = mapping.lookup(mul->getOperand(1));
+    auto lhsMap = maps.lookup(lhs);
+    auto rhsMap = maps.lookup(rhs);
+    inputMap = alignMemoryAccess(lhs, lhsMap, rhs, rhsMap, builder, pc);
+    idx_to_reduce = findLoopDim(inputMap);
+
+    if (idx_to_reduce != -1) {
+      auto inputType = cast<RankedTensorType>(lhs.getType());
+      SmallVector<int64_t> batchDims;
+      SmallVector<int64_t> shape;
+      for (int64_t i = 0; i < inputType.getRank(); i++) {
+        if (i == idx_to_reduce)
+          continue;
+        batchDims.push_back(i);
+        shape.push_back(inputType.getDimSize(i));
+      }
+      auto dotDims = stablehlo::DotDimensionNumbersAttr::get(
+          builder.getContext(), batchDims, batchDims, {idx_to_reduce},
+          {idx_to_reduce});
+      reduced = stablehlo::DotGeneralOp::create(
+          builder, loc, inputType.clone(shape), lhs, rhs, dotDims,
+          /*precision_config=*/nullptr, /*algorithm=*/nullptr);
+    }
+  }
+
+  if (!reduced) {
+    // Aligning with the induction variable broadcasts loop invariant values
+    // along the loop dimension.
+    Value input = mapping.lookup(reducedVal);
+    Value iv = mapping.lookup(forOp.getInductionVar());
+    auto valMap = maps.lookup(input);
+    auto ivMap = maps.lookup(iv);
+    inputMap = alignMemoryAccess(input, valMap, iv, ivMap, builder, pc);
+    idx_to_reduce = findLoopDim(inputMap);
+    assert(idx_to_reduce != -1);
+
+    auto inputType = cast<RankedTensorType>(input.getType());
+    SmallVector<int64_t> shape;
+    for (int64_t i = 0; i < inputType.getRank(); i++)
+      if (i != idx_to_reduce)
+        shape.push_back(inputType.getDimSize(i));
+
+    Value inputs[] = {input};
+    Type types[] = {inputType.clone(shape)};
+    Value inits[] = {emitReductionIdentity(builder, loc, kind,
+                                           inputType.getElementType())};
+    auto red = stablehlo::ReduceOp::create(
+        builder, loc, types, inputs, inits,
+        builder.getDenseI64ArrayAttr({idx_to_reduce}));
+    buildReductionBody(red.getBody(), kind, inputType.getElementType(), loc);
+    reduced = red->getResult(0);
+  }
+
+  if (idx_to_reduce != -1) {
+    SmallVector<AffineExpr> exprs;
+    for (auto &&[i, expr] :
+         llvm::enumerate(inputMap.getAffineMap().getResults()))
+      if (i != idx_to_reduce)
+        exprs.push_back(expr);
+    reducedMap.reset(AffineMap::get(inputMap.getAffineMap().getNumDims(),
+                                    inputMap.getAffineMap().getNumSymbols(),
+                                    exprs, builder.getContext()),
+                     inputMap.getOperands());
+    reducedMap.composeSimplifyAndCanonicalize();
+  }
+
+  Value init = mapping.lookup(initVal);
+  auto initMap = maps.lookup(init);
+  auto outputMap =
+      alignMemoryAccess(reduced, reducedMap, init, initMap, builder, pc);
+
+  Value result;
+  if (isSub)
+    result = stablehlo::SubtractOp::create(builder, loc, init, reduced);
+  else
+    result = emitReductionCombiner(builder, loc, kind, reduced, init);
+  mapping.map(innerOp->getResult(0), result);
+  maps[result] = outputMap;
+}
+
 template <class T>
 static LogicalResult tryRaisingParallelOpToStableHLO(
     T parallelOp, IRMapping &parentMapping, OpBuilder &builder,
@@ -1317,12 +1578,31 @@ static LogicalResult tryRaisingParallelOpToStableHLO(
       Value reduced_val = innerOp.getOperand(1 - op_idx);
       Value init_val = iter_inputs[reduced_idx];
 
-      Value reduce_broadcasted = mapping.lookup(reduced_val);
-      auto reduce_map = maps.lookup(reduce_broadcasted);
-
       auto forOp = cast<affine::AffineForOp>(
           iters[reduced_idx].getOwner()->getParentOp());
 
+      // `acc - x` accumulates a sum which is subtracted from the init.
+      bool isSub = isa<arith::SubIOp, arith::SubFOp>(&innerOp);
+      arith::AtomicRMWKind kind;
+      if (isa<arith::SubFOp>(&innerOp))
+        kind = arith::AtomicRMWKind::addf;
+      else if (isa<arith::SubIOp>(&innerOp))
+        kind = arith::AtomicRMWKind::addi;
+      else
+        kind = *getReductionKind(&innerOp);
+
+      // Only the final value is used (by the yield): no need to compute the
+      // partial results of every iteration.
+      if (innerOp.getResult(0).hasOneUse() &&
+          isa<affine::AffineYieldOp>(*innerOp.getResult(0).user_begin())) {
+        raiseLoopReduction(&innerOp, forOp, reduced_val, init_val, kind,
+                           isSub, mapping, builder, maps, *newPc);
+        continue;
+      }
+
+      Value reduce_broadcasted = mapping.lookup(reduced_val);
+      auto reduce_map = maps.lookup(reduce_broadcasted);
+
       Value idx_broadcasted = mapping.lookup(forOp.getInductionVar());
       auto idx_map = maps.lookup(idx_broadcasted);
 
@@ -1344,13 +1624,13 @@ static LogicalResult tryRaisingParallelOpToStableHLO(
       }
       assert(idx_to_reduce != -1);
 
-      auto unrankedTensorType = RankedTensorType::get(
-          {}, cast<RankedTensorType>(reduce_broadcasted.getType())
-                  .getElementType());
-      Value init_values[1] = {stablehlo::ConstantOp::create(
+      auto elementType =
+          cast<RankedTensorType>(reduce_broadcasted.getType())
+              .getElementType();
+      Value init_values[1] = {emitReductionIdentity(
           builder,
           rewriteLocation(innerOp.getLoc(), pc.options.strip_llvm_debuginfo),
-          builder.getZeroAttr(unrankedTensorType))};
+          kind, elementType)};
 
       auto shape =
           cast<RankedTensorType>(reduce_broadcasted.getType()).getShape();
@@ -1378,41 +1658,21 @@ static LogicalResult tryRaisingParallelOpToStableHLO(
               RankedTensorType::get(padding_shape, builder.getIntegerType(64)),
               padding_dialations));
 
-      auto block = new Block();
-      redwin.getBody().push_back(block);
-
-      auto a = block->addArgument(
-          unrankedTensorType,
-          rewriteLocation(innerOp.getLoc(), pc.options.strip_llvm_debuginfo));
-      auto b = block->addArgument(
-          unrankedTensorType,
+      buildReductionBody(
+          redwin.getBody(), kind, elementType,
           rewriteLocation(innerOp.getLoc(), pc.options.strip_llvm_debuginfo));
 
-      {
-        OpBuilder builder(block, block->end());
-        auto addOp = stablehlo::AddOp::create(
-            builder,
-            rewriteLocation(innerOp.getLoc(), pc.options.strip_llvm_debuginfo),
-            a, b);
-        stablehlo::ReturnOp::create(
-            builder,
-            rewriteLocation(innerOp.getLoc(), pc.options.strip_llvm_debuginfo),
-            addOp.getResult());
-      }
-
       Value result = redwin->getResult(0);
-      if (isa<arith::AddIOp, arith::AddFOp>(&innerOp)) {
-        result = stablehlo::AddOp::create(
-            builder,
-            rewriteLocation(innerOp.getLoc(), pc.options.strip_llvm_debuginfo),
-            result, dsts[1]);
-      } else if (isa<arith::SubIOp, arith::SubFOp>(&innerOp)) {
+      if (isSub) {
         result = stablehlo::SubtractOp::create(
             builder,
             rewriteLocation(innerOp.getLoc(), pc.options.strip_llvm_debuginfo),
             dsts[1], result);
       } else {
-        llvm_unreachable("unhandled reduction");
+        result = emitReductionCombiner(
+            builder,
+            rewriteLocation(innerOp.getLoc(), pc.options.strip_llvm_debuginfo),
+            kind, result, dsts[1]);
       }
 
       mapping.map(innerOp.getResult(0), result);
@@ -1563,6 +1823,12 @@ static LogicalResult tryRaisingParallelOpToStableHLO(
       switch (kind) {
       case arith::AtomicRMWKind::addf:
       case arith::AtomicRMWKind::addi:
+      case arith::AtomicRMWKind::mulf:
+      case arith::AtomicRMWKind::muli:
+      case arith::AtomicRMWKind::maximumf:
+      case arith::AtomicRMWKind::minimumf:
+      case arith::AtomicRMWKind::maxs:
+      case arith::AtomicRMWKind::mins:
         break;
       default:
         return failure();
@@ -1571,40 +1837,22 @@ static LogicalResult tryRaisingParallelOpToStableHLO(
       Value inputs[] = {val};
       Type types[] = {RankedTensorType::get(redshape, res.getType())};
 
-      auto unrankedTensorType = RankedTensorType::get(
-          {}, cast<RankedTensorType>(val.getType()).getElementType());
-      Value inits[1] = {stablehlo::ConstantOp::create(
+      auto elementType =
+          cast<RankedTensorType>(val.getType()).getElementType();
+      Value inits[1] = {emitReductionIdentity(
           builder,
-          rewriteLocation(res.getLoc(), pc.options.strip_llvm_debuginfo),
-          builder.getZeroAttr(unrankedTensorType))};
+          rewriteLocation(res.getLoc(), pc.options.strip_llvm_debuginfo), kind,
+          elementType)};
 
       auto red = stablehlo::ReduceOp::create(
           builder,
           rewriteLocation(val.getLoc(), pc.options.strip_llvm_debuginfo), types,
           inputs, inits, builder.getDenseI64ArrayAttr(idxs_to_reduce));
 
-      auto block = new Block();
-      red.getBody().push_back(block);
-
-      auto a = block->addArgument(
-          unrankedTensorType,
-          rewriteLocation(res.getLoc(), pc.options.strip_llvm_debuginfo));
-      auto b = block->addArgument(
-          unrankedTensorType,
+      buildReductionBody(
+          red.getBody(), kind, elementType,
           rewriteLocation(res.getLoc(), pc.options.strip_llvm_debuginfo));
 
-      {
-        OpBuilder builder(block, block->end());
-        auto addOp = stablehlo::AddOp::create(
-            builder,
-            rewriteLocation(res.getLoc(), pc.options.strip_llvm_debuginfo), a,
-            b);
-        stablehlo::ReturnOp::create(
-            builder,
-            rewriteLocation(res.getLoc(), pc.options.strip_llvm_debuginfo),
-            addOp.getResult());
-      }
-
       SmallVector<Value> vals;
       for (auto v : outputMap.getOperands()) {
         auto operand = dyn_cast<BlockArgument>(v);
@@ -1661,7 +1909,7 @@ static bool isLockStepExecutable(affine::AffineForOp forOp,
           llvm::errs() << "user not directly in for: " << *user << "\n";
         return false;
       }
-      if (isa<arith::AddIOp, arith::AddFOp>(user)) {
+      if (getReductionKind(user)) {
       } else if (auto sub = dyn_cast<arith::SubIOp>(user)) {
         if (sub.getRhs() == arg) {
           if (pc.options.dump_failed_lockstep)
@@ -2680,6 +2928,119 @@ struct PushReductionsDown : public OpRewritePattern<arith::AddFOp> {
   }
 };
 
+// Whether an access through `v` may touch the memory behind `mem`. Distinct
+// function arguments are only assumed not to alias when one of them is marked
+// `llvm.noalias`; views and casts resolve to their base and alias it.
+static bool mayAliasAccumulator(Value v, Value mem) {
+  if (!mayAlias(v, mem))
+    return false;
+  Value base = getBase(v), memBase = getBase(mem);
+  if (base == memBase)
+    return true;
+  auto isNoAliasArg = [](Value val) {
+    auto arg = dyn_cast<BlockArgument>(val);
+    if (!arg || !arg.getOwner()->isEntryBlock())
+      return false;
+    auto func = dyn_cast<FunctionOpInterface>(arg.getOwner()->getParentOp());
+    return func && func.getArgAttr(arg.getArgNumber(),
+                                   LLVM::LLVMDialect::getNoAliasAttrName());
+  };
+  auto isDistinctBase = [](Value val) {
+    return isStackAlloca(val) ||
+           (isa<BlockArgument>(val) &&
+            isa<FunctionOpInterface>(
+                cast<BlockArgument>(val).getOwner()->getParentOp()));
+  };
+  return !((isNoAliasArg(base) && isDistinctBase(memBase)) ||
+           (isNoAliasArg(memBase) && isDistinctBase(base)));
+}
+
+// Promotes a memory location that is loaded and then stored at the same
+// loop-invariant index in every iteration to an iter_arg, so that an
+// accumulation through memory raises like an explicit reduction:
+//
+//   affine.for %k {                  %init = affine.load %C[%i, %j]
+//     %c = affine.load %C[%i, %j]    %r = affine.for %k iter_args(%c = %init)
+//     affine.store %s, %C[%i, %j]      affine.yield %s
+//   }                                affine.store %r, %C[%i, %j]
+struct PromoteLoopAccumulator : public OpRewritePattern<affine::AffineForOp> {
+  using OpRewritePattern::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(affine::AffineForOp forOp,
+                                PatternRewriter &rewriter) const final {
+    for (auto load : forOp.getBody()->getOps<affine::AffineLoadOp>()) {
+      if (!llvm::all_of(load.getMapOperands(), [&](Value v) {
+            return forOp.isDefinedOutsideOfLoop(v);
+          }))
+        continue;
+
+      affine::AffineStoreOp store;
+      bool otherUses = false;
+      for (Operation *user : load.getMemRef().getUsers()) {
+        if (user == load || !forOp->isAncestor(user))
+          continue;
+        auto st = dyn_cast<affine::AffineStoreOp>(user);
+        if (store || !st || st->getBlock() != forOp.getBody() ||
+            st.getAffineMap() != load.getAffineMap() ||
+            !llvm::equal(st.getMapOperands(), load.getMapOperands()) ||
+            !load->isBeforeInBlock(st)) {
+          otherUses = true;
+          break;
+        }
+        store = st;
+      }
+      if (otherUses || !store)
+        continue;
+
+      // Any other write in the loop might alias the promoted location, and a
+      // read through an aliasing memref would miss the promoted updates.
+      Value memref = load.getMemRef();
+      auto onlyReads = forOp.getBody()->walk([&](Operation *op) {
+        if (op == store || op == load || isMemoryEffectFree(op) ||
+            op->hasTrait<OpTrait::HasRecursiveMemoryEffects>())
+          return WalkResult::advance();
+        auto iface = dyn_cast<MemoryEffectOpInterface>(op);
+        if (!iface || !iface.onlyHasEffect<MemoryEffects::Read>())
+          return WalkResult::interrupt();
+        SmallVector<MemoryEffects::EffectInstance> effects;
+        iface.getEffects(effects);
+        for (auto &effect : effects) {
+          Value read = effect.getValue();
+          if (!read || mayAliasAccumulator(read, memref))
+            return WalkResult::interrupt();
+        }
+        return WalkResult::advance();
+      });
+      if (onlyReads.wasInterrupted())
+        continue;
+
+      rewriter.setInsertionPoint(forOp);
+      auto init = affine::AffineLoadOp::create(
+          rewriter, load.getLoc(), load.getMemRef(), load.getAffineMap(),
+          load.getMapOperands());
+      Value stored = store.getValueToStore();
+      auto newLoop = forOp.replaceWithAdditionalYields(
+          rewriter, ValueRange(init), /*replaceInitOperandUsesInLoop=*/false,
+          [&](OpBuilder &, Location, ArrayRef<BlockArgument>) {
+            return SmallVector<Value>{stored};
+          });
+      if (failed(newLoop))
+        return failure();
+      auto newFor = cast<affine::AffineForOp>(newLoop->getOperation());
+      rewriter.replaceAllUsesWith(load, newFor.getRegionIterArgs().back());
+      rewriter.setInsertionPointAfter(newFor);
+      affine::AffineStoreOp::create(rewriter, store.getLoc(),
+                                    newFor.getResults().back(),
+                                    store.getMemRef(), store.getAffineMap(),
+                                    store.getMapOperands());
+      rewriter.eraseOp(store);
+      rewriter.eraseOp(load);
+      return success();
+    }
+    return failure();
+  }
+};
+
 struct AffineToStableHLORaisingPass
     : public enzyme::impl::AffineToStableHLORaisingBase<
           AffineToStableHLORaisingPass> {
@@ -2696,7 +3057,7 @@ struct AffineToStableHLORaisingPass
     if (enable_lockstep_for) {
 
       RewritePatternSet patterns(context);
-      patterns.add<PushReductionsDown>(context);
+      patterns.add<PushReductionsDown, PromoteLoopAccumulator>(context);
       GreedyRewriteConfig config;
       if (failed(applyPatternsAndFoldGreedily(getOperation(),
                                               std::move(patterns), config))) {
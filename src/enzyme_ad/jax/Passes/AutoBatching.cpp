@@ -878,6 +878,26 @@ SliceToBatchBase::matchAndRewriteImpl(stablehlo::SliceOp sliceOp,
   return success();
 }
 
+// Running total of the bytes of intermediates batched out of a while loop in
+// the "cost" batching mode.
+constexpr llvm::StringLiteral kBatchedBytesAttrName = "enzymexla.batched_bytes";
+
+static int64_t getTensorBytes(Type type) {
+  auto tensorType = dyn_cast<RankedTensorType>(type);
+  if (!tensorType || !tensorType.hasStaticShape())
+    return 0;
+  auto elemType = tensorType.getElementType();
+  int64_t factor = 1;
+  if (auto complexType = dyn_cast<ComplexType>(elemType)) {
+    elemType = complexType.getElementType();
+    factor = 2;
+  }
+  if (!elemType.isIntOrFloat())
+    return 0;
+  return tensorType.getNumElements() * factor *
+         llvm::divideCeil(elemType.getIntOrFloatBitWidth(), 8);
+}
+
 static bool definedOutside(Value v, Operation *op) {
   return !op->isAncestor(v.getParentBlock()->getParentOp());
 }
@@ -997,29 +1017,114 @@ LogicalResult GreedyWhileLoopBatchFission::matchAndRewriteImpl(
     return failure();
   }
 
+  // With a cost model, only the candidates whose saved kernel launches are
+  // worth their batched intermediates are kept, cheapest first, until the
+  // memory budget of the loop is used up. The remaining users of a slice stay
+  // in the loop.
+  SmallVector<std::pair<Operation *, int64_t>> candidates;
+  for (auto &[op, slices] : userOpToSlicesMap)
+    candidates.push_back({op, 0});
+
+  if (cost) {
+    int64_t numIters = info.getConstantNumIters();
+    if (numIters <= 1)
+      return failure();
+    int64_t savedBytes = (numIters - 1) * cost->launchCostBytes;
+
+    int64_t budget = std::numeric_limits<int64_t>::max();
+    if (cost->maxMemoryRatio >= 0) {
+      int64_t stateBytes = 0;
+      for (auto type : whileOp->getOperandTypes())
+        stateBytes += getTensorBytes(type);
+      auto batched =
+          whileOp->getAttrOfType<IntegerAttr>(kBatchedBytesAttrName);
+      budget = static_cast<int64_t>(cost->maxMemoryRatio * stateBytes) -
+               (batched ? batched.getInt() : 0);
+    }
+
+    for (auto &[op, bytes] : candidates)
+      bytes = estimateBatchedBytes(op, userOpToSlicesMap[op], numIters);
+    llvm::erase_if(candidates, [&](auto &candidate) {
+      return candidate.second > savedBytes;
+    });
+    llvm::stable_sort(candidates, [](auto &lhs, auto &rhs) {
+      return lhs.second < rhs.second;
+    });
+    int64_t used = 0;
+    llvm::erase_if(candidates, [&](auto &candidate) {
+      if (used + candidate.second > budget)
+        return true;
+      used += candidate.second;
+      return false;
+    });
+  }
+
   bool anyOpRewritten = false;
+  int64_t batchedBytes = 0;
 
-  for (auto &[op, slices] : userOpToSlicesMap) {
+  for (auto &[op, bytes] : candidates) {
+    auto &slices = userOpToSlicesMap[op];
     assert(!avoidBatching(op));
+    bool opRewritten = false;
 
     if (auto dsOp = dyn_cast<stablehlo::DynamicSliceOp>(op)) {
       if (raiseDynamicSliceToGather(rewriter, whileOp, slices, dsOp, info)) {
-        anyOpRewritten = true;
+        opRewritten = true;
       }
     } else if ((dyn_cast<BatchOpInterface>(op) ||
                 stablehlo::hasTraitElementwise(op)) &&
                op->getNumResults() == 1) {
       if (liftOperationByBatching(rewriter, whileOp, slices, op, info)) {
-        anyOpRewritten = true;
+        opRewritten = true;
       } else if (liftReduceLikeOperation(rewriter, whileOp, slices, op, info)) {
-        anyOpRewritten = true;
+        opRewritten = true;
       }
     }
+
+    if (opRewritten) {
+      anyOpRewritten = true;
+      batchedBytes += bytes;
+    }
+  }
+
+  if (cost && batchedBytes > 0) {
+    auto batched = whileOp->getAttrOfType<IntegerAttr>(kBatchedBytesAttrName);
+    rewriter.modifyOpInPlace(whileOp, [&] {
+      whileOp->setAttr(kBatchedBytesAttrName,
+                       rewriter.getI64IntegerAttr(
+                           batchedBytes + (batched ? batched.getInt() : 0)));
+    });
   }
 
   return success(anyOpRewritten);
 };
 
+int64_t GreedyWhileLoopBatchFission::estimateBatchedBytes(
+    Operation *op, ArrayRef<SliceInfo<stablehlo::DynamicSliceOp>> slices,
+    int64_t numIters) const {
+  // The batched results are materialized for all iterations.
+  int64_t bytes = 0;
+  for (auto type : op->getResultTypes())
+    bytes += numIters * getTensorBytes(type);
+
+  // Slices of a batched input are views of it and constants are folded into
+  // the batched function, but any other operand is broadcast to all
+  // iterations.
+  for (auto operand : op->getOperands()) {
+    if (matchPattern(operand, m_Constant()))
+      continue;
+    auto defOp = operand.getDefiningOp();
+    if (auto reshape = dyn_cast_or_null<stablehlo::ReshapeOp>(defOp))
+      defOp = reshape.getOperand().getDefiningOp();
+    if (defOp && llvm::any_of(slices, [&](auto &slice) {
+          return slice.sliceOp == defOp;
+        }))
+      continue;
+    bytes += numIters * getTensorBytes(operand.getType());
+  }
+  return bytes;
+}
+
 GreedyWhileLoopBatchFission::ValidBatchingInfo
 GreedyWhileLoopBatchFission::isDynamicSliceValidForBatching(
     stablehlo::DynamicSliceOp sliceOp, mlir::enzyme::WhileLoopInfo &loopInfo,
@@ -2350,6 +2455,9 @@ void populateAutoBatchingPassPatterns(RewritePatternSet &patterns,
 
   if (options.whileLoopBatchingMode == "greedy") {
     patterns.add<GreedyWhileLoopBatchFission>(ctx);
+  } else if (options.whileLoopBatchingMode == "cost") {
+    patterns.add<GreedyWhileLoopBatchFission>(ctx,
+                                              options.whileLoopBatchingCost);
   }
 
   if (options.enableWhileElementwiseReductionToReduce) {
@@ -2382,7 +2490,8 @@ struct AutoBatchingPass
         while_loop_batching_mode,
         while_elementwise_reduction_to_reduce_passes,
         while_is_copy_simplify_passes,
-        while_remove_loop_carried_dependencies_from_load_operations};
+        while_remove_loop_carried_dependencies_from_load_operations,
+        {while_loop_batching_launch_cost, while_loop_batching_memory_ratio}};
     mlir::enzyme::populateAutoBatchingPassPatterns(patterns, context, options);
 
     GreedyRewriteConfig config;
@@ -2392,5 +2501,10 @@ struct AutoBatchingPass
                                             config))) {
       signalPassFailure();
     }
+
+    // The running totals of the "cost" mode are only meaningful while the
+    // patterns run.
+    getOperation()->walk(
+        [](Operation *op) { op->removeAttr(kBatchedBytesAttrName); });
   }
 };
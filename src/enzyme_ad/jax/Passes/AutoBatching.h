@@ -191,13 +191,32 @@ bool liftReduceLikeOperation(
     llvm::ArrayRef<SliceInfo<mlir::stablehlo::DynamicSliceOp>> slices,
     mlir::Operation *op, mlir::enzyme::WhileLoopInfo info);
 
+// Parameters of the cost model deciding which ops are worth batching out of a
+// while loop.
+struct WhileLoopBatchingCost {
+  // Bytes of materialized batched intermediates that one saved kernel launch
+  // is worth.
+  int64_t launchCostBytes = 1 << 20;
+  // Upper bound on the batched intermediates of one loop, as a multiple of the
+  // size of its loop-carried state. Negative means unbounded.
+  double maxMemoryRatio = 1.0;
+};
+
 struct GreedyWhileLoopBatchFission
     : public mlir::enzyme::CheckedOpRewritePattern<
           mlir::stablehlo::WhileOp, GreedyWhileLoopBatchFission> {
   using Base =
       mlir::enzyme::CheckedOpRewritePattern<mlir::stablehlo::WhileOp,
                                             GreedyWhileLoopBatchFission>;
-  using Base::Base;
+
+  // Without a cost model every op that can be batched is batched.
+  std::optional<WhileLoopBatchingCost> cost;
+
+  GreedyWhileLoopBatchFission(
+      mlir::MLIRContext *ctx,
+      std::optional<WhileLoopBatchingCost> cost = std::nullopt,
+      mlir::PatternBenefit benefit = 1)
+      : Base(ctx, benefit), cost(cost) {}
 
   mlir::LogicalResult
   matchAndRewriteImpl(mlir::stablehlo::WhileOp whileOp,
@@ -220,6 +239,11 @@ private:
     llvm::SmallVector<int64_t> dimensions;
   };
 
+  int64_t estimateBatchedBytes(
+      mlir::Operation *op,
+      llvm::ArrayRef<SliceInfo<mlir::stablehlo::DynamicSliceOp>> slices,
+      int64_t numIters) const;
+
   ValidBatchingInfo
   isDynamicSliceValidForBatching(mlir::stablehlo::DynamicSliceOp sliceOp,
                                  mlir::enzyme::WhileLoopInfo &loopInfo,
@@ -331,6 +355,8 @@ struct AutoBatchingPassPipelineOptions {
   bool enableWhileElementwiseReductionToReduce;
   bool enableWhileIsCopySimplify;
   bool enableRemoveLoopCarriedDependenciesFromWhileLoadOperations;
+  // Only used by the "cost" while loop batching mode.
+  WhileLoopBatchingCost whileLoopBatchingCost = {};
 };
 
 void populateAutoBatchingPassPatterns(RewritePatternSet &patterns,
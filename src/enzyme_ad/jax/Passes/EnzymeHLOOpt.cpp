@@ -34,7 +34,9 @@
 #include "src/enzyme_ad/jax/Dialect/Ops.h"
 #include "src/enzyme_ad/jax/Implementations/WhileLoopInfo.h"
 #include "src/enzyme_ad/jax/Passes/EnzymeHLOPatterns.h"
+#include "src/enzyme_ad/jax/Passes/HLOCostModel.h"
 #include "src/enzyme_ad/jax/Passes/Passes.h"
+#include "src/enzyme_ad/jax/Passes/WorklistDriver.h"
 #include "src/enzyme_ad/jax/Utils.h"
 #include "stablehlo/dialect/Base.h"
 #include "stablehlo/dialect/ChloOps.h"
@@ -54,6 +56,10 @@
 #include "llvm/ADT/SmallSet.h"
 
 #include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <iterator>
@@ -33802,14 +33808,140 @@ void mlir::transform::addWrapUnaryElementwise(RewritePatternSet &patterns,
 
 namespace {
 
+// Per-pattern counters collected when `profile_patterns` is enabled.
+struct PatternProfile {
+  uint64_t attempts = 0;
+  uint64_t successes = 0;
+  std::chrono::nanoseconds time{0};
+  std::chrono::nanoseconds successTime{0};
+};
+
+// Forwards to a wrapped pattern while recording how often it was tried, how
+// often it succeeded and how long it took. The wrapper inherits the root
+// kind, benefit and generated ops of the wrapped pattern so the greedy driver
+// orders and dispatches it exactly as it would the original.
+class ProfiledPattern final : public RewritePattern {
+public:
+  static std::unique_ptr<RewritePattern>
+  wrap(std::unique_ptr<RewritePattern> inner, PatternProfile &profile) {
+    SmallVector<StringRef> generated;
+    for (OperationName name : inner->getGeneratedOps())
+      generated.push_back(name.getStringRef());
+
+    std::unique_ptr<ProfiledPattern> wrapped;
+    if (std::optional<OperationName> root = inner->getRootKind())
+      wrapped.reset(new ProfiledPattern(root->getStringRef(), generated,
+                                        std::move(inner), profile));
+    else if (std::optional<TypeID> id = inner->getRootInterfaceID())
+      wrapped.reset(new ProfiledPattern(MatchInterfaceOpTypeTag(), *id,
+                                        generated, std::move(inner), profile));
+    else if (std::optional<TypeID> id = inner->getRootTraitID())
+      wrapped.reset(new ProfiledPattern(MatchTraitOpTypeTag(), *id, generated,
+                                        std::move(inner), profile));
+    else
+      wrapped.reset(new ProfiledPattern(MatchAnyOpTypeTag(), generated,
+                                        std::move(inner), profile));
+    return wrapped;
+  }
+
+  LogicalResult matchAndRewrite(Operation *op,
+                                PatternRewriter &rewriter) const override {
+    auto start = std::chrono::steady_clock::now();
+    LogicalResult result = inner->matchAndRewrite(op, rewriter);
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start);
+    profile.attempts++;
+    profile.time += elapsed;
+    if (succeeded(result)) {
+      profile.successes++;
+      profile.successTime += elapsed;
+    }
+    return result;
+  }
+
+private:
+  template <typename... Tags>
+  ProfiledPattern(std::unique_ptr<RewritePattern> inner,
+                  PatternProfile &profile, ArrayRef<StringRef> generated,
+                  Tags &&...tags)
+      : RewritePattern(std::forward<Tags>(tags)..., inner->getBenefit(),
+                       inner->getContext(), generated),
+        inner(std::move(inner)), profile(profile) {
+    setDebugName(this->inner->getDebugName());
+    addDebugLabels(this->inner->getDebugLabels());
+    setHasBoundedRewriteRecursion(
+        this->inner->hasBoundedRewriteRecursion());
+  }
+
+  ProfiledPattern(StringRef root, ArrayRef<StringRef> generated,
+                  std::unique_ptr<RewritePattern> inner,
+                  PatternProfile &profile)
+      : ProfiledPattern(std::move(inner), profile, generated, root) {}
+  ProfiledPattern(MatchInterfaceOpTypeTag tag, TypeID id,
+                  ArrayRef<StringRef> generated,
+                  std::unique_ptr<RewritePattern> inner,
+                  PatternProfile &profile)
+      : ProfiledPattern(std::move(inner), profile, generated, tag, id) {}
+  ProfiledPattern(MatchTraitOpTypeTag tag, TypeID id,
+                  ArrayRef<StringRef> generated,
+                  std::unique_ptr<RewritePattern> inner,
+                  PatternProfile &profile)
+      : ProfiledPattern(std::move(inner), profile, generated, tag, id) {}
+  ProfiledPattern(MatchAnyOpTypeTag tag, ArrayRef<StringRef> generated,
+                  std::unique_ptr<RewritePattern> inner,
+                  PatternProfile &profile)
+      : ProfiledPattern(std::move(inner), profile, generated, tag) {}
+
+  std::unique_ptr<RewritePattern> inner;
+  PatternProfile &profile;
+};
+
+static void writePatternProfile(llvm::raw_ostream &os,
+                                const llvm::StringMap<PatternProfile> &profiles,
+                                int64_t iterations, bool converged,
+                                std::chrono::nanoseconds total) {
+  auto toMs = [](std::chrono::nanoseconds ns) {
+    return std::chrono::duration<double, std::milli>(ns).count();
+  };
+
+  // Most expensive patterns first so the report can be read top-down.
+  SmallVector<const llvm::StringMapEntry<PatternProfile> *> sorted;
+  for (auto &entry : profiles)
+    sorted.push_back(&entry);
+  llvm::sort(sorted, [](auto *lhs, auto *rhs) {
+    if (lhs->second.time != rhs->second.time)
+      return lhs->second.time > rhs->second.time;
+    return lhs->first() < rhs->first();
+  });
+
+  llvm::json::OStream json(os, 2);
+  json.object([&] {
+    json.attribute("iterations", iterations);
+    json.attribute("converged", converged);
+    json.attribute("total_ms", toMs(total));
+    json.attributeArray("patterns", [&] {
+      for (auto *entry : sorted) {
+        const PatternProfile &profile = entry->second;
+        json.object([&] {
+          json.attribute("name", entry->first());
+          json.attribute("attempts", profile.attempts);
+          json.attribute("successes", profile.successes);
+          json.attribute("time_ms", toMs(profile.time));
+          json.attribute("success_time_ms", toMs(profile.successTime));
+        });
+      }
+    });
+  });
+  os << "\n";
+}
+
 struct EnzymeHLOOptPass
     : public enzyme::impl::EnzymeHLOOptPassBase<EnzymeHLOOptPass> {
   using EnzymeHLOOptPassBase::EnzymeHLOOptPassBase;
 
-  void runOnOperation() override {
-    auto context = getOperation()->getContext();
+  void populatePatterns(RewritePatternSet &patterns) {
+    auto context = patterns.getContext();
 
-    RewritePatternSet patterns(context);
     mlir::enzyme::populateWithGenerated(patterns);
 
     patterns.add<SliceExtend>(context);
@@ -34265,14 +34397,225 @@ struct EnzymeHLOOptPass
       mlir::enzyme::populateAutoBatchingPassPatterns(patterns, context,
                                                      options);
     }
+  }
+
+  LogicalResult applyPatterns(Operation *op,
+                              const FrozenRewritePatternSet &patterns,
+                              const GreedyRewriteConfig &config) {
+    if (driver == "worklist")
+      return applyPatternsWithWorklist(op, patterns, config);
+    return applyPatternsAndFoldGreedily(op, patterns, config);
+  }
+
+  // Chooses between patterns that undo or compete with each other by
+  // optimizing a copy of the module once per alternative and keeping the
+  // alternative with the lowest estimated cost. Pairs are decided one after
+  // the other, each on top of the choices made so far. Only pairs with a
+  // pattern that fired while optimizing the baseline copy are tried, and at
+  // most cost_model_max_runs copies are optimized in total. Returns the
+  // patterns to disable.
+  SmallVector<StringRef>
+  selectCompetingPatterns(const GreedyRewriteConfig &config) {
+    static constexpr std::pair<StringLiteral, StringLiteral> competing[] = {
+        {"TransposeReshapeToBroadcast", "ReshapeTransposeToBroadcast"},
+        {"ConcatToPad", "ConcatPad"},
+        {"SliceConcat", "ConcatSlice"},
+        {"ConstPadConcatToConcat", "ConcatPad"},
+        {"ConstPadConcatToConcat", "PadConcatToConcatPad"},
+        {"ReshapeElementwise", "ElementwiseReshapeLike"},
+    };
+
+    SmallVector<StringRef> disabled;
+    if (!isa<ModuleOp>(getOperation())) {
+      // Optimizing a detached copy of a nested op would hide its symbol table.
+      getOperation()->emitWarning()
+          << "cost_model_selection requires enzyme-hlo-opt to run on a module";
+      return disabled;
+    }
+
+    RewritePatternSet all(&getContext());
+    populatePatterns(all);
+    auto isRegistered = [&](StringRef name) {
+      return llvm::any_of(all.getNativePatterns(), [&](auto &pattern) {
+        return patternHasName(*pattern, name);
+      });
+    };
+
+    // Successes of the competing patterns on the baseline copy. A pattern
+    // that never fired there cannot change the result when disabled.
+    llvm::StringMap<PatternProfile> baselineProfiles;
+    auto competingName = [&](const RewritePattern &pattern) {
+      for (auto [first, second] : competing)
+        for (StringRef name : {StringRef(first), StringRef(second)})
+          if (patternHasName(pattern, name))
+            return std::optional<StringRef>(name);
+      return std::optional<StringRef>();
+    };
+    auto recordCompeting = [&](RewritePatternSet &patterns) {
+      for (auto &pattern : patterns.getNativePatterns())
+        if (std::optional<StringRef> name = competingName(*pattern))
+          pattern = ProfiledPattern::wrap(std::move(pattern),
+                                          baselineProfiles[*name]);
+    };
+    auto fired = [&](StringRef name) {
+      return baselineProfiles.lookup(name).successes != 0;
+    };
+
+    HLOCostModel costModel;
+    int64_t runs = 0;
+    auto evaluate = [&](ArrayRef<StringRef> disabled,
+                        bool record = false) -> std::optional<double> {
+      ++runs;
+      RewritePatternSet patterns(&getContext());
+      populatePatterns(patterns);
+      removePatterns(patterns, disabled);
+      if (record)
+        recordCompeting(patterns);
+      Operation *copy = getOperation()->clone();
+      LogicalResult result = applyPatterns(copy, std::move(patterns), config);
+      double cost = costModel.getScalarCost(copy);
+      copy->erase();
+      if (failed(result))
+        return std::nullopt;
+      return cost;
+    };
+
+    std::optional<double> best = evaluate(disabled, /*record=*/true);
+    if (!best)
+      return disabled;
+    LLVM_DEBUG(llvm::dbgs() << "cost_model_selection: baseline cost " << *best
+                            << "\n");
+
+    for (auto [first, second] : competing) {
+      if (!isRegistered(first) || !isRegistered(second))
+        continue;
+      if (llvm::is_contained(disabled, first) ||
+          llvm::is_contained(disabled, second))
+        continue;
+      if (!fired(first) && !fired(second))
+        continue;
+
+      std::optional<StringRef> choice;
+      for (StringRef candidate : {first, second}) {
+        if (runs >= cost_model_max_runs)
+          break;
+        disabled.push_back(candidate);
+        std::optional<double> cost = evaluate(disabled);
+        disabled.pop_back();
+        LLVM_DEBUG(llvm::dbgs() << "cost_model_selection: without " << candidate
+                                << " cost "
+                                << (cost ? std::to_string(*cost) : "n/a")
+                                << "\n");
+        if (cost && *cost < *best) {
+          best = cost;
+          choice = candidate;
+        }
+      }
+      if (choice)
+        disabled.push_back(*choice);
+      if (runs >= cost_model_max_runs) {
+        LLVM_DEBUG(llvm::dbgs() << "cost_model_selection: stopping after "
+                                << runs << " runs\n");
+        break;
+      }
+    }
+    return disabled;
+  }
+
+  static bool patternHasName(const RewritePattern &pattern, StringRef name) {
+    StringRef debugName = pattern.getDebugName();
+    return debugName == name ||
+           (debugName.ends_with(name) &&
+            debugName.drop_back(name.size()).ends_with("::"));
+  }
+
+  static void removePatterns(RewritePatternSet &patterns,
+                             ArrayRef<StringRef> names) {
+    if (names.empty())
+      return;
+    llvm::erase_if(patterns.getNativePatterns(), [&](auto &pattern) {
+      return llvm::any_of(names, [&](StringRef name) {
+        return patternHasName(*pattern, name);
+      });
+    });
+  }
+
+  void runOnOperation() override {
+    RewritePatternSet patterns(&getContext());
+    populatePatterns(patterns);
 
     GreedyRewriteConfig config;
     config.setMaxIterations(max_iterations);
     config.setUseTopDownTraversal(top_down);
-    if (failed(applyPatternsAndFoldGreedily(getOperation(), std::move(patterns),
-                                            config))) {
-      signalPassFailure();
+
+    if (driver != "greedy" && driver != "worklist") {
+      getOperation()->emitError() << "unknown enzyme-hlo-opt driver '"
+                                  << driver << "'";
+      return signalPassFailure();
+    }
+
+    if (cost_model_selection)
+      removePatterns(patterns, selectCompetingPatterns(config));
+
+    if (!profile_patterns) {
+      if (failed(applyPatterns(getOperation(), std::move(patterns), config)))
+        signalPassFailure();
+      return;
     }
+
+    llvm::StringMap<PatternProfile> profiles;
+    for (auto &pattern : patterns.getNativePatterns()) {
+      StringRef name = pattern->getDebugName();
+      PatternProfile &profile = profiles[name.empty() ? "<unnamed>" : name];
+      pattern = ProfiledPattern::wrap(std::move(pattern), profile);
+    }
+    FrozenRewritePatternSet frozen(std::move(patterns));
+
+    int64_t iterations = 0;
+    bool converged = false;
+    auto start = std::chrono::steady_clock::now();
+    if (driver == "worklist") {
+      converged = succeeded(applyPatternsWithWorklist(
+          getOperation(), frozen, config, /*changed=*/nullptr, &iterations));
+    } else {
+      // Drive the greedy rewriter one iteration at a time so that the number
+      // of sweeps over the module can be reported. Each call re-seeds the
+      // worklist with every op, which is what the driver does between
+      // iterations anyway.
+      GreedyRewriteConfig iterationConfig = config;
+      iterationConfig.setMaxIterations(1);
+      while (max_iterations == GreedyRewriteConfig::kNoLimit ||
+             iterations < max_iterations) {
+        bool changed = false;
+        iterations++;
+        (void)applyPatternsAndFoldGreedily(getOperation(), frozen,
+                                           iterationConfig, &changed);
+        if (!changed) {
+          converged = true;
+          break;
+        }
+      }
+    }
+    auto total = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start);
+
+    if (profile_output == "-") {
+      writePatternProfile(llvm::errs(), profiles, iterations, converged,
+                          total);
+    } else {
+      std::error_code EC;
+      llvm::raw_fd_ostream os(profile_output, EC, llvm::sys::fs::OF_Text);
+      if (EC) {
+        getOperation()->emitError()
+            << "could not open pattern profile output '" << profile_output
+            << "': " << EC.message();
+        return signalPassFailure();
+      }
+      writePatternProfile(os, profiles, iterations, converged, total);
+    }
+
+    if (!converged)
+      signalPassFailure();
   }
 };
 
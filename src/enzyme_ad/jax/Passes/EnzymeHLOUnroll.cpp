@@ -7,7 +7,8 @@
 //===----------------------------------------------------------------------===//
 //
 // This file implements a pass to unroll stablehlo.while ops with known number
-// of iterations.
+// of iterations, either fully or by a factor with peeled first and last
+// iterations.
 //
 //===----------------------------------------------------------------------===//
 
@@ -15,6 +16,7 @@
 
 #include "mlir/IR/Builders.h"
 #include "mlir/IR/IRMapping.h"
+#include "llvm/ADT/MapVector.h"
 
 #include "src/enzyme_ad/jax/CheckedRewrite.h"
 #include "src/enzyme_ad/jax/Passes/Passes.h"
@@ -32,6 +34,7 @@
 #include "mlir/Dialect/Tensor/IR/Tensor.h"
 
 #include "src/enzyme_ad/jax/Implementations/WhileLoopInfo.h"
+#include "src/enzyme_ad/jax/Utils.h"
 
 namespace mlir {
 namespace enzyme {
@@ -44,6 +47,38 @@ using namespace mlir;
 using namespace mlir::enzyme;
 using namespace enzyme;
 
+// Clones `count` iterations of the body of `op` at the insertion point of
+// `rewriter`, starting from the carried values `values`, and returns the
+// values carried out of the last one. If `innerLoops` is set, the clones of
+// each while op of the body are appended to its entry.
+static SmallVector<Value> cloneIterations(
+    stablehlo::WhileOp op, int64_t count, ValueRange values,
+    RewriterBase &rewriter,
+    llvm::MapVector<Operation *, SmallVector<stablehlo::WhileOp>> *innerLoops =
+        nullptr) {
+  auto bodyTerm = cast<stablehlo::ReturnOp>(&op.getBody().front().back());
+  auto loopBodyBlock = &op.getBody().front();
+
+  SmallVector<Value> results(values.begin(), values.end());
+
+  for (int64_t iter = 0; iter < count; iter++) {
+    IRMapping operandMap;
+    operandMap.map(loopBodyBlock->getArguments(), results);
+
+    for (auto &it : loopBodyBlock->without_terminator()) {
+      auto cloned = rewriter.clone(it, operandMap);
+      if (innerLoops && isa<stablehlo::WhileOp>(it))
+        (*innerLoops)[&it].push_back(cast<stablehlo::WhileOp>(cloned));
+    }
+
+    results.clear();
+    for (auto r : bodyTerm->getOperands()) {
+      results.push_back(operandMap.lookupOrDefault(r));
+    }
+  }
+  return results;
+}
+
 LogicalResult
 WhileUnroll::matchAndRewriteImpl(mlir::stablehlo::WhileOp op,
                                  PatternRewriter &rewriter) const {
@@ -52,7 +87,6 @@ WhileUnroll::matchAndRewriteImpl(mlir::stablehlo::WhileOp op,
   if (info.computeInfo().failed() || !info.isConstant())
     return failure();
 
-  auto bodyTerm = cast<stablehlo::ReturnOp>(&op.getBody().front().back());
   auto loopBodyBlock = &op.getBody().front();
 
   auto iters = info.getConstantNumIters();
@@ -66,21 +100,216 @@ WhileUnroll::matchAndRewriteImpl(mlir::stablehlo::WhileOp op,
     return rewriter.notifyMatchFailure(op,
                                        "max operations for unrolling exceeded");
 
-  SmallVector<Value> results(op.getOperands().begin(), op.getOperands().end());
+  rewriter.replaceOp(op,
+                     cloneIterations(op, iters, op.getOperands(), rewriter));
+  return success();
+}
 
-  for (size_t iter = 0; iter < iters; iter++) {
-    IRMapping operandMap;
-    operandMap.map(loopBodyBlock->getArguments(), results);
+// Whether `op` or an op nested in it uses a value produced by one of `ops`,
+// which all live in the block of `op`.
+static bool usesAnyOf(Operation *op,
+                      const llvm::SmallPtrSetImpl<Operation *> &ops) {
+  Block *block = op->getBlock();
+  return op
+      ->walk([&](Operation *nested) {
+        for (Value operand : nested->getOperands()) {
+          auto def = operand.getDefiningOp();
+          if (!def)
+            continue;
+          auto ancestor = block->findAncestorOpInBlock(*def);
+          if (ancestor && ancestor != op && ops.contains(ancestor))
+            return WalkResult::interrupt();
+        }
+        return WalkResult::advance();
+      })
+      .wasInterrupted();
+}
 
-    for (auto &it : loopBodyBlock->without_terminator()) {
-      rewriter.clone(it, operandMap);
+// Fuses `loops`, the copies of one inner loop made by unrolling an outer loop,
+// into a single while carrying the state of all of them. This is only legal
+// if no copy depends on the results of another and all of them run the same
+// constant number of iterations.
+static LogicalResult jamLoops(ArrayRef<stablehlo::WhileOp> loops,
+                              RewriterBase &rewriter) {
+  if (loops.size() < 2)
+    return failure();
+
+  std::optional<int64_t> iters;
+  for (auto loop : loops) {
+    WhileLoopInfo info(loop);
+    if (info.computeInfo().failed() || !info.isConstant())
+      return failure();
+    if (iters && *iters != info.getConstantNumIters())
+      return failure();
+    iters = info.getConstantNumIters();
+  }
+
+  Block *block = loops.front()->getBlock();
+  llvm::SmallPtrSet<Operation *, 8> isLoop;
+  for (auto loop : loops) {
+    if (loop->getBlock() != block)
+      return failure();
+    isLoop.insert(loop);
+  }
+
+  // Collect the ops depending on any of the loops; they are moved after the
+  // fused loop.
+  llvm::SmallPtrSet<Operation *, 16> sources;
+  SmallVector<Operation *> dependents;
+  for (auto &it : block->without_terminator()) {
+    if (isLoop.contains(&it)) {
+      if (usesAnyOf(&it, sources))
+        return failure();
+      sources.insert(&it);
+    } else if (usesAnyOf(&it, sources)) {
+      sources.insert(&it);
+      dependents.push_back(&it);
     }
+  }
 
-    results.clear();
-    for (auto r : bodyTerm->getOperands()) {
-      results.push_back(operandMap.lookupOrDefault(r));
+  for (auto dependent : dependents)
+    rewriter.moveOpBefore(dependent, block->getTerminator());
+
+  SmallVector<Value> operands;
+  SmallVector<Type> types;
+  for (auto loop : loops) {
+    llvm::append_range(operands, loop.getOperands());
+    llvm::append_range(types, loop->getResultTypes());
+  }
+
+  rewriter.setInsertionPoint(dependents.empty() ? block->getTerminator()
+                                                : dependents.front());
+  auto loc = loops.front().getLoc();
+  auto fused = stablehlo::WhileOp::create(rewriter, loc, types, operands);
+  fused->setAttrs(loops.front()->getAttrs());
+
+  SmallVector<Location> locs(types.size(), loc);
+  Block *cond = rewriter.createBlock(&fused.getCond(), {}, types, locs);
+  Block *body = rewriter.createBlock(&fused.getBody(), {}, types, locs);
+
+  // All copies advance in lockstep, so the condition of the first one decides
+  // for all of them.
+  {
+    IRMapping mapping;
+    auto &condBlock = loops.front().getCond().front();
+    mapping.map(condBlock.getArguments(),
+                cond->getArguments().take_front(condBlock.getNumArguments()));
+    rewriter.setInsertionPointToEnd(cond);
+    for (auto &it : condBlock)
+      rewriter.clone(it, mapping);
+  }
+
+  SmallVector<Value> yielded;
+  size_t offset = 0;
+  rewriter.setInsertionPointToEnd(body);
+  for (auto loop : loops) {
+    auto &bodyBlock = loop.getBody().front();
+    IRMapping mapping;
+    mapping.map(bodyBlock.getArguments(),
+                body->getArguments().slice(offset, loop.getNumOperands()));
+    for (auto &it : bodyBlock.without_terminator())
+      rewriter.clone(it, mapping);
+    for (auto r : bodyBlock.getTerminator()->getOperands())
+      yielded.push_back(mapping.lookupOrDefault(r));
+    offset += loop.getNumOperands();
+  }
+  stablehlo::ReturnOp::create(rewriter, loc, yielded);
+
+  offset = 0;
+  for (auto loop : loops) {
+    rewriter.replaceOp(
+        loop, fused->getResults().slice(offset, loop.getNumResults()));
+    offset += loop.getNumResults();
+  }
+  return success();
+}
+
+// Peels the first `peelFirst` and last `peelLast` iterations of `op` and
+// unrolls the remaining ones by `factor`, leaving the iterations that do not
+// fill a whole unrolled trip to a remainder loop. With `jam`, the copies of
+// each loop nested in the unrolled body are fused into one.
+static LogicalResult partiallyUnrollWhile(stablehlo::WhileOp op, int64_t factor,
+                                          int64_t peelFirst, int64_t peelLast,
+                                          bool jam, RewriterBase &rewriter) {
+  WhileLoopInfo info(op);
+  if (info.computeInfo().failed() || !info.isConstant())
+    return failure();
+
+  auto iv = info.getInductionVariable();
+  int64_t step = *info.getConstantStep();
+  if (!iv || step <= 0)
+    return failure();
+  auto ivType = cast<RankedTensorType>(iv.getType());
+  unsigned ivNum = cast<BlockArgument>(iv).getArgNumber();
+
+  int64_t iters = info.getConstantNumIters();
+  peelFirst = std::min(std::max<int64_t>(peelFirst, 0), iters);
+  peelLast = std::min(std::max<int64_t>(peelLast, 0), iters - peelFirst);
+  int64_t rest = iters - peelFirst - peelLast;
+  factor = std::max<int64_t>(std::min(factor, rest), 1);
+  if (peelFirst == 0 && peelLast == 0 && factor == 1)
+    return failure();
+
+  auto loc = op.getLoc();
+  int64_t start = *info.getConstantStart() + peelFirst * step;
+
+  // Creates a loop running `trips` times `copies` iterations of `op` from the
+  // induction variable value `start`.
+  auto createLoop = [&](int64_t trips, int64_t copies, ValueRange inits,
+                        llvm::MapVector<Operation *,
+                                        SmallVector<stablehlo::WhileOp>>
+                            *innerLoops) {
+    auto loop = stablehlo::WhileOp::create(rewriter, loc, op->getResultTypes(),
+                                           inits);
+    loop->setAttrs(op->getAttrs());
+
+    SmallVector<Location> locs(inits.size(), loc);
+    Block *cond = rewriter.createBlock(&loop.getCond(), {},
+                                       op->getResultTypes(), locs);
+    Block *body = rewriter.createBlock(&loop.getBody(), {},
+                                       op->getResultTypes(), locs);
+
+    rewriter.setInsertionPointToEnd(cond);
+    auto limit = stablehlo::ConstantOp::create(
+        rewriter, loc, ivType,
+        cast<ElementsAttr>(makeAttr(ivType, start + trips * copies * step)));
+    auto cmp = stablehlo::CompareOp::create(
+        rewriter, loc, cond->getArgument(ivNum), limit,
+        stablehlo::ComparisonDirection::LT);
+    stablehlo::ReturnOp::create(rewriter, loc, cmp.getResult());
+
+    rewriter.setInsertionPointToEnd(body);
+    stablehlo::ReturnOp::create(
+        rewriter, loc,
+        cloneIterations(op, copies, body->getArguments(), rewriter,
+                        innerLoops));
+
+    rewriter.setInsertionPointAfter(loop);
+    start += trips * copies * step;
+    return loop;
+  };
+
+  rewriter.setInsertionPoint(op);
+  SmallVector<Value> results =
+      cloneIterations(op, peelFirst, op.getOperands(), rewriter);
+
+  if (rest > 0) {
+    llvm::MapVector<Operation *, SmallVector<stablehlo::WhileOp>> innerLoops;
+    auto main = createLoop(rest / factor, factor, results,
+                           jam && factor > 1 ? &innerLoops : nullptr);
+    results.assign(main->result_begin(), main->result_end());
+
+    if (rest % factor != 0) {
+      auto remainder = createLoop(rest % factor, 1, results, nullptr);
+      results.assign(remainder->result_begin(), remainder->result_end());
     }
+
+    for (auto &[_, loops] : innerLoops)
+      (void)jamLoops(loops, rewriter);
   }
+
+  rewriter.setInsertionPoint(op);
+  results = cloneIterations(op, peelLast, results, rewriter);
   rewriter.replaceOp(op, results);
   return success();
 }
@@ -97,6 +326,20 @@ struct EnzymeHLOUnrollPass
     if (failed(applyPatternsAndFoldGreedily(getOperation(), std::move(patterns),
                                             config))) {
       signalPassFailure();
+      return;
     }
+
+    if (unrollFactor <= 1 && peelFirst <= 0 && peelLast <= 0)
+      return;
+
+    // Loops left rolled by the full unrolling above are partially unrolled,
+    // innermost first, so that an outer loop jams already unrolled loops.
+    SmallVector<stablehlo::WhileOp> loops;
+    getOperation()->walk([&](stablehlo::WhileOp op) { loops.push_back(op); });
+
+    IRRewriter rewriter(context);
+    for (auto op : loops)
+      (void)partiallyUnrollWhile(op, unrollFactor, peelFirst, peelLast,
+                                 unrollAndJam, rewriter);
   }
 };
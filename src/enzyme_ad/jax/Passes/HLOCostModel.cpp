@@ -0,0 +1,136 @@
+//===- HLOCostModel.cpp - Analytical cost model for StableHLO -------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "src/enzyme_ad/jax/Passes/HLOCostModel.h"
+
+#include "mlir/IR/BuiltinTypes.h"
+#include "mlir/IR/Matchers.h"
+#include "src/enzyme_ad/jax/Implementations/WhileLoopInfo.h"
+#include "src/enzyme_ad/jax/Utils.h"
+#include "stablehlo/dialect/StablehloOps.h"
+
+using namespace mlir;
+using namespace mlir::enzyme;
+
+static double getNumElements(Type type) {
+  auto tensorType = dyn_cast<RankedTensorType>(type);
+  if (!tensorType || !tensorType.hasStaticShape())
+    return 1;
+  return tensorType.getNumElements();
+}
+
+static double getNumBytes(Type type) {
+  auto tensorType = dyn_cast<RankedTensorType>(type);
+  if (!tensorType)
+    return 0;
+  Type elemType = tensorType.getElementType();
+  double components = 1;
+  if (auto complexType = dyn_cast<ComplexType>(elemType)) {
+    elemType = complexType.getElementType();
+    components = 2;
+  }
+  // Index and other non-numeric element types are assumed to be 32-bit.
+  double elemBits = elemType.isIntOrFloat()
+                        ? std::max(elemType.getIntOrFloatBitWidth(), 8u)
+                        : 32;
+  return getNumElements(type) * components * elemBits / 8;
+}
+
+bool HLOCostModel::isFusible(Operation *op) const {
+  if (matchPattern(op, m_Constant()))
+    return true;
+  if (stablehlo::hasTraitElementwise(op))
+    return true;
+  return isa<stablehlo::ReshapeOp, stablehlo::BroadcastInDimOp,
+             stablehlo::SliceOp, stablehlo::IotaOp, stablehlo::ConvertOp,
+             stablehlo::SelectOp, stablehlo::ClampOp,
+             stablehlo::GetTupleElementOp, stablehlo::TupleOp>(op);
+}
+
+HLOCost HLOCostModel::getOpCost(Operation *op) const {
+  HLOCost cost;
+  if (op->hasTrait<OpTrait::IsTerminator>() || op->getNumResults() == 0)
+    return cost;
+
+  double resultElements = 0;
+  for (Type type : op->getResultTypes())
+    resultElements += getNumElements(type);
+
+  if (auto dot = dyn_cast<stablehlo::DotGeneralOp>(op)) {
+    auto lhsType = cast<RankedTensorType>(dot.getLhs().getType());
+    double contracted = 1;
+    for (int64_t dim :
+         dot.getDotDimensionNumbers().getLhsContractingDimensions())
+      contracted *= lhsType.isDynamicDim(dim) ? 1 : lhsType.getDimSize(dim);
+    cost.flops = 2 * resultElements * contracted;
+  } else if (auto conv = dyn_cast<stablehlo::ConvolutionOp>(op)) {
+    auto kernelType = cast<RankedTensorType>(conv.getRhs().getType());
+    int64_t outFeatureDim = conv.getDimensionNumbers()
+                                .getKernelOutputFeatureDimension();
+    double perOutput = getNumElements(kernelType);
+    if (kernelType.hasStaticShape() && kernelType.getDimSize(outFeatureDim))
+      perOutput /= kernelType.getDimSize(outFeatureDim);
+    cost.flops = 2 * resultElements * perOutput;
+  } else if (isa<stablehlo::ReduceOp, stablehlo::ReduceWindowOp>(op)) {
+    double inputElements = 0;
+    for (Value operand : op->getOperands())
+      inputElements += getNumElements(operand.getType());
+    cost.flops = inputElements;
+  } else if (stablehlo::hasTraitElementwise(op)) {
+    cost.flops = resultElements;
+  }
+
+  if (isFusible(op))
+    return cost;
+
+  // Everything else is assumed to read its operands from and write its
+  // results to memory.
+  cost.fusionBoundaries = 1;
+  for (Type type : op->getOperandTypes())
+    cost.bytes += getNumBytes(type);
+  for (Type type : op->getResultTypes())
+    cost.bytes += getNumBytes(type);
+  return cost;
+}
+
+HLOCost HLOCostModel::getRegionCost(Region &region) const {
+  HLOCost cost;
+  for (Block &block : region) {
+    for (Operation &op : block) {
+      cost += getOpCost(&op);
+
+      // Reduction bodies are accounted for in the reduction's own cost.
+      if (isa<stablehlo::ReduceOp, stablehlo::ReduceWindowOp,
+              stablehlo::ScatterOp, stablehlo::SortOp,
+              stablehlo::SelectAndScatterOp>(op))
+        continue;
+
+      HLOCost nested;
+      for (Region &nestedRegion : op.getRegions())
+        nested += getRegionCost(nestedRegion);
+
+      int64_t scale = 1;
+      if (auto whileOp = dyn_cast<stablehlo::WhileOp>(op)) {
+        WhileLoopInfo info(whileOp);
+        if (info.computeInfo().succeeded() && info.isConstant())
+          scale = std::max<int64_t>(info.getConstantNumIters(), 0);
+      }
+      cost.flops += scale * nested.flops;
+      cost.bytes += scale * nested.bytes;
+      cost.fusionBoundaries += scale * nested.fusionBoundaries;
+    }
+  }
+  return cost;
+}
+
+HLOCost HLOCostModel::getCost(Operation *root) const {
+  HLOCost cost;
+  for (Region &region : root->getRegions())
+    cost += getRegionCost(region);
+  return cost;
+}
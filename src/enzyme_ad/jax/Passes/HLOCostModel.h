@@ -0,0 +1,80 @@
+//===- HLOCostModel.h - Analytical cost model for StableHLO ----*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include "mlir/IR/Operation.h"
+
+namespace mlir {
+namespace enzyme {
+
+/// Estimated cost of an op or a program.
+struct HLOCost {
+  /// Floating point (or integer) operations performed.
+  double flops = 0;
+  /// Bytes read and written through memory, i.e. by ops that end up at the
+  /// boundary of a fusion.
+  double bytes = 0;
+  /// Number of ops expected to start a new fusion / kernel.
+  int64_t fusionBoundaries = 0;
+
+  HLOCost &operator+=(const HLOCost &other) {
+    flops += other.flops;
+    bytes += other.bytes;
+    fusionBoundaries += other.fusionBoundaries;
+    return *this;
+  }
+};
+
+/// Analytical cost model for StableHLO programs. The default implementation
+/// assumes elementwise ops and cheap shape ops (reshape, broadcast, slice,
+/// convert, ...) are fused into their neighbors, while every other op
+/// materializes its operands and results in memory. Subclasses can override
+/// `getOpCost` or the weights to model a particular backend.
+class HLOCostModel {
+public:
+  /// Relative weights used to collapse an HLOCost into a scalar. The defaults
+  /// model a device with ~10 flops per byte of bandwidth and a kernel launch
+  /// costing as much as moving 64KiB.
+  struct Weights {
+    double flop = 1.0;
+    double byte = 10.0;
+    double fusionBoundary = 655360.0;
+  };
+
+  HLOCostModel() = default;
+  explicit HLOCostModel(Weights weights) : weights(weights) {}
+  virtual ~HLOCostModel() = default;
+
+  /// Cost of `op` itself, excluding nested regions.
+  virtual HLOCost getOpCost(Operation *op) const;
+
+  /// Whether `op` is expected to be fused into its producers and consumers.
+  virtual bool isFusible(Operation *op) const;
+
+  /// Cost of every op nested under `root` (excluding `root` itself). Loop
+  /// bodies are scaled by their trip count when it is statically known.
+  HLOCost getCost(Operation *root) const;
+
+  double getScalarCost(const HLOCost &cost) const {
+    return weights.flop * cost.flops + weights.byte * cost.bytes +
+           weights.fusionBoundary * cost.fusionBoundaries;
+  }
+
+  double getScalarCost(Operation *root) const {
+    return getScalarCost(getCost(root));
+  }
+
+private:
+  HLOCost getRegionCost(Region &region) const;
+
+  Weights weights;
+};
+
+} // namespace enzyme
+} // namespace mlir
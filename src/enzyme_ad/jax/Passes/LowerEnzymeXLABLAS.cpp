@@ -8,6 +8,7 @@
 
 #include "mlir/Conversion/LLVMCommon/TypeConverter.h"
 #include "mlir/Dialect/LLVMIR/LLVMDialect.h"
+#include "stablehlo/dialect/ChloOps.h"
 #include "stablehlo/dialect/StablehloOps.h"
 
 #include "mlir/Transforms/GreedyPatternRewriteDriver.h"
@@ -72,6 +73,89 @@ static std::pair<Value, int64_t> createScalarOperand(PatternRewriter &rewriter,
   return {originalVal, 0};
 }
 
+// Declares the Fortran BLAS routine `blasFn`, which takes `numArgs` arguments
+// by pointer followed by one hidden length per character argument, and a
+// private `<blasFn>wrapper` that forwards to it with every length set to 1.
+static void declareBLASWrapper(PatternRewriter &rewriter, ModuleOp moduleOp,
+                               Location loc, StringRef blasFn, unsigned numArgs,
+                               unsigned numCharArgs, Type llvmIntType) {
+  auto ctx = moduleOp.getContext();
+  auto llvmPtrType = LLVM::LLVMPointerType::get(ctx);
+  auto llvmVoidType = LLVM::LLVMVoidType::get(ctx);
+  std::string blasFnWrapper = (blasFn + "wrapper").str();
+
+  if (!moduleOp.lookupSymbol<LLVM::LLVMFuncOp>(blasFn)) {
+    OpBuilder::InsertionGuard guard(rewriter);
+    rewriter.setInsertionPointToStart(moduleOp.getBody());
+
+    SmallVector<Type> argTypes(numArgs, llvmPtrType);
+    argTypes.append(numCharArgs, llvmIntType);
+    auto funcType = LLVM::LLVMFunctionType::get(llvmVoidType, argTypes, false);
+    LLVM::LLVMFuncOp::create(rewriter, loc, blasFn, funcType,
+                             LLVM::Linkage::External);
+  }
+
+  if (!moduleOp.lookupSymbol<LLVM::LLVMFuncOp>(blasFnWrapper)) {
+    OpBuilder::InsertionGuard guard(rewriter);
+    rewriter.setInsertionPointToStart(moduleOp.getBody());
+
+    SmallVector<Type> argTypes(numArgs, llvmPtrType);
+    auto funcType = LLVM::LLVMFunctionType::get(llvmVoidType, argTypes, false);
+
+    auto funcOp = LLVM::LLVMFuncOp::create(rewriter, loc, blasFnWrapper,
+                                           funcType, LLVM::Linkage::Private);
+    rewriter.setInsertionPointToStart(funcOp.addEntryBlock(rewriter));
+
+    SmallVector<Value> args(funcOp.getArguments().begin(),
+                            funcOp.getArguments().end());
+    auto const1 = LLVM::ConstantOp::create(
+        rewriter, loc, llvmIntType, rewriter.getIntegerAttr(llvmIntType, 1));
+    args.append(numCharArgs, const1);
+
+    LLVM::CallOp::create(rewriter, loc, TypeRange{},
+                         SymbolRefAttr::get(ctx, blasFn), args);
+    LLVM::ReturnOp::create(rewriter, loc, ValueRange{});
+  }
+}
+
+// Outlines a BLAS call into a private func.func taking `args`, whose body is
+// produced by `buildBody` from the function arguments, and calls it.
+static func::CallOp createOutlinedBLASCall(
+    PatternRewriter &rewriter, ModuleOp moduleOp, Location loc, StringRef name,
+    ValueRange args, Type resultType,
+    llvm::function_ref<Value(ArrayRef<BlockArgument>)> buildBody) {
+  func::FuncOp shloFunc;
+  {
+    OpBuilder::InsertionGuard guard(rewriter);
+    rewriter.setInsertionPointToStart(moduleOp.getBody());
+
+    FunctionType calleeType =
+        rewriter.getFunctionType(args.getTypes(), ArrayRef<Type>(resultType));
+    shloFunc = func::FuncOp::create(rewriter, loc, name, calleeType);
+    shloFunc.setPrivate();
+
+    auto &entryBlock = *shloFunc.addEntryBlock();
+    rewriter.setInsertionPointToStart(&entryBlock);
+    Value result = buildBody(entryBlock.getArguments());
+    func::ReturnOp::create(rewriter, loc, ValueRange{result});
+  }
+  return func::CallOp::create(rewriter, loc, shloFunc, args);
+}
+
+static Value createBLASDimSize(PatternRewriter &rewriter, Location loc,
+                               RankedTensorType intType, Value input,
+                               int64_t dim) {
+  return stablehlo::ConvertOp::create(
+      rewriter, loc, intType,
+      stablehlo::GetDimensionSizeOp::create(rewriter, loc, input, dim));
+}
+
+static Value createBLASChar(PatternRewriter &rewriter, Location loc, char c) {
+  auto uint8Type = RankedTensorType::get({}, rewriter.getIntegerType(8, false));
+  return stablehlo::ConstantOp::create(
+      rewriter, loc, uint8Type, cast<ElementsAttr>(makeAttr(uint8Type, c)));
+}
+
 struct SyrkOpLowering : public OpRewritePattern<enzymexla::SyrkOp> {
   using OpRewritePattern<enzymexla::SyrkOp>::OpRewritePattern;
 
@@ -151,8 +235,6 @@ struct SyrkOpLowering : public OpRewritePattern<enzymexla::SyrkOp> {
     auto intType = RankedTensorType::get({}, blasIntType);
     auto uint8Type =
         RankedTensorType::get({}, rewriter.getIntegerType(8, false));
-    auto llvmPtrType = LLVM::LLVMPointerType::get(ctx);
-    auto llvmVoidType = LLVM::LLVMVoidType::get(ctx);
     auto llvmIntType = typeConverter.convertType(blasIntType);
 
     std::string blasFn;
@@ -167,47 +249,9 @@ struct SyrkOpLowering : public OpRewritePattern<enzymexla::SyrkOp> {
     std::string blasFnWrapper = blasFn + "wrapper";
 
     // declare BLAS function declarations if not present
-    if (!moduleOp.lookupSymbol<LLVM::LLVMFuncOp>(blasFn)) {
-      OpBuilder::InsertionGuard guard(rewriter);
-      rewriter.setInsertionPointToStart(moduleOp.getBody());
-
-      auto funcType = LLVM::LLVMFunctionType::get(
-          llvmVoidType,
-          {llvmPtrType, llvmPtrType, llvmPtrType, llvmPtrType, llvmPtrType,
-           llvmPtrType, llvmPtrType, llvmPtrType, llvmPtrType, llvmPtrType,
-           llvmIntType, llvmIntType},
-          false);
-      LLVM::LLVMFuncOp::create(rewriter, op.getLoc(), blasFn, funcType,
-                               LLVM::Linkage::External);
-    }
-
-    if (!moduleOp.lookupSymbol<LLVM::LLVMFuncOp>(blasFnWrapper)) {
-      OpBuilder::InsertionGuard guard(rewriter);
-      rewriter.setInsertionPointToStart(moduleOp.getBody());
-
-      auto funcType = LLVM::LLVMFunctionType::get(
-          llvmVoidType,
-          {llvmPtrType, llvmPtrType, llvmPtrType, llvmPtrType, llvmPtrType,
-           llvmPtrType, llvmPtrType, llvmPtrType, llvmPtrType, llvmPtrType},
-          false);
-
-      auto funcOp =
-          LLVM::LLVMFuncOp::create(rewriter, op.getLoc(), blasFnWrapper,
-                                   funcType, LLVM::Linkage::Private);
-      rewriter.setInsertionPointToStart(funcOp.addEntryBlock(rewriter));
-
-      SmallVector<Value> args(funcOp.getArguments().begin(),
-                              funcOp.getArguments().end());
-      auto const1 =
-          LLVM::ConstantOp::create(rewriter, op.getLoc(), llvmIntType,
-                                   rewriter.getIntegerAttr(llvmIntType, 1));
-      args.push_back(const1);
-      args.push_back(const1);
-
-      LLVM::CallOp::create(rewriter, op.getLoc(), TypeRange{},
-                           SymbolRefAttr::get(ctx, blasFn), args);
-      LLVM::ReturnOp::create(rewriter, op.getLoc(), ValueRange{});
-    }
+    // {uplo, trans, n, k, alpha, A, lda, beta, C, ldc} + {uplo, trans} lengths
+    declareBLASWrapper(rewriter, moduleOp, op.getLoc(), blasFn, 10, 2,
+                       llvmIntType);
 
     CopyMode needsCopy;
     enzymexla::LapackUplo customCallUplo;
@@ -499,6 +543,349 @@ private:
   int64_t blasIntWidth;
 };
 
+// Lowers `C := alpha * A * B^T + beta * C`, the convention produced by
+// `DotGeneralToSymm`: operands are in product order, both contract along their
+// last dimension and `side` names the symmetric one.
+struct SymmOpLowering : public OpRewritePattern<enzymexla::SymmOp> {
+  using OpRewritePattern<enzymexla::SymmOp>::OpRewritePattern;
+
+  SymmOpLowering(std::string backend, int64_t blasIntWidth,
+                 MLIRContext *context, PatternBenefit benefit = 1)
+      : OpRewritePattern(context, benefit), backend(backend),
+        blasIntWidth(blasIntWidth){};
+
+  LogicalResult matchAndRewrite(enzymexla::SymmOp op,
+                                PatternRewriter &rewriter) const override {
+    auto CType = cast<RankedTensorType>(op.getC().getType());
+
+    if (CType.getRank() == 2 && backend == "cpu")
+      return matchAndRewriteCPU(op, rewriter);
+
+    return matchAndRewriteFallback(op, rewriter);
+  }
+
+  LogicalResult matchAndRewriteCPU(enzymexla::SymmOp op,
+                                   PatternRewriter &rewriter) const {
+    auto ctx = op->getContext();
+    LLVMTypeConverter typeConverter(ctx);
+
+    auto CType = cast<RankedTensorType>(op.getC().getType());
+    auto moduleOp = op->getParentOfType<ModuleOp>();
+
+    auto blasIntType = rewriter.getIntegerType(blasIntWidth);
+    auto intType = RankedTensorType::get({}, blasIntType);
+    auto llvmIntType = typeConverter.convertType(blasIntType);
+
+    auto prefix = lapackPrecisionPrefix(CType.getElementType());
+    if (!prefix) {
+      op->emitOpError() << "Unsupported element type: "
+                        << CType.getElementType();
+      return rewriter.notifyMatchFailure(op, "unsupported element type");
+    }
+    std::string blasFn = "enzymexla_blas_" + *prefix + "symm_";
+    std::string blasFnWrapper = blasFn + "wrapper";
+
+    // {side, uplo, m, n, alpha, A, lda, B, ldb, beta, C, ldc} + {side, uplo}
+    // lengths
+    declareBLASWrapper(rewriter, moduleOp, op.getLoc(), blasFn, 12, 2,
+                       llvmIntType);
+
+    static int64_t fn_counter = 0;
+    std::string funcFnName = blasFnWrapper + "_" + std::to_string(fn_counter++);
+
+    // All matrices are passed in row-major format, which BLAS sees as their
+    // transposes. C = A * B^T therefore becomes C^T = B * A^T, so the
+    // symmetric operand switches sides and its stored triangle flips. For a
+    // symmetric left operand the general operand has to be transposed first
+    // to match the (non-transposable) B argument of ?symm.
+    bool left = op.getSide() == enzymexla::LapackSide::left;
+    bool upper = standardizeUplo(op.getUplo()) == enzymexla::LapackUplo::U;
+
+    SmallVector<bool> isColMajorArr(12, false);
+    SmallVector<int64_t> operandRanks = {0, 0, 0, 0, 0, 2, 0, 2, 0, 0, 2, 0};
+    SmallVector<int64_t> outputRanks = {2};
+    auto operandLayouts =
+        getSHLOLayout(rewriter, operandRanks, isColMajorArr, 2);
+    auto resultLayouts = getSHLOLayout(rewriter, outputRanks, isColMajorArr, 2);
+
+    SmallVector<Attribute> aliases;
+    aliases.push_back(stablehlo::OutputOperandAliasAttr::get(
+        ctx, std::vector<int64_t>{}, 10, std::vector<int64_t>{}));
+
+    auto callOp = createOutlinedBLASCall(
+        rewriter, moduleOp, op.getLoc(), funcFnName,
+        ValueRange{op.getA(), op.getB(), op.getC(), op.getAlpha(),
+                   op.getBeta()},
+        CType, [&](ArrayRef<BlockArgument> args) -> Value {
+          auto loc = op.getLoc();
+          Value A = args[0], B = args[1], C = args[2];
+          Value alpha = args[3], beta = args[4];
+
+          Value sym = left ? A : B;
+          Value gen = left ? stablehlo::TransposeOpCreate(
+                                 rewriter, loc, B, ArrayRef<int64_t>{1, 0})
+                           : A;
+
+          auto side = createBLASChar(rewriter, loc, left ? 'R' : 'L');
+          auto uplo = createBLASChar(rewriter, loc, upper ? 'L' : 'U');
+          auto m = createBLASDimSize(rewriter, loc, intType, C, 1);
+          auto n = createBLASDimSize(rewriter, loc, intType, C, 0);
+          auto lda = createBLASDimSize(rewriter, loc, intType, sym, 1);
+          auto ldb = createBLASDimSize(rewriter, loc, intType, gen, 1);
+
+          // {side, uplo, m, n, alpha, A, lda, B, ldb, beta, C, ldc}
+          auto jitCall = enzymexla::JITCallOp::create(
+              rewriter, loc, TypeRange{CType},
+              mlir::FlatSymbolRefAttr::get(ctx, blasFnWrapper),
+              ValueRange{side, uplo, m, n, alpha, sym, lda, gen, ldb, beta, C,
+                         m},
+              rewriter.getStringAttr(""),
+              /*operand_layouts=*/operandLayouts,
+              /*result_layouts=*/resultLayouts,
+              /*arg_attrs=*/nullptr,
+              /*res_attrs=*/nullptr,
+              /*output_operand_aliases=*/rewriter.getArrayAttr(aliases),
+              /*xla_side_effect_free=*/rewriter.getUnitAttr());
+          return jitCall.getResult(0);
+        });
+
+    rewriter.replaceOp(op, callOp.getResult(0));
+    return success();
+  }
+
+  LogicalResult matchAndRewriteFallback(enzymexla::SymmOp op,
+                                        PatternRewriter &rewriter) const {
+    auto CType = cast<RankedTensorType>(op.getC().getType());
+    auto nBatchDims = CType.getRank() - 2;
+    SmallVector<int64_t> batchDims(nBatchDims, 0);
+    std::iota(batchDims.begin(), batchDims.end(), 0);
+
+    bool left = op.getSide() == enzymexla::LapackSide::left;
+    Value sym = left ? op.getA() : op.getB();
+    if (!stablehlo::IsTensorFilled(sym)) {
+      // Only the `uplo` triangle is guaranteed to be populated.
+      auto symType = cast<RankedTensorType>(sym.getType());
+      if (op.getUplo() != enzymexla::LapackUplo::F &&
+          (symType.getRank() != 2 || !symType.hasStaticShape()))
+        return rewriter.notifyMatchFailure(
+            op, "cannot symmetrize a batched or dynamic triangular operand");
+      sym = stablehlo::copyTriangularPart(rewriter, sym, op.getUplo());
+      if (!sym)
+        return failure();
+    }
+
+    // Since the symmetric operand equals its transpose, both operands can be
+    // contracted along their last dimension and no transpose is needed.
+    Value lhs = left ? sym : op.getA();
+    Value rhs = left ? op.getB() : sym;
+    auto dotDims = stablehlo::DotDimensionNumbersAttr::get(
+        op.getContext(), batchDims, batchDims, {nBatchDims + 1},
+        {nBatchDims + 1});
+    auto AB = stablehlo::DotGeneralOp::create(
+        rewriter, op.getLoc(), CType, lhs, rhs, dotDims, nullptr, nullptr);
+
+    Value res =
+        stablehlo::MulOpCreate(rewriter, op->getLoc(), op.getAlpha(), AB);
+    // The structured-tensor patterns create symm with a zero C and beta, in
+    // which case the accumulation is dropped altogether.
+    bool zeroC = matchPattern(op.getBeta(), m_AnyZeroFloat()) ||
+                 matchPattern(op.getC(), m_AnyZeroFloat());
+    if (!zeroC) {
+      auto bop = stablehlo::MulOpCreate(rewriter, op->getLoc(), op.getBeta(),
+                                        op.getC());
+      res = stablehlo::AddOpCreate(rewriter, op->getLoc(), res, bop);
+    }
+    rewriter.replaceOp(op, res);
+    return success();
+  }
+
+private:
+  std::string backend;
+  int64_t blasIntWidth;
+};
+
+// Lowers `B := alpha * op(A) * B` (left) or `B := alpha * B * op(A)` (right)
+// for a triangular `A`.
+struct TrmmOpLowering : public OpRewritePattern<enzymexla::TrmmOp> {
+  using OpRewritePattern<enzymexla::TrmmOp>::OpRewritePattern;
+
+  TrmmOpLowering(std::string backend, int64_t blasIntWidth,
+                 MLIRContext *context, PatternBenefit benefit = 1)
+      : OpRewritePattern(context, benefit), backend(backend),
+        blasIntWidth(blasIntWidth){};
+
+  LogicalResult matchAndRewrite(enzymexla::TrmmOp op,
+                                PatternRewriter &rewriter) const override {
+    auto BType = cast<RankedTensorType>(op.getB().getType());
+
+    // A full `uplo` is not a triangular matrix, so only the fallback applies.
+    if (BType.getRank() == 2 && backend == "cpu" &&
+        op.getUplo() != enzymexla::LapackUplo::F)
+      return matchAndRewriteCPU(op, rewriter);
+
+    return matchAndRewriteFallback(op, rewriter);
+  }
+
+  LogicalResult matchAndRewriteCPU(enzymexla::TrmmOp op,
+                                   PatternRewriter &rewriter) const {
+    auto ctx = op->getContext();
+    LLVMTypeConverter typeConverter(ctx);
+
+    auto BType = cast<RankedTensorType>(op.getB().getType());
+    auto moduleOp = op->getParentOfType<ModuleOp>();
+
+    auto blasIntType = rewriter.getIntegerType(blasIntWidth);
+    auto intType = RankedTensorType::get({}, blasIntType);
+    auto llvmIntType = typeConverter.convertType(blasIntType);
+
+    auto prefix = lapackPrecisionPrefix(BType.getElementType());
+    if (!prefix) {
+      op->emitOpError() << "Unsupported element type: "
+                        << BType.getElementType();
+      return rewriter.notifyMatchFailure(op, "unsupported element type");
+    }
+    std::string blasFn = "enzymexla_blas_" + *prefix + "trmm_";
+    std::string blasFnWrapper = blasFn + "wrapper";
+
+    // {side, uplo, transa, diag, m, n, alpha, A, lda, B, ldb} +
+    // {side, uplo, transa, diag} lengths
+    declareBLASWrapper(rewriter, moduleOp, op.getLoc(), blasFn, 11, 4,
+                       llvmIntType);
+
+    static int64_t fn_counter = 0;
+    std::string funcFnName = blasFnWrapper + "_" + std::to_string(fn_counter++);
+
+    // Row-major B is seen by BLAS as B^T, so B := op(A) * B becomes
+    // B^T := B^T * op(A)^T. With A likewise seen as A^T, op(A)^T keeps the
+    // same transpose flag but A switches sides and its triangle flips.
+    bool left = op.getSide() == enzymexla::LapackSide::left;
+    bool upper = op.getUplo() == enzymexla::LapackUplo::U;
+    char trans = 'N';
+    switch (op.getTranspose()) {
+    case enzymexla::LapackTranspose::none:
+      trans = 'N';
+      break;
+    case enzymexla::LapackTranspose::transpose:
+      trans = 'T';
+      break;
+    case enzymexla::LapackTranspose::adjoint:
+      trans = 'C';
+      break;
+    }
+
+    SmallVector<bool> isColMajorArr(11, false);
+    SmallVector<int64_t> operandRanks = {0, 0, 0, 0, 0, 0, 0, 2, 0, 2, 0};
+    SmallVector<int64_t> outputRanks = {2};
+    auto operandLayouts =
+        getSHLOLayout(rewriter, operandRanks, isColMajorArr, 2);
+    auto resultLayouts = getSHLOLayout(rewriter, outputRanks, isColMajorArr, 2);
+
+    SmallVector<Attribute> aliases;
+    aliases.push_back(stablehlo::OutputOperandAliasAttr::get(
+        ctx, std::vector<int64_t>{}, 9, std::vector<int64_t>{}));
+
+    auto callOp = createOutlinedBLASCall(
+        rewriter, moduleOp, op.getLoc(), funcFnName,
+        ValueRange{op.getA(), op.getB(), op.getAlpha()}, BType,
+        [&](ArrayRef<BlockArgument> args) -> Value {
+          auto loc = op.getLoc();
+          Value A = args[0], B = args[1], alpha = args[2];
+
+          auto side = createBLASChar(rewriter, loc, left ? 'R' : 'L');
+          auto uplo = createBLASChar(rewriter, loc, upper ? 'L' : 'U');
+          auto transa = createBLASChar(rewriter, loc, trans);
+          auto diag = createBLASChar(rewriter, loc, 'N');
+          auto m = createBLASDimSize(rewriter, loc, intType, B, 1);
+          auto n = createBLASDimSize(rewriter, loc, intType, B, 0);
+          auto lda = createBLASDimSize(rewriter, loc, intType, A, 1);
+
+          // {side, uplo, transa, diag, m, n, alpha, A, lda, B, ldb}
+          auto jitCall = enzymexla::JITCallOp::create(
+              rewriter, loc, TypeRange{BType},
+              mlir::FlatSymbolRefAttr::get(ctx, blasFnWrapper),
+              ValueRange{side, uplo, transa, diag, m, n, alpha, A, lda, B, m},
+              rewriter.getStringAttr(""),
+              /*operand_layouts=*/operandLayouts,
+              /*result_layouts=*/resultLayouts,
+              /*arg_attrs=*/nullptr,
+              /*res_attrs=*/nullptr,
+              /*output_operand_aliases=*/rewriter.getArrayAttr(aliases),
+              /*xla_side_effect_free=*/rewriter.getUnitAttr());
+          return jitCall.getResult(0);
+        });
+
+    rewriter.replaceOp(op, callOp.getResult(0));
+    return success();
+  }
+
+  LogicalResult matchAndRewriteFallback(enzymexla::TrmmOp op,
+                                        PatternRewriter &rewriter) const {
+    auto AType = cast<RankedTensorType>(op.getA().getType());
+    auto BType = cast<RankedTensorType>(op.getB().getType());
+    auto nBatchDims = BType.getRank() - 2;
+    SmallVector<int64_t> batchDims(nBatchDims, 0);
+    std::iota(batchDims.begin(), batchDims.end(), 0);
+
+    // Zero the unreferenced triangle; BLAS never reads it, so it may hold
+    // arbitrary values.
+    Value A = op.getA();
+    if (op.getUplo() != enzymexla::LapackUplo::F) {
+      if (!AType.hasStaticShape())
+        return rewriter.notifyMatchFailure(op, "dynamic triangular operand");
+      auto idxType =
+          RankedTensorType::get(AType.getShape(), rewriter.getI32Type());
+      Value rowIdxs =
+          stablehlo::IotaOp::create(rewriter, op.getLoc(), idxType, nBatchDims);
+      Value colIdxs = stablehlo::IotaOp::create(rewriter, op.getLoc(), idxType,
+                                                nBatchDims + 1);
+      Value indicator = stablehlo::CompareOp::create(
+          rewriter, op.getLoc(), rowIdxs, colIdxs,
+          op.getUplo() == enzymexla::LapackUplo::U ? ComparisonDirection::LE
+                                                   : ComparisonDirection::GE);
+      Value zero = stablehlo::ConstantOp::create(
+          rewriter, op.getLoc(), AType,
+          cast<ElementsAttr>(makeAttr(AType, 0)));
+      A = stablehlo::SelectOp::create(rewriter, op.getLoc(), indicator, A,
+                                      zero);
+    }
+
+    bool transposed = op.getTranspose() != enzymexla::LapackTranspose::none;
+    if (op.getTranspose() == enzymexla::LapackTranspose::adjoint &&
+        isa<ComplexType>(AType.getElementType()))
+      A = chlo::ConjOp::create(rewriter, op.getLoc(), A);
+
+    // op(A) is folded into the contracting dimension instead of materializing
+    // a transpose.
+    int64_t rowDim = nBatchDims, colDim = nBatchDims + 1;
+    Value lhs, rhs;
+    stablehlo::DotDimensionNumbersAttr dotDims;
+    if (op.getSide() == enzymexla::LapackSide::left) {
+      lhs = A;
+      rhs = op.getB();
+      dotDims = stablehlo::DotDimensionNumbersAttr::get(
+          op.getContext(), batchDims, batchDims, {transposed ? rowDim : colDim},
+          {rowDim});
+    } else {
+      lhs = op.getB();
+      rhs = A;
+      dotDims = stablehlo::DotDimensionNumbersAttr::get(
+          op.getContext(), batchDims, batchDims, {colDim},
+          {transposed ? colDim : rowDim});
+    }
+
+    auto prod = stablehlo::DotGeneralOp::create(
+        rewriter, op.getLoc(), BType, lhs, rhs, dotDims, nullptr, nullptr);
+    auto res =
+        stablehlo::MulOpCreate(rewriter, op->getLoc(), op.getAlpha(), prod);
+    rewriter.replaceOp(op, res);
+    return success();
+  }
+
+private:
+  std::string backend;
+  int64_t blasIntWidth;
+};
+
 struct LowerEnzymeXLABLASPass
     : public enzyme::impl::LowerEnzymeXLABLASPassBase<LowerEnzymeXLABLASPass> {
   using Base::Base;
@@ -507,7 +894,8 @@ struct LowerEnzymeXLABLASPass
     auto context = getOperation()->getContext();
     RewritePatternSet patterns(context);
 
-    patterns.add<SyrkOpLowering>(backend, blasIntWidth, context);
+    patterns.add<SyrkOpLowering, SymmOpLowering, TrmmOpLowering>(
+        backend, blasIntWidth, context);
 
     GreedyRewriteConfig config;
     config.setUseTopDownTraversal(true);
@@ -518,8 +906,8 @@ struct LowerEnzymeXLABLASPass
 
     // Verify that all illegal ops have been lowered
     auto walkResult = getOperation()->walk([&](Operation *op) {
-      if (isa<enzymexla::SyrkOp>(op)) {
-        op->emitError("Failed to lower enzymexla::SyrkOp");
+      if (isa<enzymexla::SyrkOp, enzymexla::SymmOp, enzymexla::TrmmOp>(op)) {
+        op->emitError() << "Failed to lower " << op->getName();
         return WalkResult::interrupt();
       }
       return WalkResult::advance();
@@ -18,6 +18,7 @@
 #include "llvm/Support/MathExtras.h"
 #include <algorithm>
 #include <cstdint>
+#include <numeric>
 
 #define DEBUG_TYPE "lower-enzymexla-lapack"
 
@@ -31,6 +32,35 @@ namespace enzyme {
 using namespace mlir;
 using namespace mlir::enzyme;
 
+// Reduces `input` along `dim` with the binary elementwise op `OpTy`.
+template <typename OpTy>
+static Value createReduce(PatternRewriter &rewriter, Location loc, Value input,
+                          Value init, int64_t dim) {
+  auto inputType = cast<RankedTensorType>(input.getType());
+  SmallVector<int64_t> resultShape;
+  for (auto [i, size] : llvm::enumerate(inputType.getShape()))
+    if ((int64_t)i != dim)
+      resultShape.push_back(size);
+  auto resultType =
+      RankedTensorType::get(resultShape, inputType.getElementType());
+  auto scalarType = RankedTensorType::get({}, inputType.getElementType());
+
+  auto reduceOp = stablehlo::ReduceOp::create(
+      rewriter, loc, TypeRange{resultType}, ValueRange{input},
+      ValueRange{init}, rewriter.getDenseI64ArrayAttr({dim}));
+  {
+    OpBuilder::InsertionGuard guard(rewriter);
+    Block *block = rewriter.createBlock(&reduceOp.getBody());
+    block->addArgument(scalarType, loc);
+    block->addArgument(scalarType, loc);
+    rewriter.setInsertionPointToStart(block);
+    auto res = OpTy::create(rewriter, loc, block->getArgument(0),
+                            block->getArgument(1));
+    stablehlo::ReturnOp::create(rewriter, loc, ValueRange{res});
+  }
+  return reduceOp.getResult(0);
+}
+
 struct GeqrfOpLowering : public OpRewritePattern<enzymexla::GeqrfOp> {
   std::string backend;
   int64_t blasIntWidth;
@@ -1332,11 +1362,14 @@ Value anyNonFiniteValue(PatternRewriter &rewriter, Location loc, Type outType,
 struct GetrfOpLowering : public OpRewritePattern<enzymexla::GetrfOp> {
   std::string backend;
   int64_t blasIntWidth;
+  int64_t batchedKernelMaxSize;
 
   GetrfOpLowering(std::string backend, int64_t blasIntWidth,
-                  MLIRContext *context, PatternBenefit benefit = 1)
+                  int64_t batchedKernelMaxSize, MLIRContext *context,
+                  PatternBenefit benefit = 1)
       : OpRewritePattern(context, benefit), backend(backend),
-        blasIntWidth(blasIntWidth) {}
+        blasIntWidth(blasIntWidth),
+        batchedKernelMaxSize(batchedKernelMaxSize) {}
 
   LogicalResult matchAndRewrite(enzymexla::GetrfOp op,
                                 PatternRewriter &rewriter) const override {
@@ -1440,6 +1473,13 @@ private:
     auto unbatchedInfoType =
         RankedTensorType::get({}, infoType.getElementType());
 
+    // A stack of many small matrices is dominated by per-call overhead when
+    // every matrix goes through its own LAPACK call.
+    if (numBatchDims > 0 && inputType.hasStaticShape() &&
+        inputShape[inputRank - 1] == inputShape[inputRank - 2] &&
+        inputShape[inputRank - 1] <= batchedKernelMaxSize)
+      return matchAndRewriteCPUBatchedKernel(op, rewriter);
+
     auto moduleOp = op->getParentOfType<ModuleOp>();
 
     auto blasIntType = rewriter.getIntegerType(blasIntWidth);
@@ -1762,6 +1802,234 @@ private:
     return success();
   }
 
+  // Right-looking LU with partial pivoting, fully unrolled over the columns
+  // of a square matrix. Every step is a handful of elementwise ops over the
+  // whole stack, so the batch dimensions become the vectorized and
+  // multithreaded dimensions after fusion instead of a loop of LAPACK calls.
+  // Row swaps are tracked on the permutation directly, which avoids the
+  // pivot-to-permutation loop of the LAPACK path.
+  LogicalResult
+  matchAndRewriteCPUBatchedKernel(enzymexla::GetrfOp op,
+                                  PatternRewriter &rewriter) const {
+    using stablehlo::ComparisonDirection;
+    auto loc = op.getLoc();
+    Value A = op.getInput();
+
+    auto inputType = cast<RankedTensorType>(A.getType());
+    auto pivotType = cast<RankedTensorType>(op.getResult(1).getType());
+    auto permutationType = cast<RankedTensorType>(op.getResult(2).getType());
+    auto infoType = cast<RankedTensorType>(op.getResult(3).getType());
+
+    auto elementType = inputType.getElementType();
+    Type magnitudeType = elementType;
+    if (auto complexType = dyn_cast<ComplexType>(elementType))
+      magnitudeType = complexType.getElementType();
+
+    auto numBatchDims = inputType.getRank() - 2;
+    auto rowDim = numBatchDims, colDim = numBatchDims + 1;
+    int64_t n = inputType.getShape()[rowDim];
+
+    SmallVector<int64_t> batchShape(inputType.getShape().begin(),
+                                    inputType.getShape().begin() +
+                                        numBatchDims);
+    SmallVector<int64_t> batchDims(numBatchDims);
+    std::iota(batchDims.begin(), batchDims.end(), 0);
+
+    auto withShape = [&](ArrayRef<int64_t> extra, Type elemType) {
+      SmallVector<int64_t> shape(batchShape);
+      shape.append(extra.begin(), extra.end());
+      return RankedTensorType::get(shape, elemType);
+    };
+    auto constant = [&](RankedTensorType type, int64_t value) -> Value {
+      return stablehlo::ConstantOp::create(
+          rewriter, loc, type, cast<ElementsAttr>(makeAttr(type, value)));
+    };
+    auto broadcast = [&](Value value, RankedTensorType type,
+                         ArrayRef<int64_t> dims) -> Value {
+      return stablehlo::BroadcastInDimOp::create(
+          rewriter, loc, type, value, rewriter.getDenseI64ArrayAttr(dims));
+    };
+    auto dimsWith = [&](ArrayRef<int64_t> extra) {
+      SmallVector<int64_t> dims(batchDims);
+      dims.append(extra.begin(), extra.end());
+      return dims;
+    };
+    // Extracts index `k` of dimension `dim` and drops that dimension.
+    auto extract = [&](Value value, int64_t dim, int64_t k) -> Value {
+      auto type = cast<RankedTensorType>(value.getType());
+      SmallVector<int64_t> start(type.getRank(), 0);
+      SmallVector<int64_t> limit(type.getShape());
+      SmallVector<int64_t> strides(type.getRank(), 1);
+      start[dim] = k;
+      limit[dim] = k + 1;
+      auto slice = stablehlo::SliceOp::create(rewriter, loc, value, start,
+                                              limit, strides);
+      SmallVector<int64_t> shape(type.getShape());
+      shape.erase(shape.begin() + dim);
+      return stablehlo::ReshapeOp::create(
+          rewriter, loc, RankedTensorType::get(shape, type.getElementType()),
+          slice);
+    };
+    auto compare = [&](Value lhs, Value rhs, ComparisonDirection direction) {
+      return stablehlo::CompareOp::create(rewriter, loc, lhs, rhs, direction)
+          .getResult();
+    };
+
+    auto idxElemType = pivotType.getElementType();
+    auto matType = withShape({n, n}, elementType);
+    auto matIdxType = withShape({n, n}, idxElemType);
+    auto vecType = withShape({n}, elementType);
+    auto vecIdxType = withShape({n}, idxElemType);
+    auto vecMagnitudeType = withShape({n}, magnitudeType);
+    auto batchType = withShape({}, elementType);
+    auto batchIdxType = withShape({}, idxElemType);
+    auto scalarMagnitudeType = RankedTensorType::get({}, magnitudeType);
+    auto scalarIdxType = RankedTensorType::get({}, idxElemType);
+    auto scalarType = RankedTensorType::get({}, elementType);
+
+    Value matRowIdx = stablehlo::IotaOp::create(rewriter, loc, matIdxType,
+                                                rowDim);
+    Value matColIdx = stablehlo::IotaOp::create(rewriter, loc, matIdxType,
+                                                colDim);
+    Value vecIdx = stablehlo::IotaOp::create(rewriter, loc, vecIdxType, rowDim);
+
+    Value permutation = vecIdx;
+    Value info = constant(batchIdxType, 0);
+    SmallVector<Value> pivots;
+
+    for (int64_t k = 0; k < n; k++) {
+      // Pivot search: first row at or below k with the largest magnitude,
+      // using |re| + |im| for complex inputs like i?amax.
+      Value column = extract(A, colDim, k);
+      Value magnitude;
+      if (isa<ComplexType>(elementType)) {
+        Value re = stablehlo::RealOp::create(rewriter, loc, column);
+        Value im = stablehlo::ImagOp::create(rewriter, loc, column);
+        magnitude = stablehlo::AddOp::create(
+            rewriter, loc, stablehlo::AbsOp::create(rewriter, loc, re),
+            stablehlo::AbsOp::create(rewriter, loc, im));
+      } else {
+        magnitude = stablehlo::AbsOp::create(rewriter, loc, column);
+      }
+      Value candidate =
+          compare(vecIdx, constant(vecIdxType, k), ComparisonDirection::GE);
+      magnitude = stablehlo::SelectOp::create(
+          rewriter, loc, candidate, magnitude,
+          constant(vecMagnitudeType, -1));
+      Value maxMagnitude = createReduce<stablehlo::MaxOp>(
+          rewriter, loc, magnitude, constant(scalarMagnitudeType, -1), rowDim);
+      Value isMax = compare(
+          magnitude, broadcast(maxMagnitude, vecMagnitudeType, batchDims),
+          ComparisonDirection::EQ);
+      Value p = createReduce<stablehlo::MinOp>(
+          rewriter, loc,
+          stablehlo::SelectOp::create(rewriter, loc, isMax, vecIdx,
+                                      constant(vecIdxType, n)),
+          constant(scalarIdxType, n), rowDim);
+      // A column of NaNs has no maximum; keep the diagonal as the pivot.
+      p = stablehlo::SelectOp::create(
+          rewriter, loc,
+          compare(p, constant(batchIdxType, n), ComparisonDirection::LT), p,
+          constant(batchIdxType, k));
+      pivots.push_back(p);
+
+      // Swap rows k and p.
+      Value isRowP = compare(matRowIdx, broadcast(p, matIdxType, batchDims),
+                             ComparisonDirection::EQ);
+      Value isRowK =
+          compare(matRowIdx, constant(matIdxType, k), ComparisonDirection::EQ);
+      Value rowK = extract(A, rowDim, k);
+      Value rowP = createReduce<stablehlo::AddOp>(
+          rewriter, loc,
+          stablehlo::SelectOp::create(rewriter, loc, isRowP, A,
+                                      constant(matType, 0)),
+          constant(scalarType, 0), rowDim);
+      A = stablehlo::SelectOp::create(
+          rewriter, loc, isRowK, broadcast(rowP, matType, dimsWith({colDim})),
+          stablehlo::SelectOp::create(
+              rewriter, loc, isRowP,
+              broadcast(rowK, matType, dimsWith({colDim})), A));
+
+      Value isEntryP = compare(vecIdx, broadcast(p, vecIdxType, batchDims),
+                               ComparisonDirection::EQ);
+      Value isEntryK =
+          compare(vecIdx, constant(vecIdxType, k), ComparisonDirection::EQ);
+      Value permK = extract(permutation, rowDim, k);
+      Value permP = createReduce<stablehlo::AddOp>(
+          rewriter, loc,
+          stablehlo::SelectOp::create(rewriter, loc, isEntryP, permutation,
+                                      constant(vecIdxType, 0)),
+          constant(scalarIdxType, 0), rowDim);
+      permutation = stablehlo::SelectOp::create(
+          rewriter, loc, isEntryK, broadcast(permP, vecIdxType, batchDims),
+          stablehlo::SelectOp::create(rewriter, loc, isEntryP,
+                                      broadcast(permK, vecIdxType, batchDims),
+                                      permutation));
+
+      // Like getrf, a zero pivot records the first singular column in info
+      // and skips the scaling of that column.
+      Value pivot = extract(rowP, rowDim, k);
+      Value isSingular =
+          compare(pivot, constant(batchType, 0), ComparisonDirection::EQ);
+      info = stablehlo::SelectOp::create(
+          rewriter, loc,
+          stablehlo::AndOp::create(
+              rewriter, loc, isSingular,
+              compare(info, constant(batchIdxType, 0),
+                      ComparisonDirection::EQ)),
+          constant(batchIdxType, k + 1), info);
+      pivot = stablehlo::SelectOp::create(rewriter, loc, isSingular,
+                                          constant(batchType, 1), pivot);
+
+      // Scale the subdiagonal of column k and apply the rank-1 update to the
+      // trailing submatrix.
+      Value multipliers = stablehlo::DivOp::create(
+          rewriter, loc, extract(A, colDim, k),
+          broadcast(pivot, vecType, batchDims));
+      Value below =
+          compare(matRowIdx, constant(matIdxType, k), ComparisonDirection::GT);
+      Value right =
+          compare(matColIdx, constant(matIdxType, k), ComparisonDirection::GT);
+      Value isColK =
+          compare(matColIdx, constant(matIdxType, k), ComparisonDirection::EQ);
+      Value L = broadcast(multipliers, matType, dimsWith({rowDim}));
+      Value update = stablehlo::SubtractOp::create(
+          rewriter, loc, A,
+          stablehlo::MulOp::create(
+              rewriter, loc, L, broadcast(rowP, matType, dimsWith({colDim}))));
+      A = stablehlo::SelectOp::create(
+          rewriter, loc, stablehlo::AndOp::create(rewriter, loc, below, right),
+          update, A);
+      A = stablehlo::SelectOp::create(
+          rewriter, loc, stablehlo::AndOp::create(rewriter, loc, below, isColK),
+          L, A);
+    }
+
+    // Pivots and the permutation are 1-indexed like the LAPACK path.
+    SmallVector<Value> pivotColumns;
+    for (auto p : pivots)
+      pivotColumns.push_back(stablehlo::ReshapeOp::create(
+          rewriter, loc, withShape({1}, idxElemType), p));
+    Value pivotResult = stablehlo::ConcatenateOp::create(
+        rewriter, loc, pivotColumns, rowDim);
+    pivotResult = stablehlo::AddOp::create(rewriter, loc, pivotResult,
+                                           constant(vecIdxType, 1));
+    permutation = stablehlo::AddOp::create(rewriter, loc, permutation,
+                                           constant(vecIdxType, 1));
+
+    rewriter.replaceAllUsesWith(op.getResult(0), A);
+    rewriter.replaceAllUsesWith(
+        op.getResult(1),
+        stablehlo::ConvertOp::create(rewriter, loc, pivotType, pivotResult));
+    rewriter.replaceAllUsesWith(
+        op.getResult(2), stablehlo::ConvertOp::create(
+                             rewriter, loc, permutationType, permutation));
+    rewriter.replaceAllUsesWith(
+        op.getResult(3),
+        stablehlo::ConvertOp::create(rewriter, loc, infoType, info));
+    return success();
+  }
+
   LogicalResult matchAndRewriteGPU(enzymexla::GetrfOp op,
                                    PatternRewriter &rewriter,
                                    const std::string &backend) const {
@@ -2719,9 +2987,10 @@ struct LowerEnzymeXLALapackPass
 
     patterns
         .add<GeqrfOpLowering, GeqrtOpLowering, OrgqrOpLowering, OrmqrOpLowering,
-             GemqrtOpLowering, GetrfOpLowering, GetriOpLowering,
-             GesvdOpLowering, GesddOpLowering, GesvjOpLowering>(
-            backend, blasIntWidth, context);
+             GemqrtOpLowering, GetriOpLowering, GesvdOpLowering,
+             GesddOpLowering, GesvjOpLowering>(backend, blasIntWidth, context);
+    patterns.add<GetrfOpLowering>(backend, blasIntWidth, batchedKernelMaxSize,
+                                  context);
 
     GreedyRewriteConfig config;
     if (failed(applyPatternsAndFoldGreedily(getOperation(), std::move(patterns),
@@ -27,6 +27,218 @@ namespace enzyme {
 
 using namespace mlir;
 
+// Returns the communicator to call MPI with inside a wrapper function: the
+// handle stored at `commPtr` if the op was given a communicator, and
+// MPI_COMM_WORLD otherwise.
+static Value getCommunicator(PatternRewriter &rewriter, Location loc,
+                             Value commPtr) {
+  auto llvmPtrType = LLVM::LLVMPointerType::get(rewriter.getContext());
+  if (commPtr)
+    return rewriter.create<LLVM::LoadOp>(loc, llvmPtrType, commPtr);
+  return rewriter.create<LLVM::AddressOfOp>(loc, llvmPtrType,
+                                            "MPI_COMM_WORLD");
+}
+
+// Creates the wrapper function `name` taking `numArgs` pointers, unless it
+// already exists, and fills its body with `buildBody`, which is given the
+// entry block and must not create the return.
+static void
+createMPIWrapper(PatternRewriter &rewriter, ModuleOp moduleOp, Location loc,
+                 StringRef name, unsigned numArgs,
+                 function_ref<void(Block *entryBlock)> buildBody) {
+  if (moduleOp.lookupSymbol<LLVM::LLVMFuncOp>(name))
+    return;
+
+  OpBuilder::InsertionGuard guard(rewriter);
+  rewriter.setInsertionPointToStart(moduleOp.getBody());
+
+  auto context = rewriter.getContext();
+  SmallVector<Type> argTypes(numArgs, LLVM::LLVMPointerType::get(context));
+  auto funcType = LLVM::LLVMFunctionType::get(LLVM::LLVMVoidType::get(context),
+                                              argTypes, false);
+  auto wrapperFunc = rewriter.create<LLVM::LLVMFuncOp>(loc, name, funcType);
+
+  auto memoryEffectsAttr = rewriter.getArrayAttr(
+      {rewriter.getStringAttr("read"), rewriter.getStringAttr("write"),
+       rewriter.getStringAttr("allocate"), rewriter.getStringAttr("free")});
+  wrapperFunc->setAttr("enzymexla.memory_effects", memoryEffectsAttr);
+  for (unsigned i = 0; i < numArgs; ++i)
+    wrapperFunc.setArgAttr(i, "enzymexla.memory_effects", memoryEffectsAttr);
+
+  Block *entryBlock = wrapperFunc.addEntryBlock(rewriter);
+  rewriter.setInsertionPointToStart(entryBlock);
+  buildBody(entryBlock);
+  rewriter.create<LLVM::ReturnOp>(loc, ValueRange{});
+}
+
+// Declares the external function `name` if not already present.
+static void declareFunction(PatternRewriter &rewriter, ModuleOp moduleOp,
+                            Location loc, StringRef name, Type resultType,
+                            ArrayRef<Type> argTypes) {
+  if (moduleOp.lookupSymbol<LLVM::LLVMFuncOp>(name))
+    return;
+
+  OpBuilder::InsertionGuard guard(rewriter);
+  rewriter.setInsertionPointToStart(moduleOp.getBody());
+  auto funcType = LLVM::LLVMFunctionType::get(resultType, argTypes, false);
+  rewriter.create<LLVM::LLVMFuncOp>(loc, name, funcType,
+                                    LLVM::Linkage::External);
+}
+
+// Declares the MPI function `name`, which returns an i32 error code, if not
+// already present.
+static void declareMPIFunction(PatternRewriter &rewriter, ModuleOp moduleOp,
+                               Location loc, StringRef name,
+                               ArrayRef<Type> argTypes) {
+  declareFunction(rewriter, moduleOp, loc, name, rewriter.getI32Type(),
+                  argTypes);
+}
+
+// Declares the MPI handle `name` (a datatype, op, communicator...) if not
+// already present.
+static void declareMPIHandle(PatternRewriter &rewriter, ModuleOp moduleOp,
+                             Location loc, StringRef name) {
+  if (moduleOp.lookupSymbol<LLVM::GlobalOp>(name))
+    return;
+
+  OpBuilder::InsertionGuard guard(rewriter);
+  rewriter.setInsertionPointToStart(moduleOp.getBody());
+  rewriter.create<LLVM::GlobalOp>(
+      loc, LLVM::LLVMPointerType::get(rewriter.getContext()),
+      /*isConstant=*/true, LLVM::Linkage::External, name,
+      /*value=*/Attribute(),
+      /*alignment=*/0,
+      /*addrSpace=*/0);
+}
+
+// Replaces `op` with a call of the wrapper `wrapperName` on `operands`, where
+// result i aliases operand `aliasedOperands[i]`.
+static void replaceWithJITCall(PatternRewriter &rewriter, Operation *op,
+                               StringRef wrapperName, ValueRange operands,
+                               ArrayRef<int64_t> aliasedOperands) {
+  auto context = op->getContext();
+  SmallVector<Attribute> aliases;
+  for (auto [i, operandIndex] : llvm::enumerate(aliasedOperands)) {
+    aliases.push_back(stablehlo::OutputOperandAliasAttr::get(
+        context,
+        /*output_tuple_indices=*/op->getNumResults() > 1
+            ? ArrayRef<int64_t>{static_cast<int64_t>(i)}
+            : ArrayRef<int64_t>{},
+        /*operand_index=*/operandIndex,
+        /*operand_tuple_indices=*/ArrayRef<int64_t>{}));
+  }
+
+  auto jitCall = rewriter.create<enzymexla::JITCallOp>(
+      op->getLoc(), op->getResultTypes(),
+      mlir::FlatSymbolRefAttr::get(context, wrapperName), operands,
+      rewriter.getStringAttr(""),
+      /*operand_layouts=*/nullptr,
+      /*result_layouts=*/nullptr,
+      /*arg_attrs=*/nullptr,
+      /*res_attrs=*/nullptr,
+      /*output_operand_aliases=*/
+      aliases.empty() ? nullptr : rewriter.getArrayAttr(aliases),
+      /*xla_side_effect_free=*/nullptr);
+  rewriter.replaceOp(op, jitCall);
+}
+
+// Creates the tensor a handle returned by MPI is written to.
+static Value createHandleTensor(PatternRewriter &rewriter, Location loc,
+                                Type type) {
+  auto tensorType = cast<RankedTensorType>(type);
+  return rewriter.create<stablehlo::ConstantOp>(
+      loc, tensorType,
+      cast<ElementsAttr>(makeAttr(tensorType, static_cast<int64_t>(-1))));
+}
+
+// A persistent request is a pointer to a record holding the MPI request, the
+// buffers owned by the request (null when unused) and their size in bytes.
+// XLA buffers may move between calls, so MPI is only ever bound to these.
+enum PersistentRequestField {
+  PersistentRequest = 0,
+  PersistentSendBuf = 1,
+  PersistentRecvBuf = 2,
+  PersistentBytes = 3,
+};
+
+static LLVM::LLVMStructType getPersistentRequestType(MLIRContext *context) {
+  auto i64Type = IntegerType::get(context, 64);
+  auto llvmPtrType = LLVM::LLVMPointerType::get(context);
+  return LLVM::LLVMStructType::getLiteral(
+      context, {i64Type, llvmPtrType, llvmPtrType, i64Type});
+}
+
+// Returns the address of `field` in the record of the persistent request
+// stored at `requestPtr`.
+static Value getPersistentRequestField(PatternRewriter &rewriter, Location loc,
+                                       Value requestPtr,
+                                       PersistentRequestField field) {
+  auto context = rewriter.getContext();
+  auto llvmPtrType = LLVM::LLVMPointerType::get(context);
+  Value record = rewriter.create<LLVM::LoadOp>(loc, llvmPtrType, requestPtr);
+  return rewriter.create<LLVM::GEPOp>(
+      loc, llvmPtrType, getPersistentRequestType(context), record,
+      ArrayRef<LLVM::GEPArg>{0, static_cast<int32_t>(field)});
+}
+
+// Allocates the record of a persistent request for `count` elements of
+// `datatype`, with a send and/or receive buffer of that size, and stores it to
+// `requestPtr`. Returns the address of the MPI request and the buffers.
+static std::tuple<Value, Value, Value>
+createPersistentRequest(PatternRewriter &rewriter, ModuleOp moduleOp,
+                        Location loc, Value count, Value datatype,
+                        Value requestPtr, bool hasSendBuf, bool hasRecvBuf) {
+  auto context = rewriter.getContext();
+  auto llvmPtrType = LLVM::LLVMPointerType::get(context);
+  auto i32Type = rewriter.getI32Type();
+  auto i64Type = rewriter.getI64Type();
+  auto recordType = getPersistentRequestType(context);
+
+  declareFunction(rewriter, moduleOp, loc, "malloc", llvmPtrType, {i64Type});
+  declareMPIFunction(rewriter, moduleOp, loc, "MPI_Type_size",
+                     {llvmPtrType, llvmPtrType});
+
+  auto malloc = [&](Value bytes) {
+    return rewriter
+        .create<LLVM::CallOp>(loc, TypeRange{llvmPtrType},
+                              SymbolRefAttr::get(context, "malloc"),
+                              ValueRange{bytes})
+        .getResult();
+  };
+
+  // The record holds four 8-byte fields.
+  Value record = malloc(rewriter.create<LLVM::ConstantOp>(
+      loc, i64Type, rewriter.getI64IntegerAttr(32)));
+
+  Value one = rewriter.create<LLVM::ConstantOp>(loc, i32Type,
+                                                rewriter.getI32IntegerAttr(1));
+  Value typeSizePtr =
+      rewriter.create<LLVM::AllocaOp>(loc, llvmPtrType, i32Type, one);
+  // TODO returns i32 error code which we're ignoring here
+  rewriter.create<LLVM::CallOp>(loc, TypeRange{i32Type},
+                                SymbolRefAttr::get(context, "MPI_Type_size"),
+                                ValueRange{datatype, typeSizePtr});
+  Value typeSize = rewriter.create<LLVM::LoadOp>(loc, i32Type, typeSizePtr);
+  Value bytes = rewriter.create<LLVM::MulOp>(
+      loc, rewriter.create<LLVM::SExtOp>(loc, i64Type, count),
+      rewriter.create<LLVM::SExtOp>(loc, i64Type, typeSize));
+
+  Value null = rewriter.create<LLVM::ZeroOp>(loc, llvmPtrType);
+  Value sendBuf = hasSendBuf ? malloc(bytes) : null;
+  Value recvBuf = hasRecvBuf ? malloc(bytes) : null;
+
+  auto getField = [&](PersistentRequestField field) {
+    return rewriter.create<LLVM::GEPOp>(
+        loc, llvmPtrType, recordType, record,
+        ArrayRef<LLVM::GEPArg>{0, static_cast<int32_t>(field)});
+  };
+  rewriter.create<LLVM::StoreOp>(loc, sendBuf, getField(PersistentSendBuf));
+  rewriter.create<LLVM::StoreOp>(loc, recvBuf, getField(PersistentRecvBuf));
+  rewriter.create<LLVM::StoreOp>(loc, bytes, getField(PersistentBytes));
+  rewriter.create<LLVM::StoreOp>(loc, record, requestPtr);
+  return {getField(PersistentRequest), sendBuf, recvBuf};
+}
+
 struct MPICommRankOpLowering
     : public OpRewritePattern<enzymexla::MPICommRankOp> {
 
@@ -49,22 +261,25 @@ struct MPICommRankOpLowering
 
       std::string mpiFunctionName = "MPI_Comm_rank";
 
-      // For now we just hard code MPI_COMM_WORLD as the communicator.
-      // TODO make this more flexible
+      // MPI_COMM_WORLD is used unless the op was given a communicator
+      Value comm = op.getComm();
       std::string communicatorName = "MPI_COMM_WORLD";
 
       // Generate the enzymexla_wrapper_MPI_Comm_rank LLVM function body
       std::string wrapperFunctionName = "enzymexla_wrapper_" + mpiFunctionName;
+      if (comm)
+        wrapperFunctionName += "_comm";
 
       if (!moduleOp.lookupSymbol<LLVM::LLVMFuncOp>(wrapperFunctionName)) {
         OpBuilder::InsertionGuard guard(rewriter);
         rewriter.setInsertionPointToStart(moduleOp.getBody());
 
         // Create the function type
+        SmallVector<Type> argTypes(1, llvmPtrType);
+        if (comm)
+          argTypes.push_back(llvmPtrType);
         auto funcType =
-            LLVM::LLVMFunctionType::get(llvmVoidType,  // void return type
-                                        {llvmPtrType}, // pointer parameter
-                                        false);        // is variadic: false
+            LLVM::LLVMFunctionType::get(llvmVoidType, argTypes, false);
 
         auto wrapperFunc = rewriter.create<LLVM::LLVMFuncOp>(
             op.getLoc(), wrapperFunctionName, funcType);
@@ -80,8 +295,10 @@ struct MPICommRankOpLowering
         rewriter.setInsertionPointToStart(entryBlock);
 
         // Add argument-level memory effects attribute
-        wrapperFunc.setArgAttr(0, "enzymexla.memory_effects",
-                               memoryEffectsAttr);
+        for (unsigned i = 0; i < argTypes.size(); ++i) {
+          wrapperFunc.setArgAttr(i, "enzymexla.memory_effects",
+                                 memoryEffectsAttr);
+        }
 
         // Get the rank pointer from the argument
         Value rankPtr = entryBlock->getArgument(0);
@@ -89,8 +306,9 @@ struct MPICommRankOpLowering
         // Get the address of the communicator
         // NOTE these symbols are not ABI-stable until MPI 5.0, but in practice,
         // they are represented as word-size values (i.e. `int` or ptr)
-        Value addressOfComm = rewriter.create<LLVM::AddressOfOp>(
-            op.getLoc(), llvmPtrType, communicatorName);
+        Value addressOfComm =
+            getCommunicator(rewriter, op.getLoc(),
+                            comm ? entryBlock->getArgument(1) : Value());
 
         // TODO error checking
         // MPI_Comm_rank returns i32 error code which we're ignoring here
@@ -115,7 +333,7 @@ struct MPICommRankOpLowering
       }
 
       // Insert MPI_COMM_WORLD declaration if not already present
-      if (!moduleOp.lookupSymbol<LLVM::GlobalOp>(communicatorName)) {
+      if (!comm && !moduleOp.lookupSymbol<LLVM::GlobalOp>(communicatorName)) {
         OpBuilder::InsertionGuard guard(rewriter);
         rewriter.setInsertionPointToStart(moduleOp.getBody());
 
@@ -134,6 +352,10 @@ struct MPICommRankOpLowering
       Value constantTensor = rewriter.create<stablehlo::ConstantOp>(
           op.getLoc(), tensorType, constantAttr);
 
+      SmallVector<Value> jitCallOperands = {constantTensor};
+      if (comm)
+        jitCallOperands.push_back(comm);
+
       // Call the LLVM function with enzymexla.jit_call
       auto aliasAttr = stablehlo::OutputOperandAliasAttr::get(
           context,
@@ -144,7 +366,7 @@ struct MPICommRankOpLowering
       auto jitCall = rewriter.create<enzymexla::JITCallOp>(
           op.getLoc(), op->getResultTypes(),
           mlir::FlatSymbolRefAttr::get(context, wrapperFunctionName),
-          ValueRange{constantTensor}, rewriter.getStringAttr(""),
+          jitCallOperands, rewriter.getStringAttr(""),
           /*operand_layouts=*/nullptr,
           /*result_layouts=*/nullptr,
           /*arg_attrs=*/nullptr,
@@ -185,22 +407,25 @@ struct MPICommSizeOpLowering
 
       std::string mpiFunctionName = "MPI_Comm_size";
 
-      // For now we just hard code MPI_COMM_WORLD as the communicator.
-      // TODO make this more flexible
+      // MPI_COMM_WORLD is used unless the op was given a communicator
+      Value comm = op.getComm();
       std::string communicatorName = "MPI_COMM_WORLD";
 
       // Generate the enzymexla_wrapper_MPI_Comm_size LLVM function body
       std::string wrapperFunctionName = "enzymexla_wrapper_" + mpiFunctionName;
+      if (comm)
+        wrapperFunctionName += "_comm";
 
       if (!moduleOp.lookupSymbol<LLVM::LLVMFuncOp>(wrapperFunctionName)) {
         OpBuilder::InsertionGuard guard(rewriter);
         rewriter.setInsertionPointToStart(moduleOp.getBody());
 
         // Create the function type
+        SmallVector<Type> argTypes(1, llvmPtrType);
+        if (comm)
+          argTypes.push_back(llvmPtrType);
         auto funcType =
-            LLVM::LLVMFunctionType::get(llvmVoidType,  // void return type
-                                        {llvmPtrType}, // parameter types
-                                        false);        // is variadic: false
+            LLVM::LLVMFunctionType::get(llvmVoidType, argTypes, false);
 
         auto wrapperFunc = rewriter.create<LLVM::LLVMFuncOp>(
             op.getLoc(), wrapperFunctionName, funcType);
@@ -216,8 +441,10 @@ struct MPICommSizeOpLowering
         rewriter.setInsertionPointToStart(entryBlock);
 
         // Add argument-level memory effects attribute
-        wrapperFunc.setArgAttr(0, "enzymexla.memory_effects",
-                               memoryEffectsAttr);
+        for (unsigned i = 0; i < argTypes.size(); ++i) {
+          wrapperFunc.setArgAttr(i, "enzymexla.memory_effects",
+                                 memoryEffectsAttr);
+        }
 
         // Get the first (and only) argument of the function
         Value sizePtr = entryBlock->getArgument(0);
@@ -225,8 +452,9 @@ struct MPICommSizeOpLowering
         // Get the address of the communicator
         // NOTE these symbols are not ABI-stable until MPI 5.0, but in practice,
         // they are represented as w ord-size values (i.e. `int` or ptr)
-        Value addressOfComm = rewriter.create<LLVM::AddressOfOp>(
-            op.getLoc(), llvmPtrType, communicatorName);
+        Value addressOfComm =
+            getCommunicator(rewriter, op.getLoc(),
+                            comm ? entryBlock->getArgument(1) : Value());
 
         // TODO error checking
         // MPI_Comm_size returns i32 error code which we're ignoring here
@@ -251,7 +479,7 @@ struct MPICommSizeOpLowering
       }
 
       // Insert MPI_COMM_WORLD declaration if not already present
-      if (!moduleOp.lookupSymbol<LLVM::GlobalOp>(communicatorName)) {
+      if (!comm && !moduleOp.lookupSymbol<LLVM::GlobalOp>(communicatorName)) {
         OpBuilder::InsertionGuard guard(rewriter);
         rewriter.setInsertionPointToStart(moduleOp.getBody());
 
@@ -270,6 +498,10 @@ struct MPICommSizeOpLowering
       Value constantTensor = rewriter.create<stablehlo::ConstantOp>(
           op.getLoc(), tensorType, constantAttr);
 
+      SmallVector<Value> jitCallOperands = {constantTensor};
+      if (comm)
+        jitCallOperands.push_back(comm);
+
       // Call the LLVM function with enzymexla.jit_call
       SmallVector<Attribute> aliases;
       aliases.push_back(stablehlo::OutputOperandAliasAttr::get(
@@ -281,7 +513,7 @@ struct MPICommSizeOpLowering
       auto jitCall = rewriter.create<enzymexla::JITCallOp>(
           op.getLoc(), op->getResultTypes(),
           mlir::FlatSymbolRefAttr::get(context, wrapperFunctionName),
-          ValueRange{constantTensor}, rewriter.getStringAttr(""),
+          jitCallOperands, rewriter.getStringAttr(""),
           /*operand_layouts=*/nullptr,
           /*result_layouts=*/nullptr,
           /*arg_attrs=*/nullptr,
@@ -321,18 +553,25 @@ struct MPIBarrierOpLowering : public OpRewritePattern<enzymexla::MPIBarrierOp> {
 
       std::string mpiFunctionName = "MPI_Barrier";
 
-      // TODO For now we just hard code MPI_COMM_WORLD as the communicator.
+      // MPI_COMM_WORLD is used unless the op was given a communicator
+      Value comm = op.getComm();
       std::string communicatorName = "MPI_COMM_WORLD";
 
       // Generate the enzymexla_wrapper_MPI_Barrier LLVM function body
       std::string wrapperFunctionName = "enzymexla_wrapper_" + mpiFunctionName;
+      if (comm)
+        wrapperFunctionName += "_comm";
 
       if (!moduleOp.lookupSymbol<LLVM::LLVMFuncOp>(wrapperFunctionName)) {
         OpBuilder::InsertionGuard guard(rewriter);
         rewriter.setInsertionPointToStart(moduleOp.getBody());
 
         // Create the function type
-        auto funcType = LLVM::LLVMFunctionType::get(llvmVoidType, {}, false);
+        SmallVector<Type> argTypes;
+        if (comm)
+          argTypes.push_back(llvmPtrType);
+        auto funcType =
+            LLVM::LLVMFunctionType::get(llvmVoidType, argTypes, false);
 
         auto wrapperFunc = rewriter.create<LLVM::LLVMFuncOp>(
             op.getLoc(), wrapperFunctionName, funcType);
@@ -347,11 +586,18 @@ struct MPIBarrierOpLowering : public OpRewritePattern<enzymexla::MPIBarrierOp> {
         Block *entryBlock = wrapperFunc.addEntryBlock(rewriter);
         rewriter.setInsertionPointToStart(entryBlock);
 
+        // Add argument-level memory effects attribute to all arguments
+        for (unsigned i = 0; i < argTypes.size(); ++i) {
+          wrapperFunc.setArgAttr(i, "enzymexla.memory_effects",
+                                 memoryEffectsAttr);
+        }
+
         // Get the address of the communicator
         // NOTE these symbols are not ABI-stable until MPI 5.0, but in practice,
         // they are represented as w ord-size values (i.e. `int` or ptr)
-        Value addressOfComm = rewriter.create<LLVM::AddressOfOp>(
-            op.getLoc(), llvmPtrType, communicatorName);
+        Value addressOfComm =
+            getCommunicator(rewriter, op.getLoc(),
+                            comm ? entryBlock->getArgument(0) : Value());
 
         // Call MPI_Barrier
         // int MPI_Barrier(MPI_Comm comm)
@@ -377,7 +623,7 @@ struct MPIBarrierOpLowering : public OpRewritePattern<enzymexla::MPIBarrierOp> {
       }
 
       // Insert MPI_COMM_WORLD declaration if not already present
-      if (!moduleOp.lookupSymbol<LLVM::GlobalOp>(communicatorName)) {
+      if (!comm && !moduleOp.lookupSymbol<LLVM::GlobalOp>(communicatorName)) {
         OpBuilder::InsertionGuard guard(rewriter);
         rewriter.setInsertionPointToStart(moduleOp.getBody());
 
@@ -393,7 +639,8 @@ struct MPIBarrierOpLowering : public OpRewritePattern<enzymexla::MPIBarrierOp> {
       rewriter.create<enzymexla::JITCallOp>(
           op.getLoc(), TypeRange{},
           mlir::FlatSymbolRefAttr::get(context, wrapperFunctionName),
-          ValueRange{}, rewriter.getStringAttr(""),
+          comm ? ValueRange{comm} : ValueRange{},
+          rewriter.getStringAttr(""),
           /*operand_layouts=*/nullptr,
           /*result_layouts=*/nullptr,
           /*arg_attrs=*/nullptr,
@@ -437,22 +684,26 @@ struct MPISendOpLowering : public OpRewritePattern<enzymexla::MPISendOp> {
       auto datatype = op.getDatatype();
       StringRef datatypeName = stringifyMPIDatatype(datatype);
 
-      // For now we just hard code MPI_COMM_WORLD as the communicator.
-      // TODO make this more flexible
+      // MPI_COMM_WORLD is used unless the op was given a communicator
+      Value comm = op.getComm();
       std::string communicatorName = "MPI_COMM_WORLD";
 
       // Generate the enzymexla_wrapper LLVM function body
       std::string wrapperFunctionName =
           "enzymexla_wrapper_" + mpiFunctionName + "_" + datatypeName.str();
+      if (comm)
+        wrapperFunctionName += "_comm";
 
       if (!moduleOp.lookupSymbol<LLVM::LLVMFuncOp>(wrapperFunctionName)) {
         OpBuilder::InsertionGuard guard(rewriter);
         rewriter.setInsertionPointToStart(moduleOp.getBody());
 
         // Create the wrapper function decl
-        auto funcType = LLVM::LLVMFunctionType::get(
-            llvmVoidType, {llvmPtrType, llvmPtrType, llvmPtrType, llvmPtrType},
-            false);
+        SmallVector<Type> argTypes(4, llvmPtrType);
+        if (comm)
+          argTypes.push_back(llvmPtrType);
+        auto funcType =
+            LLVM::LLVMFunctionType::get(llvmVoidType, argTypes, false);
 
         auto wrapperFunc = rewriter.create<LLVM::LLVMFuncOp>(
             op.getLoc(), wrapperFunctionName, funcType);
@@ -468,7 +719,7 @@ struct MPISendOpLowering : public OpRewritePattern<enzymexla::MPISendOp> {
         rewriter.setInsertionPointToStart(entryBlock);
 
         // Add argument-level memory effects attribute to all arguments
-        for (unsigned i = 0; i < 4; ++i) {
+        for (unsigned i = 0; i < argTypes.size(); ++i) {
           wrapperFunc.setArgAttr(i, "enzymexla.memory_effects",
                                  memoryEffectsAttr);
         }
@@ -495,8 +746,9 @@ struct MPISendOpLowering : public OpRewritePattern<enzymexla::MPISendOp> {
             op.getLoc(), llvmPtrType, datatypeName);
 
         // Get the address of the communicator
-        Value addressOfComm = rewriter.create<LLVM::AddressOfOp>(
-            op.getLoc(), llvmPtrType, communicatorName);
+        Value addressOfComm =
+            getCommunicator(rewriter, op.getLoc(),
+                            comm ? entryBlock->getArgument(4) : Value());
 
         // Call MPI_Send
         // int MPI_Send(const void* buf, int count, MPI_Datatype datatype, int
@@ -526,7 +778,7 @@ struct MPISendOpLowering : public OpRewritePattern<enzymexla::MPISendOp> {
       }
 
       // Insert MPI_COMM_WORLD declaration if not already present
-      if (!moduleOp.lookupSymbol<LLVM::GlobalOp>(communicatorName)) {
+      if (!comm && !moduleOp.lookupSymbol<LLVM::GlobalOp>(communicatorName)) {
         OpBuilder::InsertionGuard guard(rewriter);
         rewriter.setInsertionPointToStart(moduleOp.getBody());
 
@@ -602,8 +854,8 @@ struct MPIRecvOpLowering : public OpRewritePattern<enzymexla::MPIRecvOp> {
       auto datatype = op.getDatatype();
       StringRef datatypeName = stringifyMPIDatatype(datatype);
 
-      // For now we just hard code MPI_COMM_WORLD as the communicator.
-      // TODO make this more flexible
+      // MPI_COMM_WORLD is used unless the op was given a communicator
+      Value comm = op.getComm();
       std::string communicatorName = "MPI_COMM_WORLD";
 
       std::string statusName = "MPI_STATUS_IGNORE";
@@ -611,15 +863,19 @@ struct MPIRecvOpLowering : public OpRewritePattern<enzymexla::MPIRecvOp> {
       // Generate the enzymexla_wrapper LLVM function body
       std::string wrapperFunctionName =
           "enzymexla_wrapper_" + mpiFunctionName + "_" + datatypeName.str();
+      if (comm)
+        wrapperFunctionName += "_comm";
 
       if (!moduleOp.lookupSymbol<LLVM::LLVMFuncOp>(wrapperFunctionName)) {
         OpBuilder::InsertionGuard guard(rewriter);
         rewriter.setInsertionPointToStart(moduleOp.getBody());
 
         // Create the wrapper function decl
-        auto funcType = LLVM::LLVMFunctionType::get(
-            llvmVoidType, {llvmPtrType, llvmPtrType, llvmPtrType, llvmPtrType},
-            false);
+        SmallVector<Type> argTypes(4, llvmPtrType);
+        if (comm)
+          argTypes.push_back(llvmPtrType);
+        auto funcType =
+            LLVM::LLVMFunctionType::get(llvmVoidType, argTypes, false);
 
         auto wrapperFunc = rewriter.create<LLVM::LLVMFuncOp>(
             op.getLoc(), wrapperFunctionName, funcType);
@@ -635,7 +891,7 @@ struct MPIRecvOpLowering : public OpRewritePattern<enzymexla::MPIRecvOp> {
         rewriter.setInsertionPointToStart(entryBlock);
 
         // Add argument-level memory effects attribute to all arguments
-        for (unsigned i = 0; i < 4; ++i) {
+        for (unsigned i = 0; i < argTypes.size(); ++i) {
           wrapperFunc.setArgAttr(i, "enzymexla.memory_effects",
                                  memoryEffectsAttr);
         }
@@ -661,8 +917,9 @@ struct MPIRecvOpLowering : public OpRewritePattern<enzymexla::MPIRecvOp> {
             op.getLoc(), llvmPtrType, datatypeName);
 
         // Get the address of the communicator
-        Value addressOfComm = rewriter.create<LLVM::AddressOfOp>(
-            op.getLoc(), llvmPtrType, communicatorName);
+        Value addressOfComm =
+            getCommunicator(rewriter, op.getLoc(),
+                            comm ? entryBlock->getArgument(4) : Value());
 
         // Get the address of the status
         Value addressOfStatus = rewriter.create<LLVM::AddressOfOp>(
@@ -697,7 +954,7 @@ struct MPIRecvOpLowering : public OpRewritePattern<enzymexla::MPIRecvOp> {
       }
 
       // Insert MPI_STATUS_IGNORE declaration if not already present
-      if (!moduleOp.lookupSymbol<LLVM::GlobalOp>(communicatorName)) {
+      if (!moduleOp.lookupSymbol<LLVM::GlobalOp>(statusName)) {
         OpBuilder::InsertionGuard guard(rewriter);
         rewriter.setInsertionPointToStart(moduleOp.getBody());
 
@@ -710,7 +967,7 @@ struct MPIRecvOpLowering : public OpRewritePattern<enzymexla::MPIRecvOp> {
       }
 
       // Insert MPI_COMM_WORLD declaration if not already present
-      if (!moduleOp.lookupSymbol<LLVM::GlobalOp>(communicatorName)) {
+      if (!comm && !moduleOp.lookupSymbol<LLVM::GlobalOp>(communicatorName)) {
         OpBuilder::InsertionGuard guard(rewriter);
         rewriter.setInsertionPointToStart(moduleOp.getBody());
 
@@ -793,22 +1050,25 @@ struct MPIIsendOpLowering : public OpRewritePattern<enzymexla::MPIIsendOp> {
       auto datatype = op.getDatatype();
       StringRef datatypeName = stringifyMPIDatatype(datatype);
 
-      // For now we just hard code MPI_COMM_WORLD as the communicator.
-      // TODO make this more flexible
+      // MPI_COMM_WORLD is used unless the op was given a communicator
+      Value comm = op.getComm();
       std::string communicatorName = "MPI_COMM_WORLD";
 
       std::string wrapperFunctionName =
           "enzymexla_wrapper_" + mpiFunctionName + "_" + datatypeName.str();
+      if (comm)
+        wrapperFunctionName += "_comm";
 
       if (!moduleOp.lookupSymbol<LLVM::LLVMFuncOp>(wrapperFunctionName)) {
         OpBuilder::InsertionGuard guard(rewriter);
         rewriter.setInsertionPointToStart(moduleOp.getBody());
 
         // Create the wrapper function decl
-        auto funcType = LLVM::LLVMFunctionType::get(
-            llvmVoidType,
-            {llvmPtrType, llvmPtrType, llvmPtrType, llvmPtrType, llvmPtrType},
-            false);
+        SmallVector<Type> argTypes(5, llvmPtrType);
+        if (comm)
+          argTypes.push_back(llvmPtrType);
+        auto funcType =
+            LLVM::LLVMFunctionType::get(llvmVoidType, argTypes, false);
 
         auto wrapperFunc = rewriter.create<LLVM::LLVMFuncOp>(
             op.getLoc(), wrapperFunctionName, funcType);
@@ -824,7 +1084,7 @@ struct MPIIsendOpLowering : public OpRewritePattern<enzymexla::MPIIsendOp> {
         rewriter.setInsertionPointToStart(entryBlock);
 
         // Add argument-level memory effects attribute to all arguments
-        for (unsigned i = 0; i < 5; ++i) {
+        for (unsigned i = 0; i < argTypes.size(); ++i) {
           wrapperFunc.setArgAttr(i, "enzymexla.memory_effects",
                                  memoryEffectsAttr);
         }
@@ -834,7 +1094,7 @@ struct MPIIsendOpLowering : public OpRewritePattern<enzymexla::MPIIsendOp> {
         Value countPtr = entryBlock->getArgument(1);
         Value destPtr = entryBlock->getArgument(2);
         Value tagPtr = entryBlock->getArgument(3);
-        Value requestPtr = entryBlock->getArgument(4);
+        Value requestPtr = entryBlock->getArgument(comm ? 5 : 4);
 
         // Load the count, dest, tag values
         Value count =
@@ -852,8 +1112,9 @@ struct MPIIsendOpLowering : public OpRewritePattern<enzymexla::MPIIsendOp> {
             op.getLoc(), llvmPtrType, datatypeName);
 
         // Get the address of the communicator
-        Value addressOfComm = rewriter.create<LLVM::AddressOfOp>(
-            op.getLoc(), llvmPtrType, communicatorName);
+        Value addressOfComm =
+            getCommunicator(rewriter, op.getLoc(),
+                            comm ? entryBlock->getArgument(4) : Value());
 
         // Call MPI_Isend
         // int MPI_Isend(void* buf, int count, MPI_Datatype datatype, int
@@ -884,7 +1145,7 @@ struct MPIIsendOpLowering : public OpRewritePattern<enzymexla::MPIIsendOp> {
       }
 
       // Insert MPI_COMM_WORLD declaration if not already present
-      if (!moduleOp.lookupSymbol<LLVM::GlobalOp>(communicatorName)) {
+      if (!comm && !moduleOp.lookupSymbol<LLVM::GlobalOp>(communicatorName)) {
         OpBuilder::InsertionGuard guard(rewriter);
         rewriter.setInsertionPointToStart(moduleOp.getBody());
 
@@ -928,7 +1189,7 @@ struct MPIIsendOpLowering : public OpRewritePattern<enzymexla::MPIIsendOp> {
       aliases.push_back(stablehlo::OutputOperandAliasAttr::get(
           context,
           /*output_operand_aliases=*/std::vector<int64_t>{},
-          /*operand_index=*/4,
+          /*operand_index=*/jitCallOperands.size() - 1,
           /*operand_tuple_indices=*/std::vector<int64_t>{}));
 
       // Call the LLVM function with enzymexla.jit_call
@@ -979,23 +1240,26 @@ struct MPIIrecvOpLowering : public OpRewritePattern<enzymexla::MPIIrecvOp> {
       auto datatype = op.getDatatype();
       StringRef datatypeName = stringifyMPIDatatype(datatype);
 
-      // For now we just hard code MPI_COMM_WORLD as the communicator.
-      // TODO make this more flexible
+      // MPI_COMM_WORLD is used unless the op was given a communicator
+      Value comm = op.getComm();
       std::string communicatorName = "MPI_COMM_WORLD";
 
       // Generate the enzymexla_wrapper LLVM function body
       std::string wrapperFunctionName =
           "enzymexla_wrapper_" + mpiFunctionName + "_" + datatypeName.str();
+      if (comm)
+        wrapperFunctionName += "_comm";
 
       if (!moduleOp.lookupSymbol<LLVM::LLVMFuncOp>(wrapperFunctionName)) {
         OpBuilder::InsertionGuard guard(rewriter);
         rewriter.setInsertionPointToStart(moduleOp.getBody());
 
         // Create the wrapper function decl
-        auto funcType = LLVM::LLVMFunctionType::get(
-            llvmVoidType,
-            {llvmPtrType, llvmPtrType, llvmPtrType, llvmPtrType, llvmPtrType},
-            false);
+        SmallVector<Type> argTypes(5, llvmPtrType);
+        if (comm)
+          argTypes.push_back(llvmPtrType);
+        auto funcType =
+            LLVM::LLVMFunctionType::get(llvmVoidType, argTypes, false);
 
         auto wrapperFunc = rewriter.create<LLVM::LLVMFuncOp>(
             op.getLoc(), wrapperFunctionName, funcType);
@@ -1011,7 +1275,7 @@ struct MPIIrecvOpLowering : public OpRewritePattern<enzymexla::MPIIrecvOp> {
         rewriter.setInsertionPointToStart(entryBlock);
 
         // Add argument-level memory effects attribute to all arguments
-        for (unsigned i = 0; i < 5; ++i) {
+        for (unsigned i = 0; i < argTypes.size(); ++i) {
           wrapperFunc.setArgAttr(i, "enzymexla.memory_effects",
                                  memoryEffectsAttr);
         }
@@ -1021,7 +1285,7 @@ struct MPIIrecvOpLowering : public OpRewritePattern<enzymexla::MPIIrecvOp> {
         Value countPtr = entryBlock->getArgument(1);
         Value srcPtr = entryBlock->getArgument(2);
         Value tagPtr = entryBlock->getArgument(3);
-        Value requestPtr = entryBlock->getArgument(4);
+        Value requestPtr = entryBlock->getArgument(comm ? 5 : 4);
 
         // Load the count, src, tag values
         Value count =
@@ -1038,8 +1302,9 @@ struct MPIIrecvOpLowering : public OpRewritePattern<enzymexla::MPIIrecvOp> {
             op.getLoc(), llvmPtrType, datatypeName);
 
         // Get the address of the communicator
-        Value addressOfComm = rewriter.create<LLVM::AddressOfOp>(
-            op.getLoc(), llvmPtrType, communicatorName);
+        Value addressOfComm =
+            getCommunicator(rewriter, op.getLoc(),
+                            comm ? entryBlock->getArgument(4) : Value());
 
         // Call MPI_Irecv
         // int MPI_Irecv(void* buf, int count, MPI_Datatype datatype, int
@@ -1070,7 +1335,7 @@ struct MPIIrecvOpLowering : public OpRewritePattern<enzymexla::MPIIrecvOp> {
       }
 
       // Insert MPI_COMM_WORLD declaration if not already present
-      if (!moduleOp.lookupSymbol<LLVM::GlobalOp>(communicatorName)) {
+      if (!comm && !moduleOp.lookupSymbol<LLVM::GlobalOp>(communicatorName)) {
         OpBuilder::InsertionGuard guard(rewriter);
         rewriter.setInsertionPointToStart(moduleOp.getBody());
 
@@ -1121,7 +1386,7 @@ struct MPIIrecvOpLowering : public OpRewritePattern<enzymexla::MPIIrecvOp> {
       aliases.push_back(stablehlo::OutputOperandAliasAttr::get(
           context,
           /*output_operand_aliases=*/std::vector<int64_t>{1},
-          /*operand_index=*/4,
+          /*operand_index=*/jitCallOperands.size() - 1,
           /*operand_tuple_indices=*/std::vector<int64_t>{}));
 
       // Call the LLVM function with enzymexla.jit_call
@@ -1157,6 +1422,13 @@ struct MPIWaitOpLowering : public OpRewritePattern<enzymexla::MPIWaitOp> {
                                 PatternRewriter &rewriter) const override {
     auto context = op->getContext();
 
+    // Persistent requests are lowered by MPIPersistentWaitOpLowering.
+    if (!op.getRequest().getType().getElementType().isInteger(32))
+      return rewriter.notifyMatchFailure(op, "persistent request");
+    if (op.getWaited() || op.getOutbuf())
+      return rewriter.notifyMatchFailure(
+          op, "only persistent requests are yielded and own a buffer");
+
     if (backend == "cpu") {
 
       auto moduleOp = op->getParentOfType<ModuleOp>();
@@ -1403,21 +1675,27 @@ struct MPIAllreduceOpLowering
       // get the MPI Op type
       StringRef mpiOpName = stringifyMPIOp(op.getOp());
 
-      // TODO For now we just hard code MPI_COMM_WORLD as the communicator.
+      // MPI_COMM_WORLD is used unless the op was given a communicator
+      Value comm = op.getComm();
       std::string communicatorName = "MPI_COMM_WORLD";
 
       // Generate the enzymexla_wrapper LLVM function body
       std::string wrapperFunctionName = "enzymexla_wrapper_" + mpiFunctionName +
                                         "_" + mpiOpName.str() + "_" +
                                         datatypeName.str();
+      if (comm)
+        wrapperFunctionName += "_comm";
 
       if (!moduleOp.lookupSymbol<LLVM::LLVMFuncOp>(wrapperFunctionName)) {
         OpBuilder::InsertionGuard guard(rewriter);
         rewriter.setInsertionPointToStart(moduleOp.getBody());
 
         // Create the wrapper function decl
-        auto funcType = LLVM::LLVMFunctionType::get(
-            llvmVoidType, {llvmPtrType, llvmPtrType, llvmPtrType}, false);
+        SmallVector<Type> argTypes(3, llvmPtrType);
+        if (comm)
+          argTypes.push_back(llvmPtrType);
+        auto funcType =
+            LLVM::LLVMFunctionType::get(llvmVoidType, argTypes, false);
 
         auto wrapperFunc = rewriter.create<LLVM::LLVMFuncOp>(
             op.getLoc(), wrapperFunctionName, funcType);
@@ -1433,7 +1711,7 @@ struct MPIAllreduceOpLowering
         rewriter.setInsertionPointToStart(entryBlock);
 
         // Add argument-level memory effects attribute to all arguments
-        for (unsigned i = 0; i < 3; ++i) {
+        for (unsigned i = 0; i < argTypes.size(); ++i) {
           wrapperFunc.setArgAttr(i, "enzymexla.memory_effects",
                                  memoryEffectsAttr);
         }
@@ -1454,8 +1732,9 @@ struct MPIAllreduceOpLowering
             op.getLoc(), llvmPtrType, datatypeName);
 
         // Get the address of the communicator
-        Value addressOfComm = rewriter.create<LLVM::AddressOfOp>(
-            op.getLoc(), llvmPtrType, communicatorName);
+        Value addressOfComm =
+            getCommunicator(rewriter, op.getLoc(),
+                            comm ? entryBlock->getArgument(3) : Value());
 
         // Get the address of the MPI Op
         Value addressOfMPIOp = rewriter.create<LLVM::AddressOfOp>(
@@ -1490,7 +1769,7 @@ struct MPIAllreduceOpLowering
       }
 
       // Insert MPI_COMM_WORLD declaration if not already present
-      if (!moduleOp.lookupSymbol<LLVM::GlobalOp>(communicatorName)) {
+      if (!comm && !moduleOp.lookupSymbol<LLVM::GlobalOp>(communicatorName)) {
         OpBuilder::InsertionGuard guard(rewriter);
         rewriter.setInsertionPointToStart(moduleOp.getBody());
 
@@ -1561,6 +1840,571 @@ struct MPIAllreduceOpLowering
   }
 };
 
+struct MPICommSplitOpLowering
+    : public OpRewritePattern<enzymexla::MPICommSplitOp> {
+
+  std::string backend;
+  MPICommSplitOpLowering(std::string backend, MLIRContext *context,
+                         PatternBenefit benefit = 1)
+      : OpRewritePattern(context, benefit), backend(backend) {}
+
+  LogicalResult matchAndRewrite(enzymexla::MPICommSplitOp op,
+                                PatternRewriter &rewriter) const override {
+    if (backend != "cpu")
+      return rewriter.notifyMatchFailure(op,
+                                         "Backend not supported: " + backend);
+
+    auto moduleOp = op->getParentOfType<ModuleOp>();
+    auto loc = op.getLoc();
+    auto llvmPtrType = LLVM::LLVMPointerType::get(op->getContext());
+    auto i32Type = rewriter.getI32Type();
+
+    Value comm = op.getComm();
+    std::string wrapperFunctionName = "enzymexla_wrapper_MPI_Comm_split";
+    if (comm)
+      wrapperFunctionName += "_comm";
+
+    // int MPI_Comm_split(MPI_Comm comm, int color, int key, MPI_Comm *newcomm)
+    createMPIWrapper(
+        rewriter, moduleOp, loc, wrapperFunctionName, comm ? 4 : 3,
+        [&](Block *entryBlock) {
+          Value color = rewriter.create<LLVM::LoadOp>(
+              loc, i32Type, entryBlock->getArgument(0));
+          Value key = rewriter.create<LLVM::LoadOp>(loc, i32Type,
+                                                    entryBlock->getArgument(1));
+          Value commValue = getCommunicator(
+              rewriter, loc, comm ? entryBlock->getArgument(2) : Value());
+          // TODO returns i32 error code which we're ignoring here
+          rewriter.create<LLVM::CallOp>(
+              loc, TypeRange{i32Type},
+              SymbolRefAttr::get(op->getContext(), "MPI_Comm_split"),
+              ValueRange{commValue, color, key,
+                         entryBlock->getArguments().back()});
+        });
+    declareMPIFunction(rewriter, moduleOp, loc, "MPI_Comm_split",
+                       {llvmPtrType, i32Type, i32Type, llvmPtrType});
+    if (!comm)
+      declareMPIHandle(rewriter, moduleOp, loc, "MPI_COMM_WORLD");
+
+    SmallVector<Value> operands(op->getOperands());
+    operands.push_back(createHandleTensor(rewriter, loc, op.getType()));
+    replaceWithJITCall(rewriter, op, wrapperFunctionName, operands,
+                       {static_cast<int64_t>(operands.size()) - 1});
+    return success();
+  }
+};
+
+struct MPICommDupOpLowering : public OpRewritePattern<enzymexla::MPICommDupOp> {
+
+  std::string backend;
+  MPICommDupOpLowering(std::string backend, MLIRContext *context,
+                       PatternBenefit benefit = 1)
+      : OpRewritePattern(context, benefit), backend(backend) {}
+
+  LogicalResult matchAndRewrite(enzymexla::MPICommDupOp op,
+                                PatternRewriter &rewriter) const override {
+    if (backend != "cpu")
+      return rewriter.notifyMatchFailure(op,
+                                         "Backend not supported: " + backend);
+
+    auto moduleOp = op->getParentOfType<ModuleOp>();
+    auto loc = op.getLoc();
+    auto llvmPtrType = LLVM::LLVMPointerType::get(op->getContext());
+
+    Value comm = op.getComm();
+    std::string wrapperFunctionName = "enzymexla_wrapper_MPI_Comm_dup";
+    if (comm)
+      wrapperFunctionName += "_comm";
+
+    // int MPI_Comm_dup(MPI_Comm comm, MPI_Comm *newcomm)
+    createMPIWrapper(
+        rewriter, moduleOp, loc, wrapperFunctionName, comm ? 2 : 1,
+        [&](Block *entryBlock) {
+          Value commValue = getCommunicator(
+              rewriter, loc, comm ? entryBlock->getArgument(0) : Value());
+          // TODO returns i32 error code which we're ignoring here
+          rewriter.create<LLVM::CallOp>(
+              loc, TypeRange{rewriter.getI32Type()},
+              SymbolRefAttr::get(op->getContext(), "MPI_Comm_dup"),
+              ValueRange{commValue, entryBlock->getArguments().back()});
+        });
+    declareMPIFunction(rewriter, moduleOp, loc, "MPI_Comm_dup",
+                       {llvmPtrType, llvmPtrType});
+    if (!comm)
+      declareMPIHandle(rewriter, moduleOp, loc, "MPI_COMM_WORLD");
+
+    SmallVector<Value> operands(op->getOperands());
+    operands.push_back(createHandleTensor(rewriter, loc, op.getType()));
+    replaceWithJITCall(rewriter, op, wrapperFunctionName, operands,
+                       {static_cast<int64_t>(operands.size()) - 1});
+    return success();
+  }
+};
+
+// Lowers the ops taking a single handle pointer to the MPI function `name`,
+// such as `MPI_Comm_free(&comm)`.
+template <typename OpTy>
+struct MPIHandleOpLowering : public OpRewritePattern<OpTy> {
+
+  std::string backend;
+  std::string name;
+  MPIHandleOpLowering(std::string backend, std::string name,
+                      MLIRContext *context, PatternBenefit benefit = 1)
+      : OpRewritePattern<OpTy>(context, benefit), backend(backend),
+        name(name) {}
+
+  LogicalResult matchAndRewrite(OpTy op,
+                                PatternRewriter &rewriter) const override {
+    if (backend != "cpu")
+      return rewriter.notifyMatchFailure(op,
+                                         "Backend not supported: " + backend);
+
+    auto moduleOp = op->template getParentOfType<ModuleOp>();
+    auto loc = op.getLoc();
+    std::string wrapperFunctionName = "enzymexla_wrapper_" + name;
+
+    createMPIWrapper(rewriter, moduleOp, loc, wrapperFunctionName, 1,
+                     [&](Block *entryBlock) {
+                       // TODO returns i32 error code which we're ignoring here
+                       rewriter.create<LLVM::CallOp>(
+                           loc, TypeRange{rewriter.getI32Type()},
+                           SymbolRefAttr::get(op->getContext(), name),
+                           ValueRange{entryBlock->getArgument(0)});
+                     });
+    declareMPIFunction(rewriter, moduleOp, loc, name,
+                       {LLVM::LLVMPointerType::get(op->getContext())});
+
+    replaceWithJITCall(rewriter, op, wrapperFunctionName, op->getOperands(),
+                       {});
+    return success();
+  }
+};
+
+// Lowers `mpi.send_init` and `mpi.recv_init` to `name`, which is
+// `MPI_Send_init` or `MPI_Recv_init`, on a buffer owned by the request.
+template <typename OpTy>
+struct MPIPointToPointInitOpLowering : public OpRewritePattern<OpTy> {
+
+  std::string backend;
+  std::string name;
+  MPIPointToPointInitOpLowering(std::string backend, std::string name,
+                                MLIRContext *context,
+                                PatternBenefit benefit = 1)
+      : OpRewritePattern<OpTy>(context, benefit), backend(backend),
+        name(name) {}
+
+  LogicalResult matchAndRewrite(OpTy op,
+                                PatternRewriter &rewriter) const override {
+    if (backend != "cpu")
+      return rewriter.notifyMatchFailure(op,
+                                         "Backend not supported: " + backend);
+
+    auto moduleOp = op->template getParentOfType<ModuleOp>();
+    auto loc = op.getLoc();
+    auto llvmPtrType = LLVM::LLVMPointerType::get(op->getContext());
+    auto i32Type = rewriter.getI32Type();
+
+    StringRef datatypeName = stringifyMPIDatatype(op.getDatatype());
+    Value comm = op.getComm();
+    std::string wrapperFunctionName =
+        "enzymexla_wrapper_" + name + "_" + datatypeName.str();
+    if (comm)
+      wrapperFunctionName += "_comm";
+
+    constexpr bool isSend = std::is_same_v<OpTy, enzymexla::MPISendInitOp>;
+
+    // int MPI_Send_init(const void *buf, int count, MPI_Datatype datatype,
+    //     int dest, int tag, MPI_Comm comm, MPI_Request *request)
+    createMPIWrapper(
+        rewriter, moduleOp, loc, wrapperFunctionName, comm ? 5 : 4,
+        [&](Block *entryBlock) {
+          Value count = rewriter.create<LLVM::LoadOp>(
+              loc, i32Type, entryBlock->getArgument(0));
+          Value peer = rewriter.create<LLVM::LoadOp>(
+              loc, i32Type, entryBlock->getArgument(1));
+          Value tag = rewriter.create<LLVM::LoadOp>(loc, i32Type,
+                                                    entryBlock->getArgument(2));
+          Value addressOfDtype = rewriter.create<LLVM::AddressOfOp>(
+              loc, llvmPtrType, datatypeName);
+          Value commValue = getCommunicator(
+              rewriter, loc, comm ? entryBlock->getArgument(3) : Value());
+          auto [request, sendBuf, recvBuf] = createPersistentRequest(
+              rewriter, moduleOp, loc, count, addressOfDtype,
+              entryBlock->getArguments().back(), isSend, !isSend);
+          // TODO returns i32 error code which we're ignoring here
+          rewriter.create<LLVM::CallOp>(
+              loc, TypeRange{i32Type},
+              SymbolRefAttr::get(op->getContext(), name),
+              ValueRange{isSend ? sendBuf : recvBuf, count, addressOfDtype,
+                         peer, tag, commValue, request});
+        });
+    declareMPIFunction(rewriter, moduleOp, loc, name,
+                       {llvmPtrType, i32Type, llvmPtrType, i32Type, i32Type,
+                        llvmPtrType, llvmPtrType});
+    declareMPIHandle(rewriter, moduleOp, loc, datatypeName);
+    if (!comm)
+      declareMPIHandle(rewriter, moduleOp, loc, "MPI_COMM_WORLD");
+
+    SmallVector<Value> operands(op->getOperands());
+    operands.push_back(createHandleTensor(rewriter, loc, op.getType()));
+    replaceWithJITCall(rewriter, op, wrapperFunctionName, operands,
+                       {static_cast<int64_t>(operands.size()) - 1});
+    return success();
+  }
+};
+
+struct MPIAllreduceInitOpLowering
+    : public OpRewritePattern<enzymexla::MPIAllreduceInitOp> {
+
+  std::string backend;
+  MPIAllreduceInitOpLowering(std::string backend, MLIRContext *context,
+                             PatternBenefit benefit = 1)
+      : OpRewritePattern(context, benefit), backend(backend) {}
+
+  LogicalResult matchAndRewrite(enzymexla::MPIAllreduceInitOp op,
+                                PatternRewriter &rewriter) const override {
+    if (backend != "cpu")
+      return rewriter.notifyMatchFailure(op,
+                                         "Backend not supported: " + backend);
+
+    auto moduleOp = op->getParentOfType<ModuleOp>();
+    auto loc = op.getLoc();
+    auto llvmPtrType = LLVM::LLVMPointerType::get(op->getContext());
+    auto i32Type = rewriter.getI32Type();
+
+    StringRef datatypeName = stringifyMPIDatatype(op.getDatatype());
+    StringRef mpiOpName = stringifyMPIOp(op.getOp());
+    Value comm = op.getComm();
+    std::string wrapperFunctionName = "enzymexla_wrapper_MPI_Allreduce_init_" +
+                                      mpiOpName.str() + "_" +
+                                      datatypeName.str();
+    if (comm)
+      wrapperFunctionName += "_comm";
+
+    // int MPI_Allreduce_init(const void *sendbuf, void *recvbuf, int count,
+    //     MPI_Datatype datatype, MPI_Op op, MPI_Comm comm, MPI_Info info,
+    //     MPI_Request *request)
+    createMPIWrapper(
+        rewriter, moduleOp, loc, wrapperFunctionName, comm ? 3 : 2,
+        [&](Block *entryBlock) {
+          Value count = rewriter.create<LLVM::LoadOp>(
+              loc, i32Type, entryBlock->getArgument(0));
+          Value addressOfDtype = rewriter.create<LLVM::AddressOfOp>(
+              loc, llvmPtrType, datatypeName);
+          Value addressOfMPIOp =
+              rewriter.create<LLVM::AddressOfOp>(loc, llvmPtrType, mpiOpName);
+          Value addressOfInfo = rewriter.create<LLVM::AddressOfOp>(
+              loc, llvmPtrType, "MPI_INFO_NULL");
+          Value commValue = getCommunicator(
+              rewriter, loc, comm ? entryBlock->getArgument(1) : Value());
+          auto [request, sendBuf, recvBuf] = createPersistentRequest(
+              rewriter, moduleOp, loc, count, addressOfDtype,
+              entryBlock->getArguments().back(), /*hasSendBuf=*/true,
+              /*hasRecvBuf=*/true);
+          // TODO returns i32 error code which we're ignoring here
+          rewriter.create<LLVM::CallOp>(
+              loc, TypeRange{i32Type},
+              SymbolRefAttr::get(op->getContext(), "MPI_Allreduce_init"),
+              ValueRange{sendBuf, recvBuf, count, addressOfDtype,
+                         addressOfMPIOp, commValue, addressOfInfo, request});
+        });
+    declareMPIFunction(rewriter, moduleOp, loc, "MPI_Allreduce_init",
+                       {llvmPtrType, llvmPtrType, i32Type, llvmPtrType,
+                        llvmPtrType, llvmPtrType, llvmPtrType, llvmPtrType});
+    declareMPIHandle(rewriter, moduleOp, loc, datatypeName);
+    declareMPIHandle(rewriter, moduleOp, loc, mpiOpName);
+    declareMPIHandle(rewriter, moduleOp, loc, "MPI_INFO_NULL");
+    if (!comm)
+      declareMPIHandle(rewriter, moduleOp, loc, "MPI_COMM_WORLD");
+
+    SmallVector<Value> operands(op->getOperands());
+    operands.push_back(createHandleTensor(rewriter, loc, op.getType()));
+    replaceWithJITCall(rewriter, op, wrapperFunctionName, operands,
+                       {static_cast<int64_t>(operands.size()) - 1});
+    return success();
+  }
+};
+
+struct MPIStartOpLowering : public OpRewritePattern<enzymexla::MPIStartOp> {
+
+  std::string backend;
+  MPIStartOpLowering(std::string backend, MLIRContext *context,
+                     PatternBenefit benefit = 1)
+      : OpRewritePattern(context, benefit), backend(backend) {}
+
+  LogicalResult matchAndRewrite(enzymexla::MPIStartOp op,
+                                PatternRewriter &rewriter) const override {
+    if (backend != "cpu")
+      return rewriter.notifyMatchFailure(op,
+                                         "Backend not supported: " + backend);
+
+    auto moduleOp = op->getParentOfType<ModuleOp>();
+    auto loc = op.getLoc();
+    bool hasBuf = static_cast<bool>(op.getBuf());
+    std::string wrapperFunctionName = "enzymexla_wrapper_MPI_Start";
+    if (hasBuf)
+      wrapperFunctionName += "_buf";
+
+    // The data to send is copied into the buffer owned by the request, so the
+    // operand is free to be reused as soon as the call returns.
+    // int MPI_Start(MPI_Request *request)
+    createMPIWrapper(
+        rewriter, moduleOp, loc, wrapperFunctionName, hasBuf ? 2 : 1,
+        [&](Block *entryBlock) {
+          Value requestPtr = entryBlock->getArgument(0);
+          if (hasBuf) {
+            auto llvmPtrType = LLVM::LLVMPointerType::get(op->getContext());
+            Value sendBuf = rewriter.create<LLVM::LoadOp>(
+                loc, llvmPtrType,
+                getPersistentRequestField(rewriter, loc, requestPtr,
+                                          PersistentSendBuf));
+            Value bytes = rewriter.create<LLVM::LoadOp>(
+                loc, rewriter.getI64Type(),
+                getPersistentRequestField(rewriter, loc, requestPtr,
+                                          PersistentBytes));
+            rewriter.create<LLVM::MemcpyOp>(loc, sendBuf,
+                                            entryBlock->getArgument(1), bytes,
+                                            /*isVolatile=*/false);
+          }
+          // TODO returns i32 error code which we're ignoring here
+          rewriter.create<LLVM::CallOp>(
+              loc, TypeRange{rewriter.getI32Type()},
+              SymbolRefAttr::get(op->getContext(), "MPI_Start"),
+              ValueRange{getPersistentRequestField(rewriter, loc, requestPtr,
+                                                   PersistentRequest)});
+        });
+    declareMPIFunction(rewriter, moduleOp, loc, "MPI_Start",
+                       {LLVM::LLVMPointerType::get(op->getContext())});
+
+    // The request is returned, aliased, to order the next wait after this.
+    replaceWithJITCall(rewriter, op, wrapperFunctionName, op->getOperands(),
+                       {0});
+    return success();
+  }
+};
+
+// Lowers `mpi.wait` on a persistent request, copying the data received into
+// the buffer owned by the request to the result, if any. The request is
+// returned, aliased, to order the next start or free after the wait.
+struct MPIPersistentWaitOpLowering
+    : public OpRewritePattern<enzymexla::MPIWaitOp> {
+
+  std::string backend;
+  MPIPersistentWaitOpLowering(std::string backend, MLIRContext *context,
+                              PatternBenefit benefit = 1)
+      : OpRewritePattern(context, benefit), backend(backend) {}
+
+  LogicalResult matchAndRewrite(enzymexla::MPIWaitOp op,
+                                PatternRewriter &rewriter) const override {
+    if (backend != "cpu")
+      return rewriter.notifyMatchFailure(op,
+                                         "Backend not supported: " + backend);
+    if (!op.getRequest().getType().getElementType().isInteger(64))
+      return rewriter.notifyMatchFailure(op, "not a persistent request");
+
+    auto moduleOp = op->getParentOfType<ModuleOp>();
+    auto loc = op.getLoc();
+    auto llvmPtrType = LLVM::LLVMPointerType::get(op->getContext());
+    auto i32Type = rewriter.getI32Type();
+    Value outbuf = op.getOutbuf();
+    std::string wrapperFunctionName = "enzymexla_wrapper_MPI_Wait_persistent";
+    if (outbuf)
+      wrapperFunctionName += "_buf";
+
+    // int MPI_Wait(MPI_Request *request, MPI_Status *status)
+    createMPIWrapper(
+        rewriter, moduleOp, loc, wrapperFunctionName, outbuf ? 2 : 1,
+        [&](Block *entryBlock) {
+          Value requestPtr = entryBlock->getArgument(0);
+          // Size of status is implementation dependent, this should cover
+          // the max
+          Value one = rewriter.create<LLVM::ConstantOp>(
+              loc, i32Type, rewriter.getI32IntegerAttr(1));
+          Value statusPtr = rewriter.create<LLVM::AllocaOp>(
+              loc, llvmPtrType, LLVM::LLVMArrayType::get(i32Type, 6), one);
+          // TODO returns i32 error code which we're ignoring here
+          rewriter.create<LLVM::CallOp>(
+              loc, TypeRange{i32Type},
+              SymbolRefAttr::get(op->getContext(), "MPI_Wait"),
+              ValueRange{getPersistentRequestField(rewriter, loc, requestPtr,
+                                                   PersistentRequest),
+                         statusPtr});
+          if (outbuf) {
+            Value recvBuf = rewriter.create<LLVM::LoadOp>(
+                loc, llvmPtrType,
+                getPersistentRequestField(rewriter, loc, requestPtr,
+                                          PersistentRecvBuf));
+            Value bytes = rewriter.create<LLVM::LoadOp>(
+                loc, rewriter.getI64Type(),
+                getPersistentRequestField(rewriter, loc, requestPtr,
+                                          PersistentBytes));
+            rewriter.create<LLVM::MemcpyOp>(loc, entryBlock->getArgument(1),
+                                            recvBuf, bytes,
+                                            /*isVolatile=*/false);
+          }
+        });
+    declareMPIFunction(rewriter, moduleOp, loc, "MPI_Wait",
+                       {llvmPtrType, llvmPtrType});
+
+    SmallVector<Value> operands{op.getRequest()};
+    SmallVector<int64_t> aliasedOperands{0};
+    if (outbuf) {
+      auto tensorType = cast<RankedTensorType>(outbuf.getType());
+      operands.push_back(rewriter.create<stablehlo::ConstantOp>(
+          loc, tensorType,
+          cast<ElementsAttr>(makeAttr(tensorType, static_cast<int64_t>(0)))));
+      aliasedOperands.push_back(1);
+    }
+    replaceWithJITCall(rewriter, op, wrapperFunctionName, operands,
+                       aliasedOperands);
+    return success();
+  }
+};
+
+// Lowers `mpi.request_free` to `MPI_Request_free`, and frees the buffers owned
+// by the request along with it.
+struct MPIRequestFreeOpLowering
+    : public OpRewritePattern<enzymexla::MPIRequestFreeOp> {
+
+  std::string backend;
+  MPIRequestFreeOpLowering(std::string backend, MLIRContext *context,
+                           PatternBenefit benefit = 1)
+      : OpRewritePattern(context, benefit), backend(backend) {}
+
+  LogicalResult matchAndRewrite(enzymexla::MPIRequestFreeOp op,
+                                PatternRewriter &rewriter) const override {
+    if (backend != "cpu")
+      return rewriter.notifyMatchFailure(op,
+                                         "Backend not supported: " + backend);
+
+    auto moduleOp = op->getParentOfType<ModuleOp>();
+    auto loc = op.getLoc();
+    auto context = op->getContext();
+    auto llvmPtrType = LLVM::LLVMPointerType::get(context);
+    std::string wrapperFunctionName = "enzymexla_wrapper_MPI_Request_free";
+
+    createMPIWrapper(
+        rewriter, moduleOp, loc, wrapperFunctionName, 1,
+        [&](Block *entryBlock) {
+          Value requestPtr = entryBlock->getArgument(0);
+          // TODO returns i32 error code which we're ignoring here
+          rewriter.create<LLVM::CallOp>(
+              loc, TypeRange{rewriter.getI32Type()},
+              SymbolRefAttr::get(context, "MPI_Request_free"),
+              ValueRange{getPersistentRequestField(rewriter, loc, requestPtr,
+                                                   PersistentRequest)});
+          for (auto field : {PersistentSendBuf, PersistentRecvBuf}) {
+            Value buf = rewriter.create<LLVM::LoadOp>(
+                loc, llvmPtrType,
+                getPersistentRequestField(rewriter, loc, requestPtr, field));
+            rewriter.create<LLVM::CallOp>(loc, TypeRange{},
+                                          SymbolRefAttr::get(context, "free"),
+                                          ValueRange{buf});
+          }
+          Value record =
+              rewriter.create<LLVM::LoadOp>(loc, llvmPtrType, requestPtr);
+          rewriter.create<LLVM::CallOp>(loc, TypeRange{},
+                                        SymbolRefAttr::get(context, "free"),
+                                        ValueRange{record});
+        });
+    declareMPIFunction(rewriter, moduleOp, loc, "MPI_Request_free",
+                       {llvmPtrType});
+    declareFunction(rewriter, moduleOp, loc, "free",
+                    LLVM::LLVMVoidType::get(context), {llvmPtrType});
+
+    replaceWithJITCall(rewriter, op, wrapperFunctionName, op->getOperands(),
+                       {});
+    return success();
+  }
+};
+
+// Returns the `mpi.request_free` that ends the chain of `mpi.start` and
+// `mpi.wait` ops on the persistent request created by `init`, if the whole
+// chain is in the block of `init`.
+static enzymexla::MPIRequestFreeOp getPersistentRequestFree(Operation *init) {
+  Value request = init->getResult(0);
+  while (request && request.hasOneUse()) {
+    Operation *user = *request.getUsers().begin();
+    if (user->getBlock() != init->getBlock())
+      return nullptr;
+    if (auto start = dyn_cast<enzymexla::MPIStartOp>(user))
+      request = start.getStarted();
+    else if (auto wait = dyn_cast<enzymexla::MPIWaitOp>(user))
+      request = wait.getWaited();
+    else
+      return dyn_cast<enzymexla::MPIRequestFreeOp>(user);
+  }
+  return nullptr;
+}
+
+// Moves the creation of a persistent request whose operands are all defined
+// outside of a while loop before it, so that the loop only starts the
+// request. The data sent and received flows through `mpi.start` and
+// `mpi.wait`, so it may change in every iteration. The request becomes a
+// loop-carried value threaded through the starts and waits of every iteration,
+// and freeing it moves after the loop, where it takes the request last waited
+// on. Requests are hoisted one at a time, in the order they are created.
+struct HoistPersistentRequestInit
+    : public OpRewritePattern<stablehlo::WhileOp> {
+  using OpRewritePattern::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(stablehlo::WhileOp whileOp,
+                                PatternRewriter &rewriter) const override {
+    Operation *init = nullptr;
+    enzymexla::MPIRequestFreeOp free;
+    for (Operation &op : whileOp.getBody().front()) {
+      if (!isa<enzymexla::MPISendInitOp, enzymexla::MPIRecvInitOp,
+               enzymexla::MPIAllreduceInitOp>(op))
+        continue;
+      if (llvm::any_of(op.getOperands(), [&](Value operand) {
+            return whileOp->isAncestor(operand.getParentBlock()->getParentOp());
+          }))
+        continue;
+      if ((free = getPersistentRequestFree(&op))) {
+        init = &op;
+        break;
+      }
+    }
+    if (!init)
+      return rewriter.notifyMatchFailure(whileOp, "no request to hoist");
+
+    auto loc = whileOp.getLoc();
+    Value request = init->getResult(0);
+    Type requestType = request.getType();
+    rewriter.moveOpBefore(init, whileOp);
+
+    SmallVector<Value> operands(whileOp->getOperands());
+    operands.push_back(request);
+    SmallVector<Type> types(whileOp->getResultTypes());
+    types.push_back(requestType);
+    rewriter.setInsertionPoint(whileOp);
+    auto newWhileOp = rewriter.create<stablehlo::WhileOp>(
+        loc, types, operands, whileOp->getAttrs());
+    rewriter.inlineRegionBefore(whileOp.getCond(), newWhileOp.getCond(),
+                                newWhileOp.getCond().end());
+    rewriter.inlineRegionBefore(whileOp.getBody(), newWhileOp.getBody(),
+                                newWhileOp.getBody().end());
+    newWhileOp.getCond().front().addArgument(requestType, loc);
+    newWhileOp.getBody().front().addArgument(requestType, loc);
+
+    Block &body = newWhileOp.getBody().front();
+    rewriter.replaceUsesWithIf(request, body.getArguments().back(),
+                               [&](OpOperand &use) {
+                                 return newWhileOp->isAncestor(use.getOwner());
+                               });
+    Operation *yield = body.getTerminator();
+    rewriter.modifyOpInPlace(yield, [&] {
+      yield->insertOperands(yield->getNumOperands(), free.getRequest());
+    });
+    rewriter.moveOpAfter(free, newWhileOp);
+    rewriter.modifyOpInPlace(free, [&] {
+      free->setOperand(0, newWhileOp->getResults().back());
+    });
+    rewriter.replaceOp(whileOp, newWhileOp->getResults().drop_back());
+    return success();
+  }
+};
+
 struct LowerEnzymeXLAMPIPass
     : public enzyme::impl::LowerEnzymeXLAMPIPassBase<LowerEnzymeXLAMPIPass> {
   using Base::Base;
@@ -1579,10 +2423,28 @@ struct LowerEnzymeXLAMPIPass
     patterns.add<MPIWaitOpLowering>(backend, context);
     patterns.add<MPIWaitallOpLowering>(backend, context);
     patterns.add<MPIAllreduceOpLowering>(backend, context);
+    patterns.add<MPICommSplitOpLowering>(backend, context);
+    patterns.add<MPICommDupOpLowering>(backend, context);
+    patterns.add<MPIHandleOpLowering<enzymexla::MPICommFreeOp>>(
+        backend, "MPI_Comm_free", context);
+    patterns.add<MPIPointToPointInitOpLowering<enzymexla::MPISendInitOp>>(
+        backend, "MPI_Send_init", context);
+    patterns.add<MPIPointToPointInitOpLowering<enzymexla::MPIRecvInitOp>>(
+        backend, "MPI_Recv_init", context);
+    patterns.add<MPIAllreduceInitOpLowering>(backend, context);
+    patterns.add<MPIStartOpLowering>(backend, context);
+    patterns.add<MPIPersistentWaitOpLowering>(backend, context);
+    patterns.add<MPIRequestFreeOpLowering>(backend, context);
+
+    // Persistent requests are hoisted out of loops before they are lowered.
+    RewritePatternSet hoistPatterns(context);
+    hoistPatterns.add<HoistPersistentRequestInit>(context);
 
     GreedyRewriteConfig config;
-    if (failed(applyPatternsAndFoldGreedily(getOperation(), std::move(patterns),
-                                            config))) {
+    if (failed(applyPatternsAndFoldGreedily(
+            getOperation(), std::move(hoistPatterns), config)) ||
+        failed(applyPatternsAndFoldGreedily(getOperation(),
+                                            std::move(patterns), config))) {
       signalPassFailure();
     }
   }
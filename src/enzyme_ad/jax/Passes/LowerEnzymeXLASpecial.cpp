@@ -0,0 +1,607 @@
+// This must come first for windows builds
+#define _USE_MATH_DEFINES
+
+#include "src/enzyme_ad/jax/Dialect/Dialect.h"
+#include "src/enzyme_ad/jax/Dialect/Ops.h"
+#include "src/enzyme_ad/jax/Passes/Passes.h"
+#include "src/enzyme_ad/jax/Utils.h"
+
+#include "stablehlo/dialect/StablehloOps.h"
+
+#include "mlir/IR/Matchers.h"
+#include "mlir/Transforms/GreedyPatternRewriteDriver.h"
+#include "llvm/ADT/SmallVector.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <optional>
+
+#define DEBUG_TYPE "lower-enzymexla-special"
+
+namespace mlir {
+namespace enzyme {
+#define GEN_PASS_DEF_LOWERENZYMEXLASPECIALPASS
+#include "src/enzyme_ad/jax/Passes/Passes.h.inc"
+} // namespace enzyme
+} // namespace mlir
+
+using namespace mlir;
+using namespace mlir::enzyme;
+
+// The polynomial and asymptotic approximations below are the ones from
+// Abramowitz & Stegun 9.4.1-9.4.6 and 9.8.1-9.8.8, accurate to about 1e-7
+// (relative to max(1, |f|)). Integer orders above one are computed with the
+// usual three-term recurrences, upwards where they are stable and with
+// Miller's backward recurrence otherwise (Numerical Recipes, bessj and bessi),
+// which loses up to an order of magnitude of accuracy for larger orders.
+// This is only enough for single precision, so wider types are left alone and
+// narrower ones are computed in f32.
+
+// Coefficients in increasing powers of (x/3)^2 of J0(x), |x| <= 3.
+static constexpr double kJ0Small[] = {1.0,        -2.2499997, 1.2656208,
+                                      -0.3163866, 0.0444479,  -0.0039444,
+                                      0.0002100};
+// Coefficients in increasing powers of (x/3)^2 of J1(x) / x, |x| <= 3.
+static constexpr double kJ1Small[] = {0.5,         -0.56249985, 0.21093573,
+                                      -0.03954289, 0.00443319,  -0.00031761,
+                                      0.00001109};
+// Coefficients in increasing powers of (x/3)^2 of
+// Y0(x) - 2/pi log(x/2) J0(x), 0 < x <= 3.
+static constexpr double kY0Small[] = {0.36746691,  0.60559366, -0.74350384,
+                                      0.25300117,  -0.04261214, 0.00427916,
+                                      -0.00024846};
+// Coefficients in increasing powers of (x/3)^2 of
+// x Y1(x) - 2/pi x log(x/2) J1(x), 0 < x <= 3.
+static constexpr double kY1Small[] = {-0.6366198, 0.2212091,  2.1682709,
+                                      -1.3164827, 0.3123951,  -0.0400976,
+                                      0.0027873};
+// Amplitude and phase shift of J0 and Y0 in increasing powers of 3/x, x >= 3.
+static constexpr double kF0[] = {0.79788456,  -0.00000077, -0.00552740,
+                                 -0.00009512, 0.00137237,  -0.00072805,
+                                 0.00014476};
+static constexpr double kTheta0[] = {-0.78539816, -0.04166397, -0.00003954,
+                                     0.00262573,  -0.00054125, -0.00029333,
+                                     0.00013558};
+// Amplitude and phase shift of J1 and Y1 in increasing powers of 3/x, x >= 3.
+static constexpr double kF1[] = {0.79788456, 0.00000156,  0.01659667,
+                                 0.00017105, -0.00249511, 0.00113653,
+                                 -0.00020033};
+static constexpr double kTheta1[] = {-2.35619449, 0.12499612,  0.00005650,
+                                     -0.00637879, 0.00074348,  0.00079824,
+                                     -0.00029166};
+// Coefficients in increasing powers of (x/3.75)^2 of I0(x) and I1(x) / x,
+// |x| <= 3.75.
+static constexpr double kI0Small[] = {1.0,       3.5156229, 3.0899424,
+                                      1.2067492, 0.2659732, 0.0360768,
+                                      0.0045813};
+static constexpr double kI1Small[] = {0.5,        0.87890594, 0.51498869,
+                                      0.15084934, 0.02658733, 0.00301532,
+                                      0.00032411};
+// Coefficients in increasing powers of 3.75/x of sqrt(x) exp(-x) I0(x) and
+// sqrt(x) exp(-x) I1(x), x >= 3.75.
+static constexpr double kI0Large[] = {0.39894228,  0.01328592,  0.00225319,
+                                      -0.00157565, 0.00916281,  -0.02057706,
+                                      0.02635537,  -0.01647633, 0.00392377};
+static constexpr double kI1Large[] = {0.39894228,  -0.03988024, -0.00362018,
+                                      0.00163801,  -0.01031555, 0.02282967,
+                                      -0.02895312, 0.01787654,  -0.00420059};
+// Coefficients in increasing powers of (x/2)^2 of K0(x) + log(x/2) I0(x) and
+// x K1(x) - x log(x/2) I1(x), 0 < x <= 2.
+static constexpr double kK0Small[] = {-0.57721566, 0.42278420, 0.23069756,
+                                      0.03488590,  0.00262698, 0.00010750,
+                                      0.00000740};
+static constexpr double kK1Small[] = {1.0,         0.15443144,  -0.67278579,
+                                      -0.18156897, -0.01919402, -0.00110404,
+                                      -0.00004686};
+// Coefficients in increasing powers of 2/x of sqrt(x) exp(x) K0(x) and
+// sqrt(x) exp(x) K1(x), x >= 2.
+static constexpr double kK0Large[] = {1.25331414,  -0.07832358, 0.02189568,
+                                      -0.01062446, 0.00587872,  -0.00251540,
+                                      0.00053208};
+static constexpr double kK1Large[] = {1.25331414, 0.23498619,  -0.03655620,
+                                      0.01504268, -0.00780353, 0.00325614,
+                                      -0.00068245};
+
+// Values are rescaled during backward recurrences once they exceed this, to
+// stay well within the range of f32.
+static constexpr double kRecurrenceBig = 1e10;
+// Below this argument the backward recurrences are replaced by the first two
+// terms of the power series, whose relative error (x/2)^4 / (2 (n+1)(n+2)) is
+// below single precision there.
+static constexpr double kSeriesThreshold = 1e-2;
+// Recurrences are unrolled, so only orders up to this are lowered.
+static constexpr int64_t kMaxBesselOrder = 64;
+// Number of terms of the asymptotic expansion of I_n for large arguments.
+static constexpr int64_t kHankelTerms = 12;
+
+// Whether the approximations are accurate to the precision of `type`.
+static bool isSinglePrecisionOrLess(RankedTensorType type) {
+  auto floatType = dyn_cast<FloatType>(type.getElementType());
+  return floatType && floatType.getWidth() <= 32;
+}
+
+// The type the lowering of an op with result `type` computes in. The
+// constants of the approximations and recurrences overflow or flush to zero
+// in narrower types, so those are computed in f32.
+static RankedTensorType getComputeType(RankedTensorType type) {
+  if (type.getElementType().getIntOrFloatBitWidth() < 32)
+    return type.clone(Float32Type::get(type.getContext()));
+  return type;
+}
+
+static Value convertIfNeeded(PatternRewriter &rewriter, Location loc,
+                             Value value, RankedTensorType type) {
+  if (value.getType() == type)
+    return value;
+  return stablehlo::ConvertOp::create(rewriter, loc, type, value);
+}
+
+namespace {
+
+enum class BesselKind {
+  J,
+  Y,
+  I,
+  K,
+  SphericalJ,
+  SphericalY,
+};
+
+// Emits elementwise StableHLO math on tensors of the type of the lowered op.
+struct SpecialBuilder {
+  PatternRewriter &rewriter;
+  Location loc;
+  RankedTensorType type;
+
+  Value cst(double value) {
+    return stablehlo::ConstantOp::create(
+        rewriter, loc, type, cast<ElementsAttr>(makeAttr(type, value)));
+  }
+
+  Value add(Value a, Value b) {
+    return stablehlo::AddOp::create(rewriter, loc, a, b);
+  }
+  Value sub(Value a, Value b) {
+    return stablehlo::SubtractOp::create(rewriter, loc, a, b);
+  }
+  Value mul(Value a, Value b) {
+    return stablehlo::MulOp::create(rewriter, loc, a, b);
+  }
+  Value mul(double a, Value b) { return mul(cst(a), b); }
+  Value div(Value a, Value b) {
+    return stablehlo::DivOp::create(rewriter, loc, a, b);
+  }
+  Value div(double a, Value b) { return div(cst(a), b); }
+  Value neg(Value a) { return stablehlo::NegOp::create(rewriter, loc, a); }
+  Value abs(Value a) { return stablehlo::AbsOp::create(rewriter, loc, a); }
+  Value sign(Value a) { return stablehlo::SignOp::create(rewriter, loc, a); }
+  Value sqrt(Value a) { return stablehlo::SqrtOp::create(rewriter, loc, a); }
+  Value exp(Value a) { return stablehlo::ExpOp::create(rewriter, loc, a); }
+  Value log(Value a) { return stablehlo::LogOp::create(rewriter, loc, a); }
+  Value sin(Value a) { return stablehlo::SineOp::create(rewriter, loc, a); }
+  Value cos(Value a) { return stablehlo::CosineOp::create(rewriter, loc, a); }
+
+  Value compare(Value a, double b, stablehlo::ComparisonDirection direction) {
+    return stablehlo::CompareOp::create(rewriter, loc, a, cst(b), direction);
+  }
+  Value lt(Value a, double b) {
+    return compare(a, b, stablehlo::ComparisonDirection::LT);
+  }
+  Value le(Value a, double b) {
+    return compare(a, b, stablehlo::ComparisonDirection::LE);
+  }
+  Value gt(Value a, double b) {
+    return compare(a, b, stablehlo::ComparisonDirection::GT);
+  }
+  Value eq(Value a, double b) {
+    return compare(a, b, stablehlo::ComparisonDirection::EQ);
+  }
+  Value select(Value pred, Value a, Value b) {
+    return stablehlo::SelectOp::create(rewriter, loc, pred, a, b);
+  }
+
+  // Evaluates the polynomial with `coeffs` in increasing powers at `t`.
+  Value poly(Value t, ArrayRef<double> coeffs) {
+    Value result = cst(coeffs.back());
+    for (double c : llvm::reverse(coeffs.drop_back()))
+      result = add(mul(result, t), cst(c));
+    return result;
+  }
+
+  // J0 and J1 for x >= 0 along with Y0 and Y1 (NaN for x < 0).
+  std::pair<Value, Value> besselOrder0(Value x, bool second) {
+    Value ax = abs(x);
+    Value t = div(ax, cst(3.0));
+    Value t2 = mul(t, t);
+    Value u = div(3.0, ax);
+    Value amplitude = div(poly(u, kF0), sqrt(ax));
+    Value phase = add(ax, poly(u, kTheta0));
+    Value j0Small = poly(t2, kJ0Small);
+    Value j0 = select(le(ax, 3.0), j0Small, mul(amplitude, cos(phase)));
+    if (!second)
+      return {j0, Value()};
+    Value y0Small =
+        add(mul(mul(2.0 / M_PI, log(div(x, cst(2.0)))), j0Small),
+            poly(t2, kY0Small));
+    Value y0 = select(le(ax, 3.0), y0Small, mul(amplitude, sin(phase)));
+    y0 = select(lt(x, 0.0), cst(std::numeric_limits<double>::quiet_NaN()),
+                y0);
+    return {j0, y0};
+  }
+
+  std::pair<Value, Value> besselOrder1(Value x, bool second) {
+    Value ax = abs(x);
+    Value t = div(ax, cst(3.0));
+    Value t2 = mul(t, t);
+    Value u = div(3.0, ax);
+    Value amplitude = div(poly(u, kF1), sqrt(ax));
+    Value phase = add(ax, poly(u, kTheta1));
+    Value j1Small = mul(x, poly(t2, kJ1Small));
+    Value j1 = select(le(ax, 3.0), j1Small,
+                      mul(sign(x), mul(amplitude, cos(phase))));
+    if (!second)
+      return {j1, Value()};
+    Value y1Small = div(
+        add(mul(mul(mul(2.0 / M_PI, x), log(div(x, cst(2.0)))), j1Small),
+            poly(t2, kY1Small)),
+        x);
+    Value y1 = select(le(ax, 3.0), y1Small, mul(amplitude, sin(phase)));
+    y1 = select(lt(x, 0.0), cst(std::numeric_limits<double>::quiet_NaN()),
+                y1);
+    y1 = select(eq(x, 0.0), cst(-std::numeric_limits<double>::infinity()),
+                y1);
+    return {j1, y1};
+  }
+
+  // exp(-|x|) I0(x) and exp(-|x|) I1(x).
+  Value scaledBesselI0(Value x) {
+    Value ax = abs(x);
+    Value t = div(ax, cst(3.75));
+    Value small = mul(poly(mul(t, t), kI0Small), exp(neg(ax)));
+    Value large = div(poly(div(3.75, ax), kI0Large), sqrt(ax));
+    return select(lt(ax, 3.75), small, large);
+  }
+
+  Value scaledBesselI1(Value x) {
+    Value ax = abs(x);
+    Value t = div(ax, cst(3.75));
+    Value small = mul(mul(x, poly(mul(t, t), kI1Small)), exp(neg(ax)));
+    Value large =
+        mul(sign(x), div(poly(div(3.75, ax), kI1Large), sqrt(ax)));
+    return select(lt(ax, 3.75), small, large);
+  }
+
+  // exp(x) K0(x) and exp(x) K1(x), NaN for x < 0.
+  Value scaledBesselK0(Value x) {
+    Value half = div(x, cst(2.0));
+    Value t = div(x, cst(3.75));
+    Value i0 = poly(mul(t, t), kI0Small);
+    Value small = mul(add(mul(neg(log(half)), i0), poly(mul(half, half),
+                                                         kK0Small)),
+                      exp(x));
+    Value large = div(poly(div(2.0, x), kK0Large), sqrt(x));
+    return select(le(x, 2.0), small, large);
+  }
+
+  Value scaledBesselK1(Value x) {
+    Value half = div(x, cst(2.0));
+    Value t = div(x, cst(3.75));
+    Value i1 = mul(x, poly(mul(t, t), kI1Small));
+    Value small =
+        mul(div(add(mul(mul(x, log(half)), i1), poly(mul(half, half),
+                                                     kK1Small)),
+                x),
+            exp(x));
+    Value large = div(poly(div(2.0, x), kK1Large), sqrt(x));
+    Value result = select(le(x, 2.0), small, large);
+    return select(eq(x, 0.0), cst(std::numeric_limits<double>::infinity()),
+                  result);
+  }
+
+  // Runs the upward recurrence f_{k+1} = (a k + b) / x f_k + s f_{k-1} from
+  // f_0 and f_1 up to f_n.
+  Value upward(Value x, Value f0, Value f1, int64_t n, double a, double b,
+               double s) {
+    Value prev = f0, cur = f1;
+    for (int64_t k = 1; k < n; ++k) {
+      Value next = add(mul(div(a * k + b, x), cur), mul(s, prev));
+      prev = cur;
+      cur = next;
+    }
+    return n == 0 ? f0 : cur;
+  }
+
+  // Runs the backward recurrence f_{k-1} = (a k + b) / x f_k + s f_{k+1} from
+  // an arbitrary start at order `m` down to order 0, rescaling as it goes.
+  // Returns the unnormalized f_n, f_0 and f_1, as well as the sum
+  // f_0 + 2 f_2 + 2 f_4 + ... used to normalize J.
+  struct Backward {
+    Value fn, f0, f1, evenSum;
+  };
+  Backward backward(Value x, int64_t n, int64_t m, double a, double b,
+                    double s) {
+    Value zero = cst(0.0);
+    Value next = zero, cur = cst(1.0), fn = zero, evenSum = zero;
+    Value f1 = zero;
+    for (int64_t k = m; k > 0; --k) {
+      Value prev = add(mul(div(a * k + b, x), cur), mul(s, next));
+      next = cur;
+      cur = prev;
+
+      Value big = gt(abs(cur), kRecurrenceBig);
+      Value scale = select(big, cst(1.0 / kRecurrenceBig), cst(1.0));
+      cur = mul(cur, scale);
+      next = mul(next, scale);
+      fn = mul(fn, scale);
+      evenSum = mul(evenSum, scale);
+      f1 = mul(f1, scale);
+
+      // `cur` now holds f_{k-1}.
+      if ((k - 1) % 2 == 0 && k - 1 > 0)
+        evenSum = add(evenSum, mul(2.0, cur));
+      if (k - 1 == n)
+        fn = cur;
+      if (k - 1 == 1)
+        f1 = cur;
+    }
+    return {n == 0 ? cur : fn, cur, f1, add(evenSum, cur)};
+  }
+
+  // sqrt(2 pi x) exp(-x) I_n(x) ~ sum_k (-1)^k prod_{j<=k} (4n^2 - (2j-1)^2)
+  // / (k! (8x)^k) (A&S 9.7.1), for x > 0.
+  Value hankelBesselI(Value x, int64_t n) {
+    SmallVector<double> coeffs = {1.0};
+    for (int64_t k = 1; k < kHankelTerms; ++k)
+      coeffs.push_back(-coeffs.back() *
+                       (4.0 * n * n - (2.0 * k - 1) * (2.0 * k - 1)) /
+                       (8.0 * k));
+    return div(poly(div(1.0, x), coeffs), sqrt(mul(2.0 * M_PI, x)));
+  }
+
+  // The first two terms of the power series of J_n or I_n (`sign` -1 or 1),
+  // (x/2)^n / n! (1 + sign (x/2)^2 / (n + 1)).
+  Value series(Value x, int64_t n, double sign) {
+    Value half = div(x, cst(2.0));
+    Value power = cst(1.0);
+    double factorial = 1;
+    for (int64_t k = 1; k <= n; ++k) {
+      power = mul(power, half);
+      factorial *= k;
+    }
+    return mul(div(power, cst(factorial)),
+               add(cst(1.0), mul(sign / (n + 1), mul(half, half))));
+  }
+};
+
+// Orders the backward recurrences of J and I start from, from Numerical
+// Recipes.
+static int64_t backwardStartJ(int64_t n) {
+  return 2 * ((n + static_cast<int64_t>(std::sqrt(40.0 * n))) / 2);
+}
+static int64_t backwardStartI(int64_t n) {
+  return 2 * (n + static_cast<int64_t>(std::sqrt(40.0 * n)));
+}
+// Above this argument I_n is given by its asymptotic expansion. The terms of
+// the expansion then shrink at least like 1/k!, while the backward recurrence
+// from backwardStartI(n) is still accurate just below it: its relative error
+// of about exp(-(m^2 - n^2) / x) grows with x.
+static double hankelThresholdI(int64_t n) {
+  return std::max(n * n / 2.0, 20.0);
+}
+
+// Returns the order of `nu` if it is a constant integer that the lowering
+// unrolls the recurrences for.
+static std::optional<int64_t> getIntegerOrder(Value nu) {
+  DenseElementsAttr attr;
+  if (!matchPattern(nu, m_Constant(&attr)) || !attr.isSplat())
+    return std::nullopt;
+
+  double value;
+  if (isa<FloatType>(attr.getElementType()))
+    value = attr.getSplatValue<APFloat>().convertToDouble();
+  else if (isa<IntegerType>(attr.getElementType()))
+    value = attr.getSplatValue<APInt>().getSExtValue();
+  else
+    return std::nullopt;
+
+  if (value != std::round(value) || std::abs(value) > kMaxBesselOrder)
+    return std::nullopt;
+  return static_cast<int64_t>(value);
+}
+
+static Value lowerBessel(SpecialBuilder &b, BesselKind kind, int64_t n,
+                         Value x, bool scaled) {
+  // Negative orders follow from the reflection formulas.
+  if (n < 0) {
+    Value positive = lowerBessel(b, kind, -n, x, scaled);
+    if ((kind == BesselKind::J || kind == BesselKind::Y) && n % 2 != 0)
+      return b.neg(positive);
+    return positive;
+  }
+
+  Value ax = b.abs(x);
+  // (-1)^n for the odd functions of x.
+  Value reflect = n % 2 ? b.sign(x) : b.cst(1.0);
+
+  switch (kind) {
+  case BesselKind::J: {
+    if (n == 0)
+      return b.besselOrder0(x, false).first;
+    if (n == 1)
+      return b.besselOrder1(x, false).first;
+    Value j0 = b.besselOrder0(ax, false).first;
+    Value j1 = b.besselOrder1(ax, false).first;
+    Value up = b.upward(ax, j0, j1, n, 2, 0, -1);
+    auto down = b.backward(ax, n, backwardStartJ(n), 2, 0, -1);
+    Value miller = b.div(down.fn, down.evenSum);
+    Value small = b.select(b.lt(ax, kSeriesThreshold), b.series(ax, n, -1),
+                           miller);
+    return b.mul(reflect, b.select(b.gt(ax, n), up, small));
+  }
+  case BesselKind::Y: {
+    if (n == 0)
+      return b.besselOrder0(x, true).second;
+    if (n == 1)
+      return b.besselOrder1(x, true).second;
+    return b.upward(x, b.besselOrder0(x, true).second,
+                    b.besselOrder1(x, true).second, n, 2, 0, -1);
+  }
+  case BesselKind::I: {
+    Value i0 = b.scaledBesselI0(ax);
+    Value result;
+    if (n == 0) {
+      result = i0;
+    } else if (n == 1) {
+      result = b.scaledBesselI1(ax);
+    } else {
+      // The upward recurrence is unstable for I at every argument, so the
+      // backward recurrence is normalized by I0 instead.
+      auto down = b.backward(ax, n, backwardStartI(n), 2, 0, 1);
+      Value miller = b.mul(i0, b.div(down.fn, down.f0));
+      Value series = b.mul(b.series(ax, n, 1), b.exp(b.neg(ax)));
+      result = b.select(b.lt(ax, kSeriesThreshold), series, miller);
+      result = b.select(b.gt(ax, hankelThresholdI(n)),
+                        b.hankelBesselI(ax, n), result);
+    }
+    result = b.mul(reflect, result);
+    return scaled ? result : b.mul(result, b.exp(ax));
+  }
+  case BesselKind::K: {
+    Value result = b.upward(x, b.scaledBesselK0(x), b.scaledBesselK1(x), n, 2,
+                            0, 1);
+    return scaled ? result : b.mul(result, b.exp(b.neg(x)));
+  }
+  case BesselKind::SphericalJ: {
+    Value sinx = b.sin(x), cosx = b.cos(x);
+    Value zero = b.eq(x, 0.0);
+    Value j0 = b.select(zero, b.cst(1.0), b.div(sinx, x));
+    Value j1 =
+        b.select(zero, b.cst(0.0), b.div(b.sub(b.div(sinx, x), cosx), x));
+    if (n == 0)
+      return j0;
+    if (n == 1)
+      return j1;
+    // j0 is even and j1 odd, so their values at |x| are j0 and sign(x) j1.
+    Value j1Abs = b.mul(b.sign(x), j1);
+    Value up = b.upward(ax, j0, j1Abs, n, 2, 1, -1);
+    auto down = b.backward(ax, n, backwardStartJ(n), 2, 1, -1);
+    // Normalize by whichever of j0 and j1 is further from a zero.
+    Value useJ0 = b.gt(b.abs(j0), b.abs(j1Abs));
+    Value norm = b.select(useJ0, b.div(j0, down.f0), b.div(j1Abs, down.f1));
+    Value miller = b.mul(down.fn, norm);
+    // x^n / (2n+1)!! (1 - x^2 / (2 (2n + 3))).
+    Value power = b.cst(1.0);
+    double doubleFactorial = 1;
+    for (int64_t k = 1; k <= n; ++k) {
+      power = b.mul(power, ax);
+      doubleFactorial *= 2 * k + 1;
+    }
+    Value series = b.mul(b.div(power, b.cst(doubleFactorial)),
+                         b.sub(b.cst(1.0), b.mul(1.0 / (2 * (2 * n + 3)),
+                                                 b.mul(ax, ax))));
+    Value small = b.select(b.lt(ax, kSeriesThreshold), series, miller);
+    return b.mul(reflect, b.select(b.gt(ax, n), up, small));
+  }
+  case BesselKind::SphericalY: {
+    Value sinx = b.sin(x), cosx = b.cos(x);
+    Value y0 = b.neg(b.div(cosx, x));
+    Value y1 = b.sub(b.div(y0, x), b.div(sinx, x));
+    return b.upward(x, y0, y1, n, 2, 1, -1);
+  }
+  }
+  llvm_unreachable("unknown Bessel function");
+}
+
+template <typename OpTy, BesselKind Kind, bool Scaled = false>
+struct LowerBesselOp : public OpRewritePattern<OpTy> {
+  using OpRewritePattern<OpTy>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(OpTy op,
+                                PatternRewriter &rewriter) const override {
+    auto type = dyn_cast<RankedTensorType>(op.getType());
+    if (!type || !isa<FloatType>(type.getElementType()))
+      return rewriter.notifyMatchFailure(op, "only real arguments");
+    if (!isSinglePrecisionOrLess(type))
+      return rewriter.notifyMatchFailure(
+          op, "approximations are only accurate to single precision");
+
+    auto order = getIntegerOrder(op.getNu());
+    if (!order)
+      return rewriter.notifyMatchFailure(op, "order is not a small integer");
+    if ((Kind == BesselKind::SphericalJ || Kind == BesselKind::SphericalY) &&
+        *order < 0)
+      return rewriter.notifyMatchFailure(op, "negative spherical order");
+
+    auto computeType = getComputeType(type);
+    SpecialBuilder builder{rewriter, op.getLoc(), computeType};
+    Value z = convertIfNeeded(rewriter, op.getLoc(), op.getZ(), computeType);
+    Value result = lowerBessel(builder, Kind, *order, z, Scaled);
+    rewriter.replaceOp(op,
+                       convertIfNeeded(rewriter, op.getLoc(), result, type));
+    return success();
+  }
+};
+
+struct LowerJincOp : public OpRewritePattern<enzymexla::Jinc> {
+  using OpRewritePattern<enzymexla::Jinc>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(enzymexla::Jinc op,
+                                PatternRewriter &rewriter) const override {
+    auto type = dyn_cast<RankedTensorType>(op.getType());
+    if (!type || !isa<FloatType>(type.getElementType()))
+      return rewriter.notifyMatchFailure(op, "only real arguments");
+    if (!isSinglePrecisionOrLess(type))
+      return rewriter.notifyMatchFailure(
+          op, "approximations are only accurate to single precision");
+
+    // jinc(x) = J1(pi x) / (2 x) = pi / 2 J1(y) / y with y = pi |x|, which
+    // the small argument polynomial gives directly, including at 0.
+    auto computeType = getComputeType(type);
+    SpecialBuilder b{rewriter, op.getLoc(), computeType};
+    Value x = convertIfNeeded(rewriter, op.getLoc(), op.getX(), computeType);
+    Value y = b.mul(M_PI, b.abs(x));
+    Value t = b.div(y, b.cst(3.0));
+    Value small = b.poly(b.mul(t, t), kJ1Small);
+    Value large = b.div(b.besselOrder1(y, false).first, y);
+    Value result = b.mul(M_PI / 2, b.select(b.le(y, 3.0), small, large));
+    rewriter.replaceOp(op,
+                       convertIfNeeded(rewriter, op.getLoc(), result, type));
+    return success();
+  }
+};
+
+} // namespace
+
+struct LowerEnzymeXLASpecialPass
+    : public enzyme::impl::LowerEnzymeXLASpecialPassBase<
+          LowerEnzymeXLASpecialPass> {
+  using Base::Base;
+
+  void runOnOperation() override {
+    auto context = getOperation()->getContext();
+    RewritePatternSet patterns(context);
+
+    // Without an imaginary part the scaled J and Y equal the unscaled ones.
+    patterns.add<LowerBesselOp<enzymexla::BesselJ, BesselKind::J>,
+                 LowerBesselOp<enzymexla::BesselJX, BesselKind::J>,
+                 LowerBesselOp<enzymexla::BesselY, BesselKind::Y>,
+                 LowerBesselOp<enzymexla::BesselYX, BesselKind::Y>,
+                 LowerBesselOp<enzymexla::BesselI, BesselKind::I>,
+                 LowerBesselOp<enzymexla::BesselIX, BesselKind::I, true>,
+                 LowerBesselOp<enzymexla::BesselK, BesselKind::K>,
+                 LowerBesselOp<enzymexla::BesselKX, BesselKind::K, true>>(
+        context);
+    patterns.add<
+        LowerBesselOp<enzymexla::SphericalBesselJ, BesselKind::SphericalJ>,
+        LowerBesselOp<enzymexla::SphericalBesselY, BesselKind::SphericalY>>(
+        context);
+    patterns.add<LowerJincOp>(context);
+
+    GreedyRewriteConfig config;
+    if (failed(applyPatternsAndFoldGreedily(getOperation(), std::move(patterns),
+                                            config))) {
+      signalPassFailure();
+    }
+  }
+};
@@ -20,9 +20,11 @@
 #include "mlir/Dialect/OpenMP/OpenMPDialect.h"
 #include "mlir/Dialect/SCF/IR/SCF.h"
 #include "mlir/IR/PatternMatch.h"
+#include "mlir/Transforms/RegionUtils.h"
 #include "mlir/Transforms/GreedyPatternRewriteDriver.h"
 #include "src/enzyme_ad/jax/Passes/EnzymeHLOPatterns.h"
 #include "src/enzyme_ad/jax/Passes/Passes.h"
+#include "src/enzyme_ad/jax/Utils.h"
 #include "stablehlo/dialect/ChloOps.h"
 #include "stablehlo/dialect/StablehloOps.h"
 
@@ -48,8 +50,24 @@
 #include "llvm/ExecutionEngine/Orc/TargetProcess/JITLoaderGDB.h"
 #include "llvm/ExecutionEngine/Orc/TargetProcess/RegisterEHFrames.h"
 #include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include "llvm/ExecutionEngine/ObjectCache.h"
 #include "llvm/ExecutionEngine/SectionMemoryManager.h"
 
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/SHA256.h"
+#include "llvm/Support/Threading.h"
+
+#include "llvm/ADT/ScopeExit.h"
+
+#include <chrono>
+#include <future>
+#include <limits>
+#include <mutex>
+
 #include "mlir/Conversion/AffineToStandard/AffineToStandard.h"
 #include "mlir/Conversion/ArithToLLVM/ArithToLLVM.h"
 #include "mlir/Conversion/FuncToLLVM/ConvertFuncToLLVMPass.h"
@@ -239,16 +257,296 @@ struct CallInfo {
   void *(*init)();
 };
 
-llvm::StringMap<CallInfo> jitkernels;
-llvm::sys::SmartRWMutex<true> jit_kernel_mutex;
+llvm::StringMap<std::shared_future<CallInfo>> jitkernels;
+#ifndef NDEBUG
+llvm::StringMap<std::string> jitkernelstext;
+#endif
+std::mutex jit_kernel_mutex;
 std::unique_ptr<llvm::orc::LLJIT> JIT = nullptr;
 llvm::orc::SymbolMap MappedSymbols;
+std::mutex mapped_symbols_mutex;
+
+namespace {
+
+// Persistent, content-addressed cache of the object files produced for host
+// modules. Modules that should be persisted carry the path of their cache
+// entry in their module identifier (see `getModuleIdentifier`), which lets the
+// JIT compiler write the object once it has been generated. Entries are
+// evicted least recently used first once the directory exceeds its size bound.
+class JITObjectCache : public llvm::ObjectCache {
+public:
+  static constexpr llvm::StringLiteral IdentifierPrefix =
+      "enzymexla-jit-cache:";
+
+  std::atomic<uint64_t> hits = 0;
+  std::atomic<uint64_t> misses = 0;
+  std::atomic<uint64_t> evictions = 0;
+
+  static std::string getModuleIdentifier(llvm::StringRef path) {
+    return (IdentifierPrefix + path).str();
+  }
+
+  static std::string getEntryPath(llvm::StringRef dir, llvm::StringRef key) {
+    llvm::SmallString<128> path(dir);
+    llvm::sys::path::append(path, key + ".o");
+    return std::string(path.str());
+  }
+
+  void setMaxBytes(uint64_t bytes) { maxBytes = bytes; }
+
+  // Returns the object stored at `path`, or nullptr on a miss. Hits refresh
+  // the modification time of the entry which drives eviction.
+  std::unique_ptr<llvm::MemoryBuffer> load(llvm::StringRef path) {
+    auto buf = llvm::MemoryBuffer::getFile(path, /*IsText=*/false,
+                                           /*RequiresNullTerminator=*/false);
+    if (!buf) {
+      misses++;
+      return nullptr;
+    }
+    hits++;
+    int FD;
+    if (!llvm::sys::fs::openFileForRead(path, FD)) {
+      (void)llvm::sys::fs::setLastAccessAndModificationTime(
+          FD, std::chrono::system_clock::now());
+      (void)llvm::sys::Process::SafelyCloseFileDescriptor(FD);
+    }
+    LLVM_DEBUG(llvm::dbgs() << "jit object cache hit: " << path << "\n");
+    return std::move(*buf);
+  }
+
+  void notifyObjectCompiled(const llvm::Module *M,
+                            llvm::MemoryBufferRef Obj) override {
+    llvm::StringRef id = M->getModuleIdentifier();
+    if (!id.consume_front(IdentifierPrefix))
+      return;
+
+    llvm::StringRef dir = llvm::sys::path::parent_path(id);
+    if (auto EC = llvm::sys::fs::create_directories(dir)) {
+      llvm::errs() << " could not create jit object cache directory " << dir
+                   << ": " << EC.message() << "\n";
+      return;
+    }
+    // writeToOutput goes through a temporary file and a rename, so concurrent
+    // processes never observe a partially written object.
+    if (auto Err = llvm::writeToOutput(id, [&](llvm::raw_ostream &OS) {
+          OS << Obj.getBuffer();
+          return llvm::Error::success();
+        })) {
+      llvm::errs() << " could not write jit object cache entry " << id << ": "
+                   << Err << "\n";
+      return;
+    }
+    LLVM_DEBUG(llvm::dbgs() << "jit object cache store: " << id << "\n");
+    evict(dir);
+  }
+
+  std::unique_ptr<llvm::MemoryBuffer>
+  getObject(const llvm::Module *M) override {
+    // Lookups happen before lowering in CompileCall, such that hits skip the
+    // MLIR pipeline as well. Anything reaching the compiler is a miss.
+    return nullptr;
+  }
+
+private:
+  std::atomic<uint64_t> maxBytes = 0;
+  llvm::sys::SmartMutex<true> evictionMutex;
+
+  void evict(llvm::StringRef dir) {
+    llvm::sys::SmartScopedLock<true> lock(evictionMutex);
+
+    struct Entry {
+      std::string path;
+      uint64_t size;
+      llvm::sys::TimePoint<> time;
+    };
+    SmallVector<Entry> entries;
+    uint64_t total = 0;
+    std::error_code EC;
+    for (llvm::sys::fs::directory_iterator it(dir, EC), end; it != end && !EC;
+         it.increment(EC)) {
+      if (llvm::sys::path::extension(it->path()) != ".o")
+        continue;
+      auto status = it->status();
+      if (!status)
+        continue;
+      entries.push_back(Entry{it->path(), status->getSize(),
+                              status->getLastModificationTime()});
+      total += status->getSize();
+    }
+    if (total <= maxBytes)
+      return;
+
+    llvm::sort(entries, [](const Entry &lhs, const Entry &rhs) {
+      return lhs.time < rhs.time;
+    });
+    for (auto &entry : entries) {
+      if (total <= maxBytes)
+        break;
+      if (llvm::sys::fs::remove(entry.path))
+        continue;
+      total -= entry.size;
+      evictions++;
+      LLVM_DEBUG(llvm::dbgs()
+                 << "jit object cache evict: " << entry.path << "\n");
+    }
+  }
+};
+
+JITObjectCache &getJITObjectCache() {
+  static JITObjectCache cache;
+  return cache;
+}
+
+// Computes the cache key of a host module from its structural hash before
+// lowering and everything else that influences the generated object.
+std::string getJITObjectCacheKey(llvm::StringRef modhash,
+                                 llvm::StringRef options) {
+  llvm::SHA256 hasher;
+  hasher.update(modhash);
+  hasher.update(options);
+  hasher.update(JIT->getTargetTriple().str());
+  if (auto JTMB = llvm::orc::JITTargetMachineBuilder::detectHost()) {
+    hasher.update(JTMB->getCPU());
+    hasher.update(JTMB->getFeatures().getString());
+  } else {
+    llvm::consumeError(JTMB.takeError());
+  }
+  hasher.update(LLVM_VERSION_STRING);
+  return llvm::toHex(hasher.final(), /*LowerCase=*/true);
+}
+
+// Tuning state of one enzymexla.alternatives op of a host kernel. The first
+// invocation of every alternative is a cold run and is not recorded, the next
+// `runs` are timed, after which all calls dispatch to the alternative with the
+// lowest median time. Compiled kernels
+// refer to their state by address, so states are never freed. Choices are
+// written next to the object cache so that later processes compile the
+// winning alternative only, as do later compilations in this process. Kernels
+// compiled while tuning keep calling enzymexla_autotune_begin and _end after a
+// winner is picked, which then costs two calls and an atomic load per
+// dispatch, but no clock reads.
+struct AutotuneState {
+  std::string path;
+  int32_t numAlternatives;
+  unsigned runs;
+  std::atomic<int32_t> winner = -1;
+  std::atomic<int64_t> calls = 0;
+  std::mutex mutex;
+  SmallVector<SmallVector<double>> timings;
+  SmallVector<bool> warm;
+
+  AutotuneState(std::string path, int32_t numAlternatives, unsigned runs)
+      : path(std::move(path)), numAlternatives(numAlternatives),
+        runs(std::max(runs, 1u)), timings(numAlternatives),
+        warm(numAlternatives, false) {}
+
+  void load() {
+    if (path.empty())
+      return;
+    auto buf = llvm::MemoryBuffer::getFile(path, /*IsText=*/true);
+    if (!buf)
+      return;
+    auto [choice, count] = (*buf)->getBuffer().trim().split(' ');
+    int32_t alternative, total;
+    if (choice.getAsInteger(10, alternative) || count.getAsInteger(10, total) ||
+        total != numAlternatives || alternative < 0 ||
+        alternative >= numAlternatives)
+      return;
+    winner = alternative;
+  }
+
+  void record(int32_t alternative, double seconds) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (winner >= 0)
+      return;
+    if (!warm[alternative]) {
+      warm[alternative] = true;
+      return;
+    }
+    timings[alternative].push_back(seconds);
+    for (auto &times : timings)
+      if (times.size() < runs)
+        return;
+
+    int32_t best = 0;
+    double bestTime = std::numeric_limits<double>::infinity();
+    for (auto &&[i, times] : llvm::enumerate(timings)) {
+      llvm::sort(times);
+      if (times[times.size() / 2] < bestTime) {
+        bestTime = times[times.size() / 2];
+        best = i;
+      }
+    }
+    LLVM_DEBUG(llvm::dbgs() << "autotuning picked alternative " << best
+                            << " of " << numAlternatives << " for " << path
+                            << "\n");
+    winner = best;
+    store();
+  }
+
+private:
+  void store() {
+    if (path.empty())
+      return;
+    llvm::StringRef dir = llvm::sys::path::parent_path(path);
+    if (auto EC = llvm::sys::fs::create_directories(dir)) {
+      llvm::errs() << " could not create autotuning directory " << dir << ": "
+                   << EC.message() << "\n";
+      return;
+    }
+    if (auto Err = llvm::writeToOutput(path, [&](llvm::raw_ostream &OS) {
+          OS << winner.load() << " " << numAlternatives << "\n";
+          return llvm::Error::success();
+        })) {
+      llvm::errs() << " could not write autotuning choice " << path << ": "
+                   << Err << "\n";
+    }
+  }
+};
+
+llvm::StringMap<std::unique_ptr<AutotuneState>> autotuneStates;
+std::mutex autotune_mutex;
+
+// Returns the tuning state identified by `key`, picking up the choice of an
+// earlier process from `dir` if there is one.
+AutotuneState *getAutotuneState(llvm::StringRef key, llvm::StringRef dir,
+                                int32_t numAlternatives, unsigned runs) {
+  std::lock_guard<std::mutex> lock(autotune_mutex);
+  auto &state = autotuneStates[key];
+  if (!state) {
+    std::string path;
+    if (!dir.empty()) {
+      llvm::SmallString<128> file(dir);
+      llvm::sys::path::append(file, key + ".tune");
+      path = std::string(file.str());
+    }
+    state = std::make_unique<AutotuneState>(path, numAlternatives, runs);
+    state->load();
+  }
+  return state.get();
+}
+
+// Start times of the alternatives currently running on this thread.
+thread_local SmallVector<std::chrono::steady_clock::time_point, 2>
+    autotuneStarts;
+
+} // namespace
 
 bool initJIT();
 
+extern "C" MLIR_CAPI_EXPORTED void
+EnzymeJaXJITObjectCacheStatistics(uint64_t *hits, uint64_t *misses,
+                                  uint64_t *evictions) {
+  auto &cache = getJITObjectCache();
+  *hits = cache.hits;
+  *misses = cache.misses;
+  *evictions = cache.evictions;
+}
+
 extern "C" MLIR_CAPI_EXPORTED void EnzymeJaXMapSymbol(const char *name,
                                                       void *symbol) {
   initJIT();
+  std::lock_guard<std::mutex> lock(mapped_symbols_mutex);
   MappedSymbols[JIT->mangleAndIntern(name)] = llvm::orc::ExecutorSymbolDef(
       llvm::orc::ExecutorAddr::fromPtr(symbol), llvm::JITSymbolFlags());
 }
@@ -268,11 +566,67 @@ extern "C" void __chkstk(void);
 #endif
 #endif
 
+// Number of threads ORC uses to compile modules, defaults to the number of
+// hardware threads and can be overridden with ENZYMEXLA_JIT_COMPILE_THREADS.
+unsigned getNumJITCompileThreads() {
+  if (auto env = getenv("ENZYMEXLA_JIT_COMPILE_THREADS")) {
+    unsigned numThreads;
+    if (!llvm::StringRef(env).getAsInteger(10, numThreads))
+      return numThreads;
+  }
+  return llvm::hardware_concurrency().compute_thread_count();
+}
+
+// Runtime entry points of kernels compiled for autotuning, called around the
+// dispatch of every enzymexla.alternatives op.
+static int32_t autotuneBegin(void *data) {
+  auto state = static_cast<AutotuneState *>(data);
+  int32_t winner = state->winner.load(std::memory_order_acquire);
+  if (winner >= 0) {
+    // A default start time marks the call as untimed.
+    autotuneStarts.emplace_back();
+    return winner;
+  }
+  autotuneStarts.push_back(std::chrono::steady_clock::now());
+  return state->calls.fetch_add(1, std::memory_order_relaxed) %
+         state->numAlternatives;
+}
+
+static void autotuneEnd(void *data, int32_t alternative) {
+  auto start = autotuneStarts.pop_back_val();
+  auto state = static_cast<AutotuneState *>(data);
+  if (start == std::chrono::steady_clock::time_point() ||
+      state->winner.load(std::memory_order_acquire) >= 0)
+    return;
+  auto end = std::chrono::steady_clock::now();
+  state->record(alternative,
+                std::chrono::duration<double>(end - start).count());
+}
+
+// Sequential enzymexla_parallel_for, used until a runtime with a thread pool
+// maps its own implementation through EnzymeJaXMapSymbol.
+static void sequentialParallelFor(int64_t n,
+                                  void (*body)(void *, int64_t, int64_t),
+                                  void *data) {
+  if (n > 0)
+    body(data, 0, n);
+}
+
 bool initJIT() {
+  static std::mutex init_mutex;
+  std::lock_guard<std::mutex> lock(init_mutex);
   if (!JIT) {
     auto tJIT =
         llvm::orc::LLJITBuilder()
             .setLinkProcessSymbolsByDefault(true)
+            .setNumCompileThreads(getNumJITCompileThreads())
+            .setCompileFunctionCreator(
+                [](llvm::orc::JITTargetMachineBuilder JTMB)
+                    -> llvm::Expected<std::unique_ptr<
+                        llvm::orc::IRCompileLayer::IRCompiler>> {
+                  return std::make_unique<llvm::orc::ConcurrentIRCompiler>(
+                      std::move(JTMB), &getJITObjectCache());
+                })
             .setObjectLinkingLayerCreator(
                 [](llvm::orc::ExecutionSession &ES)
                     -> llvm::Expected<std::unique_ptr<llvm::orc::ObjectLayer>> {
@@ -311,6 +665,23 @@ bool initJIT() {
 
     JIT->getMainJITDylib().addGenerator(std::move(ProcessSymsGenerator.get()));
 
+    {
+      std::lock_guard<std::mutex> lock(mapped_symbols_mutex);
+      MappedSymbols.try_emplace(
+          JIT->mangleAndIntern("enzymexla_parallel_for"),
+          llvm::orc::ExecutorSymbolDef(
+              llvm::orc::ExecutorAddr::fromPtr(&sequentialParallelFor),
+              llvm::JITSymbolFlags()));
+      MappedSymbols[JIT->mangleAndIntern("enzymexla_autotune_begin")] =
+          llvm::orc::ExecutorSymbolDef(
+              llvm::orc::ExecutorAddr::fromPtr(&autotuneBegin),
+              llvm::JITSymbolFlags());
+      MappedSymbols[JIT->mangleAndIntern("enzymexla_autotune_end")] =
+          llvm::orc::ExecutorSymbolDef(
+              llvm::orc::ExecutorAddr::fromPtr(&autotuneEnd),
+              llvm::JITSymbolFlags());
+    }
+
 #if defined(_WIN32)
 #ifdef __MINGW32__
 #if defined(__i386__)
@@ -328,8 +699,47 @@ bool initJIT() {
   return true;
 }
 
+std::string getNextJITDylibName() {
+  static std::atomic<size_t> id = 0;
+  return "enzymejitdl_" + std::to_string(id++);
+}
+
+CallInfo LookupHostEntries(llvm::orc::JITDylib &LibA, bool compileInit) {
+  llvm::orc::SymbolMap symbols;
+  {
+    std::lock_guard<std::mutex> lock(mapped_symbols_mutex);
+    symbols = MappedSymbols;
+  }
+  if (auto Err = LibA.define(llvm::orc::absoluteSymbols(std::move(symbols)))) {
+    llvm::errs() << " Symbol define Error " << Err << "\n";
+    return {};
+  }
+
+  llvm::Expected<llvm::orc::ExecutorAddr> NVSym(llvm::orc::ExecutorAddr{});
+  if (compileInit) {
+    NVSym = JIT->lookup(LibA, "nv_func_init");
+    if (!NVSym) {
+      llvm::errs() << " lookupError " << NVSym.takeError() << "\n";
+      return {};
+    }
+  }
+
+  auto nvptr = (void *)NVSym->getValue();
+
+  auto Entry = JIT->lookup(LibA, "entry");
+  if (!Entry) {
+    llvm::errs() << " lookupError " << Entry.takeError() << "\n";
+    return {};
+  }
+
+  auto ptr = (void *)Entry->getValue();
+
+  return CallInfo{(void (*)(void *, void *, void **))ptr, (void *(*)())nvptr};
+}
+
 CallInfo CompileHostModule(std::string &key, mlir::ModuleOp modOp,
-                           bool compileInit, bool dump_final_module) {
+                           bool compileInit, bool dump_final_module,
+                           llvm::StringRef cachePath) {
   std::unique_ptr<llvm::LLVMContext> ctx(new llvm::LLVMContext);
   auto llvmModule = translateModuleToLLVMIR(modOp, *ctx);
   if (!llvmModule) {
@@ -342,43 +752,40 @@ CallInfo CompileHostModule(std::string &key, mlir::ModuleOp modOp,
 
   llvmModule->setDataLayout(JIT->getDataLayout());
   llvmModule->setTargetTriple(JIT->getTargetTriple());
+  if (!cachePath.empty())
+    llvmModule->setModuleIdentifier(
+        JITObjectCache::getModuleIdentifier(cachePath));
 
   if (dump_final_module) {
     llvm::errs() << " final_llvm_module before jit: " << *llvmModule << "\n";
   }
-  auto LibA =
-      JIT->createJITDylib("enzymejitdl_" + std::to_string(jitkernels.size()));
+  auto LibA = JIT->createJITDylib(getNextJITDylibName());
+  if (!LibA) {
+    llvm::errs() << " createJITDylibError " << LibA.takeError() << "\n";
+    return {};
+  }
   if (auto Err = JIT->addIRModule(
           LibA.get(),
           llvm::orc::ThreadSafeModule(std::move(llvmModule), std::move(ctx)))) {
     llvm::errs() << " addIRModuleError " << Err << "\n";
     return {};
   }
-  if (auto Err = LibA->define(llvm::orc::absoluteSymbols(MappedSymbols))) {
-    llvm::errs() << " Symbol define Error " << Err << "\n";
-    return {};
-  }
+  return LookupHostEntries(LibA.get(), compileInit);
+}
 
-  llvm::Expected<llvm::orc::ExecutorAddr> NVSym(llvm::orc::ExecutorAddr{});
-  if (compileInit) {
-    NVSym = JIT->lookup(LibA.get(), "nv_func_init");
-    if (!NVSym) {
-      llvm::errs() << " lookupError " << NVSym.takeError() << "\n";
-      return {};
-    }
+// Links a host object previously stored in the persistent object cache.
+CallInfo LoadHostObject(std::unique_ptr<llvm::MemoryBuffer> obj,
+                        bool compileInit) {
+  auto LibA = JIT->createJITDylib(getNextJITDylibName());
+  if (!LibA) {
+    llvm::errs() << " createJITDylibError " << LibA.takeError() << "\n";
+    return {};
   }
-
-  auto nvptr = (void *)NVSym->getValue();
-
-  auto Entry = JIT->lookup(LibA.get(), "entry");
-  if (!Entry) {
-    llvm::errs() << " lookupError " << Entry.takeError() << "\n";
+  if (auto Err = JIT->addObjectFile(LibA.get(), std::move(obj))) {
+    llvm::errs() << " addObjectFileError " << Err << "\n";
     return {};
   }
-
-  auto ptr = (void *)Entry->getValue();
-
-  return CallInfo{(void (*)(void *, void *, void **))ptr, (void *(*)())nvptr};
+  return LookupHostEntries(LibA.get(), compileInit);
 }
 
 void rewriteKernelCallABI(
@@ -674,9 +1081,353 @@ void rewriteKernelCallABI(
   });
 }
 
+constexpr llvm::StringLiteral kParallelBodyPrefix =
+    "__enzymexla_parallel_body_";
+constexpr llvm::StringLiteral kParallelDispatchPrefix =
+    "__enzymexla_parallel_dispatch_";
+constexpr llvm::StringLiteral kParallelForFn = "enzymexla_parallel_for";
+
+// Outlines the outermost reduction-free scf.parallel loops of a host module
+// into functions over a range of iterations of their first dimension. The
+// loop is replaced by a call to a dispatch declaration taking the trip count
+// and the captured values, which lowerParallelForDispatches turns into a call
+// to enzymexla_parallel_for once the module is in the LLVM dialect and the
+// captured values have their final types.
+static void outlineParallelLoops(ModuleOp submod) {
+  SmallVector<scf::ParallelOp> loops;
+  submod.walk([&](scf::ParallelOp op) {
+    if (!op->getParentOfType<scf::ParallelOp>() && op.getNumReductions() == 0)
+      loops.push_back(op);
+  });
+
+  OpBuilder builder(submod.getContext());
+  auto indexType = builder.getIndexType();
+  for (auto [idx, op] : llvm::enumerate(loops)) {
+    auto loc = op.getLoc();
+
+    // Constants are rematerialized in the outlined body, everything else is
+    // passed through the context.
+    SetVector<Value> used;
+    getUsedValuesDefinedAbove(op.getRegion(), op.getRegion(), used);
+    used.insert(op.getLowerBound().begin(), op.getLowerBound().end());
+    used.insert(op.getUpperBound().begin(), op.getUpperBound().end());
+    used.insert(op.getStep().begin(), op.getStep().end());
+    SmallVector<Value> captures;
+    SmallVector<Operation *> constants;
+    for (auto value : used) {
+      auto defOp = value.getDefiningOp();
+      if (defOp && defOp->hasTrait<OpTrait::ConstantLike>())
+        constants.push_back(defOp);
+      else
+        captures.push_back(value);
+    }
+
+    SmallVector<Type> bodyArgTypes = {indexType, indexType};
+    SmallVector<Type> dispatchArgTypes = {indexType};
+    for (auto value : captures) {
+      bodyArgTypes.push_back(value.getType());
+      dispatchArgTypes.push_back(value.getType());
+    }
+
+    builder.setInsertionPointToEnd(submod.getBody());
+    auto bodyFn = func::FuncOp::create(
+        builder, loc, (Twine(kParallelBodyPrefix) + Twine(idx)).str(),
+        builder.getFunctionType(bodyArgTypes, {}));
+    bodyFn.setPrivate();
+    auto dispatchFn = func::FuncOp::create(
+        builder, loc, (Twine(kParallelDispatchPrefix) + Twine(idx)).str(),
+        builder.getFunctionType(dispatchArgTypes, {}));
+    dispatchFn.setPrivate();
+
+    Block *entry = bodyFn.addEntryBlock();
+    builder.setInsertionPointToStart(entry);
+    IRMapping mapping;
+    for (auto [capture, arg] :
+         llvm::zip(captures, entry->getArguments().drop_front(2)))
+      mapping.map(capture, arg);
+    for (auto constant : constants)
+      builder.clone(*constant, mapping);
+
+    Value one = arith::ConstantIndexOp::create(builder, loc, 1);
+    auto forOp = scf::ForOp::create(builder, loc, entry->getArgument(0),
+                                    entry->getArgument(1), one);
+    builder.setInsertionPointToStart(forOp.getBody());
+    Value iv = arith::AddIOp::create(
+        builder, loc, mapping.lookup(op.getLowerBound()[0]),
+        arith::MulIOp::create(builder, loc, forOp.getInductionVar(),
+                              mapping.lookup(op.getStep()[0])));
+    mapping.map(op.getInductionVars()[0], iv);
+    if (op.getNumLoops() > 1) {
+      auto mapAll = [&](ValueRange values) {
+        SmallVector<Value> mapped;
+        for (auto value : values.drop_front())
+          mapped.push_back(mapping.lookup(value));
+        return mapped;
+      };
+      auto inner = scf::ParallelOp::create(
+          builder, loc, mapAll(op.getLowerBound()), mapAll(op.getUpperBound()),
+          mapAll(op.getStep()));
+      for (auto [oldIv, newIv] : llvm::zip(op.getInductionVars().drop_front(),
+                                           inner.getInductionVars()))
+        mapping.map(oldIv, newIv);
+      builder.setInsertionPointToStart(inner.getBody());
+    }
+    for (auto &bodyOp : op.getBody()->without_terminator())
+      builder.clone(bodyOp, mapping);
+    builder.setInsertionPointToEnd(entry);
+    func::ReturnOp::create(builder, loc);
+
+    builder.setInsertionPoint(op);
+    Value tripCount = arith::CeilDivSIOp::create(
+        builder, loc,
+        arith::SubIOp::create(builder, loc, op.getUpperBound()[0],
+                              op.getLowerBound()[0]),
+        op.getStep()[0]);
+    SmallVector<Value> dispatchArgs = {tripCount};
+    dispatchArgs.append(captures.begin(), captures.end());
+    func::CallOp::create(builder, loc, dispatchFn, dispatchArgs);
+    op.erase();
+  }
+}
+
+static Value castToIntWidth(OpBuilder &builder, Location loc, Value value,
+                            Type type) {
+  auto width = cast<IntegerType>(value.getType()).getWidth();
+  auto newWidth = cast<IntegerType>(type).getWidth();
+  if (width < newWidth)
+    return LLVM::SExtOp::create(builder, loc, type, value);
+  if (width > newWidth)
+    return LLVM::TruncOp::create(builder, loc, type, value);
+  return value;
+}
+
+// Replaces the dispatch calls left by outlineParallelLoops with calls to
+// enzymexla_parallel_for. The captured values are stored into a stack
+// allocated context, which a trampoline unpacks before calling the outlined
+// body on its range of iterations.
+static LogicalResult lowerParallelForDispatches(ModuleOp submod) {
+  SmallVector<LLVM::CallOp> calls;
+  submod.walk([&](LLVM::CallOp call) {
+    auto callee = call.getCallee();
+    if (callee && callee->starts_with(kParallelDispatchPrefix))
+      calls.push_back(call);
+  });
+  if (calls.empty())
+    return success();
+
+  auto ctx = submod.getContext();
+  OpBuilder builder(ctx);
+  auto ptrType = LLVM::LLVMPointerType::get(ctx);
+  auto i64Type = builder.getI64Type();
+  auto voidType = LLVM::LLVMVoidType::get(ctx);
+
+  auto runtimeFn = submod.lookupSymbol<LLVM::LLVMFuncOp>(kParallelForFn);
+  if (!runtimeFn) {
+    builder.setInsertionPointToStart(submod.getBody());
+    runtimeFn = LLVM::LLVMFuncOp::create(
+        builder, submod.getLoc(), kParallelForFn,
+        LLVM::LLVMFunctionType::get(voidType, {i64Type, ptrType, ptrType}));
+  }
+
+  SmallPtrSet<Operation *, 4> dispatchFns;
+  for (auto call : calls) {
+    auto loc = call.getLoc();
+    StringRef id = call.getCallee()->drop_front(kParallelDispatchPrefix.size());
+    auto bodyFn = submod.lookupSymbol<LLVM::LLVMFuncOp>(
+        (Twine(kParallelBodyPrefix) + id).str());
+    if (!bodyFn)
+      return call.emitError("missing outlined parallel loop body");
+    dispatchFns.insert(submod.lookupSymbol(*call.getCallee()));
+
+    auto operands = call.getArgOperands();
+    auto captures = operands.drop_front();
+    SmallVector<Type> captureTypes;
+    for (auto value : captures)
+      captureTypes.push_back(value.getType());
+    auto contextType = LLVM::LLVMStructType::getLiteral(ctx, captureTypes);
+
+    auto bodyParams = bodyFn.getFunctionType().getParams();
+    builder.setInsertionPointToEnd(submod.getBody());
+    auto trampoline = LLVM::LLVMFuncOp::create(
+        builder, loc, ("__enzymexla_parallel_trampoline_" + id).str(),
+        LLVM::LLVMFunctionType::get(voidType, {ptrType, i64Type, i64Type}),
+        LLVM::Linkage::Internal);
+    {
+      OpBuilder::InsertionGuard guard(builder);
+      Block *entry = trampoline.addEntryBlock(builder);
+      builder.setInsertionPointToStart(entry);
+      SmallVector<Value> args = {
+          castToIntWidth(builder, loc, entry->getArgument(1), bodyParams[0]),
+          castToIntWidth(builder, loc, entry->getArgument(2), bodyParams[1])};
+      for (auto [i, type] : llvm::enumerate(captureTypes)) {
+        auto gep = LLVM::GEPOp::create(
+            builder, loc, ptrType, contextType, entry->getArgument(0),
+            ArrayRef<LLVM::GEPArg>{0, static_cast<int32_t>(i)});
+        args.push_back(LLVM::LoadOp::create(builder, loc, type, gep));
+      }
+      LLVM::CallOp::create(builder, loc, bodyFn, args);
+      LLVM::ReturnOp::create(builder, loc, ValueRange{});
+    }
+
+    // The context lives in the entry block such that loops around the
+    // dispatch do not grow the stack.
+    Value context;
+    if (captures.empty()) {
+      builder.setInsertionPoint(call);
+      context = LLVM::ZeroOp::create(builder, loc, ptrType);
+    } else {
+      auto parent = call->getParentOfType<LLVM::LLVMFuncOp>();
+      builder.setInsertionPointToStart(&parent.getBody().front());
+      Value one = LLVM::ConstantOp::create(builder, loc, i64Type, 1);
+      context =
+          LLVM::AllocaOp::create(builder, loc, ptrType, contextType, one);
+      builder.setInsertionPoint(call);
+      for (auto [i, value] : llvm::enumerate(captures)) {
+        auto gep = LLVM::GEPOp::create(
+            builder, loc, ptrType, contextType, context,
+            ArrayRef<LLVM::GEPArg>{0, static_cast<int32_t>(i)});
+        LLVM::StoreOp::create(builder, loc, value, gep);
+      }
+    }
+
+    Value fn = LLVM::AddressOfOp::create(builder, loc, trampoline);
+    Value tripCount = castToIntWidth(builder, loc, operands[0], i64Type);
+    LLVM::CallOp::create(builder, loc, runtimeFn,
+                         ValueRange{tripCount, fn, context});
+    call.erase();
+  }
+
+  for (auto dispatchFn : dispatchFns)
+    dispatchFn->erase();
+  return success();
+}
+
+constexpr llvm::StringLiteral kAutotuneBeginFn = "enzymexla_autotune_begin";
+constexpr llvm::StringLiteral kAutotuneEndFn = "enzymexla_autotune_end";
+
+// Replaces `aop` by the body of its alternative `choice`.
+static void selectAlternative(enzymexla::AlternativesOp aop, unsigned choice) {
+  Block *body = &aop->getRegion(choice).front();
+  body->getTerminator()->erase();
+  aop->getBlock()->getOperations().splice(Block::iterator(aop),
+                                          body->getOperations());
+  aop->erase();
+}
+
+// Replaces `aop` by a dispatch to the alternative returned by
+// enzymexla_autotune_begin, and reports its completion to
+// enzymexla_autotune_end such that `state` can time it.
+static void lowerAlternativeToAutotuning(enzymexla::AlternativesOp aop,
+                                         AutotuneState *state) {
+  auto ctx = aop.getContext();
+  auto loc = aop.getLoc();
+  auto submod = aop->getParentOfType<ModuleOp>();
+  OpBuilder builder(ctx);
+  auto ptrType = LLVM::LLVMPointerType::get(ctx);
+  auto i32Type = builder.getI32Type();
+  auto i64Type = builder.getI64Type();
+  auto voidType = LLVM::LLVMVoidType::get(ctx);
+
+  auto beginFn = submod.lookupSymbol<LLVM::LLVMFuncOp>(kAutotuneBeginFn);
+  if (!beginFn) {
+    builder.setInsertionPointToStart(submod.getBody());
+    beginFn = LLVM::LLVMFuncOp::create(
+        builder, submod.getLoc(), kAutotuneBeginFn,
+        LLVM::LLVMFunctionType::get(i32Type, {ptrType}));
+  }
+  auto endFn = submod.lookupSymbol<LLVM::LLVMFuncOp>(kAutotuneEndFn);
+  if (!endFn) {
+    builder.setInsertionPointToStart(submod.getBody());
+    endFn = LLVM::LLVMFuncOp::create(
+        builder, submod.getLoc(), kAutotuneEndFn,
+        LLVM::LLVMFunctionType::get(voidType, {ptrType, i32Type}));
+  }
+
+  builder.setInsertionPoint(aop);
+  auto addr = LLVM::ConstantOp::create(
+      builder, loc, i64Type,
+      builder.getI64IntegerAttr(reinterpret_cast<intptr_t>(state)));
+  Value statePtr = LLVM::IntToPtrOp::create(builder, loc, ptrType, addr);
+  Value choice =
+      LLVM::CallOp::create(builder, loc, beginFn, ValueRange{statePtr})
+          ->getResult(0);
+
+  unsigned numAlternatives = aop->getNumRegions();
+  for (auto &&[i, region] : llvm::enumerate(aop->getRegions())) {
+    Block *body = &region.front();
+    body->getTerminator()->erase();
+    if (i + 1 == numAlternatives) {
+      builder.getInsertionBlock()->getOperations().splice(
+          builder.getInsertionPoint(), body->getOperations());
+      break;
+    }
+    auto cmpOp = arith::CmpIOp::create(
+        builder, loc, arith::CmpIPredicate::eq, choice,
+        arith::ConstantIntOp::create(builder, loc, i, 32));
+    auto ifOp = scf::IfOp::create(builder, loc, cmpOp, /*hasElse*/ true);
+    ifOp.thenBlock()->getOperations().splice(
+        Block::iterator(ifOp.thenBlock()->getTerminator()),
+        body->getOperations());
+    builder.setInsertionPoint(ifOp.elseBlock()->getTerminator());
+  }
+
+  builder.setInsertionPoint(aop);
+  LLVM::CallOp::create(builder, loc, endFn, ValueRange{statePtr, choice});
+  aop->erase();
+}
+
+// Lowers the enzymexla.alternatives ops of a host module for autotuning. Ops
+// whose tuning already finished, in this process or an earlier one, are
+// replaced by their winning alternative, which is appended to `choices`. The
+// others dispatch at runtime until they are tuned. Returns whether the module
+// refers to a tuning state, in which case it must not be persisted.
+static bool lowerAlternatives(ModuleOp submod, llvm::StringRef key,
+                              enzymexla::JITCallOp jcall, llvm::StringRef dir,
+                              unsigned runs, std::string &choices) {
+  SmallVector<Operation *> ops;
+  submod.walk([&](enzymexla::AlternativesOp aop) { ops.push_back(aop); });
+  if (ops.empty())
+    return false;
+
+  // Nested alternatives are flattened such that every op is tuned on its own.
+  auto ctx = submod.getContext();
+  RewritePatternSet patterns(ctx);
+  enzymexla::AlternativesOp::getCanonicalizationPatterns(patterns, ctx);
+  (void)applyOpPatternsGreedily(ops, std::move(patterns));
+
+  SmallVector<enzymexla::AlternativesOp> aops;
+  submod.walk([&](enzymexla::AlternativesOp aop) { aops.push_back(aop); });
+
+  // The best alternative usually depends on the problem size, so choices are
+  // keyed by the shapes of the call as well.
+  std::string shapes;
+  llvm::raw_string_ostream shapesStream(shapes);
+  shapesStream << "autotune ";
+  llvm::interleaveComma(jcall.getInputs().getTypes(), shapesStream);
+  shapesStream << " -> ";
+  llvm::interleaveComma(jcall->getResultTypes(), shapesStream);
+  std::string tuneKey = getJITObjectCacheKey(key, shapesStream.str());
+
+  bool tuning = false;
+  for (auto &&[i, aop] : llvm::enumerate(aops)) {
+    auto state = getAutotuneState((tuneKey + "_" + Twine(i)).str(), dir,
+                                  aop->getNumRegions(), runs);
+    int32_t winner = state->winner.load(std::memory_order_acquire);
+    if (winner >= 0) {
+      choices += " " + std::to_string(winner);
+      selectAlternative(aop, winner);
+    } else {
+      lowerAlternativeToAutotuning(aop, state);
+      tuning = true;
+    }
+  }
+  return tuning;
+}
+
 CallInfo CompileCall(SymbolTableCollection &symbolTable, mlir::Location loc,
                      FunctionOpInterface op, bool jit,
                      enzymexla::JITCallOp jcall, bool openmp,
+                     bool intraOpParallel,
                      size_t cuResultHandlerPtr, size_t cuStreamSynchronizePtr,
                      int indexBitWidth, const std::string &cubinTriple,
                      const std::string &cubinChip,
@@ -684,7 +1435,10 @@ CallInfo CompileCall(SymbolTableCollection &symbolTable, mlir::Location loc,
                      const std::string &cubinFormat, int cuOptLevel,
                      const std::string &toolkitPath,
                      const llvm::SmallVectorImpl<std::string> &linkFiles,
-                     bool debug, bool returnPtr, bool dump_final_module) {
+                     bool debug, bool returnPtr, bool dump_final_module,
+                     llvm::StringRef objectCacheDir,
+                     uint64_t objectCacheMaxBytes, bool autotune,
+                     unsigned autotuneRuns) {
 
   OpBuilder builder(op);
 
@@ -842,104 +1596,186 @@ CallInfo CompileCall(SymbolTableCollection &symbolTable, mlir::Location loc,
     op.erase();
   });
 
-  std::string modstr;
-  llvm::raw_string_ostream ss(modstr);
-
-  ss << submod;
-
   if (!jit) {
     submod.erase();
     return {};
   }
 
-  llvm::sys::SmartScopedWriter<true> jit_lock(jit_kernel_mutex);
+  // Kernels are deduplicated by their 128-bit structural hash, such that
+  // lookups do not need to print the submodule. The text is only materialized
+  // for debug output, and in asserts builds to verify that equal hashes imply
+  // equal kernels.
+  std::string key = computeStructuralHash(submod).str();
+  if (intraOpParallel)
+    key += ":intra_op_parallel";
+  std::string modstr;
+#ifdef NDEBUG
+  if (debug)
+#endif
+  {
+    llvm::raw_string_ostream ss(modstr);
+    ss << submod;
+  }
 
-  auto found = jitkernels.find(ss.str());
-  if (found != jitkernels.end()) {
+  // Only one thread compiles a given kernel, concurrent requests for the same
+  // kernel wait on its future while unrelated kernels compile in parallel.
+  std::promise<CallInfo> promise;
+  std::shared_future<CallInfo> pending;
+  {
+    std::lock_guard<std::mutex> jit_lock(jit_kernel_mutex);
+    auto [found, inserted] = jitkernels.try_emplace(key);
+    if (inserted)
+      found->second = promise.get_future().share();
+    else
+      pending = found->second;
+#ifndef NDEBUG
+    auto [text, newText] = jitkernelstext.try_emplace(key, modstr);
+    assert((newText || text->second == modstr) &&
+           "structural hash collision between jit kernels");
+#endif
+  }
+  if (pending.valid()) {
     submod.erase();
-    return found->second;
-  } else {
-    if (numGPUModule != 0)
-      submod->setAttr(gpu::GPUDialect::getContainerModuleAttrName(),
-                      UnitAttr::get(jcall.getContext()));
-    static size_t id = 0;
-    submod.setName("jitoffload" + std::to_string(id));
-    id++;
-    PassManager pm(submod.getContext());
-    if (numGPUModule == 0) {
-      SmallVector<Operation *> toErase;
-      submod.walk([&](LLVM::InlineAsmOp asmop) {
-        if (asmop.getAsmString() == "exit;") {
-          toErase.push_back(asmop);
-        }
-      });
-      for (auto op : toErase) {
-        op->erase();
-      }
-      pm.addPass(createLowerAffinePass());
-      if (openmp)
-        pm.addPass(createConvertSCFToOpenMPPass());
-      else
-        pm.addPass(createSCFToControlFlowPass());
+    return pending.get();
+  }
+
+  // Publish the result on every exit path. Failed compilations are dropped
+  // from the map so that later calls retry them.
+  CallInfo ptr{};
+  auto publish = llvm::make_scope_exit([&]() {
+    if (!ptr.run) {
+      std::lock_guard<std::mutex> jit_lock(jit_kernel_mutex);
+      jitkernels.erase(key);
+#ifndef NDEBUG
+      jitkernelstext.erase(key);
+#endif
+    }
+    promise.set_value(ptr);
+  });
 
-      buildLowerToCPUPassPipeline(pm);
-      auto subres = pm.run(submod);
-      if (!subres.succeeded()) {
+  if (numGPUModule != 0)
+    submod->setAttr(gpu::GPUDialect::getContainerModuleAttrName(),
+                    UnitAttr::get(jcall.getContext()));
+  static std::atomic<size_t> id = 0;
+  submod.setName("jitoffload" + std::to_string(id++));
+
+  std::string choices;
+  bool tuning = false;
+  if (numGPUModule == 0 && autotune && initJIT())
+    tuning = lowerAlternatives(submod, key, jcall, objectCacheDir,
+                               autotuneRuns, choices);
+
+  // GPU host modules embed process specific handler addresses, so only CPU
+  // modules are persisted across processes. The same holds for kernels that
+  // are still being tuned.
+  std::string cachePath;
+  if (numGPUModule == 0 && !tuning && !objectCacheDir.empty() && initJIT()) {
+    std::string options;
+    llvm::raw_string_ostream optionsStream(options);
+    optionsStream << "openmp=" << openmp
+                  << " intraOpParallel=" << intraOpParallel
+                  << " returnPtr=" << returnPtr
+                  << " alternatives=" << choices;
+    cachePath = JITObjectCache::getEntryPath(
+        objectCacheDir, getJITObjectCacheKey(key, optionsStream.str()));
+    auto &cache = getJITObjectCache();
+    cache.setMaxBytes(objectCacheMaxBytes);
+    if (auto obj = cache.load(cachePath)) {
+      ptr = LoadHostObject(std::move(obj), /*compileInit=*/false);
+      if (ptr.run) {
         submod.erase();
-        return {};
+        return ptr;
       }
-    } else {
-      submod->walk([](gpu::GPUModuleOp gmod) {
-        auto str = gmod.getName();
-        if (str.size() > 200)
-          gmod.setName(str.substr(0, 200));
-      });
-
-      std::string legalName;
-      submod->walk([&](gpu::LaunchFuncOp gmod) {
-        if (legalName.size())
-          assert(legalName == gmod.getKernelName());
-        else
-          legalName = gmod.getKernelName().str();
-        auto str = gmod.getKernelModuleName().getValue();
-        if (str.size() > 200)
-          gmod.setKernelAttr(SymbolRefAttr::get(
-              StringAttr::get(gmod.getContext(), str.substr(0, 200)),
-              gmod.getKernel().getNestedReferences()));
-      });
-      mlir::gpu::GPUToNVVMPipelineOptions options;
-      options.indexBitWidth = indexBitWidth;
-      options.cubinTriple = cubinTriple;
-      options.cubinChip = cubinChip;
-      options.cubinFeatures = cubinFeatures;
-      options.cubinFormat = cubinFormat;
-      options.optLevel = cuOptLevel;
-      options.kernelUseBarePtrCallConv = false;
-      options.hostUseBarePtrCallConv = false;
-      buildLowerToNVVMPassPipeline(pm, options, toolkitPath, linkFiles);
-      if (numGPUModule != 1) {
-        llvm::errs() << " only single gpu module calls supported atm\n";
-        submod.erase();
-        return {};
+    }
+  }
+
+  PassManager pm(submod.getContext());
+  if (numGPUModule == 0) {
+    SmallVector<Operation *> toErase;
+    submod.walk([&](LLVM::InlineAsmOp asmop) {
+      if (asmop.getAsmString() == "exit;") {
+        toErase.push_back(asmop);
       }
-      auto subres = pm.run(submod);
-      if (!subres.succeeded()) {
+    });
+    for (auto op : toErase) {
+      op->erase();
+    }
+    if (intraOpParallel) {
+      // Affine parallel loops are only visible to the outlining once they
+      // are lowered to scf.parallel.
+      PassManager affinePm(submod.getContext());
+      affinePm.addPass(createLowerAffinePass());
+      if (failed(affinePm.run(submod))) {
         submod.erase();
         return {};
       }
-      rewriteKernelCallABI(submod, loc, legalName, debug, jcall, modstr,
-                           cuResultHandlerPtr, cuStreamSynchronizePtr,
-                           indexBitWidth, cubinTriple, cubinChip, cubinFeatures,
-                           cubinFormat, cuOptLevel, toolkitPath, linkFiles);
+      outlineParallelLoops(submod);
+      pm.addPass(createSCFToControlFlowPass());
+    } else {
+      pm.addPass(createLowerAffinePass());
+      if (openmp)
+        pm.addPass(createConvertSCFToOpenMPPass());
+      else
+        pm.addPass(createSCFToControlFlowPass());
     }
 
-    auto ptr = CompileHostModule(ss.str(), submod, numGPUModule != 0,
-                                 dump_final_module);
-    jitkernels[ss.str()] = ptr;
-    submod.erase();
-    return ptr;
+    buildLowerToCPUPassPipeline(pm);
+    auto subres = pm.run(submod);
+    if (!subres.succeeded() ||
+        (intraOpParallel && failed(lowerParallelForDispatches(submod)))) {
+      submod.erase();
+      return {};
+    }
+  } else {
+    submod->walk([](gpu::GPUModuleOp gmod) {
+      auto str = gmod.getName();
+      if (str.size() > 200)
+        gmod.setName(str.substr(0, 200));
+    });
+
+    std::string legalName;
+    submod->walk([&](gpu::LaunchFuncOp gmod) {
+      if (legalName.size())
+        assert(legalName == gmod.getKernelName());
+      else
+        legalName = gmod.getKernelName().str();
+      auto str = gmod.getKernelModuleName().getValue();
+      if (str.size() > 200)
+        gmod.setKernelAttr(SymbolRefAttr::get(
+            StringAttr::get(gmod.getContext(), str.substr(0, 200)),
+            gmod.getKernel().getNestedReferences()));
+    });
+    mlir::gpu::GPUToNVVMPipelineOptions options;
+    options.indexBitWidth = indexBitWidth;
+    options.cubinTriple = cubinTriple;
+    options.cubinChip = cubinChip;
+    options.cubinFeatures = cubinFeatures;
+    options.cubinFormat = cubinFormat;
+    options.optLevel = cuOptLevel;
+    options.kernelUseBarePtrCallConv = false;
+    options.hostUseBarePtrCallConv = false;
+    buildLowerToNVVMPassPipeline(pm, options, toolkitPath, linkFiles);
+    if (numGPUModule != 1) {
+      llvm::errs() << " only single gpu module calls supported atm\n";
+      submod.erase();
+      return {};
+    }
+    auto subres = pm.run(submod);
+    if (!subres.succeeded()) {
+      submod.erase();
+      return {};
+    }
+    rewriteKernelCallABI(submod, loc, legalName, debug, jcall, modstr,
+                         cuResultHandlerPtr, cuStreamSynchronizePtr,
+                         indexBitWidth, cubinTriple, cubinChip, cubinFeatures,
+                         cubinFormat, cuOptLevel, toolkitPath, linkFiles);
   }
-};
+
+  ptr = CompileHostModule(key, submod, numGPUModule != 0,
+                          dump_final_module, cachePath);
+  submod.erase();
+  return ptr;
+}
 
 namespace {
 
@@ -1005,6 +1841,11 @@ struct LowerJITPass
     llvm::SmallVector<std::string> linkFilesArray =
         parseLinkFilesString(linkFiles.getValue());
 
+    std::string cacheDir = objectCacheDir.getValue();
+    if (cacheDir.empty())
+      if (auto envDir = getenv("ENZYMEXLA_JIT_CACHE_DIR"))
+        cacheDir = envDir;
+
     SetVector<FunctionOpInterface> callees;
     bool failed = false;
     getOperation()->walk([&](JITCallOp op) {
@@ -1036,10 +1877,12 @@ struct LowerJITPass
       }
 
       CallInfo cdata = CompileCall(
-          symbolTable, op.getLoc(), fn, jit, op, openmp, cuResultHandlerPtr,
+          symbolTable, op.getLoc(), fn, jit, op, openmp,
+          intraOpParallel && backend == "cpu", cuResultHandlerPtr,
           cuStreamSynchronizePtr, indexBitWidth, cubinTriple, cubinChip,
           cubinFeatures, cubinFormat, cuOptLevel, toolkitPath, linkFilesArray,
-          debug, hasReturn, dump_final_module);
+          debug, hasReturn, dump_final_module, cacheDir, objectCacheMaxBytes,
+          autotune, autotuneRuns);
 
       std::string backendinfo((char *)&cdata, sizeof(CallInfo));
       if (jit) {
@@ -1078,6 +1921,22 @@ struct LowerJITPass
                 mlir::stablehlo::CustomCallApiVersion::API_VERSION_TYPED_FFI),
             /*calledcomputations*/ nullptr, operand_layouts, result_layouts,
             output_operand_aliases);
+      else if (backend == "cpu" && intraOpParallel)
+        // The typed FFI handler provides the intra-op thread pool that
+        // enzymexla_parallel_for runs on.
+        replacement = stablehlo::CustomCallOp::create(
+            rewriter, op.getLoc(), op.getResultTypes(), op.getInputs(),
+            hasReturn ? rewriter.getStringAttr(
+                            "enzymexla_compile_cpu_ffi_with_error")
+                      : rewriter.getStringAttr("enzymexla_compile_cpu_ffi"),
+            /* has_side_effect*/ hasSideEffectAttr,
+            /*backend_config*/ dattr,
+            /* api_version*/
+            CustomCallApiVersionAttr::get(
+                rewriter.getContext(),
+                mlir::stablehlo::CustomCallApiVersion::API_VERSION_TYPED_FFI),
+            /*calledcomputations*/ nullptr, operand_layouts, result_layouts,
+            output_operand_aliases);
       else if (backend == "cpu")
         replacement = stablehlo::CustomCallOp::create(
             rewriter, op.getLoc(), op.getResultTypes(), op.getInputs(),
@@ -0,0 +1,44 @@
+//===- MarkCacheStorage.cpp - Request compressed reverse-mode caches ------ //
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===---------------------------------------------------------------------===//
+//
+// This file implements a pass requesting a storage for the reverse-mode caches
+// of the loops in a module, applied when the caches are stacked.
+//===---------------------------------------------------------------------===//
+
+#include "src/enzyme_ad/jax/Passes/Passes.h"
+
+#include "mlir/IR/BuiltinAttributes.h"
+#include "mlir/IR/BuiltinOps.h"
+
+namespace mlir {
+namespace enzyme {
+#define GEN_PASS_DEF_MARKCACHESTORAGEPASS
+#include "src/enzyme_ad/jax/Passes/Passes.h.inc"
+} // namespace enzyme
+} // namespace mlir
+
+using namespace mlir;
+using namespace mlir::enzyme;
+
+namespace {
+struct MarkCacheStoragePass
+    : public enzyme::impl::MarkCacheStoragePassBase<MarkCacheStoragePass> {
+  using MarkCacheStoragePassBase::MarkCacheStoragePassBase;
+
+  void runOnOperation() override {
+    ModuleOp module = getOperation();
+    if (!llvm::is_contained({"lossless", "bf16", "f8E4M3FN", "f8E5M2"},
+                            StringRef(storage))) {
+      module.emitError() << "unknown cache storage '" << storage << "'";
+      return signalPassFailure();
+    }
+    module->setAttr("enzymexla.cache_storage",
+                    StringAttr::get(module.getContext(), storage));
+  }
+};
+} // namespace
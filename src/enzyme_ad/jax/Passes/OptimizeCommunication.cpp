@@ -24,10 +24,15 @@
 #include "stablehlo/dialect/StablehloOps.h"
 
 #include "src/enzyme_ad/jax/Utils.h"
+#include "mlir/IR/Matchers.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/TypeSwitch.h"
 
 #include <algorithm>
 #include <cstdint>
+#include <memory>
+#include <optional>
 
 #define DEBUG_TYPE "optimize-communication"
 
@@ -4726,6 +4731,802 @@ struct ReorderAssociativeOp : public OpRewritePattern<opTy> {
   }
 };
 
+// The values in manual computations that are computed from the result of a
+// collective permute, i.e. that are part of a received halo. The set is built
+// in one forward sweep and then kept up to date from the rewriter
+// notifications, so queries do not walk the use-def chains again.
+class HaloValues final : public RewriterBase::Listener {
+public:
+  explicit HaloValues(Operation *root) {
+    root->walk([&](Operation *op) { update(op); });
+  }
+
+  bool contains(Value v) const { return values.contains(v); }
+
+  void notifyOperationInserted(Operation *op,
+                               OpBuilder::InsertPoint previous) override {
+    update(op);
+  }
+  void notifyOperationModified(Operation *op) override { update(op); }
+  void notifyOperationErased(Operation *op) override {
+    for (auto result : op->getResults())
+      values.erase(result);
+  }
+
+private:
+  bool isHalo(Operation *op) const {
+    if (!op->getParentOfType<sdy::ManualComputationOp>())
+      return false;
+    if (isa<stablehlo::CollectivePermuteOp>(op))
+      return true;
+    return llvm::any_of(op->getOperands(),
+                        [&](Value v) { return contains(v); });
+  }
+
+  // Recomputes the results of `root`, and of its transitive users whenever
+  // that changes their inputs.
+  void update(Operation *root) {
+    SmallVector<Operation *> worklist = {root};
+    while (!worklist.empty()) {
+      auto *op = worklist.pop_back_val();
+      bool halo = isHalo(op);
+      for (auto result : op->getResults()) {
+        bool changed = halo ? values.insert(result).second
+                            : values.erase(result);
+        if (changed)
+          llvm::append_range(worklist, result.getUsers());
+      }
+    }
+  }
+
+  DenseSet<Value> values;
+};
+
+// A concatenation inside a manual computation that joins received halos with
+// local data.
+static stablehlo::ConcatenateOp getHaloConcat(const HaloValues &halos,
+                                              Value v) {
+  auto concat = v.getDefiningOp<stablehlo::ConcatenateOp>();
+  if (!concat || !concat->getParentOfType<sdy::ManualComputationOp>())
+    return nullptr;
+  bool hasHalo = false, hasLocal = false;
+  for (auto operand : concat.getOperands()) {
+    if (halos.contains(operand))
+      hasHalo = true;
+    else
+      hasLocal = true;
+  }
+  if (!hasHalo || !hasLocal)
+    return nullptr;
+  return concat;
+}
+
+// Slices `v` to [start, limit) along `dim`, keeping the other dimensions.
+static Value sliceAlongDim(PatternRewriter &rewriter, Location loc, Value v,
+                           int64_t dim, int64_t start, int64_t limit) {
+  auto type = cast<RankedTensorType>(v.getType());
+  if (start == 0 && limit == type.getDimSize(dim))
+    return v;
+  SmallVector<int64_t> starts(type.getRank(), 0);
+  SmallVector<int64_t> limits = llvm::to_vector(type.getShape());
+  SmallVector<int64_t> strides(type.getRank(), 1);
+  starts[dim] = start;
+  limits[dim] = limit;
+  return stablehlo::SliceOp::create(rewriter, loc, v, starts, limits, strides);
+}
+
+// slice(concat(halo, local, halo)) -> concat(slice(halo), slice(local), ...)
+//
+// Slices that only read local data then no longer wait for the halo
+// exchange.
+struct HaloSliceConcatSplit : public OpRewritePattern<stablehlo::SliceOp> {
+  HaloSliceConcatSplit(const HaloValues &halos, MLIRContext *context,
+                       PatternBenefit benefit = 1)
+      : OpRewritePattern(context, benefit), halos(halos) {}
+
+  LogicalResult matchAndRewrite(stablehlo::SliceOp slice,
+                                PatternRewriter &rewriter) const override {
+    auto concat = getHaloConcat(halos, slice.getOperand());
+    if (!concat)
+      return failure();
+    int64_t dim = concat.getDimension();
+    if (llvm::any_of(slice.getStrides(), [](int64_t s) { return s != 1; }))
+      return failure();
+
+    int64_t start = slice.getStartIndices()[dim];
+    int64_t limit = slice.getLimitIndices()[dim];
+    auto starts = llvm::to_vector(slice.getStartIndices());
+    auto limits = llvm::to_vector(slice.getLimitIndices());
+
+    SmallVector<Value> pieces;
+    int64_t offset = 0;
+    for (auto operand : concat.getOperands()) {
+      int64_t size = cast<RankedTensorType>(operand.getType()).getDimSize(dim);
+      int64_t lo = std::max(start, offset), hi = std::min(limit, offset + size);
+      offset += size;
+      if (lo >= hi)
+        continue;
+      starts[dim] = lo - (offset - size);
+      limits[dim] = hi - (offset - size);
+      pieces.push_back(stablehlo::SliceOp::create(rewriter, slice.getLoc(),
+                                                  operand, starts, limits,
+                                                  slice.getStrides()));
+    }
+
+    if (pieces.size() == 1)
+      rewriter.replaceOp(slice, pieces[0]);
+    else
+      rewriter.replaceOpWithNewOp<stablehlo::ConcatenateOp>(slice, pieces,
+                                                            dim);
+    return success();
+  }
+
+private:
+  const HaloValues &halos;
+};
+
+// elementwise(concat(halo, local, halo), ...) ->
+//   concat(elementwise(halo, ...), elementwise(local, ...), ...)
+//
+// The operands are split at the union of the concatenation boundaries, so the
+// interior of a stencil is computed from local data alone and can run while
+// the halo exchange is in flight. Only the boundary segments consume the
+// received halos.
+struct HaloElementwiseConcatSplit : public RewritePattern {
+  HaloElementwiseConcatSplit(const HaloValues &halos, MLIRContext *context,
+                             PatternBenefit benefit = 1)
+      : RewritePattern(MatchAnyOpTypeTag(), benefit, context), halos(halos) {}
+
+  LogicalResult matchAndRewrite(Operation *op,
+                                PatternRewriter &rewriter) const override {
+    if (!op->hasTrait<OpTrait::Elementwise>() || op->getNumResults() != 1 ||
+        op->getNumRegions() != 0 ||
+        !isa<stablehlo::StablehloDialect>(op->getDialect()))
+      return failure();
+    auto resultType = dyn_cast<RankedTensorType>(op->getResult(0).getType());
+    if (!resultType || !resultType.hasStaticShape())
+      return failure();
+    for (auto operand : op->getOperands())
+      if (cast<ShapedType>(operand.getType()).getShape() !=
+          resultType.getShape())
+        return failure();
+
+    std::optional<int64_t> dim;
+    SmallVector<int64_t> bounds;
+    for (auto operand : op->getOperands()) {
+      auto concat = getHaloConcat(halos, operand);
+      if (!concat)
+        continue;
+      if (dim && *dim != concat.getDimension())
+        return failure();
+      dim = concat.getDimension();
+      int64_t offset = 0;
+      for (auto piece : concat.getOperands()) {
+        offset += cast<RankedTensorType>(piece.getType()).getDimSize(*dim);
+        bounds.push_back(offset);
+      }
+    }
+    if (!dim)
+      return failure();
+    llvm::sort(bounds);
+    bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+
+    SmallVector<Value> segments;
+    int64_t start = 0;
+    for (int64_t limit : bounds) {
+      SmallVector<Value> operands;
+      for (auto operand : op->getOperands()) {
+        auto concat = getHaloConcat(halos, operand);
+        if (!concat) {
+          operands.push_back(
+              sliceAlongDim(rewriter, op->getLoc(), operand, *dim, start,
+                            limit));
+          continue;
+        }
+        // The refined bounds never straddle a piece.
+        int64_t offset = 0;
+        for (auto piece : concat.getOperands()) {
+          int64_t size =
+              cast<RankedTensorType>(piece.getType()).getDimSize(*dim);
+          if (start >= offset && limit <= offset + size) {
+            operands.push_back(sliceAlongDim(rewriter, op->getLoc(), piece,
+                                             *dim, start - offset,
+                                             limit - offset));
+            break;
+          }
+          offset += size;
+        }
+      }
+
+      SmallVector<int64_t> shape = llvm::to_vector(resultType.getShape());
+      shape[*dim] = limit - start;
+      OperationState state(op->getLoc(), op->getName());
+      state.addOperands(operands);
+      state.addTypes(RankedTensorType::get(shape, resultType.getElementType()));
+      state.addAttributes(op->getAttrs());
+      segments.push_back(rewriter.create(state)->getResult(0));
+      start = limit;
+    }
+
+    rewriter.replaceOpWithNewOp<stablehlo::ConcatenateOp>(op, segments, *dim);
+    return success();
+  }
+
+private:
+  const HaloValues &halos;
+};
+
+// Issues every collective permute in a manual computation as soon as its
+// operand is available. XLA turns collective permutes into asynchronous
+// start/done pairs, so the work placed between the permute and its first
+// user hides the latency of the exchange.
+static void issueCollectivePermutesEarly(Operation *root) {
+  SmallVector<stablehlo::CollectivePermuteOp> perms;
+  root->walk([&](stablehlo::CollectivePermuteOp perm) {
+    if (perm->getParentOfType<sdy::ManualComputationOp>())
+      perms.push_back(perm);
+  });
+  for (auto perm : perms) {
+    Operation *def = perm.getOperand().getDefiningOp();
+    if (def && def->getBlock() == perm->getBlock())
+      perm->moveAfter(def);
+    else
+      perm->moveBefore(&perm->getBlock()->front());
+  }
+}
+
+// Whether the manual computations `first` and `second`, with `first` earlier
+// in the same block, can be fused into one at the position of `second`.
+static bool canMergeManualComputations(sdy::ManualComputationOp first,
+                                       sdy::ManualComputationOp second) {
+  if (first.getManualAxesAttr() != second.getManualAxesAttr())
+    return false;
+
+  Attribute mesh;
+  for (auto manual : {first, second}) {
+    for (auto shardings : {manual.getInShardings().getShardings(),
+                           manual.getOutShardings().getShardings()}) {
+      for (auto sharding : shardings) {
+        if (mesh && mesh != sharding.getMeshOrRef())
+          return false;
+        mesh = sharding.getMeshOrRef();
+      }
+    }
+  }
+
+  // `first` moves down to `second`, so none of its results may be used in
+  // between. This also rules out `second` depending on `first`.
+  Block *block = second->getBlock();
+  for (auto *user : first->getUsers()) {
+    auto *ancestor = block->findAncestorOpInBlock(*user);
+    if (!ancestor || !second->isBeforeInBlock(ancestor))
+      return false;
+  }
+  return true;
+}
+
+static sdy::ManualComputationOp
+mergeManualComputations(sdy::ManualComputationOp first,
+                        sdy::ManualComputationOp second) {
+  auto *context = first.getContext();
+  IRRewriter rewriter(second);
+
+  SmallVector<Value> operands = llvm::to_vector(first.getOperands());
+  llvm::append_range(operands, second.getOperands());
+  SmallVector<Type> types = llvm::to_vector(first.getResultTypes());
+  llvm::append_range(types, second.getResultTypes());
+  SmallVector<TensorShardingAttr> inShardings =
+      llvm::to_vector(first.getInShardings().getShardings());
+  llvm::append_range(inShardings, second.getInShardings().getShardings());
+  SmallVector<TensorShardingAttr> outShardings =
+      llvm::to_vector(first.getOutShardings().getShardings());
+  llvm::append_range(outShardings, second.getOutShardings().getShardings());
+
+  auto merged = sdy::ManualComputationOp::create(
+      rewriter, second.getLoc(), types, operands,
+      TensorShardingPerValueAttr::get(context, inShardings),
+      TensorShardingPerValueAttr::get(context, outShardings),
+      first.getManualAxesAttr());
+
+  Block &firstBody = first.getBody().front();
+  Block &secondBody = second.getBody().front();
+  SmallVector<Type> argTypes = llvm::to_vector(firstBody.getArgumentTypes());
+  llvm::append_range(argTypes, secondBody.getArgumentTypes());
+  SmallVector<Location> argLocs(argTypes.size(), second.getLoc());
+  Block *body = rewriter.createBlock(&merged.getBody(), merged.getBody().end(),
+                                     argTypes, argLocs);
+
+  SmallVector<Value> results;
+  unsigned argOffset = 0;
+  for (Block *src : {&firstBody, &secondBody}) {
+    auto args = body->getArguments().slice(argOffset, src->getNumArguments());
+    argOffset += src->getNumArguments();
+    auto ret = cast<sdy::ReturnOp>(src->getTerminator());
+    llvm::append_range(results, ret.getOperands());
+    rewriter.eraseOp(ret);
+    rewriter.mergeBlocks(src, body, args);
+  }
+  rewriter.setInsertionPointToEnd(body);
+  sdy::ReturnOp::create(rewriter, second.getLoc(), results);
+
+  rewriter.replaceOp(
+      first, merged.getResults().take_front(first.getNumResults()));
+  rewriter.replaceOp(
+      second, merged.getResults().take_back(second.getNumResults()));
+  return merged;
+}
+
+// Packs collective permutes of a block that send to the same neighbors into a
+// single permute of their flattened, concatenated operands. The halos of many
+// fields then travel as one message per neighbor instead of one each.
+static void packCollectivePermutes(Block *block) {
+  SmallVector<SmallVector<stablehlo::CollectivePermuteOp>> groups;
+  for (auto perm : block->getOps<stablehlo::CollectivePermuteOp>()) {
+    auto type = dyn_cast<RankedTensorType>(perm.getOperand().getType());
+    if (!type || !type.hasStaticShape())
+      continue;
+
+    // The packed permute is issued at the last member, so earlier members
+    // must not be used before it.
+    auto usedBefore = [&](stablehlo::CollectivePermuteOp member) {
+      for (auto *user : member->getUsers()) {
+        auto *ancestor = block->findAncestorOpInBlock(*user);
+        if (!ancestor || ancestor->isBeforeInBlock(perm))
+          return true;
+      }
+      return false;
+    };
+
+    auto group = llvm::find_if(groups, [&](auto &group) {
+      auto leader = group.front();
+      return leader.getSourceTargetPairs() == perm.getSourceTargetPairs() &&
+             leader.getType().getElementType() == type.getElementType() &&
+             llvm::none_of(group, usedBefore);
+    });
+    if (group == groups.end())
+      groups.push_back({perm});
+    else
+      group->push_back(perm);
+  }
+
+  for (auto &group : groups) {
+    if (group.size() < 2)
+      continue;
+    auto last = group.back();
+    auto loc = last.getLoc();
+    auto elemType = last.getType().getElementType();
+    OpBuilder builder(last);
+
+    SmallVector<Value> flat;
+    SmallVector<int64_t> sizes;
+    for (auto perm : group) {
+      sizes.push_back(perm.getType().getNumElements());
+      flat.push_back(stablehlo::ReshapeOp::create(
+          builder, loc, RankedTensorType::get({sizes.back()}, elemType),
+          perm.getOperand()));
+    }
+    auto packed = stablehlo::ConcatenateOp::create(builder, loc, flat, 0);
+    auto exchanged = stablehlo::CollectivePermuteOp::create(
+        builder, loc, packed, group.front().getSourceTargetPairs(),
+        group.front().getChannelHandleAttr());
+
+    int64_t offset = 0;
+    for (auto [perm, size] : llvm::zip(group, sizes)) {
+      auto piece = stablehlo::SliceOp::create(
+          builder, loc, exchanged.getResult(), ArrayRef<int64_t>{offset},
+          ArrayRef<int64_t>{offset + size}, ArrayRef<int64_t>{1});
+      offset += size;
+      perm.replaceAllUsesWith(stablehlo::ReshapeOp::create(
+                                  builder, loc, perm.getType(), piece)
+                                  .getResult());
+      perm.erase();
+    }
+  }
+}
+
+// Fuses independent manual computations over the same mesh axes, then packs
+// the halo exchanges of the fields they cover.
+static void packHaloExchanges(Operation *root) {
+  SmallVector<Block *> blocks;
+  root->walk([&](Block *block) {
+    if (!block->getParentOp()->getParentOfType<sdy::ManualComputationOp>() &&
+        !isa<sdy::ManualComputationOp>(block->getParentOp()))
+      blocks.push_back(block);
+  });
+  for (Block *block : blocks) {
+    sdy::ManualComputationOp prev;
+    for (auto &op : llvm::make_early_inc_range(*block)) {
+      auto manual = dyn_cast<sdy::ManualComputationOp>(&op);
+      if (!manual)
+        continue;
+      if (prev && canMergeManualComputations(prev, manual))
+        manual = mergeManualComputations(prev, manual);
+      prev = manual;
+    }
+  }
+
+  SmallVector<Block *> bodies;
+  root->walk([&](Block *block) {
+    if (block->getParentOp()->getParentOfType<sdy::ManualComputationOp>() ||
+        isa<sdy::ManualComputationOp>(block->getParentOp()))
+      bodies.push_back(block);
+  });
+  for (Block *block : bodies)
+    packCollectivePermutes(block);
+}
+
+// Bandwidth (bytes/s) and latency (s) of the links along a mesh axis.
+struct CommLink {
+  double bandwidth;
+  double latency;
+};
+
+// Parses a comma separated list of `axis=bandwidth:latency` entries, with the
+// bandwidth in GB/s and the latency in microseconds.
+static LogicalResult parseAxisLinks(StringRef spec,
+                                    llvm::StringMap<CommLink> &links) {
+  SmallVector<StringRef> entries;
+  spec.split(entries, ',', /*MaxSplit=*/-1, /*KeepEmpty=*/false);
+  for (auto entry : entries) {
+    auto [axis, params] = entry.split('=');
+    auto [bandwidthStr, latencyStr] = params.split(':');
+    double bandwidth, latency;
+    if (axis.trim().empty() || bandwidthStr.trim().getAsDouble(bandwidth) ||
+        latencyStr.trim().getAsDouble(latency) || bandwidth <= 0)
+      return failure();
+    links[axis.trim()] = CommLink{bandwidth * 1e9, latency * 1e-6};
+  }
+  return success();
+}
+
+// Analytical per-device execution time of the ops of a sharded program. Ops
+// outside of manual computations are costed on their local shard, with the
+// halo exchange the SPMD partitioner needs when they cross shard boundaries
+// along a sharded dimension. Collectives inside manual computations are
+// costed by the bytes they move over the links of the mesh axes they span.
+class CommunicationCostModel {
+public:
+  CommunicationCostModel(CommLink defaultLink,
+                         llvm::StringMap<CommLink> axisLinks, double flopRate)
+      : defaultLink(defaultLink), axisLinks(std::move(axisLinks)),
+        flopRate(flopRate) {}
+
+  double getOpTime(Operation *op) const {
+    if (op->hasTrait<OpTrait::IsTerminator>() || op->getNumResults() == 0 ||
+        isa<sdy::ManualComputationOp>(op) || matchPattern(op, m_Constant()))
+      return 0;
+    auto resultType = dyn_cast<RankedTensorType>(op->getResult(0).getType());
+    if (!resultType || !resultType.hasStaticShape())
+      return 0;
+
+    // Shards of the result per dimension, and the mesh axes they are split
+    // over. Types inside manual computations are already local.
+    int64_t rank = resultType.getRank();
+    SmallVector<int64_t> shards(rank, 1);
+    SmallVector<SmallVector<StringRef>> dimAxes(rank);
+    TensorShardingAttr sharding;
+    if (!op->getParentOfType<sdy::ManualComputationOp>())
+      sharding = mlir::sdy::getSharding(op->getResult(0));
+    if (sharding) {
+      TensorShardingAttr shardings[] = {sharding};
+      auto mesh = mlir::sdy::getCommonMesh(shardings, shardings, op);
+      for (auto [dim, dimSharding] :
+           llvm::enumerate(sharding.getDimShardings())) {
+        for (auto axis : dimSharding.getAxes()) {
+          shards[dim] *= axis.getSize(mesh);
+          dimAxes[dim].push_back(axis.getName());
+        }
+      }
+    }
+
+    double localElements = 1;
+    for (auto [size, numShards] : llvm::zip(resultType.getShape(), shards))
+      localElements *= llvm::divideCeil(size, numShards);
+    double elementBytes = getElementBytes(resultType);
+
+    // Every op touches its local result once.
+    double time = localElements / flopRate;
+
+    // Time for the partitioner to shift data by `lhs` and `rhs` rows along
+    // `dim`. It realigns the whole local shard with a collective permute
+    // for every shift that crosses a shard boundary, rather than moving
+    // only the rows that change owner.
+    auto halo = [&](int64_t dim, int64_t lhs, int64_t rhs) -> double {
+      if (shards[dim] == 1)
+        return 0;
+      int64_t messages = (lhs != 0) + (rhs != 0);
+      return transfer(messages * localElements * elementBytes, messages,
+                      getLink(dimAxes[dim]));
+    };
+
+    if (auto perm = dyn_cast<stablehlo::CollectivePermuteOp>(op))
+      return time + transfer(localElements * elementBytes, 1,
+                             getPermuteLink(perm));
+
+    if (isa<stablehlo::AllGatherOp, stablehlo::AllReduceOp,
+            stablehlo::AllToAllOp, stablehlo::ReduceScatterOp>(op)) {
+      int64_t groupSize = 1;
+      if (auto groups = op->getAttrOfType<DenseIntElementsAttr>(
+              "replica_groups")) {
+        auto groupsType = cast<RankedTensorType>(groups.getType());
+        if (groupsType.getRank() == 2)
+          groupSize = groupsType.getDimSize(1);
+      }
+      return time + transfer(localElements * elementBytes,
+                             std::max<int64_t>(groupSize - 1, 0), defaultLink);
+    }
+
+    if (!sharding)
+      return time;
+
+    return time +
+           llvm::TypeSwitch<Operation *, double>(op)
+               .Case([&](enzymexla::RotateOp rotate) {
+                 int64_t size = resultType.getDimSize(rotate.getDimension());
+                 int64_t amount = std::min<int64_t>(rotate.getAmount(),
+                                                    size - rotate.getAmount());
+                 return halo(rotate.getDimension(), amount, 0);
+               })
+               .Case([&](enzymexla::WrapOp wrap) {
+                 return halo(wrap.getDimension(), wrap.getLhs(),
+                             wrap.getRhs());
+               })
+               .Case([&](enzymexla::ExtendOp extend) {
+                 return halo(extend.getDimension(), extend.getLhs(),
+                             extend.getRhs());
+               })
+               .Case([&](stablehlo::PadOp pad) {
+                 double total = 0;
+                 for (int64_t dim = 0; dim < rank; dim++)
+                   total += halo(dim, pad.getEdgePaddingLow()[dim],
+                                 pad.getEdgePaddingHigh()[dim]);
+                 return total;
+               })
+               .Case([&](stablehlo::SliceOp slice) {
+                 auto operandShape = slice.getOperand().getType().getShape();
+                 double total = 0;
+                 for (int64_t dim = 0; dim < rank; dim++)
+                   total += halo(dim, slice.getStartIndices()[dim],
+                                 operandShape[dim] -
+                                     slice.getLimitIndices()[dim]);
+                 return total;
+               })
+               .Case([&](stablehlo::ConcatenateOp concat) {
+                 // Every operand but the largest one is moved to the shards
+                 // it ends up on.
+                 int64_t dim = concat.getDimension();
+                 SmallVector<int64_t> sizes;
+                 for (auto operand : concat.getOperands())
+                   sizes.push_back(cast<RankedTensorType>(operand.getType())
+                                       .getDimSize(dim));
+                 llvm::sort(sizes);
+                 double total = 0;
+                 for (auto size : ArrayRef<int64_t>(sizes).drop_back())
+                   total += halo(dim, size, 0);
+                 return total;
+               })
+               .Case([&](stablehlo::DynamicUpdateSliceOp dus) {
+                 // The update is scattered to the shards it overlaps.
+                 auto updateShape = dus.getUpdate().getType().getShape();
+                 double total = 0;
+                 for (int64_t dim = 0; dim < rank; dim++)
+                   if (updateShape[dim] != resultType.getDimSize(dim))
+                     total += halo(dim, updateShape[dim], 0);
+                 return total;
+               })
+               .Case([&](stablehlo::CustomCallOp call) {
+                 return getSPMDCustomCallTime(call, halo);
+               })
+               .Default([](Operation *) { return 0.0; });
+  }
+
+private:
+  static double getElementBytes(RankedTensorType type) {
+    Type elemType = type.getElementType();
+    double components = 1;
+    if (auto complexType = dyn_cast<ComplexType>(elemType)) {
+      elemType = complexType.getElementType();
+      components = 2;
+    }
+    if (!elemType.isIntOrFloat())
+      return 4 * components;
+    return components * std::max(elemType.getIntOrFloatBitWidth(), 8u) / 8;
+  }
+
+  double transfer(double bytes, double messages, CommLink link) const {
+    return messages * link.latency + bytes / link.bandwidth;
+  }
+
+  // The slowest link among `axes`.
+  CommLink getLink(ArrayRef<StringRef> axes) const {
+    std::optional<CommLink> slowest;
+    for (auto axis : axes) {
+      auto found = axisLinks.find(axis);
+      CommLink link =
+          found == axisLinks.end() ? defaultLink : found->getValue();
+      if (!slowest || link.bandwidth < slowest->bandwidth)
+        slowest = link;
+    }
+    return slowest.value_or(defaultLink);
+  }
+
+  // The slowest link a collective permute crosses, over the mesh axes
+  // between the device coordinates of each of its source/target pairs.
+  CommLink getPermuteLink(stablehlo::CollectivePermuteOp perm) const {
+    auto manual = perm->getParentOfType<sdy::ManualComputationOp>();
+    if (!manual)
+      return defaultLink;
+    auto inShardings = manual.getInShardings().getShardings();
+    auto outShardings = manual.getOutShardings().getShardings();
+    if (inShardings.empty() && outShardings.empty())
+      return defaultLink;
+    auto mesh = mlir::sdy::getCommonMesh(inShardings, outShardings, manual);
+    if (!mesh)
+      return defaultLink;
+    auto pairs = perm.getSourceTargetPairs().getValues<int64_t>();
+    std::optional<CommLink> slowest;
+    for (size_t i = 0; i + 1 < pairs.size(); i += 2) {
+      int64_t source = pairs[i], target = pairs[i + 1];
+      SmallVector<StringRef> crossed;
+      for (auto axis : llvm::reverse(mesh.getAxes())) {
+        if (source % axis.getSize() != target % axis.getSize())
+          crossed.push_back(axis.getName());
+        source /= axis.getSize();
+        target /= axis.getSize();
+      }
+      CommLink link = getLink(crossed);
+      if (!slowest || link.bandwidth < slowest->bandwidth)
+        slowest = link;
+    }
+    return slowest.value_or(defaultLink);
+  }
+
+  // Custom calls lowered by the SPMD partitioner exchange a halo along their
+  // `dimension`, described in their backend config.
+  template <typename HaloFn>
+  static double getSPMDCustomCallTime(stablehlo::CustomCallOp call,
+                                      HaloFn &halo) {
+    StringRef target = call.getCallTargetName();
+    if (!target.starts_with("_SPMD"))
+      return 0;
+    auto config = dyn_cast_or_null<StringAttr>(call.getBackendConfigAttr());
+    if (!config)
+      return 0;
+    llvm::StringMap<int64_t> values;
+    SmallVector<StringRef> entries;
+    config.getValue().split(entries, ',');
+    for (auto entry : entries) {
+      auto [key, value] = entry.split('=');
+      int64_t parsed;
+      if (!value.getAsInteger(10, parsed))
+        values[key.trim()] = parsed;
+    }
+    if (!values.contains("dimension"))
+      return 0;
+    int64_t dim = values["dimension"];
+    if (target == "_SPMDInternalOp_RotateRight") {
+      int64_t size =
+          cast<RankedTensorType>(call.getResult(0).getType()).getDimSize(dim);
+      int64_t amount = values.lookup("amount");
+      return halo(dim, std::min(amount, size - amount), 0);
+    }
+    if (target == "_SPMDEnzymeInternalOp_MultiRotate")
+      return halo(dim, values.lookup("left_amount"),
+                  values.lookup("right_amount"));
+    return 0;
+  }
+
+  CommLink defaultLink;
+  llvm::StringMap<CommLink> axisLinks;
+  double flopRate;
+};
+
+// Rewriter that applies a pattern tentatively. Replacements and erasures of
+// existing ops are dropped, so the IR it creates is dead and can be costed
+// and removed again without touching the rest of the program.
+class TrialRewriter final : public PatternRewriter,
+                            public RewriterBase::Listener {
+public:
+  explicit TrialRewriter(MLIRContext *context) : PatternRewriter(context) {
+    setListener(this);
+  }
+
+  ~TrialRewriter() override {
+    for (auto *op : llvm::reverse(inserted)) {
+      if (!alive.contains(op))
+        continue;
+      op->dropAllUses();
+      op->erase();
+    }
+  }
+
+  void replaceOp(Operation *op, ValueRange newValues) override {
+    if (alive.contains(op))
+      PatternRewriter::replaceOp(op, newValues);
+  }
+  void replaceOp(Operation *op, Operation *newOp) override {
+    if (alive.contains(op))
+      PatternRewriter::replaceOp(op, newOp);
+  }
+  void eraseOp(Operation *op) override {
+    if (alive.contains(op))
+      PatternRewriter::eraseOp(op);
+  }
+
+  void notifyOperationInserted(Operation *op,
+                               OpBuilder::InsertPoint previous) override {
+    inserted.push_back(op);
+    alive.insert(op);
+  }
+  void notifyOperationErased(Operation *op) override { alive.erase(op); }
+
+  // Ops created by the trial that are still part of the IR.
+  SmallVector<Operation *> getCreatedOps() const {
+    SmallVector<Operation *> ops;
+    for (auto *op : inserted)
+      if (alive.contains(op))
+        ops.push_back(op);
+    return ops;
+  }
+
+private:
+  SmallVector<Operation *> inserted;
+  llvm::SmallPtrSet<Operation *, 16> alive;
+};
+
+// Chooses, per op, the cheapest of several communication strategies under a
+// CommunicationCostModel. Leaving the op to the SPMD partitioner is always a
+// candidate, so the pattern only fires when a rewrite is estimated to win.
+template <typename OpTy>
+struct CostSelectedCommOptimize : public OpRewritePattern<OpTy> {
+  CostSelectedCommOptimize(std::shared_ptr<CommunicationCostModel> model,
+                           MLIRContext *context, PatternBenefit benefit = 1)
+      : OpRewritePattern<OpTy>(context, benefit), model(std::move(model)) {}
+
+  template <typename PatternTy, typename... Args>
+  void addCandidate(Args &&...args) {
+    candidates.push_back(
+        std::make_unique<PatternTy>(std::forward<Args>(args)...));
+  }
+
+  LogicalResult matchAndRewrite(OpTy op,
+                                PatternRewriter &rewriter) const override {
+    double bestTime = model->getOpTime(op);
+    const RewritePattern *best = nullptr;
+    for (auto &candidate : candidates) {
+      std::optional<double> time = evaluate(*candidate, op);
+      LLVM_DEBUG(llvm::dbgs()
+                 << op->getName() << " " << candidate->getDebugName() << ": "
+                 << (time ? std::to_string(*time) : "no match")
+                 << " (partitioner " << bestTime << ")\n");
+      if (time && *time < bestTime) {
+        bestTime = *time;
+        best = candidate.get();
+      }
+    }
+    if (!best)
+      return rewriter.notifyMatchFailure(
+          op, "no strategy is cheaper than the SPMD partitioner");
+    return best->matchAndRewrite(op, rewriter);
+  }
+
+private:
+  std::optional<double> evaluate(const RewritePattern &pattern,
+                                 Operation *op) const {
+    TrialRewriter trial(op->getContext());
+    trial.setInsertionPoint(op);
+    if (failed(pattern.matchAndRewrite(op, trial)))
+      return std::nullopt;
+    double time = 0;
+    for (auto *created : trial.getCreatedOps())
+      time += model->getOpTime(created);
+    return time;
+  }
+
+  std::shared_ptr<CommunicationCostModel> model;
+  SmallVector<std::unique_ptr<RewritePattern>> candidates;
+};
+
 struct OptimizeCommunicationPass
     : public enzyme::impl::OptimizeCommunicationBase<
           OptimizeCommunicationPass> {
@@ -4742,30 +5543,91 @@ struct OptimizeCommunicationPass
         channel_id = std::max(channel_id, (int)attr->getHandle() + 1);
     });
 
-    if (periodic_concat > 0)
+    if (auto_select) {
+      llvm::StringMap<CommLink> links;
+      if (failed(parseAxisLinks(axis_links, links))) {
+        getOperation()->emitError()
+            << "invalid axis_links '" << axis_links
+            << "', expected axis=bandwidth:latency[,...]";
+        return signalPassFailure();
+      }
+      if (link_bandwidth <= 0 || device_flops <= 0) {
+        getOperation()->emitError()
+            << "link_bandwidth and device_flops must be positive";
+        return signalPassFailure();
+      }
+      auto model = std::make_shared<CommunicationCostModel>(
+          CommLink{link_bandwidth * 1e9, link_latency * 1e-6},
+          std::move(links), device_flops * 1e12);
+
+      auto wrap =
+          std::make_unique<CostSelectedCommOptimize<enzymexla::WrapOp>>(
+              model, context);
+      wrap->addCandidate<WrapCommOptimize>(channel_id, context);
+      wrap->addCandidate<WrapToPadCommOptimize>(context);
+      wrap->addCandidate<WrapToRotateOptimize>(context);
+      patterns.add(std::move(wrap));
+
+      auto extend =
+          std::make_unique<CostSelectedCommOptimize<enzymexla::ExtendOp>>(
+              model, context);
+      extend->addCandidate<ExtendCommOptimize>(channel_id, context);
+      extend->addCandidate<ExtendToPadCommOptimize>(context);
+      extend->addCandidate<ExtendToPadCommOptimize2>(context);
+      extend->addCandidate<ExtendDUSLike>(channel_id, context);
+      patterns.add(std::move(extend));
+
+      auto rotate =
+          std::make_unique<CostSelectedCommOptimize<enzymexla::RotateOp>>(
+              model, context);
+      rotate->addCandidate<RotateCommOptimize>(channel_id, context);
+      rotate->addCandidate<RotateSpmdOptimize>(context);
+      rotate->addCandidate<RotateToPadCommOptimize>(context);
+      patterns.add(std::move(rotate));
+
+      auto dus = std::make_unique<
+          CostSelectedCommOptimize<stablehlo::DynamicUpdateSliceOp>>(model,
+                                                                     context);
+      dus->addCandidate<DUSToPadManualCompComm>(channel_id, context);
+      dus->addCandidate<DUSToPadComm>(context);
+      patterns.add(std::move(dus));
+
+      auto concat =
+          std::make_unique<CostSelectedCommOptimize<stablehlo::ConcatenateOp>>(
+              model, context);
+      concat->addCandidate<PeriodicConcatSimplify>(channel_id, context);
+      concat->addCandidate<ConcatTwoOperandsCommOptimize>(channel_id, context);
+      concat->addCandidate<ConcatToDUSOptimize>(context);
+      concat->addCandidate<ConcatToRotatePadOptimize>(context);
+      concat->addCandidate<ConcatToPadCommOptimize>(context);
+      concat->addCandidate<ConcatTwoDUSLike>(channel_id, context);
+      patterns.add(std::move(concat));
+    }
+
+    if (!auto_select && periodic_concat > 0)
       patterns.add<PeriodicConcatSimplify>(channel_id, context,
                                            PatternBenefit(periodic_concat));
 
-    if (concat_to_pad_comm > 0)
+    if (!auto_select && concat_to_pad_comm > 0)
       patterns.add<ConcatToPadCommOptimize>(context,
                                             PatternBenefit(concat_to_pad_comm));
 
-    if (concat_to_dus > 0)
+    if (!auto_select && concat_to_dus > 0)
       patterns.add<ConcatToDUSOptimize>(context, PatternBenefit(concat_to_dus));
 
-    if (concat_to_rotatepad > 0)
+    if (!auto_select && concat_to_rotatepad > 0)
       patterns.add<ConcatToRotatePadOptimize>(
           context, PatternBenefit(concat_to_rotatepad));
 
-    if (concat_two_operands_comm > 0)
+    if (!auto_select && concat_two_operands_comm > 0)
       patterns.add<ConcatTwoOperandsCommOptimize>(
           channel_id, context, PatternBenefit(concat_two_operands_comm));
 
-    if (rotate_comm > 0)
+    if (!auto_select && rotate_comm > 0)
       patterns.add<RotateCommOptimize>(channel_id, context,
                                        PatternBenefit(rotate_comm));
 
-    if (rotate_spmd > 0)
+    if (!auto_select && rotate_spmd > 0)
       patterns.add<RotateSpmdOptimize>(context, PatternBenefit(rotate_spmd));
 
     if (multirotate_spmd > 0)
@@ -4780,31 +5642,31 @@ struct OptimizeCommunicationPass
       patterns.add<MultiSliceCustomCallOptimize>(
           context, PatternBenefit(multislice_custom_call));
 
-    if (rotate_to_pad_comm > 0)
+    if (!auto_select && rotate_to_pad_comm > 0)
       patterns.add<RotateToPadCommOptimize>(context,
                                             PatternBenefit(rotate_to_pad_comm));
 
-    if (wrap_comm > 0)
+    if (!auto_select && wrap_comm > 0)
       patterns.add<WrapCommOptimize>(channel_id, context,
                                      PatternBenefit(wrap_comm));
 
-    if (wrap_to_pad_comm > 0)
+    if (!auto_select && wrap_to_pad_comm > 0)
       patterns.add<WrapToPadCommOptimize>(context,
                                           PatternBenefit(wrap_to_pad_comm));
 
-    if (wrap_to_rotate > 0)
+    if (!auto_select && wrap_to_rotate > 0)
       patterns.add<WrapToRotateOptimize>(context,
                                          PatternBenefit(wrap_to_rotate));
 
-    if (extend_comm > 0)
+    if (!auto_select && extend_comm > 0)
       patterns.add<ExtendCommOptimize>(channel_id, context,
                                        PatternBenefit(extend_comm));
 
-    if (extend_to_pad_comm > 0)
+    if (!auto_select && extend_to_pad_comm > 0)
       patterns.add<ExtendToPadCommOptimize>(context,
                                             PatternBenefit(extend_to_pad_comm));
 
-    if (extend_to_pad_comm2 > 0)
+    if (!auto_select && extend_to_pad_comm2 > 0)
       patterns.add<ExtendToPadCommOptimize2>(
           context, PatternBenefit(extend_to_pad_comm2));
 
@@ -4812,21 +5674,28 @@ struct OptimizeCommunicationPass
       patterns.add<UpdateWithoutCornersToSelect>(
           context, PatternBenefit(updatewithoutcorners_to_select));
 
-    if (dus_to_pad_manual_comp_comm > 0)
+    if (!auto_select && dus_to_pad_manual_comp_comm > 0)
       patterns.add<DUSToPadManualCompComm>(
           channel_id, context, PatternBenefit(dus_to_pad_manual_comp_comm));
 
-    if (concat_two_dus_like > 0)
+    if (!auto_select && concat_two_dus_like > 0)
       patterns.add<ConcatTwoDUSLike>(channel_id, context,
                                      PatternBenefit(concat_two_dus_like));
 
-    if (extend_dus_like > 0)
+    if (!auto_select && extend_dus_like > 0)
       patterns.add<ExtendDUSLike>(channel_id, context,
                                   PatternBenefit(extend_dus_like));
 
-    if (dus_to_pad_comm > 0)
+    if (!auto_select && dus_to_pad_comm > 0)
       patterns.add<DUSToPadComm>(context, PatternBenefit(dus_to_pad_comm));
 
+    std::optional<HaloValues> halos;
+    if (halo_overlap > 0) {
+      halos.emplace(getOperation());
+      patterns.add<HaloSliceConcatSplit, HaloElementwiseConcatSplit>(
+          *halos, context, PatternBenefit(halo_overlap));
+    }
+
     if (reorder_associative > 0) {
       patterns.add<ReorderAssociativeOp<stablehlo::AddOp>,
                    ReorderAssociativeOp<stablehlo::MulOp>,
@@ -4839,11 +5708,19 @@ struct OptimizeCommunicationPass
     }
 
     GreedyRewriteConfig config;
+    if (halos)
+      config.setListener(&*halos);
     if (failed(applyPatternsAndFoldGreedily(getOperation(), std::move(patterns),
                                             config))) {
       signalPassFailure();
     }
 
+    if (pack_halo_exchanges)
+      packHaloExchanges(getOperation());
+
+    if (halo_overlap > 0)
+      issueCollectivePermutesEarly(getOperation());
+
     SmallVector<stablehlo::SliceOp> slices;
     getOperation()->walk([&](stablehlo::SliceOp slice) {
       bool needed = false;
@@ -16,6 +16,8 @@
 #include "mlir/Dialect/SCF/IR/SCF.h"
 #include "mlir/Dialect/SCF/Transforms/Passes.h"
 #include "mlir/Dialect/UB/IR/UBOps.h"
+#include "mlir/Dialect/Utils/StaticValueUtils.h"
+#include "mlir/Dialect/Vector/IR/VectorOps.h"
 #include "mlir/IR/Dominance.h"
 #include "mlir/IR/IRMapping.h"
 #include "mlir/IR/ImplicitLocOpBuilder.h"
@@ -2850,6 +2852,478 @@ struct LowerCacheLoad : public OpRewritePattern<enzymexla::CacheLoadOp> {
   }
 };
 
+/// Lane-uniformity analysis for mapping dimension `dim` of a barrier-free
+/// scf.parallel onto vector lanes. Values that do not depend on the lane
+/// induction variable are uniform and stay scalar, all others are varying and
+/// become vectors. Fails on anything that cannot be executed lane-wise.
+struct SIMDAnalysis {
+  scf::ParallelOp op;
+  unsigned dim;
+  Value iv;
+  bool unitStep;
+  /// Whether the trailing lanes of the last vector iteration are masked off.
+  /// Lane 0 is always active, so this only matters for ops that are executed
+  /// for every lane regardless of the mask.
+  bool tailMasked;
+  DenseSet<Value> varying;
+  unsigned contiguous = 0;
+  bool changed = false;
+  bool invalid = false;
+
+  SIMDAnalysis(scf::ParallelOp op, unsigned dim, bool tailMasked)
+      : op(op), dim(dim), iv(op.getInductionVars()[dim]),
+        unitStep(isConstantIntValue(op.getStep()[dim], 1)),
+        tailMasked(tailMasked) {}
+
+  static bool isLaneType(Type t) {
+    return isa<IntegerType, FloatType, IndexType>(t);
+  }
+
+  bool isVarying(Value v) const { return varying.contains(v); }
+
+  void markVarying(Value v) {
+    if (!isLaneType(v.getType()))
+      invalid = true;
+    if (varying.insert(v).second)
+      changed = true;
+  }
+
+  /// Whether `v` is the lane induction variable plus a uniform offset, i.e.
+  /// consecutive lanes access consecutive elements.
+  bool isContiguous(Value v) const {
+    if (!unitStep)
+      return false;
+    if (v == iv)
+      return true;
+    if (auto add = v.getDefiningOp<arith::AddIOp>()) {
+      if (!isVarying(add.getLhs()))
+        return isContiguous(add.getRhs());
+      if (!isVarying(add.getRhs()))
+        return isContiguous(add.getLhs());
+      return false;
+    }
+    if (auto sub = v.getDefiningOp<arith::SubIOp>())
+      return !isVarying(sub.getRhs()) && isContiguous(sub.getLhs());
+    return false;
+  }
+
+  /// Loads executed for inactive lanes must not fault, unless they read from
+  /// a local allocation.
+  static bool needsMaskedLoad(memref::LoadOp load, bool divergent) {
+    return divergent && !isa_and_nonnull<memref::AllocaOp, memref::AllocOp>(
+                            load.getMemref().getDefiningOp());
+  }
+
+  LogicalResult visitBlock(Block &block, bool divergent) {
+    for (auto &op : block.without_terminator())
+      if (failed(visitOp(&op, divergent)))
+        return failure();
+    return success();
+  }
+
+  LogicalResult visitOp(Operation *op, bool divergent) {
+    bool anyVarying = llvm::any_of(op->getOperands(),
+                                   [&](Value v) { return isVarying(v); });
+
+    if (auto load = dyn_cast<memref::LoadOp>(op)) {
+      auto indices = load.getIndices();
+      if (!anyVarying && !needsMaskedLoad(load, divergent))
+        return success();
+      if (isVarying(load.getMemref()) || indices.empty())
+        return failure();
+      for (auto idx : indices.drop_back())
+        if (isVarying(idx))
+          return failure();
+      if (isContiguous(indices.back()))
+        contiguous++;
+      markVarying(load.getResult());
+      return success();
+    }
+
+    if (auto store = dyn_cast<memref::StoreOp>(op)) {
+      auto indices = store.getIndices();
+      if (!anyVarying && !divergent)
+        return success();
+      // All lanes storing to the same location, or a store that may only be
+      // executed by some of the lanes, cannot be expressed lane-wise.
+      if (isVarying(store.getMemref()) || indices.empty() ||
+          !isVarying(indices.back()) ||
+          !isLaneType(store.getValue().getType()))
+        return failure();
+      for (auto idx : indices.drop_back())
+        if (isVarying(idx))
+          return failure();
+      if (isContiguous(indices.back()))
+        contiguous++;
+      return success();
+    }
+
+    if (auto ifOp = dyn_cast<scf::IfOp>(op)) {
+      bool divergentIf = divergent || isVarying(ifOp.getCondition());
+      if (failed(visitBlock(*ifOp.thenBlock(), divergentIf)))
+        return failure();
+      if (ifOp.elseBlock() &&
+          failed(visitBlock(*ifOp.elseBlock(), divergentIf)))
+        return failure();
+      for (auto [i, res] : llvm::enumerate(ifOp.getResults())) {
+        if (isVarying(ifOp.getCondition()) ||
+            isVarying(ifOp.thenYield().getOperand(i)) ||
+            isVarying(ifOp.elseYield().getOperand(i)))
+          markVarying(res);
+      }
+      return success();
+    }
+
+    if (auto forOp = dyn_cast<scf::ForOp>(op)) {
+      if (isVarying(forOp.getLowerBound()) ||
+          isVarying(forOp.getUpperBound()) || isVarying(forOp.getStep()))
+        return failure();
+      for (auto [init, arg, res, yielded] :
+           llvm::zip(forOp.getInitArgs(), forOp.getRegionIterArgs(),
+                     forOp.getResults(), forOp.getYieldedValues())) {
+        if (isVarying(init) || isVarying(yielded)) {
+          markVarying(arg);
+          markVarying(res);
+        }
+      }
+      return visitBlock(*forOp.getBody(), divergent);
+    }
+
+    if (op->getNumRegions() == 0 && isMemoryEffectFree(op)) {
+      // Division is executed for all lanes, including inactive ones, whose
+      // operands may be the zero filled in by a masked load.
+      if ((divergent || (tailMasked && anyVarying)) &&
+          isa<arith::DivSIOp, arith::DivUIOp, arith::RemSIOp, arith::RemUIOp,
+              arith::CeilDivSIOp, arith::CeilDivUIOp, arith::FloorDivSIOp>(
+              op))
+        return failure();
+      if (!anyVarying)
+        return success();
+      if (!OpTrait::hasElementwiseMappableTraits(op) ||
+          !llvm::all_of(op->getOperandTypes(), isLaneType))
+        return failure();
+      for (auto res : op->getResults())
+        markVarying(res);
+      return success();
+    }
+
+    LLVM_DEBUG(DBGS() << "cannot vectorize " << *op << "\n");
+    return failure();
+  }
+
+  LogicalResult run() {
+    markVarying(iv);
+    // Iterate to a fixpoint, loop-carried values may become varying through
+    // their yields.
+    do {
+      changed = false;
+      contiguous = 0;
+      if (failed(visitBlock(*op.getBody(), /*divergent*/ false)))
+        return failure();
+    } while (changed);
+    return failure(invalid);
+  }
+};
+
+/// Rewrites the body of a scf.parallel lane-wise according to a SIMDAnalysis.
+/// Inactive lanes are described by a mask, which is null when all lanes are
+/// active.
+struct SIMDEmitter {
+  const SIMDAnalysis &info;
+  unsigned width;
+  IRMapping mapping;
+
+  SIMDEmitter(const SIMDAnalysis &info, unsigned width)
+      : info(info), width(width) {}
+
+  VectorType getVectorType(Type t) const {
+    return VectorType::get({width}, t);
+  }
+
+  Value getScalar(Value v) const { return mapping.lookupOrDefault(v); }
+
+  Value getVector(OpBuilder &b, Value v) const {
+    if (info.isVarying(v))
+      return mapping.lookup(v);
+    return vector::BroadcastOp::create(b, v.getLoc(),
+                                       getVectorType(v.getType()),
+                                       getScalar(v));
+  }
+
+  Value getMask(OpBuilder &b, Location loc, Value mask) const {
+    if (mask)
+      return mask;
+    return arith::ConstantOp::create(
+        b, loc,
+        DenseElementsAttr::get(getVectorType(b.getI1Type()), true));
+  }
+
+  /// Returns the index accessed by the first lane of a contiguous access.
+  Value getContiguousBase(OpBuilder &b, Value v) const {
+    assert(info.isContiguous(v));
+    if (v == info.iv)
+      return v;
+    if (auto add = v.getDefiningOp<arith::AddIOp>()) {
+      if (!info.isVarying(add.getLhs()))
+        return arith::AddIOp::create(b, add.getLoc(),
+                                     getScalar(add.getLhs()),
+                                     getContiguousBase(b, add.getRhs()));
+      return arith::AddIOp::create(b, add.getLoc(),
+                                   getContiguousBase(b, add.getLhs()),
+                                   getScalar(add.getRhs()));
+    }
+    auto sub = v.getDefiningOp<arith::SubIOp>();
+    return arith::SubIOp::create(b, sub.getLoc(),
+                                 getContiguousBase(b, sub.getLhs()),
+                                 getScalar(sub.getRhs()));
+  }
+
+  bool isContiguousAccess(MemRefType type, Value idx) const {
+    return info.isVarying(idx) && info.isContiguous(idx) &&
+           type.isLastDimUnitStride();
+  }
+
+  void emitBlock(OpBuilder &b, Block &block, Value mask) {
+    for (auto &op : block.without_terminator())
+      emitOp(b, &op, mask);
+  }
+
+  void emitLoad(OpBuilder &b, memref::LoadOp load, Value mask) {
+    auto loc = load.getLoc();
+    auto vecType = getVectorType(load.getType());
+    Value zero = arith::ConstantOp::create(
+        b, loc, cast<TypedAttr>(b.getZeroAttr(vecType)));
+    SmallVector<Value> indices;
+    for (auto idx : load.getIndices().drop_back())
+      indices.push_back(getScalar(idx));
+    Value last = load.getIndices().back();
+    Value res;
+    if (isContiguousAccess(load.getMemRefType(), last)) {
+      indices.push_back(getContiguousBase(b, last));
+      if (mask)
+        res = vector::MaskedLoadOp::create(b, loc, vecType, load.getMemref(),
+                                           indices, mask, zero);
+      else
+        res = vector::LoadOp::create(b, loc, vecType, load.getMemref(),
+                                     indices);
+    } else {
+      indices.push_back(arith::ConstantIndexOp::create(b, loc, 0));
+      res = vector::GatherOp::create(b, loc, vecType, load.getMemref(),
+                                     indices, getVector(b, last),
+                                     getMask(b, loc, mask), zero);
+    }
+    mapping.map(load.getResult(), res);
+  }
+
+  void emitStore(OpBuilder &b, memref::StoreOp store, Value mask) {
+    auto loc = store.getLoc();
+    Value value = getVector(b, store.getValue());
+    SmallVector<Value> indices;
+    for (auto idx : store.getIndices().drop_back())
+      indices.push_back(getScalar(idx));
+    Value last = store.getIndices().back();
+    if (isContiguousAccess(store.getMemRefType(), last)) {
+      indices.push_back(getContiguousBase(b, last));
+      if (mask)
+        vector::MaskedStoreOp::create(b, loc, store.getMemref(), indices, mask,
+                                      value);
+      else
+        vector::StoreOp::create(b, loc, value, store.getMemref(), indices);
+    } else {
+      indices.push_back(arith::ConstantIndexOp::create(b, loc, 0));
+      vector::ScatterOp::create(b, loc, store.getMemref(), indices,
+                                getVector(b, last), getMask(b, loc, mask),
+                                value);
+    }
+  }
+
+  void emitIf(OpBuilder &b, scf::IfOp ifOp, Value mask) {
+    auto loc = ifOp.getLoc();
+    Value cond = ifOp.getCondition();
+    if (info.isVarying(cond)) {
+      // Execute both branches under complementary masks and select the
+      // results per lane.
+      Value vcond = getVector(b, cond);
+      Value notCond =
+          arith::XOrIOp::create(b, loc, vcond, getMask(b, loc, nullptr));
+      Value thenMask =
+          mask ? arith::AndIOp::create(b, loc, mask, vcond) : vcond;
+      Value elseMask =
+          mask ? arith::AndIOp::create(b, loc, mask, notCond) : notCond;
+      emitBlock(b, *ifOp.thenBlock(), thenMask);
+      if (ifOp.elseBlock())
+        emitBlock(b, *ifOp.elseBlock(), elseMask);
+      for (auto [i, res] : llvm::enumerate(ifOp.getResults())) {
+        Value tv = getVector(b, ifOp.thenYield().getOperand(i));
+        Value fv = getVector(b, ifOp.elseYield().getOperand(i));
+        mapping.map(res, arith::SelectOp::create(b, loc, vcond, tv, fv));
+      }
+      return;
+    }
+
+    SmallVector<Type> types;
+    for (auto res : ifOp.getResults())
+      types.push_back(info.isVarying(res) ? getVectorType(res.getType())
+                                          : res.getType());
+    auto newIf = scf::IfOp::create(b, loc, types, getScalar(cond),
+                                   ifOp.elseBlock() != nullptr);
+    auto emitBranch = [&](Block *src, Block *dst) {
+      OpBuilder nb = OpBuilder::atBlockEnd(dst);
+      if (dst->mightHaveTerminator())
+        nb.setInsertionPoint(dst->getTerminator());
+      emitBlock(nb, *src, mask);
+      if (types.empty())
+        return;
+      SmallVector<Value> yields;
+      for (auto [res, v] : llvm::zip(ifOp.getResults(),
+                                     src->getTerminator()->getOperands()))
+        yields.push_back(info.isVarying(res) ? getVector(nb, v)
+                                             : getScalar(v));
+      scf::YieldOp::create(nb, loc, yields);
+    };
+    emitBranch(ifOp.thenBlock(), newIf.thenBlock());
+    if (ifOp.elseBlock())
+      emitBranch(ifOp.elseBlock(), newIf.elseBlock());
+    for (auto [res, nres] : llvm::zip(ifOp.getResults(), newIf.getResults()))
+      mapping.map(res, nres);
+  }
+
+  void emitFor(OpBuilder &b, scf::ForOp forOp, Value mask) {
+    SmallVector<Value> inits;
+    for (auto [init, arg] :
+         llvm::zip(forOp.getInitArgs(), forOp.getRegionIterArgs()))
+      inits.push_back(info.isVarying(arg) ? getVector(b, init)
+                                          : getScalar(init));
+    auto newFor = scf::ForOp::create(
+        b, forOp.getLoc(), getScalar(forOp.getLowerBound()),
+        getScalar(forOp.getUpperBound()), getScalar(forOp.getStep()), inits,
+        [&](OpBuilder &nb, Location loc, Value iv, ValueRange args) {
+          mapping.map(forOp.getInductionVar(), iv);
+          mapping.map(forOp.getRegionIterArgs(), args);
+          emitBlock(nb, *forOp.getBody(), mask);
+          SmallVector<Value> yields;
+          for (auto [yielded, arg] : llvm::zip(forOp.getYieldedValues(),
+                                               forOp.getRegionIterArgs()))
+            yields.push_back(info.isVarying(arg) ? getVector(nb, yielded)
+                                                 : getScalar(yielded));
+          scf::YieldOp::create(nb, loc, yields);
+        });
+    newFor->setAttrs(forOp->getAttrs());
+    mapping.map(forOp.getResults(), newFor.getResults());
+  }
+
+  void emitOp(OpBuilder &b, Operation *op, Value mask) {
+    if (auto load = dyn_cast<memref::LoadOp>(op)) {
+      if (info.isVarying(load.getResult()))
+        return emitLoad(b, load, mask);
+    } else if (auto store = dyn_cast<memref::StoreOp>(op)) {
+      if (!store.getIndices().empty() &&
+          info.isVarying(store.getIndices().back()))
+        return emitStore(b, store, mask);
+    } else if (auto ifOp = dyn_cast<scf::IfOp>(op)) {
+      return emitIf(b, ifOp, mask);
+    } else if (auto forOp = dyn_cast<scf::ForOp>(op)) {
+      return emitFor(b, forOp, mask);
+    } else if (llvm::any_of(op->getResults(), [&](Value v) {
+                 return info.isVarying(v);
+               })) {
+      OperationState state(op->getLoc(), op->getName());
+      for (auto operand : op->getOperands())
+        state.addOperands(getVector(b, operand));
+      for (auto res : op->getResults())
+        state.addTypes(getVectorType(res.getType()));
+      state.addAttributes(op->getAttrs());
+      Operation *newOp = b.create(state);
+      mapping.map(op->getResults(), newOp->getResults());
+      return;
+    }
+    b.clone(*op, mapping);
+  }
+};
+
+/// Maps one dimension of an innermost, barrier-free scf.parallel onto the
+/// lanes of `width`-wide vectors. The dimension giving the most contiguous
+/// memory accesses is chosen, preferring later dimensions on ties. Leaves the
+/// loop untouched and fails if no dimension can be vectorized.
+static LogicalResult vectorizeThreadLoop(scf::ParallelOp op,
+                                         unsigned width) {
+  if (width < 2 || !op.getInitVals().empty())
+    return failure();
+  if (op.getBody()
+          ->walk([](Operation *nested) {
+            return isa<scf::ParallelOp, affine::AffineParallelOp,
+                       enzymexla::BarrierOp>(nested)
+                       ? WalkResult::interrupt()
+                       : WalkResult::advance();
+          })
+          .wasInterrupted())
+    return failure();
+
+  auto getTripCount = [&](unsigned dim) -> std::optional<int64_t> {
+    auto lb = getConstantIntValue(op.getLowerBound()[dim]);
+    auto ub = getConstantIntValue(op.getUpperBound()[dim]);
+    auto step = getConstantIntValue(op.getStep()[dim]);
+    if (!lb || !ub || !step || *step <= 0)
+      return std::nullopt;
+    return std::max<int64_t>(0, (*ub - *lb + *step - 1) / *step);
+  };
+
+  std::optional<SIMDAnalysis> best;
+  for (unsigned dim = 0, e = op.getNumLoops(); dim < e; dim++) {
+    auto tripCount = getTripCount(dim);
+    if (tripCount && *tripCount < width)
+      continue;
+    SIMDAnalysis info(op, dim, !tripCount || *tripCount % width != 0);
+    if (failed(info.run()))
+      continue;
+    if (!best || info.contiguous >= best->contiguous)
+      best.emplace(std::move(info));
+  }
+  if (!best)
+    return failure();
+
+  unsigned dim = best->dim;
+  Location loc = op.getLoc();
+  OpBuilder b(op);
+  Value step = op.getStep()[dim];
+  Value newStep = arith::MulIOp::create(
+      b, loc, step, arith::ConstantIndexOp::create(b, loc, width));
+
+  SIMDEmitter emitter(*best, width);
+  Block *body = op.getBody();
+  SmallVector<Operation *> oldOps;
+  for (auto &o : body->without_terminator())
+    oldOps.push_back(&o);
+
+  b.setInsertionPointToStart(body);
+  Value iv = best->iv;
+  auto indexVecType = emitter.getVectorType(b.getIndexType());
+  SmallVector<int64_t> offsets(llvm::seq<int64_t>(0, width));
+  Value lanes = arith::ConstantOp::create(
+      b, loc, DenseElementsAttr::get(indexVecType, ArrayRef(offsets)));
+  if (!isConstantIntValue(step, 1))
+    lanes = arith::MulIOp::create(
+        b, loc, lanes, vector::BroadcastOp::create(b, loc, indexVecType, step));
+  Value laneIVs = arith::AddIOp::create(
+      b, loc, vector::BroadcastOp::create(b, loc, indexVecType, iv), lanes);
+  emitter.mapping.map(iv, laneIVs);
+
+  Value mask;
+  if (best->tailMasked)
+    mask = arith::CmpIOp::create(
+        b, loc, arith::CmpIPredicate::slt, laneIVs,
+        vector::BroadcastOp::create(b, loc, indexVecType,
+                                    op.getUpperBound()[dim]));
+
+  for (auto *o : oldOps)
+    emitter.emitOp(b, o, mask);
+  for (auto *o : llvm::reverse(oldOps))
+    o->erase();
+
+  op->setOperand(op.getStep().getBeginOperandIndex() + dim, newStep);
+  return success();
+}
+
 struct SCFCPUifyPass : public enzyme::impl::SCFCPUifyBase<SCFCPUifyPass> {
   template <bool UseMinCut>
   void addPatterns(RewritePatternSet &patterns, StringRef method) {
@@ -2935,7 +3409,7 @@ struct SCFCPUifyPass : public enzyme::impl::SCFCPUifyBase<SCFCPUifyPass> {
           return;
         }
       }
-    } else if (method == "omp") {
+    } else if (method.starts_with("omp")) {
       SmallVector<enzymexla::BarrierOp> toReplace;
       getOperation()->walk(
           [&](enzymexla::BarrierOp b) { toReplace.push_back(b); });
@@ -2948,6 +3422,15 @@ struct SCFCPUifyPass : public enzyme::impl::SCFCPUifyBase<SCFCPUifyPass> {
       llvm::errs() << "unknown cpuify type: " << method << "\n";
       llvm_unreachable("unknown cpuify type");
     }
+
+    if (method.contains("simd")) {
+      // Walk is post-order, so innermost loops come first.
+      SmallVector<scf::ParallelOp> loops;
+      getOperation()->walk([&](scf::ParallelOp op) { loops.push_back(op); });
+      for (auto op : loops)
+        if (failed(vectorizeThreadLoop(op, simdWidth)))
+          LLVM_DEBUG(DBGS() << "left scalar: " << op.getLoc() << "\n");
+    }
   }
 };
 
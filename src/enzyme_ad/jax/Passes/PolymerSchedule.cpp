@@ -0,0 +1,51 @@
+//===---------------------------------------------------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===---------------------------------------------------------------------===//
+//
+// This file implements a pass rescheduling affine loop nests with the ISL
+// scheduler.
+//===---------------------------------------------------------------------===//
+
+#include "../polymer/mlir/include/mlir/Conversion/Polymer/Support/PolymerUtils.h"
+#include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/MemRef/IR/MemRef.h"
+#include "mlir/Dialect/SCF/IR/SCF.h"
+#include "src/enzyme_ad/jax/Dialect/Dialect.h"
+#include "src/enzyme_ad/jax/Dialect/Ops.h"
+#include "src/enzyme_ad/jax/Passes/Passes.h"
+#include "llvm/Support/DebugLog.h"
+
+#define DEBUG_TYPE "polymer-schedule"
+
+namespace mlir {
+namespace enzyme {
+#define GEN_PASS_DEF_POLYMERSCHEDULEPASS
+#include "src/enzyme_ad/jax/Passes/Passes.h.inc"
+} // namespace enzyme
+} // namespace mlir
+
+using namespace mlir;
+using namespace mlir::enzyme;
+
+namespace {
+struct PolymerSchedulePass
+    : public enzyme::impl::PolymerSchedulePassBase<PolymerSchedulePass> {
+  using PolymerSchedulePassBase::PolymerSchedulePassBase;
+  void runOnOperation() override {
+    SmallVector<func::FuncOp> funcs;
+    getOperation()->walk([&](func::FuncOp func) {
+      if (!func.isExternal())
+        funcs.push_back(func);
+    });
+    for (auto func : funcs) {
+      if (polymer::islexternalTransform(func, tileSize, parallelize).failed())
+        LDBG() << "Could not reschedule " << func.getName();
+    }
+  }
+};
+} // namespace
@@ -0,0 +1,328 @@
+//===- WorklistDriver.cpp - Neighborhood worklist rewrite driver ----------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements a pattern rewrite driver for the enzyme-hlo-opt pass
+// that avoids the whole-module re-scans of the greedy driver. Patterns are
+// dispatched through a PatternApplicator, which indexes them by root op, and
+// only ops whose neighborhood changed are revisited.
+//
+// Patterns are not further bucketed by operand or user shapes: the match
+// conditions of the EnzymeHLOOpt patterns live in their matchAndRewrite and
+// are not exposed as declarative predicates a driver could index on.
+//
+//===----------------------------------------------------------------------===//
+
+#include "src/enzyme_ad/jax/Passes/WorklistDriver.h"
+
+#include "mlir/IR/Matchers.h"
+#include "mlir/IR/PatternMatch.h"
+#include "mlir/Interfaces/FunctionInterfaces.h"
+#include "mlir/Interfaces/SideEffectInterfaces.h"
+#include "mlir/Rewrite/PatternApplicator.h"
+#include "mlir/Transforms/FoldUtils.h"
+#include "mlir/Transforms/RegionUtils.h"
+#include "src/enzyme_ad/jax/CheckedRewrite.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Support/Debug.h"
+
+#define DEBUG_TYPE "enzymexla-worklist-driver"
+
+using namespace mlir;
+using namespace mlir::enzyme;
+
+namespace {
+
+/// LIFO worklist with O(1) membership tests and removal.
+class Worklist {
+public:
+  void push(Operation *op) {
+    if (!indices.try_emplace(op, list.size()).second)
+      return;
+    list.push_back(op);
+  }
+
+  Operation *pop() {
+    while (!list.empty()) {
+      Operation *op = list.pop_back_val();
+      if (!op)
+        continue;
+      indices.erase(op);
+      return op;
+    }
+    return nullptr;
+  }
+
+  void remove(Operation *op) {
+    auto it = indices.find(op);
+    if (it == indices.end())
+      return;
+    list[it->second] = nullptr;
+    indices.erase(it);
+  }
+
+private:
+  SmallVector<Operation *> list;
+  DenseMap<Operation *, unsigned> indices;
+};
+
+class WorklistRewriteDriver final : public PatternRewriter,
+                                    public RewriterBase::Listener {
+public:
+  WorklistRewriteDriver(Operation *root,
+                        const FrozenRewritePatternSet &patterns,
+                        const GreedyRewriteConfig &config)
+      : PatternRewriter(root->getContext()), root(root), matcher(patterns),
+        config(config), folder(root->getContext(), this) {
+    matcher.applyDefaultCostModel();
+    setListener(this);
+  }
+
+  LogicalResult run(bool *changed, int64_t *sweeps);
+
+private:
+  /// Enqueues every op nested under the root in traversal order and returns
+  /// the number of ops enqueued.
+  int64_t seed();
+
+  /// Processes the worklist until it is empty or the rewrite budget is spent.
+  /// Returns true if the IR changed.
+  bool processWorklist();
+
+  /// Folds `op` through the OperationFolder, which materializes constants
+  /// uniqued and hoisted to the entry of the enclosing region.
+  LogicalResult tryFold(Operation *op);
+
+  /// Registers an existing constant with the folder. Returns true if it was
+  /// deduplicated against an earlier one and erased.
+  bool insertKnownConstant(Operation *op);
+
+  /// Whether patterns are disabled for `op` through
+  /// `enzymexla.disable_hlo_opts` on its enclosing function. Checked once
+  /// per function instead of once per pattern.
+  bool patternsDisabled(Operation *op);
+
+  void addToWorklist(Operation *op) {
+    if (op == root || !root->isProperAncestor(op))
+      return;
+    if (Region *scope = config.getScope();
+        scope && !scope->isAncestor(op->getParentRegion()))
+      return;
+    if (config.getStrictness() != GreedyRewriteStrictness::AnyOp &&
+        !strictModeFilteredOps.contains(op))
+      return;
+    worklist.push(op);
+  }
+
+  void notifyBlockInserted(Block *block, Region *previous,
+                           Region::iterator previousIt) override {
+    if (config.getListener())
+      config.getListener()->notifyBlockInserted(block, previous, previousIt);
+  }
+
+  void notifyBlockErased(Block *block) override {
+    if (config.getListener())
+      config.getListener()->notifyBlockErased(block);
+  }
+
+  void notifyOperationInserted(Operation *op,
+                               OpBuilder::InsertPoint previous) override {
+    if (config.getListener())
+      config.getListener()->notifyOperationInserted(op, previous);
+    op->walk([&](Operation *nested) {
+      if (config.getStrictness() == GreedyRewriteStrictness::ExistingAndNewOps)
+        strictModeFilteredOps.insert(nested);
+      addToWorklist(nested);
+    });
+  }
+
+  void notifyOperationModified(Operation *op) override {
+    if (config.getListener())
+      config.getListener()->notifyOperationModified(op);
+    addToWorklist(op);
+  }
+
+  void notifyOperationReplaced(Operation *op, ValueRange replacement) override {
+    if (config.getListener())
+      config.getListener()->notifyOperationReplaced(op, replacement);
+  }
+
+  void notifyOperationErased(Operation *op) override {
+    if (config.getListener())
+      config.getListener()->notifyOperationErased(op);
+    // Producers may have become dead or gained a simpler use pattern.
+    for (Value operand : op->getOperands())
+      if (Operation *def = operand.getDefiningOp())
+        addToWorklist(def);
+    worklist.remove(op);
+    disabledFuncs.erase(op);
+    strictModeFilteredOps.erase(op);
+    if (config.isConstantCSEEnabled())
+      folder.notifyRemoval(op);
+  }
+
+  void
+  notifyMatchFailure(Location loc,
+                     function_ref<void(Diagnostic &)> reasonCallback) override {
+    if (config.getListener())
+      config.getListener()->notifyMatchFailure(loc, reasonCallback);
+  }
+
+  Operation *root;
+  PatternApplicator matcher;
+  const GreedyRewriteConfig &config;
+  OperationFolder folder;
+  Worklist worklist;
+  DenseMap<Operation *, bool> disabledFuncs;
+  /// Ops that may be rewritten under a strict GreedyRewriteStrictness.
+  DenseSet<Operation *> strictModeFilteredOps;
+  int64_t numRewrites = 0;
+  int64_t maxRewrites = GreedyRewriteConfig::kNoLimit;
+  bool strictSeeded = false;
+};
+
+} // namespace
+
+bool WorklistRewriteDriver::insertKnownConstant(Operation *op) {
+  if (!config.isConstantCSEEnabled())
+    return false;
+  Attribute constValue;
+  if (!matchPattern(op, m_Constant(&constValue)))
+    return false;
+  return !folder.insertKnownConstant(op, constValue);
+}
+
+int64_t WorklistRewriteDriver::seed() {
+  SmallVector<Operation *> ops;
+  auto collect = [&](Operation *op) {
+    if (op == root)
+      return;
+    if (strictSeeded &&
+        config.getStrictness() != GreedyRewriteStrictness::AnyOp &&
+        !strictModeFilteredOps.contains(op))
+      return;
+    ops.push_back(op);
+  };
+  if (config.getUseTopDownTraversal())
+    root->walk<WalkOrder::PreOrder>(collect);
+  else
+    root->walk(collect);
+  if (!strictSeeded) {
+    strictSeeded = true;
+    if (config.getStrictness() != GreedyRewriteStrictness::AnyOp)
+      strictModeFilteredOps.insert(ops.begin(), ops.end());
+  }
+  // Constants are registered in traversal order so the first one of each
+  // value is kept, then the rest is pushed in reverse as the worklist pops
+  // from the back.
+  SmallVector<Operation *> toVisit;
+  for (Operation *op : ops)
+    if (!insertKnownConstant(op))
+      toVisit.push_back(op);
+  for (Operation *op : llvm::reverse(toVisit))
+    addToWorklist(op);
+  return toVisit.size();
+}
+
+bool WorklistRewriteDriver::patternsDisabled(Operation *op) {
+  auto func = op->getParentOfType<FunctionOpInterface>();
+  if (!func)
+    return false;
+  auto [it, inserted] = disabledFuncs.try_emplace(func.getOperation(), false);
+  if (inserted)
+    it->second = func->hasAttrOfType<UnitAttr>(kDisablePatternAttrName);
+  return it->second;
+}
+
+LogicalResult WorklistRewriteDriver::tryFold(Operation *op) {
+  if (!config.isFoldingEnabled())
+    return failure();
+  // Folding a constant only produces the same constant again, unless it is
+  // uniqued against an existing one.
+  if (op->hasTrait<OpTrait::ConstantLike>() && !config.isConstantCSEEnabled())
+    return failure();
+  return folder.tryToFold(op);
+}
+
+bool WorklistRewriteDriver::processWorklist() {
+  bool changed = false;
+  while (Operation *op = worklist.pop()) {
+    if (maxRewrites != GreedyRewriteConfig::kNoLimit &&
+        numRewrites >= maxRewrites)
+      break;
+
+    if (isOpTriviallyDead(op)) {
+      eraseOp(op);
+      changed = true;
+      continue;
+    }
+
+    if (succeeded(tryFold(op))) {
+      numRewrites++;
+      changed = true;
+      continue;
+    }
+
+    if (patternsDisabled(op))
+      continue;
+
+    setInsertionPoint(op);
+    if (succeeded(matcher.matchAndRewrite(op, *this))) {
+      LLVM_DEBUG(llvm::dbgs() << "rewrote op #" << numRewrites << "\n");
+      numRewrites++;
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+LogicalResult WorklistRewriteDriver::run(bool *changed, int64_t *sweeps) {
+  int64_t maxSweeps = config.getMaxIterations();
+  bool anyChange = false;
+  bool converged = false;
+  int64_t numSweeps = 0;
+
+  while (maxSweeps == GreedyRewriteConfig::kNoLimit || numSweeps < maxSweeps) {
+    numSweeps++;
+    int64_t numOps = seed();
+    if (maxSweeps != GreedyRewriteConfig::kNoLimit)
+      maxRewrites = numRewrites + maxSweeps * std::max<int64_t>(numOps, 1);
+
+    anyChange |= processWorklist();
+    if (maxRewrites != GreedyRewriteConfig::kNoLimit &&
+        numRewrites >= maxRewrites)
+      break;
+
+    // Region simplification can expose new opportunities anywhere, so only
+    // in that case is another full sweep needed.
+    auto level = config.getRegionSimplificationLevel();
+    MutableArrayRef<Region> regions =
+        config.getScope() ? MutableArrayRef<Region>(*config.getScope())
+                          : root->getRegions();
+    if (level == GreedySimplifyRegionLevel::Disabled ||
+        failed(simplifyRegions(
+            *this, regions,
+            /*mergeBlocks=*/level == GreedySimplifyRegionLevel::Aggressive))) {
+      converged = true;
+      break;
+    }
+    anyChange = true;
+  }
+
+  if (changed)
+    *changed = anyChange;
+  if (sweeps)
+    *sweeps = numSweeps;
+  return success(converged);
+}
+
+LogicalResult mlir::enzyme::applyPatternsWithWorklist(
+    Operation *op, const FrozenRewritePatternSet &patterns,
+    GreedyRewriteConfig config, bool *changed, int64_t *sweeps) {
+  WorklistRewriteDriver driver(op, patterns, config);
+  return driver.run(changed, sweeps);
+}
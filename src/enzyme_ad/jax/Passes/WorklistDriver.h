@@ -0,0 +1,35 @@
+//===- WorklistDriver.h - Neighborhood worklist rewrite driver -*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include "mlir/Rewrite/FrozenRewritePatternSet.h"
+#include "mlir/Transforms/GreedyPatternRewriteDriver.h"
+
+namespace mlir {
+namespace enzyme {
+
+/// Applies `patterns` to the ops nested under `op` until a fixpoint is
+/// reached. Unlike the greedy driver, the module is only swept once: after a
+/// rewrite, only the neighborhood of the changed ops (new ops, users of
+/// replaced values and producers of erased operands) is re-enqueued. A full
+/// re-scan only happens when region simplification changed the IR.
+///
+/// Respects the traversal order, folding, constant CSE, region
+/// simplification, scope, strictness and listener of `config`. Its maximum
+/// iteration count bounds the number of sweeps and, scaled by the number of
+/// ops, the total number of rewrites. Returns failure if the budget was exhausted
+/// before convergence. `sweeps`, if provided, receives the number of sweeps.
+LogicalResult applyPatternsWithWorklist(Operation *op,
+                                        const FrozenRewritePatternSet &patterns,
+                                        GreedyRewriteConfig config = {},
+                                        bool *changed = nullptr,
+                                        int64_t *sweeps = nullptr);
+
+} // namespace enzyme
+} // namespace mlir
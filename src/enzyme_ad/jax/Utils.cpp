@@ -28,7 +28,10 @@
 #include "mlir/IR/IntegerSet.h"
 
 #include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/xxhash.h"
 
 #include "shardy/dialect/sdy/ir/utils.h"
 #include "stablehlo/dialect/ChloOps.h"
@@ -2121,6 +2124,200 @@ bool allAccessesAreOnMainDiagonal(stablehlo::GatherOp op,
   return false; // TODO: implement this where we are doing gather with iota
 }
 
+std::string StableHash::str() const {
+  std::string result;
+  llvm::raw_string_ostream os(result);
+  os << llvm::format_hex_no_prefix(high, 16)
+     << llvm::format_hex_no_prefix(low, 16);
+  return result;
+}
+
+void StableHasher::update(uint64_t value) {
+  for (int i = 0; i < 8; i++)
+    bytes.push_back(static_cast<char>(value >> (8 * i)));
+}
+
+void StableHasher::update(llvm::StringRef data) {
+  update(data.size());
+  bytes.append(data.begin(), data.end());
+}
+
+void StableHasher::update(llvm::ArrayRef<int64_t> data) {
+  update(data.size());
+  for (auto value : data)
+    update(static_cast<uint64_t>(value));
+}
+
+StableHash StableHasher::getHash() const {
+  llvm::XXH128_hash_t hash =
+      llvm::xxh3_128bits(llvm::arrayRefFromStringRef(bytes));
+  return StableHash{hash.low64, hash.high64};
+}
+
+namespace {
+
+class StructuralHashImpl {
+public:
+  StableHash run(Operation *op) {
+    hashOperation(op);
+    return hasher.getHash();
+  }
+
+private:
+  // Tags separating the different kinds of entities in the hashed stream.
+  enum Tag : uint64_t {
+    OperationTag = 1,
+    RegionTag,
+    BlockTag,
+    OperandTag,
+    ExternalOperandTag,
+    SuccessorTag,
+    NullTag,
+  };
+
+  StableHasher hasher;
+  llvm::DenseMap<Value, uint64_t> valueIds;
+  llvm::DenseMap<Block *, uint64_t> blockIds;
+  llvm::DenseMap<Type, StableHash> typeHashes;
+  llvm::DenseMap<Attribute, StableHash> attrHashes;
+  uint64_t numExternalValues = 0;
+
+  // Types are uniqued per context and cheap to print, memoize their hash.
+  StableHash getHash(Type type) {
+    if (!type)
+      return StableHash{NullTag, NullTag};
+    auto found = typeHashes.find(type);
+    if (found != typeHashes.end())
+      return found->second;
+    std::string str;
+    llvm::raw_string_ostream os(str);
+    type.print(os);
+    StableHasher sub;
+    sub.update(os.str());
+    return typeHashes[type] = sub.getHash();
+  }
+
+  StableHash getHash(Attribute attr) {
+    if (!attr)
+      return StableHash{NullTag, NullTag};
+    auto found = attrHashes.find(attr);
+    if (found != attrHashes.end())
+      return found->second;
+
+    StableHasher sub;
+    sub.update(attr.getAbstractAttribute().getName());
+    if (auto str = dyn_cast<StringAttr>(attr)) {
+      sub.update(str.getValue());
+    } else if (auto intAttr = dyn_cast<IntegerAttr>(attr)) {
+      sub.update(getHash(intAttr.getType()));
+      hashAPInt(sub, intAttr.getValue());
+    } else if (auto floatAttr = dyn_cast<FloatAttr>(attr)) {
+      sub.update(getHash(floatAttr.getType()));
+      hashAPInt(sub, floatAttr.getValue().bitcastToAPInt());
+    } else if (auto dense = dyn_cast<DenseIntOrFPElementsAttr>(attr)) {
+      // Avoid printing large constants, hash their raw storage instead.
+      sub.update(getHash(dense.getType()));
+      sub.update(static_cast<uint64_t>(dense.isSplat()));
+      ArrayRef<char> raw = dense.getRawData();
+      sub.update(llvm::StringRef(raw.data(), raw.size()));
+    } else if (auto array = dyn_cast<ArrayAttr>(attr)) {
+      sub.update(array.size());
+      for (auto elem : array)
+        sub.update(getHash(elem));
+    } else if (auto dict = dyn_cast<DictionaryAttr>(attr)) {
+      sub.update(dict.size());
+      for (auto named : dict) {
+        sub.update(named.getName().getValue());
+        sub.update(getHash(named.getValue()));
+      }
+    } else if (auto typeAttr = dyn_cast<TypeAttr>(attr)) {
+      sub.update(getHash(typeAttr.getValue()));
+    } else if (auto denseArray = dyn_cast<DenseI64ArrayAttr>(attr)) {
+      sub.update(denseArray.asArrayRef());
+    } else if (isa<UnitAttr>(attr)) {
+      // Fully described by its name.
+    } else {
+      std::string str;
+      llvm::raw_string_ostream os(str);
+      attr.print(os);
+      sub.update(os.str());
+    }
+    return attrHashes[attr] = sub.getHash();
+  }
+
+  static void hashAPInt(StableHasher &sub, const llvm::APInt &value) {
+    sub.update(value.getBitWidth());
+    for (unsigned i = 0, e = value.getNumWords(); i < e; i++)
+      sub.update(value.getRawData()[i]);
+  }
+
+  void defineValue(Value value) {
+    valueIds.try_emplace(value, valueIds.size());
+  }
+
+  void hashOperand(Value value) {
+    auto found = valueIds.find(value);
+    if (found != valueIds.end()) {
+      hasher.update(OperandTag);
+      hasher.update(found->second);
+      return;
+    }
+    // Values defined above the hashed operation are numbered in order of
+    // first use.
+    hasher.update(ExternalOperandTag);
+    hasher.update(numExternalValues++);
+    hasher.update(getHash(value.getType()));
+    defineValue(value);
+  }
+
+  void hashOperation(Operation *op) {
+    hasher.update(OperationTag);
+    hasher.update(op->getName().getStringRef());
+    hasher.update(getHash(op->getPropertiesAsAttribute()));
+    hasher.update(getHash(op->getDiscardableAttrDictionary()));
+
+    hasher.update(op->getNumOperands());
+    for (auto operand : op->getOperands())
+      hashOperand(operand);
+
+    hasher.update(op->getNumSuccessors());
+    for (auto *succ : op->getSuccessors()) {
+      hasher.update(SuccessorTag);
+      hasher.update(blockIds.lookup(succ));
+    }
+
+    hasher.update(op->getNumResults());
+    for (auto result : op->getResults()) {
+      hasher.update(getHash(result.getType()));
+      defineValue(result);
+    }
+
+    hasher.update(op->getNumRegions());
+    for (auto &region : op->getRegions()) {
+      hasher.update(RegionTag);
+      // Number all blocks first such that forward branches are resolved.
+      for (auto &block : region)
+        blockIds.try_emplace(&block, blockIds.size());
+      for (auto &block : region) {
+        hasher.update(BlockTag);
+        hasher.update(block.getNumArguments());
+        for (auto arg : block.getArguments()) {
+          hasher.update(getHash(arg.getType()));
+          defineValue(arg);
+        }
+        for (auto &nested : block)
+          hashOperation(&nested);
+      }
+    }
+  }
+};
+
+} // namespace
+
+StableHash computeStructuralHash(Operation *op) {
+  return StructuralHashImpl().run(op);
+}
+
 } // namespace enzyme
 
 namespace stablehlo {
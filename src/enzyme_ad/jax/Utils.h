@@ -329,6 +329,9 @@ bool getEffectsAfter(
     llvm::SmallVectorImpl<mlir::MemoryEffects::EffectInstance> &effects,
     bool stopAtBarrier);
 
+mlir::Value getBase(mlir::Value v);
+bool isStackAlloca(mlir::Value v);
+
 bool mayReadFrom(mlir::Operation *, mlir::Value);
 bool mayWriteTo(mlir::Operation *, mlir::Value, bool ignoreBarrier = false);
 
@@ -1167,6 +1170,45 @@ bool allAccessesAreOnMainDiagonal(
 bool allAccessesAreOnMainDiagonal(
     stablehlo::GatherOp op, llvm::SetVector<mlir::Operation *> &opsToReplace);
 
+// 128-bit hash whose value only depends on the hashed content, and in
+// particular not on pointer values, the MLIRContext or the process.
+struct StableHash {
+  uint64_t low = 0;
+  uint64_t high = 0;
+
+  bool operator==(const StableHash &other) const {
+    return low == other.low && high == other.high;
+  }
+  bool operator!=(const StableHash &other) const { return !(*this == other); }
+
+  // Hexadecimal representation, suitable as a map or file name key.
+  std::string str() const;
+};
+
+// Accumulates a little-endian byte stream and digests it with the 128-bit
+// XXH3 hash, so that no part of the input is narrowed to 64 bits first.
+class StableHasher {
+public:
+  void update(uint64_t value);
+  void update(llvm::StringRef data);
+  void update(llvm::ArrayRef<int64_t> data);
+  void update(const StableHash &hash) {
+    update(hash.low);
+    update(hash.high);
+  }
+  StableHash getHash() const;
+
+private:
+  std::string bytes;
+};
+
+// Computes a structural hash of `op` and everything nested in it. Locations
+// and SSA value names are ignored, values are identified by the order in which
+// they are defined, and types and attributes are hashed by content so that the
+// result is stable across contexts. Structurally equivalent operations hash to
+// the same value without printing them.
+StableHash computeStructuralHash(mlir::Operation *op);
+
 } // namespace enzyme
 
 namespace stablehlo {
@@ -17,7 +17,14 @@
 
 #include "absl/status/statusor.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/ThreadPool.h"
 
+#include <functional>
+#include <mutex>
+
+#include "mlir/Bytecode/BytecodeReader.h"
+#include "mlir/Bytecode/BytecodeWriter.h"
 #include "mlir/Conversion/ConvertToLLVM/ToLLVMPass.h"
 #include "mlir/Dialect/Arith/IR/Arith.h"
 #include "mlir/Dialect/Complex/IR/Complex.h"
@@ -128,28 +135,109 @@ void run_pass_pipeline(mlir::Operation *mod, const std::string &pass_pipeline) {
   }
 }
 
+namespace {
+
+// MLIRContexts with all dialects loaded are expensive to create, so
+// run_pass_pipeline leases them from this pool. All pooled contexts share one
+// thread pool. A context is retired after a fixed number of uses as uniqued
+// attributes (e.g. large constants) are never freed by a context.
+class MLIRContextPool {
+public:
+  using Handle = std::unique_ptr<mlir::MLIRContext,
+                                 std::function<void(mlir::MLIRContext *)>>;
+
+  static MLIRContextPool &get() {
+    // Leaked on purpose, contexts may still be in use during static
+    // destruction.
+    static auto *pool = new MLIRContextPool();
+    return *pool;
+  }
+
+  Handle acquire() {
+    std::unique_ptr<mlir::MLIRContext> context;
+    unsigned uses = 0;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!idle.empty()) {
+        context = std::move(idle.back().context);
+        uses = idle.back().uses;
+        idle.pop_back();
+      }
+    }
+    if (!context) {
+      context = std::make_unique<mlir::MLIRContext>(
+          registry, mlir::MLIRContext::Threading::DISABLED);
+      context->setThreadPool(threadPool);
+      mlir::enzyme::loadAllRegisteredDialects(*context);
+    }
+    return Handle(context.release(), [this, uses](mlir::MLIRContext *context) {
+      release(std::unique_ptr<mlir::MLIRContext>(context), uses + 1);
+    });
+  }
+
+private:
+  static constexpr unsigned kMaxUses = 64;
+  static constexpr size_t kMaxIdle = 8;
+
+  struct Entry {
+    std::unique_ptr<mlir::MLIRContext> context;
+    unsigned uses;
+  };
+
+  llvm::DefaultThreadPool threadPool;
+  mlir::DialectRegistry registry;
+  std::mutex mutex;
+  std::vector<Entry> idle;
+
+  MLIRContextPool() {
+    mlir::enzyme::prepareRegistry(registry);
+    mlir::enzyme::registerDialects(registry);
+    mlir::enzyme::registerInterfaces(registry);
+  }
+
+  void release(std::unique_ptr<mlir::MLIRContext> context, unsigned uses) {
+    if (uses >= kMaxUses)
+      return;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (idle.size() < kMaxIdle)
+      idle.push_back(Entry{std::move(context), uses});
+  }
+};
+
+// Parses `input`, which may be textual MLIR or MLIR bytecode, runs
+// `pass_pipeline` on it and renames symbols clashing with `oldsym_vec`.
+// Returns the (possibly renamed) entry function and the resulting module,
+// serialized as bytecode if `emitBytecode` is set and as text otherwise.
+// `nulTerminated` states that `input` is followed by a NUL byte, which lets
+// text be parsed in place.
 std::pair<std::string, std::string>
-run_pass_pipeline(const std::vector<std::string> &oldsym_vec,
-                  const std::string &mlir, const std::string &pass_pipeline) {
+run_pass_pipeline_impl(const std::vector<std::string> &oldsym_vec,
+                       llvm::StringRef input, const std::string &pass_pipeline,
+                       bool emitBytecode, bool nulTerminated) {
   using namespace llvm;
   using namespace mlir;
 
   std::set<std::string> oldsyms(oldsym_vec.begin(), oldsym_vec.end());
 
-  // Parse MLIR.
-  mlir::DialectRegistry registry;
-  mlir::enzyme::prepareRegistry(registry);
-  mlir::enzyme::registerDialects(registry);
-  mlir::enzyme::registerInterfaces(registry);
-  MLIRContext context(registry);
-  mlir::ParserConfig parser_config(&context);
+  auto context = MLIRContextPool::get().acquire();
+
+  // Parse MLIR. Bytecode is copied to get a suitably aligned buffer. Text is
+  // parsed in place when NUL-terminated, as the lexer reads the terminator,
+  // and copied otherwise.
+  auto buffer = !nulTerminated ||
+                        mlir::isBytecode(MemoryBufferRef(input, "<input>"))
+                    ? MemoryBuffer::getMemBufferCopy(input, "<input>")
+                    : MemoryBuffer::getMemBuffer(input, "<input>");
+  llvm::SourceMgr sourceMgr;
+  sourceMgr.AddNewSourceBuffer(std::move(buffer), llvm::SMLoc());
+  mlir::ParserConfig parser_config(context.get());
   mlir::OwningOpRef<mlir::ModuleOp> parsed_module =
-      mlir::parseSourceString<mlir::ModuleOp>(mlir, parser_config);
+      mlir::parseSourceFile<mlir::ModuleOp>(sourceMgr, parser_config);
   if (!parsed_module) {
     throw nanobind::value_error("Failed to parse module");
   }
 
-  mlir::PassManager pm(&context);
+  mlir::PassManager pm(context.get());
 
   std::string error_message;
   llvm::raw_string_ostream error_stream(error_message);
@@ -160,10 +248,10 @@ run_pass_pipeline(const std::vector<std::string> &oldsym_vec,
     throw nanobind::value_error(error_message.c_str());
   }
 
-  DiagnosticEngine &engine = context.getDiagEngine();
   error_stream << "Pipeline failed:\n";
-  DiagnosticEngine::HandlerID id =
-      engine.registerHandler([&](Diagnostic &diag) -> LogicalResult {
+  // Scoped since the context outlives this call.
+  ScopedDiagnosticHandler handler(
+      context.get(), [&](Diagnostic &diag) -> LogicalResult {
         error_stream << diag << "\n";
         return failure();
       });
@@ -199,12 +287,36 @@ run_pass_pipeline(const std::vector<std::string> &oldsym_vec,
 
   std::string output;
   llvm::raw_string_ostream ss(output);
-  parsed_module->getOperation()->print(
-      ss, mlir::OpPrintingFlags().enableDebugInfo());
+  if (emitBytecode) {
+    if (failed(mlir::writeBytecodeToFile(parsed_module->getOperation(), ss)))
+      throw nanobind::value_error("failed to write bytecode");
+  } else {
+    parsed_module->getOperation()->print(
+        ss, mlir::OpPrintingFlags().enableDebugInfo());
+  }
 
   return std::make_pair(entryfn.str(), ss.str());
 }
 
+} // namespace
+
+std::pair<std::string, std::string>
+run_pass_pipeline(const std::vector<std::string> &oldsym_vec,
+                  const std::string &mlir, const std::string &pass_pipeline) {
+  return run_pass_pipeline_impl(oldsym_vec, mlir, pass_pipeline,
+                                /*emitBytecode=*/false,
+                                /*nulTerminated=*/true);
+}
+
+std::pair<std::string, std::string>
+run_pass_pipeline_bytecode(const std::vector<std::string> &oldsym_vec,
+                           llvm::StringRef mlir,
+                           const std::string &pass_pipeline) {
+  return run_pass_pipeline_impl(oldsym_vec, mlir, pass_pipeline,
+                                /*emitBytecode=*/true,
+                                /*nulTerminated=*/false);
+}
+
 absl::StatusOr<std::unique_ptr<xla::Executable>>
 BuildExecutable(xla::Service *self, const xla::HloModuleProto &module_proto,
                 std::unique_ptr<xla::HloModuleConfig> module_config,
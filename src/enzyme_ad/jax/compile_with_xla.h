@@ -15,6 +15,13 @@ std::pair<std::string, std::string>
 run_pass_pipeline(const std::vector<std::string> &oldsyms,
                   const std::string &mlir, const std::string &pass_pipeline);
 
+// Same as above, but returns the resulting module as MLIR bytecode. `mlir` may
+// be given either as bytecode or as text.
+std::pair<std::string, std::string>
+run_pass_pipeline_bytecode(const std::vector<std::string> &oldsyms,
+                           llvm::StringRef mlir,
+                           const std::string &pass_pipeline);
+
 namespace mlir {
 class Operation;
 }
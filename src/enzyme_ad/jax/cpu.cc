@@ -1,6 +1,16 @@
+#include "llvm/ADT/SmallVector.h"
+#include "xla/ffi/api/c_api.h"
+#include "xla/ffi/api/ffi.h"
+#include "xla/ffi/ffi_api.h"
 #include "xla/service/custom_call_status.h"
 #include "xla/service/custom_call_target_registry.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
 #include <cstring>
+#include <memory>
+#include <mutex>
 
 #if (defined(_WIN32) || defined(__CYGWIN__)) &&                                \
     !defined(MLIR_CAPI_ENABLE_WINDOWS_DLL_DECLSPEC)
@@ -44,10 +54,190 @@ void forwarding_custom_call(void *out, const void **in, const void *opaque_ptr,
   }
 }
 
+// Intra-op thread pool of the XLA execution running the current kernel. It is
+// only set on the thread that entered the kernel through the FFI handler, so
+// loops nested in a parallel region, and kernels called through the legacy
+// custom call, run inline.
+struct IntraOpThreadPool {
+  const XLA_FFI_Api *api;
+  XLA_FFI_ExecutionContext *ctx;
+  int64_t numThreads;
+};
+
+static thread_local const IntraOpThreadPool *currentThreadPool = nullptr;
+
+// Iterations [0, n) split into chunks that the calling thread and the pool
+// workers claim from a shared counter. Workers that start late find no chunk
+// left, so the caller never waits on a worker that XLA has not scheduled yet.
+struct ParallelForState {
+  void (*body)(void *, int64_t, int64_t);
+  void *data;
+  int64_t n;
+  int64_t chunkSize;
+  int64_t numChunks;
+  std::atomic<int64_t> nextChunk{0};
+  std::atomic<int64_t> doneChunks{0};
+  std::mutex mutex;
+  std::condition_variable finished;
+
+  void runChunks() {
+    int64_t done = 0;
+    for (int64_t chunk; (chunk = nextChunk.fetch_add(1)) < numChunks; done++) {
+      int64_t begin = chunk * chunkSize;
+      body(data, begin, std::min(n, begin + chunkSize));
+    }
+    if (done && doneChunks.fetch_add(done) + done == numChunks) {
+      std::lock_guard<std::mutex> lock(mutex);
+      finished.notify_all();
+    }
+  }
+};
+
+static void runParallelForTask(void *data) {
+  auto state = static_cast<std::shared_ptr<ParallelForState> *>(data);
+  (*state)->runChunks();
+  delete state;
+}
+
+// Runtime entry point targeted by the intra-op parallel lowering of lower-jit.
+// Calls `body(data, begin, end)` on disjoint ranges covering [0, n).
+extern "C" MLIR_CAPI_EXPORTED void
+enzymexla_parallel_for(int64_t n, void (*body)(void *, int64_t, int64_t),
+                       void *data) {
+  if (n <= 0)
+    return;
+  const IntraOpThreadPool *pool = currentThreadPool;
+  if (!pool || pool->numThreads <= 1 || n == 1) {
+    body(data, 0, n);
+    return;
+  }
+
+  // A few chunks per thread balance uneven iterations without making the
+  // shared counter contended.
+  auto state = std::make_shared<ParallelForState>();
+  state->body = body;
+  state->data = data;
+  state->n = n;
+  state->chunkSize = (n + 4 * pool->numThreads - 1) / (4 * pool->numThreads);
+  state->numChunks = (n + state->chunkSize - 1) / state->chunkSize;
+
+  int64_t numTasks = std::min(pool->numThreads, state->numChunks) - 1;
+  for (int64_t i = 0; i < numTasks; i++) {
+    auto *taskState = new std::shared_ptr<ParallelForState>(state);
+    XLA_FFI_ThreadPool_Schedule_Args args = {
+        XLA_FFI_ThreadPool_Schedule_Args_STRUCT_SIZE,
+        /*extension_start=*/nullptr, pool->ctx, runParallelForTask, taskState};
+    if (XLA_FFI_Error *err = pool->api->XLA_FFI_ThreadPool_Schedule(&args)) {
+      XLA_FFI_Error_Destroy_Args destroy_args = {
+          XLA_FFI_Error_Destroy_Args_STRUCT_SIZE,
+          /*extension_start=*/nullptr, err};
+      pool->api->XLA_FFI_Error_Destroy(&destroy_args);
+      delete taskState;
+      break;
+    }
+  }
+
+  state->runChunks();
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->finished.wait(lock, [&]() {
+    return state->doneChunks.load() == state->numChunks;
+  });
+}
+
+XLA_FFI_Error *instantiate(XLA_FFI_CallFrame *call_frame) { return nullptr; }
+
+XLA_FFI_Error *prepare(XLA_FFI_CallFrame *call_frame) { return nullptr; }
+
+XLA_FFI_Error *initialize(XLA_FFI_CallFrame *call_frame) { return nullptr; }
+
+template <bool withError>
+XLA_FFI_Error *execute(XLA_FFI_CallFrame *call_frame) {
+  // If passed a call frame with the metadata extension, just return the
+  // metadata.
+  if (call_frame->extension_start != nullptr &&
+      call_frame->extension_start->type == XLA_FFI_Extension_Metadata) {
+    auto extension = reinterpret_cast<XLA_FFI_Metadata_Extension *>(
+        call_frame->extension_start);
+    extension->metadata->api_version = XLA_FFI_Api_Version{
+        XLA_FFI_Api_Version_STRUCT_SIZE,
+        /*extension_start=*/nullptr,
+        XLA_FFI_API_MAJOR,
+        XLA_FFI_API_MINOR,
+    };
+    return nullptr;
+  }
+
+  auto *bspan =
+      reinterpret_cast<XLA_FFI_ByteSpan *>(call_frame->attrs.attrs[0]);
+  const CallInfo<withError> *cinfo =
+      reinterpret_cast<const CallInfo<withError> *>(bspan->ptr);
+
+  size_t numargs = call_frame->args.size;
+  llvm::SmallVector<const void *> ptrs(numargs);
+  for (size_t i = 0; i < numargs; i++) {
+    ptrs[i] =
+        reinterpret_cast<XLA_FFI_Buffer *>(call_frame->args.args[i])->data;
+  }
+
+  IntraOpThreadPool pool = {call_frame->api, call_frame->ctx, 1};
+  XLA_FFI_ThreadPool_NumThreads_Args num_threads_args = {
+      XLA_FFI_ThreadPool_NumThreads_Args_STRUCT_SIZE,
+      /*extension_start=*/nullptr, call_frame->ctx, &pool.numThreads};
+  if (XLA_FFI_Error *err =
+          call_frame->api->XLA_FFI_ThreadPool_NumThreads(&num_threads_args)) {
+    // No intra-op thread pool, parallel loops run on the calling thread.
+    XLA_FFI_Error_Destroy_Args destroy_args = {
+        XLA_FFI_Error_Destroy_Args_STRUCT_SIZE,
+        /*extension_start=*/nullptr, err};
+    call_frame->api->XLA_FFI_Error_Destroy(&destroy_args);
+    pool.numThreads = 1;
+  }
+
+  const IntraOpThreadPool *previous = currentThreadPool;
+  currentThreadPool = &pool;
+  char *err = nullptr;
+  if constexpr (withError) {
+    err = cinfo->run(ptrs.data());
+  } else {
+    cinfo->run(ptrs.data());
+  }
+  currentThreadPool = previous;
+
+  if (err) {
+    XLA_FFI_Error_Create_Args error_args = {
+        XLA_FFI_Error_Create_Args_STRUCT_SIZE,
+        /*extension_start=*/nullptr,
+        /*message=*/err,
+        /*errc=*/XLA_FFI_Error_Code_INTERNAL};
+    return call_frame->api->XLA_FFI_Error_Create(&error_args);
+  }
+  return nullptr;
+}
+
+extern "C" void EnzymeJaXMapSymbol(const char *name, void *symbol);
+
 extern "C" MLIR_CAPI_EXPORTED void RegisterEnzymeXLACPUHandler() {
   xla::CustomCallTargetRegistry::Global()->Register(
       "enzymexla_compile_cpu", (void *)&forwarding_custom_call<false>, "Host");
   xla::CustomCallTargetRegistry::Global()->Register(
       "enzymexla_compile_cpu_with_error", (void *)&forwarding_custom_call<true>,
       "Host");
+
+  // Typed FFI variants, which give kernels access to XLA's intra-op thread
+  // pool through enzymexla_parallel_for.
+  XLA_FFI_Handler_Bundle bundle = {instantiate, prepare, initialize,
+                                   execute<false>};
+  xla::ffi::Ffi::RegisterStaticHandler(xla::ffi::GetXlaFfiApi(),
+                                       "enzymexla_compile_cpu_ffi", "Host",
+                                       bundle,
+                                       /*XLA_FFI_Handler_Traits traits = */ 0);
+
+  XLA_FFI_Handler_Bundle bundle_with_error = {instantiate, prepare, initialize,
+                                              execute<true>};
+  xla::ffi::Ffi::RegisterStaticHandler(
+      xla::ffi::GetXlaFfiApi(), "enzymexla_compile_cpu_ffi_with_error", "Host",
+      bundle_with_error, /*XLA_FFI_Handler_Traits traits = */ 0);
+
+  EnzymeJaXMapSymbol("enzymexla_parallel_for",
+                     (void *)&enzymexla_parallel_for);
 }
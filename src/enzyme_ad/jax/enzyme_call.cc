@@ -19,6 +19,7 @@
 #include "absl/status/statusor.h"
 #include "clang_compile.h"
 #include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ExecutionEngine/Orc/CompileUtils.h"
 #include "llvm/ExecutionEngine/Orc/Core.h"
@@ -61,6 +62,7 @@
 
 #include "xla/mlir_hlo/transforms/passes.h"
 
+#include "src/enzyme_ad/jax/Utils.h"
 #include "compile_with_xla.h"
 #include "xla/hlo/ir/hlo_casting_utils.h"
 #include "xla/hlo/ir/hlo_instructions.h"
@@ -908,6 +910,46 @@ public:
     }
   }
 
+  // Stable hash of everything that determines the code generated by create,
+  // used to reuse kernels across repeated traces without recompiling them.
+  static mlir::enzyme::StableHash
+  getKernelHash(llvm::StringRef fn, llvm::StringRef source,
+                llvm::ArrayRef<llvm::SmallVector<int64_t>> out_shapes,
+                llvm::ArrayRef<std::string> out_names,
+                llvm::ArrayRef<llvm::SmallVector<int64_t>> in_shapes,
+                llvm::ArrayRef<std::string> in_names, PyObject *pyargv,
+                ABI mode, Language lang, bool xla_runtime,
+                llvm::StringRef pass_pipeline) {
+    mlir::enzyme::StableHasher hasher;
+    hasher.update(fn);
+    hasher.update(source);
+    hasher.update(out_shapes.size());
+    for (auto &&[shape, name] : llvm::zip(out_shapes, out_names)) {
+      hasher.update(shape);
+      hasher.update(name);
+    }
+    hasher.update(in_shapes.size());
+    for (auto &&[shape, name] : llvm::zip(in_shapes, in_names)) {
+      hasher.update(shape);
+      hasher.update(name);
+    }
+    assert(PySequence_Check(pyargv));
+    auto sz = PySequence_Size(pyargv);
+    hasher.update(static_cast<uint64_t>(sz));
+    for (Py_ssize_t i = 0; i < sz; ++i) {
+      PyObject *item = PySequence_GetItem(pyargv, i);
+      auto argv = PyUnicode_AsUTF8(item);
+      Py_DECREF(item);
+      assert(argv);
+      hasher.update(llvm::StringRef(argv));
+    }
+    hasher.update(static_cast<uint64_t>(mode));
+    hasher.update(static_cast<uint64_t>(lang));
+    hasher.update(static_cast<uint64_t>(xla_runtime));
+    hasher.update(pass_pipeline);
+    return hasher.getHash();
+  }
+
   static std::tuple<size_t, size_t>
   create(std::string fn, llvm::StringRef source,
          llvm::ArrayRef<llvm::SmallVector<int64_t>> out_shapes,
@@ -918,7 +960,16 @@ public:
          const std::string &platform) {
     if (platform != "cpu")
       return std::make_tuple(UNKNOWN_PLATFORM, 0);
+    std::string key =
+        getKernelHash(fn, source, out_shapes, out_names, in_shapes, in_names,
+                      pyargv, mode, lang, xla_runtime, pass_pipeline)
+            .str();
     llvm::sys::SmartScopedWriter<true> lock(kernel_mutex);
+    // The source is already text here, so a hit is confirmed against it and
+    // a hash collision recompiles instead of dispatching the wrong kernel.
+    auto found = kernel_hashes.find(key);
+    if (found != kernel_hashes.end() && kernel_sources[key] == source)
+      return found->second;
     size_t identifier = last_identifier++;
 
     auto [mod, llvm_ctx, num_out, tmpBuf] =
@@ -983,6 +1034,8 @@ public:
 
     kernels.try_emplace(
         identifier, std::make_unique<CpuKernel>(identifier, num_out, Entry));
+    kernel_hashes[key] = std::make_tuple(identifier, tmpBuf);
+    kernel_sources[key] = source.str();
     return std::make_tuple(identifier, tmpBuf);
   }
 
@@ -1005,11 +1058,15 @@ public:
 
 private:
   static llvm::DenseMap<int64_t, std::unique_ptr<CpuKernel>> kernels;
+  static llvm::StringMap<std::tuple<size_t, size_t>> kernel_hashes;
+  static llvm::StringMap<std::string> kernel_sources;
   static size_t last_identifier;
   static llvm::sys::SmartRWMutex<true> kernel_mutex;
 };
 
 llvm::DenseMap<int64_t, std::unique_ptr<CpuKernel>> CpuKernel::kernels;
+llvm::StringMap<std::tuple<size_t, size_t>> CpuKernel::kernel_hashes;
+llvm::StringMap<std::string> CpuKernel::kernel_sources;
 size_t CpuKernel::last_identifier = 1;
 llvm::sys::SmartRWMutex<true> CpuKernel::kernel_mutex;
 std::unique_ptr<llvm::DataLayout> CpuKernel::DL;
@@ -1036,6 +1093,21 @@ void Callback(void *out, void **ins, void *opaque, size_t opaque_len,
 extern "C" void RegisterEnzymeXLAGPUHandler();
 extern "C" void RegisterEnzymeXLACPUHandler();
 
+static std::vector<std::string> getStringVector(nanobind::object pyobj) {
+  auto pyargv = pyobj.ptr();
+  std::vector<std::string> strs;
+  assert(PySequence_Check(pyargv));
+  auto sz = PySequence_Size(pyargv);
+  for (Py_ssize_t i = 0; i < sz; ++i) {
+    PyObject *item = PySequence_GetItem(pyargv, i);
+    auto argv = PyUnicode_AsUTF8(item);
+    Py_DECREF(item);
+    assert(argv);
+    strs.emplace_back(argv);
+  }
+  return strs;
+}
+
 NB_MODULE(enzyme_call, m) {
   llvm::InitializeAllTargets();
   llvm::InitializeAllTargetMCs();
@@ -1239,29 +1311,30 @@ NB_MODULE(enzyme_call, m) {
   m.def("run_pass_pipeline",
         [](nanobind::object pyoldsyms, const std::string &mlir,
            const std::string &pass_pipeline) {
-          auto pyargv = pyoldsyms.ptr();
-          std::vector<std::string> oldsyms;
-          assert(PySequence_Check(pyargv));
-          auto sz = PySequence_Size(pyargv);
-          for (Py_ssize_t i = 0; i < sz; ++i) {
-            PyObject *item = PySequence_GetItem(pyargv, i);
-#if PY_VERSION_HEX < 0x03000000
-            auto argv = PyString_AsString(item);
-#else
-      auto argv = PyUnicode_AsUTF8(item);
-#endif
-            Py_DECREF(item);
-            assert(argv);
-            oldsyms.emplace_back(argv);
-#if PY_VERSION_HEX < 0x03000000
-            free(argv);
-#else
-      // should not free py3+
-#endif
-          }
+          auto oldsyms = getStringVector(pyoldsyms);
+          // Pipelines may JIT compile kernels, release the GIL such that
+          // several modules can be lowered from Python threads concurrently.
+          nanobind::gil_scoped_release release;
           return run_pass_pipeline(oldsyms, mlir, pass_pipeline);
         });
 
+  // Bytecode variant of run_pass_pipeline, which avoids printing and parsing
+  // large modules as text. Accepts bytecode or text and returns bytecode.
+  m.def("run_pass_pipeline_bytecode",
+        [](nanobind::object pyoldsyms, nanobind::bytes mlir,
+           const std::string &pass_pipeline) {
+          auto oldsyms = getStringVector(pyoldsyms);
+          llvm::StringRef input(mlir.c_str(), mlir.size());
+          std::pair<std::string, std::string> result;
+          {
+            nanobind::gil_scoped_release release;
+            result = run_pass_pipeline_bytecode(oldsyms, input, pass_pipeline);
+          }
+          return nanobind::make_tuple(
+              result.first,
+              nanobind::bytes(result.second.data(), result.second.size()));
+        });
+
   m.def("register_enzymexla_cpu_handler",
         []() { RegisterEnzymeXLACPUHandler(); });
 
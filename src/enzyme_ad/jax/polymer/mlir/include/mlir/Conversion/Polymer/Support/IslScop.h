@@ -74,6 +74,11 @@ class ScopArrayInfo;
 static constexpr char gridParallelMark[] = "grid_parallel";
 static constexpr char allocateArrayMark[] = "allocate_array";
 static constexpr char asyncWaitGroupMark[] = "async_wait_group";
+static constexpr char parallelLoopMark[] = "parallel";
+
+/// Operations carrying this attribute (scf.execute_region) are modelled as a
+/// single statement whose accesses are the union of the nested affine accesses.
+static constexpr char stmtRegionAttrName[] = "polymer.stmt.region";
 
 struct AllocateArrayMarkInfo {
   isl::union_set allocate;
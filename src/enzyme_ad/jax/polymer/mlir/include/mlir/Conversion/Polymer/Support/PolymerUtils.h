@@ -5,8 +5,12 @@
 #include "mlir/Dialect/Func/IR/FuncOps.h"
 
 namespace polymer {
-mlir::func::FuncOp islexternalTransform(mlir::func::FuncOp f,
-                                        mlir::OpBuilder &rewriter);
+/// Reschedules the affine loop nests in `f` with the ISL scheduler: loops are
+/// fused, permuted and tiled for locality (`tileSize` 0 disables tiling) and,
+/// if `parallelize` is set, outer parallel loops become scf.parallel. The
+/// function is left untouched on failure.
+mlir::LogicalResult islexternalTransform(mlir::Operation *f, unsigned tileSize,
+                                         bool parallelize);
 mlir::func::FuncOp plutoTransform(mlir::func::FuncOp f,
                                   mlir::OpBuilder &rewriter,
                                   std::string dumpClastAfterPluto,
@@ -187,7 +187,6 @@ static bool isMark(isl_id *id, StringRef mark) {
   return mark.str() == isl_id_get_name(id);
 }
 
-static constexpr char parallelLoopMark[] = "parallel";
 static isl_id *getParallelLoopMark(isl_ctx *ctx) {
   isl_id *loopMark = isl_id_alloc(ctx, parallelLoopMark, nullptr);
   return loopMark;
@@ -1279,10 +1278,13 @@ public:
     auto *Child = isl_ast_node_mark_get_node(Node);
     isl_ast_node_free(Node);
 
-    // TODO this needs to check for "permutable" instead
     if (isParallelLoopMark(Id)) {
-      assert(isl_ast_node_get_type(Child) == isl_ast_node_for);
-      createFor(Child);
+      // The band may have been reduced to a single iteration, in which case
+      // there is no loop left to parallelize.
+      if (isl_ast_node_get_type(Child) == isl_ast_node_for)
+        createParallel(Child, 1);
+      else
+        create(Child);
     } else if (isMark(Id, gridParallelMark)) {
       assert(isl_ast_node_get_type(Child) == isl_ast_node_for);
       auto nMembers = (uintptr_t)isl::manage_copy(Id).get_user();
@@ -1919,6 +1921,24 @@ std::unique_ptr<IslScop> IslScopBuilder::build(Operation *f) {
           (void)scop->addAccessRelation(stmt, kind, polymer::MemoryAccess::KILL,
                                         redirected, map, universe, domain);
       };
+      if (op->hasAttr(stmtRegionAttrName)) {
+        // Values defined in the region are private to it, only the array
+        // accesses are observable.
+        op->walk([&](Operation *nested) {
+          affine::AffineValueMap vMap;
+          if (auto loadOp = dyn_cast<affine::AffineReadOpInterface>(nested)) {
+            vMap.reset(loadOp.getAffineMap(), loadOp.getMapOperands());
+            addLoad(loadOp.getMemRef(), polymer::MemoryAccess::MT_Array, vMap);
+          } else if (auto storeOp =
+                         dyn_cast<affine::AffineWriteOpInterface>(nested)) {
+            vMap.reset(storeOp.getAffineMap(), storeOp.getMapOperands());
+            addMustStore(storeOp.getMemRef(), polymer::MemoryAccess::MT_Array,
+                         vMap);
+          }
+        });
+        continue;
+      }
+
       bool needToLoadOperands = true;
       bool needToStoreResults = true;
       auto unitMap = AffineMap::get(op->getContext());
@@ -2070,6 +2090,11 @@ void IslScopBuilder::gatherStmts(Operation *f, IRMapping &map,
       return;
     if (op == f)
       return;
+    // Operations nested in a statement region belong to that statement.
+    for (Operation *parent = op->getParentOp(); parent != f;
+         parent = parent->getParentOp())
+      if (parent->hasAttr(stmtRegionAttrName))
+        return;
     std::string calleeName = "S" + std::to_string(stmtId++) + "." +
                              op->getName().getStringRef().str();
     S.stmts.emplace_back(op, &S, calleeName.c_str());
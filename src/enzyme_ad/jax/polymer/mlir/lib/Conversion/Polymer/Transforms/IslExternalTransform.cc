@@ -1,36 +1,36 @@
 
 #include "mlir/Conversion/Polymer/Support/IslScop.h"
+#include "mlir/Conversion/Polymer/Support/PolymerUtils.h"
 #include "mlir/Conversion/Polymer/Support/ScopStmt.h"
 #include "mlir/Conversion/Polymer/Target/ISL.h"
-#include "mlir/Conversion/Polymer/Transforms/ExtractScopStmt.h"
 #include "mlir/Conversion/Polymer/Transforms/PlutoTransform.h"
 #include "mlir/IR/Verifier.h"
 
 #include "mlir/Conversion/AffineToStandard/AffineToStandard.h"
-#include "mlir/Dialect/Affine/Analysis/AffineAnalysis.h"
-#include "mlir/Dialect/Affine/Analysis/AffineStructures.h"
 #include "mlir/Dialect/Affine/IR/AffineOps.h"
-#include "mlir/Dialect/Affine/IR/AffineValueMap.h"
-#include "mlir/Dialect/Affine/Utils.h"
 #include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/SCF/IR/SCF.h"
 #include "mlir/IR/Builders.h"
 #include "mlir/IR/IRMapping.h"
-#include "mlir/IR/OpImplementation.h"
-#include "mlir/IR/PatternMatch.h"
-#include "mlir/IR/Types.h"
 #include "mlir/IR/Value.h"
-#include "mlir/Pass/Pass.h"
-#include "mlir/Pass/PassManager.h"
-#include "mlir/Transforms/DialectConversion.h"
-#include "mlir/Transforms/Passes.h"
-#include "llvm/Support/CommandLine.h"
-#include "llvm/Support/MemoryBuffer.h"
+#include "mlir/Interfaces/SideEffectInterfaces.h"
+#include "mlir/Transforms/GreedyPatternRewriteDriver.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include "polly/Support/GICHelper.h"
+#include "polly/Support/ISLTools.h"
+
+#include "isl/ctx.h"
+#include "isl/flow.h"
 #include "isl/id.h"
-#include "isl/id_to_id.h"
+#include "isl/options.h"
 #include "isl/schedule.h"
 #include "isl/schedule_node.h"
+#include "isl/space.h"
+#include "isl/union_map.h"
+#include "isl/union_set.h"
 #include "isl/val.h"
 
 using namespace mlir;
@@ -40,83 +40,373 @@ using llvm::dbgs;
 
 #define DEBUG_TYPE "islexternal-opt"
 
+/// Bound on the work done by the ISL scheduler, same as polly's default.
+static constexpr unsigned long maxScheduleOperations = 350000;
+
+/// Only plain affine loads and stores are modelled precisely inside a
+/// statement region, everything else has to be free of memory effects.
+static bool isValidStmtRegionOp(Operation *op) {
+  return isa<affine::AffineLoadOp, affine::AffineStoreOp>(op) ||
+         isMemoryEffectFree(op);
+}
+
+/// Collects the maximal runs of non-loop operations in the bodies of the
+/// affine loops in `f`. Every run becomes one statement, which keeps the SSA
+/// values flowing between its operations local to the statement. Fails if
+/// the function cannot be rescheduled and regenerated safely.
+static LogicalResult
+collectStmtRegions(Operation *f,
+                   SmallVectorImpl<SmallVector<Operation *>> &runs) {
+  if (f->getNumRegions() != 1 || !f->getRegion(0).hasOneBlock())
+    return failure();
+  Block &entry = f->getRegion(0).front();
+
+  // Top-level operations are cloned ahead of the generated loops, only
+  // allocations and pure operations can be reordered like that.
+  // Deallocations are moved behind the loops again, so they must come last.
+  bool hasLoops = false, seenFree = false;
+  for (Operation &op : entry.without_terminator()) {
+    if (isa<affine::AffineForOp, affine::AffineParallelOp>(op)) {
+      if (seenFree)
+        return failure();
+      hasLoops = true;
+    } else if (hasSingleEffect<MemoryEffects::Free>(&op)) {
+      seenFree = true;
+    } else if (!isMemoryEffectFree(&op) &&
+               !hasSingleEffect<MemoryEffects::Allocate>(&op)) {
+      LLVM_DEBUG(dbgs() << "Unsupported top-level op " << op << "\n");
+      return failure();
+    }
+  }
+  if (!hasLoops)
+    return failure();
+
+  auto isLoop = [](Operation *op) {
+    return isa<affine::AffineForOp, affine::AffineParallelOp>(op);
+  };
+  // Loop bounds and statement operands may only refer to loop induction
+  // variables and to values defined at the top level.
+  auto isInvariant = [&](Value v) {
+    if (v.getParentBlock() == &entry)
+      return true;
+    auto ba = dyn_cast<BlockArgument>(v);
+    return ba && isLoop(ba.getOwner()->getParentOp());
+  };
+
+  WalkResult res = f->walk([&](Operation *op) {
+    if (isa<affine::AffineIfOp>(op))
+      return WalkResult::interrupt();
+    if (!isLoop(op))
+      return WalkResult::advance();
+    if (op->getNumResults() != 0 ||
+        !llvm::all_of(op->getOperands(), isInvariant))
+      return WalkResult::interrupt();
+
+    Block *body = &op->getRegion(0).front();
+    SmallVector<Operation *> run;
+    auto flush = [&]() {
+      if (!run.empty())
+        runs.push_back(std::move(run));
+      run.clear();
+    };
+    for (Operation &nested : body->without_terminator()) {
+      if (isLoop(&nested)) {
+        flush();
+        continue;
+      }
+      if (!isValidStmtRegionOp(&nested))
+        return WalkResult::interrupt();
+      run.push_back(&nested);
+    }
+    flush();
+    return WalkResult::advance();
+  });
+  if (res.wasInterrupted())
+    return failure();
+
+  for (auto &run : runs) {
+    llvm::SmallPtrSet<Operation *, 8> inRun(run.begin(), run.end());
+    Block *block = run.front()->getBlock();
+    auto isLocal = [&](Value v) {
+      if (isInvariant(v))
+        return true;
+      Operation *def = v.getDefiningOp();
+      if (!def)
+        def = cast<BlockArgument>(v).getOwner()->getParentOp();
+      Operation *ancestor = block->findAncestorOpInBlock(*def);
+      return ancestor && inRun.contains(ancestor);
+    };
+    for (Operation *op : run) {
+      WalkResult res = op->walk([&](Operation *nested) {
+        if (!llvm::all_of(nested->getOperands(), isLocal))
+          return WalkResult::interrupt();
+        return WalkResult::advance();
+      });
+      if (res.wasInterrupted()) {
+        LLVM_DEBUG(dbgs() << "Value escapes its statement " << *op << "\n");
+        return failure();
+      }
+    }
+  }
+  return success();
+}
+
+static void wrapStmtRegions(ArrayRef<SmallVector<Operation *>> runs) {
+  for (auto &run : runs) {
+    OpBuilder b(run.front());
+    Location loc = run.front()->getLoc();
+    auto exec = b.create<scf::ExecuteRegionOp>(loc, TypeRange());
+    exec->setAttr(stmtRegionAttrName, b.getUnitAttr());
+    Block *body = b.createBlock(&exec.getRegion());
+    for (Operation *op : run)
+      op->moveBefore(body, body->end());
+    b.setInsertionPointToEnd(body);
+    b.create<scf::YieldOp>(loc);
+  }
+}
+
+static void inlineStmtRegions(Operation *f) {
+  SmallVector<scf::ExecuteRegionOp> regions;
+  f->walk([&](scf::ExecuteRegionOp exec) {
+    if (exec->hasAttr(stmtRegionAttrName))
+      regions.push_back(exec);
+  });
+  for (auto exec : regions) {
+    Block &body = exec.getRegion().front();
+    body.getTerminator()->erase();
+    exec->getBlock()->getOperations().splice(Block::iterator(exec),
+                                             body.getOperations());
+    exec->erase();
+  }
+}
+
+/// Computes the memory based dependences between the statements in `domain`
+/// under their original execution order.
+static __isl_give isl_union_map *computeDeps(IslScop &scop,
+                                             __isl_keep isl_union_set *domain) {
+  isl_space *space = isl_union_set_get_space(domain);
+  isl_union_map *reads = isl_union_map_empty(isl_space_copy(space));
+  isl_union_map *mustWrites = isl_union_map_empty(isl_space_copy(space));
+  isl_union_map *mayWrites = isl_union_map_empty(isl_space_copy(space));
+  isl_union_map *kills = isl_union_map_empty(space);
+
+  for (ScopStmt &stmt : scop) {
+    for (MemoryAccess *ma : stmt) {
+      isl_map *acc = isl_map_intersect_domain(
+          ma->getAccessRelation().release(), stmt.getDomain().release());
+      isl_union_map *accs = isl_union_map_intersect_domain(
+          isl_union_map_from_map(acc), isl_union_set_copy(domain));
+      if (ma->isRead())
+        reads = isl_union_map_union(reads, accs);
+      else if (ma->isMustWrite())
+        mustWrites = isl_union_map_union(mustWrites, accs);
+      else if (ma->isMayWrite())
+        mayWrites = isl_union_map_union(mayWrites, accs);
+      else
+        kills = isl_union_map_union(kills, accs);
+    }
+  }
+  isl_union_map *writes = isl_union_map_union(isl_union_map_copy(mustWrites),
+                                              isl_union_map_copy(mayWrites));
+
+  isl_schedule *schedule = isl_schedule_intersect_domain(
+      scop.getScheduleTree().release(), isl_union_set_copy(domain));
+
+  auto compute = [&](isl_union_map *sink, isl_union_map *mustSource,
+                     isl_union_map *maySource) {
+    isl_union_access_info *ai = isl_union_access_info_from_sink(sink);
+    ai = isl_union_access_info_set_must_source(ai, mustSource);
+    ai = isl_union_access_info_set_may_source(ai, maySource);
+    ai = isl_union_access_info_set_kill(ai, isl_union_map_copy(kills));
+    ai = isl_union_access_info_set_schedule(ai, isl_schedule_copy(schedule));
+    isl_union_flow *flow = isl_union_access_info_compute_flow(ai);
+    isl_union_map *deps = isl_union_flow_get_may_dependence(flow);
+    isl_union_flow_free(flow);
+    return deps;
+  };
+
+  // read-after-write
+  isl_union_map *deps =
+      compute(isl_union_map_copy(reads), isl_union_map_copy(mustWrites),
+              isl_union_map_copy(mayWrites));
+  // write-after-read
+  deps = isl_union_map_union(deps, compute(isl_union_map_copy(writes),
+                                           isl_union_map_empty(
+                                               isl_union_map_get_space(reads)),
+                                           isl_union_map_copy(reads)));
+  // write-after-write
+  deps = isl_union_map_union(deps, compute(isl_union_map_copy(writes),
+                                           isl_union_map_copy(mustWrites),
+                                           isl_union_map_copy(mayWrites)));
+
+  isl_schedule_free(schedule);
+  isl_union_map_free(reads);
+  isl_union_map_free(mustWrites);
+  isl_union_map_free(mayWrites);
+  isl_union_map_free(kills);
+  isl_union_map_free(writes);
+  return isl_union_map_coalesce(deps);
+}
+
+static __isl_give isl_schedule_node *
+tilePermutableBand(__isl_take isl_schedule_node *node, void *user) {
+  unsigned tileSize = *static_cast<unsigned *>(user);
+  if (isl_schedule_node_get_type(node) != isl_schedule_node_band)
+    return node;
+  if (isl_schedule_node_band_get_permutable(node) != isl_bool_true)
+    return node;
+  unsigned nMembers =
+      unsignedFromIslSize(isl_schedule_node_band_n_member(node));
+  // A single loop gains no locality from tiling.
+  if (nMembers < 2)
+    return node;
+  isl_ctx *ctx = isl_schedule_node_get_ctx(node);
+  isl_multi_val *sizes =
+      isl_multi_val_zero(isl_schedule_node_band_get_space(node));
+  for (unsigned i = 0; i < nMembers; i++)
+    sizes = isl_multi_val_set_val(sizes, i, isl_val_int_from_ui(ctx, tileSize));
+  return isl_schedule_node_band_tile(node, sizes);
+}
+
+/// Marks the outermost coincident band member on every path of the schedule
+/// tree as parallel, nested parallelism is left sequential.
+static __isl_give isl_schedule_node *
+insertParallelMarks(__isl_take isl_schedule_node *node) {
+  if (isl_schedule_node_get_type(node) == isl_schedule_node_band &&
+      unsignedFromIslSize(isl_schedule_node_band_n_member(node)) > 0 &&
+      isl_schedule_node_band_member_get_coincident(node, 0) == isl_bool_true) {
+    isl_ctx *ctx = isl_schedule_node_get_ctx(node);
+    return isl_schedule_node_insert_mark(
+        node, isl_id_alloc(ctx, parallelLoopMark, nullptr));
+  }
+  unsigned nChildren = unsignedFromIslSize(isl_schedule_node_n_children(node));
+  for (unsigned i = 0; i < nChildren; i++) {
+    node = isl_schedule_node_child(node, i);
+    node = insertParallelMarks(node);
+    node = isl_schedule_node_parent(node);
+  }
+  return node;
+}
+
+/// Computes a Pluto-style schedule: loops are fused and permuted to minimize
+/// dependence distances, permutable bands are tiled and outer parallel loops
+/// are marked.
+static __isl_give isl_schedule *
+computeSchedule(IslScop &scop, __isl_take isl_union_set *domain,
+                unsigned tileSize, bool parallelize) {
+  isl_ctx *ctx = scop.getIslCtx();
+  isl_union_map *deps = computeDeps(scop, domain);
+  LLVM_DEBUG(dbgs() << "Dependences: "; polly::dumpIslObj(deps));
+
+  isl_schedule_constraints *sc = isl_schedule_constraints_on_domain(domain);
+  sc = isl_schedule_constraints_set_validity(sc, isl_union_map_copy(deps));
+  sc = isl_schedule_constraints_set_coincidence(sc, isl_union_map_copy(deps));
+  sc = isl_schedule_constraints_set_proximity(sc, deps);
+
+  isl_options_set_schedule_serialize_sccs(ctx, 0);
+  isl_options_set_schedule_outer_coincidence(ctx, 1);
+  isl_options_set_schedule_maximize_band_depth(ctx, 1);
+  isl_options_set_tile_scale_tile_loops(ctx, 0);
+  isl_options_set_tile_shift_point_loops(ctx, 1);
+  isl_schedule *schedule;
+  {
+    polly::IslMaxOperationsGuard guard(ctx, maxScheduleOperations);
+    schedule = isl_schedule_constraints_compute_schedule(sc);
+  }
+  if (!schedule)
+    return nullptr;
+
+  if (tileSize > 1)
+    schedule = isl_schedule_map_schedule_node_bottom_up(
+        schedule, tilePermutableBand, &tileSize);
+
+  if (parallelize) {
+    isl_schedule_node *root = isl_schedule_get_root(schedule);
+    isl_schedule_free(schedule);
+    root = insertParallelMarks(root);
+    schedule = isl_schedule_node_get_schedule(root);
+    isl_schedule_node_free(root);
+  }
+  return schedule;
+}
+
 namespace polymer {
 
-Operation *
-islexternalTransform(Operation *f, OpBuilder &rewriter,
-                     std::optional<std::string> ClIslExternalDumpSchedules,
-                     std::optional<std::string> ClIslExternalDumpAccesses,
-                     std::optional<std::string> ClIslExternalImportSchedules) {
+LogicalResult islexternalTransform(Operation *f, unsigned tileSize,
+                                   bool parallelize) {
   LLVM_DEBUG(dbgs() << "IslExternal transforming: \n");
   LLVM_DEBUG(f->dump());
 
-  // StringRef funcName = f.getName();
-
-  // std::unique_ptr<IslScop> scop = createIslFromFuncOp(f);
-
-  // std::error_code EC;
-  // if (ClIslExternalDumpSchedules) {
-  //   std::string fname = (*ClIslExternalDumpSchedules + "/" + funcName).str();
-  //   llvm::raw_fd_ostream ScheduleOut(fname, EC);
-  //   if (EC) {
-  //     llvm::errs() << "Can't open " << fname << "\n";
-  //     abort();
-  //   }
-  //   scop->dumpSchedule(ScheduleOut);
-  // }
-  // if (ClIslExternalDumpAccesses) {
-  //   std::string fname = (*ClIslExternalDumpAccesses + "/" + funcName).str();
-  //   llvm::raw_fd_ostream AccessesOut(fname, EC);
-  //   if (EC) {
-  //     llvm::errs() << "Can't open " << fname << "\n";
-  //     abort();
-  //   }
-  //   scop->dumpAccesses(AccessesOut);
-  // }
-
-  // isl_schedule *newSchedule = nullptr;
-  // if (ClIslExternalImportSchedules) {
-  //   // Do a round trip
-  //   newSchedule = isl_schedule_copy(scop->getSchedule());
-  // } else {
-  //   std::string fname = (*ClIslExternalImportSchedules + "/" +
-  //   funcName).str(); auto ScheduleIn =
-  //   llvm::MemoryBuffer::getFileAsStream(fname); if (std::error_code EC =
-  //   ScheduleIn.getError()) {
-  //     llvm::errs() << "Can't open " << fname << "\n";
-  //     abort();
-  //   }
-  //   newSchedule =
-  //       isl_schedule_read_from_str(isl_schedule_get_ctx(scop->getSchedule()),
-  //                                  ScheduleIn->get()->getBufferStart());
-  //   if (!newSchedule) {
-  //     llvm::errs() << "Could not read valid isl schedule from " << fname
-  //                  << "\n";
-  //     abort();
-  //   }
-  // }
-  // assert(newSchedule);
-
-  // Operation *g = scop->applySchedule(newSchedule, f);
-  // assert(mlir::verify(g).succeeded());
-
-  // if (g) {
-  //   SmallVector<DictionaryAttr> argAttrs;
-  //   f->getAllArgAttrs(argAttrs);
-  //   g->setAllArgAttrs(argAttrs);
-  // }
-
-  // return g;
-
-  return nullptr;
+  SmallVector<SmallVector<Operation *>> runs;
+  if (failed(collectStmtRegions(f, runs))) {
+    LLVM_DEBUG(dbgs() << "Function is not supported by the scheduler\n");
+    return failure();
+  }
+  wrapStmtRegions(runs);
+
+  std::unique_ptr<IslScop> scop = createIslFromFuncOp(f);
+  if (!scop || scop->buildSchedule().failed()) {
+    LLVM_DEBUG(dbgs() << "Failed to build scop\n");
+    scop.reset();
+    inlineStmtRegions(f);
+    return failure();
+  }
+  LLVM_DEBUG(scop->dumpSchedule(dbgs()));
+  LLVM_DEBUG(scop->dumpAccesses(dbgs()));
+
+  // Top-level operations are not rescheduled, applySchedule clones them
+  // ahead of the generated loops.
+  Block &entry = f->getRegion(0).front();
+  isl_union_set *domain =
+      isl_union_set_empty(scop->getParamSpace().release());
+  for (ScopStmt &stmt : *scop) {
+    Operation *op = stmt.getOperation();
+    if (op->getBlock() == &entry || op->hasTrait<OpTrait::IsTerminator>())
+      continue;
+    domain = isl_union_set_add_set(domain, stmt.getDomain().release());
+  }
+
+  isl_schedule *schedule =
+      computeSchedule(*scop, domain, tileSize, parallelize);
+  if (!schedule) {
+    LLVM_DEBUG(dbgs() << "Failed to compute a schedule\n");
+    scop.reset();
+    inlineStmtRegions(f);
+    return failure();
+  }
+  LLVM_DEBUG(dbgs() << "New schedule:\n"; polly::dumpIslObj(schedule));
+
+  auto [g, oldToNew] =
+      scop->applySchedule(schedule, /*lrs=*/nullptr, f, /*integerBitWidth=*/64);
+  scop->cleanup(g);
+
+  // Deallocations were cloned in front of the loops together with the other
+  // top-level operations.
+  Operation *terminator = g->getRegion(0).front().getTerminator();
+  for (Operation &op : entry.without_terminator())
+    if (hasSingleEffect<MemoryEffects::Free>(&op))
+      oldToNew.lookup(&op)->moveBefore(terminator);
+
+  f->getRegion(0).takeBody(g->getRegion(0));
+  g->erase();
+  // Also strips the statement names from the new body.
+  scop.reset();
+  inlineStmtRegions(f);
+
+  // The statements now live in scf loops whose induction variables are not
+  // valid affine dimensions.
+  RewritePatternSet patterns(f->getContext());
+  populateAffineToStdConversionPatterns(patterns);
+  (void)applyPatternsGreedily(f, std::move(patterns));
+  assert(mlir::verify(f).succeeded());
+  return success();
 }
 
 mlir::func::FuncOp plutoTransform(mlir::func::FuncOp f,
                                   mlir::OpBuilder &rewriter,
                                   std::string dumpClastAfterPluto,
-                                  bool parallelize = false, bool debug = false,
-                                  int cloogf = -1, int cloogl = -1,
-                                  bool diamondTiling = false) {
+                                  bool parallelize, bool debug, int cloogf,
+                                  int cloogl, bool diamondTiling) {
   llvm_unreachable("not compiled with pluto support");
 }
 void registerPlutoTransformPass() {}
@@ -0,0 +1,132 @@
+import time
+
+import numpy as np
+from absl.testing import absltest
+
+BATCH_SIZES = (1000, 10000, 100000)
+MATRIX_SIZES = (4, 8, 16, 32)
+# Skip the largest stacks to keep the sweep within a few hundred MB.
+MAX_ELEMENTS = 1 << 25
+REPEATS = 5
+
+# `batched_kernel_max_size` is raised above every swept size so that the
+# unrolled kernel is always taken; the baseline is JAX's own CPU lowering,
+# which issues one LAPACK getrf call per matrix like the default CPU path of
+# `lower-enzymexla-lapack`.
+LOWER_PIPELINE = (
+    "lower-enzymexla-linalg{backend=cpu},"
+    + "lower-enzymexla-lapack{backend=cpu batched_kernel_max_size=32},"
+    + "enzyme-hlo-opt,cse,drop-unsupported-attributes"
+)
+
+
+def lu_source(batch, n):
+    ty = f"tensor<{batch}x{n}x{n}xf32>"
+    vty = f"tensor<{batch}x{n}xi32>"
+    bty = f"tensor<{batch}xi32>"
+    return f"""
+module {{
+  func.func @main(%arg0: {ty}) -> ({ty}, {vty}, {vty}, {bty}) {{
+    %0:4 = enzymexla.linalg.lu %arg0 : ({ty}) -> ({ty}, {vty}, {vty}, {bty})
+    return %0#0, %0#1, %0#2, %0#3 : {ty}, {vty}, {vty}, {bty}
+  }}
+}}
+"""
+
+
+def expected_info(lu):
+    # getrf reports the first zero on the diagonal of U, 1-indexed.
+    zero = np.diagonal(lu, axis1=-2, axis2=-1) == 0
+    return np.where(zero.any(-1), zero.argmax(-1) + 1, 0)
+
+
+def apply_pivots(pivots):
+    # Permutation obtained by applying the row swaps in order.
+    batch, n = pivots.shape
+    perm = np.tile(np.arange(n, dtype=pivots.dtype), (batch, 1))
+    rows = np.arange(batch)
+    for k in range(n):
+        p = pivots[:, k]
+        row = perm[rows, k].copy()
+        perm[rows, k] = perm[rows, p]
+        perm[rows, p] = row
+    return perm
+
+
+def best_time(fn, *args):
+    fn(*args)[0].block_until_ready()
+    times = []
+    for _ in range(REPEATS):
+        start = time.perf_counter()
+        fn(*args)[0].block_until_ready()
+        times.append(time.perf_counter() - start)
+    return min(times)
+
+
+class BatchedLU(absltest.TestCase):
+    def check_factorization(self, x, result, expected):
+        lu, pivots, perm, info = (np.asarray(r) for r in result)
+        lu_ref, pivots_ref, perm_ref = (np.asarray(r) for r in expected)
+        n = x.shape[-1]
+
+        # The kernel is 1-indexed like LAPACK, JAX is 0-indexed.
+        pivots, perm = pivots - 1, perm - 1
+        np.testing.assert_array_equal(info, expected_info(lu_ref))
+        np.testing.assert_array_equal(perm, apply_pivots(pivots))
+
+        # Every factorization satisfies P A = L U, whatever the pivots.
+        lower = np.tril(lu, -1) + np.eye(n, dtype=lu.dtype)
+        upper = np.triu(lu)
+        np.testing.assert_allclose(
+            lower @ upper,
+            np.take_along_axis(x, perm[..., None], axis=-2),
+            atol=1e-3,
+            rtol=1e-3,
+        )
+
+        # Rounding differs from LAPACK, so a near tie between two pivot
+        # candidates may rarely be broken the other way.
+        same = (pivots == pivots_ref).all(-1)
+        self.assertGreaterEqual(same.mean(), 0.999)
+        np.testing.assert_array_equal(perm[same], perm_ref[same])
+        np.testing.assert_allclose(lu[same], lu_ref[same], atol=1e-3, rtol=1e-3)
+
+    def test_sweep(self):
+        import jax
+        import jax.numpy as jnp
+        from enzyme_ad.jax import enzyme_call, hlo_call
+
+        for n in MATRIX_SIZES:
+            for batch in BATCH_SIZES:
+                if batch * n * n > MAX_ELEMENTS:
+                    continue
+                _, lowered = enzyme_call.run_pass_pipeline(
+                    [], lu_source(batch, n), LOWER_PIPELINE
+                )
+                self.assertNotIn("jit_call", lowered)
+
+                x = jax.random.normal(
+                    jax.random.PRNGKey(0), (batch, n, n), dtype=jnp.float32
+                )
+                # Some singular matrices so that info is exercised as well.
+                x = x.at[::7, :, n // 2].set(0)
+                kernel = jax.jit(lambda a, src=lowered: hlo_call(a, source=src))
+                lapack = jax.jit(jax.lax.linalg.lu)
+
+                self.check_factorization(np.asarray(x), kernel(x), lapack(x))
+
+                kernel_time = best_time(kernel, x)
+                lapack_time = best_time(lapack, x)
+                print(
+                    f"n={n} batch={batch}: kernel {kernel_time * 1e3:.2f}ms, "
+                    f"lapack {lapack_time * 1e3:.2f}ms, "
+                    f"speedup {lapack_time / kernel_time:.2f}x"
+                )
+
+
+if __name__ == "__main__":
+    from test_utils import fix_paths
+
+    fix_paths()
+
+    absltest.main()
@@ -0,0 +1,161 @@
+from absl.testing import absltest
+
+import llama
+from test_utils import CurBackends, setup_backends, splatvjp_noprim, to_backend
+
+# Reverse-mode caches of the layer loop, stored as requested through
+# `mark-cache-storage`. "full" keeps the default full-precision storage.
+STORAGES = ["full", "lossless", "bf16", "f8E4M3FN", "f8E5M2"]
+
+
+def storage_pipeline(storage):
+    from enzyme_ad.jax import JaXPipeline, full_optimization_pass_pipeline
+
+    passes = full_optimization_pass_pipeline()
+    if storage != "full":
+        passes = f"mark-cache-storage{{storage={storage}}}," + passes
+    return JaXPipeline(passes)
+
+
+def looped_forward(x, config, weights, key_cache, value_cache):
+    # `llama.forward` with its layers run by a loop instead of being unrolled,
+    # so that the values the reverse pass needs are stacked in loop caches.
+    import jax
+    import jax.numpy as jnp
+
+    pos = key_cache.shape[1]
+    n_layers = config["n_layers"]
+    dim = config["dim"]
+    n_heads = config["n_heads"]
+    n_kv_heads = config["n_kv_heads"]
+    head_size = dim // n_heads
+    kv_dim = dim // n_heads * n_kv_heads
+    kv_mul = n_heads // n_kv_heads
+
+    toconv = []
+    for i in range(0, dim, 2):
+        freq = 1 / jnp.power(10000, (i % head_size) / head_size)
+        val = pos * freq
+        fcr = jnp.cos(val)
+        fci = jnp.sin(val)
+        toconv.append(jnp.array([[fcr, -fci], [fci, fcr]]))
+    toconv2 = toconv[: kv_dim // 2] + [jnp.eye(2)] * (dim // 2 - kv_dim // 2)
+    toconv = jnp.array(toconv)
+    toconv2 = jnp.array(toconv2)
+
+    def layer(i, x):
+        xb = llama.rmsnorm(x, weights["rms_att_weight"][i])
+        q = weights["wq"][i] @ xb
+        k = weights["wk"][i] @ xb
+        v = weights["wv"][i] @ xb
+
+        k = jnp.reshape(
+            jnp.einsum("ijk,ik -> ij", toconv2, jnp.reshape(k, (dim // 2, 2))),
+            (dim,),
+        )
+        q = jnp.reshape(
+            jnp.einsum("ijk,ik -> ij", toconv, jnp.reshape(q, (dim // 2, 2))),
+            (dim,),
+        )
+
+        key_cache_l = jnp.append(key_cache[i], jnp.reshape(k, (1, dim)), axis=0)
+        value_cache_l = jnp.append(value_cache[i], jnp.reshape(v, (1, dim)), axis=0)
+
+        xbs2 = []
+        for h in range(n_heads):
+            q2 = q[head_size * h : head_size * (h + 1)]
+            key_index = h // kv_mul
+            heads = slice(key_index * head_size, (key_index + 1) * head_size)
+            att = jnp.einsum("ij,j->i", key_cache_l[:, heads], q2)
+            att = llama.softmax(att / jnp.sqrt(head_size))
+            xbs2.append(jnp.einsum("ij,i->j", value_cache_l[:, heads], att))
+        x = x + weights["wo"][i] @ jnp.concatenate(xbs2, axis=None)
+
+        xb = llama.rmsnorm(x, weights["rms_ffn_weight"][i])
+        hb = llama.silu(weights["w1"][i] @ xb) * (weights["w3"][i] @ xb)
+        return x + weights["w2"][i] @ hb
+
+    x = jax.lax.fori_loop(0, n_layers, layer, x)
+    return llama.rmsnorm(x, weights["rms_final_weight"])
+
+
+def peak_memory(compiled):
+    stats = compiled.memory_analysis()
+    if stats is None:
+        return 0
+    peak = getattr(stats, "peak_memory_in_bytes", 0)
+    if peak:
+        return peak
+    return (
+        stats.temp_size_in_bytes
+        + stats.argument_size_in_bytes
+        + stats.output_size_in_bytes
+    )
+
+
+def relative_error(grads, ref):
+    import jax
+    import jax.numpy as jnp
+
+    err = 0.0
+    for g, r in zip(jax.tree_util.tree_leaves(grads), jax.tree_util.tree_leaves(ref)):
+        scale = float(jnp.max(jnp.abs(r)))
+        diff = float(jnp.max(jnp.abs(g - r)))
+        err = max(err, diff / scale if scale else diff)
+    return err
+
+
+class LlamaCacheStorage(llama.Llama):
+    def setUp(self):
+        super().setUp()
+        config = {
+            "dim": 288,
+            "hidden_dim": 768,
+            "n_layers": 6,
+            "n_heads": 6,
+            "n_kv_heads": 6,
+            "vocab_size": 32000,
+            "seq_len": 256,
+        }
+
+        def fn(x, weights, key_cache, value_cache):
+            return looped_forward(x, config, weights, key_cache, value_cache)
+
+        self.fn = fn
+
+    def test(self):
+        import jax
+        from enzyme_ad.jax import enzyme_jax_ir
+
+        setup_backends()
+        for backend in CurBackends:
+            ins = [to_backend(x, backend) for x in self.ins]
+            dout = to_backend(self.douts, backend)
+
+            ref = None
+            for storage in STORAGES:
+                fn = enzyme_jax_ir(
+                    pipeline_options=storage_pipeline(storage), inner_jit=False
+                )(self.fn)
+                compiled = (
+                    jax.jit(splatvjp_noprim(fn)).trace(dout, *ins).lower().compile()
+                )
+                grads = compiled(dout, *ins)
+                if ref is None:
+                    ref = grads
+
+                err = relative_error(grads, ref)
+                print(
+                    f"llama {backend} {storage}: peak memory "
+                    f"{peak_memory(compiled) / 2**20:.2f} MiB, "
+                    f"max relative gradient error {err:.3e}"
+                )
+                if storage == "lossless":
+                    self.assertLessEqual(err, self.rtol)
+
+
+if __name__ == "__main__":
+    from test_utils import fix_paths
+
+    fix_paths()
+    absltest.main()
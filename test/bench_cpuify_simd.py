@@ -0,0 +1,108 @@
+import time
+
+from absl.testing import absltest
+
+BLOCKS = 1 << 12
+REPEATS = 5
+
+# Threads per block; 250 is not a multiple of the SIMD width, so the last
+# vector iteration of each block runs with a tail mask.
+THREADS = (256, 250)
+
+METHODS = ("omp", "distribute.simd")
+
+
+def kernel_source(threads):
+    size = BLOCKS * threads
+    ty = f"tensor<{size}xi32>"
+    return f"""
+module {{
+  func.func private @kernel(%pa: !llvm.ptr, %pb: !llvm.ptr) {{
+    %c0 = arith.constant 0 : index
+    %c1 = arith.constant 1 : index
+    %nb = arith.constant {BLOCKS} : index
+    %nt = arith.constant {threads} : index
+    %c7 = arith.constant 7 : i32
+    %a = "enzymexla.pointer2memref"(%pa) : (!llvm.ptr) -> memref<?xi32>
+    %b = "enzymexla.pointer2memref"(%pb) : (!llvm.ptr) -> memref<?xi32>
+    scf.parallel (%bx, %tx) = (%c0, %c0) to (%nb, %nt) step (%c1, %c1) {{
+      %0 = arith.muli %bx, %nt : index
+      %1 = arith.addi %0, %tx : index
+      %2 = memref.load %a[%1] : memref<?xi32>
+      %3 = memref.load %b[%1] : memref<?xi32>
+      %4 = arith.muli %2, %c7 : i32
+      %5 = arith.divsi %4, %3 : i32
+      %6 = arith.addi %5, %2 : i32
+      memref.store %6, %b[%1] : memref<?xi32>
+      scf.reduce
+    }}
+    return
+  }}
+  func.func @main(%arg0: {ty}, %arg1: {ty}) -> {ty} {{
+    %0 = enzymexla.jit_call @kernel (%arg0, %arg1) {{output_operand_aliases = [#stablehlo.output_operand_alias<output_tuple_indices = [], operand_index = 1, operand_tuple_indices = []>]}} : ({ty}, {ty}) -> {ty}
+    return %0 : {ty}
+  }}
+}}
+"""
+
+
+def best_time(fn, *args):
+    fn(*args)
+    times = []
+    for _ in range(REPEATS):
+        start = time.perf_counter()
+        fn(*args)
+        times.append(time.perf_counter() - start)
+    return min(times)
+
+
+class CPUifySIMD(absltest.TestCase):
+    def test_simd_vs_omp(self):
+        import jax
+        import jax.numpy as jnp
+        import numpy as np
+        from enzyme_ad.jax import enzyme_call, hlo_call
+
+        for threads in THREADS:
+            size = BLOCKS * threads
+            a = jax.random.randint(
+                jax.random.PRNGKey(0), (size,), -1000, 1000, dtype=jnp.int32
+            )
+            # Divisors are nonzero on active lanes only; inactive tail lanes
+            # must not divide by the zero a masked load fills in.
+            b = jax.random.randint(
+                jax.random.PRNGKey(1), (size,), 1, 100, dtype=jnp.int32
+            )
+            a_host = np.asarray(a)
+            b_host = np.asarray(b)
+            quotient = np.trunc(a_host * 7 / b_host).astype(np.int32)
+            expected = quotient + a_host
+
+            times = {}
+            for method in METHODS:
+                _, lowered = enzyme_call.run_pass_pipeline(
+                    [],
+                    kernel_source(threads),
+                    f"cpuify{{method={method}}}," "lower-jit{backend=cpu openmp=true}",
+                )
+                self.assertIn("enzymexla_compile_cpu", lowered)
+                kernel = jax.jit(lambda x, y, src=lowered: hlo_call(x, y, source=src))
+                np.testing.assert_array_equal(np.asarray(kernel(a, b)), expected)
+                times[method] = best_time(
+                    lambda x, y: kernel(x, y).block_until_ready(), a, b
+                )
+
+            print(
+                f"cpuify threads={threads}: "
+                f"omp {times['omp'] * 1e3:.2f}ms, "
+                f"simd {times['distribute.simd'] * 1e3:.2f}ms, "
+                f"speedup {times['omp'] / times['distribute.simd']:.2f}x"
+            )
+
+
+if __name__ == "__main__":
+    from test_utils import fix_paths
+
+    fix_paths()
+
+    absltest.main()
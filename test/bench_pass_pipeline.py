@@ -0,0 +1,309 @@
+import glob
+import math
+import os
+import re
+import time
+
+from absl.testing import absltest
+
+NUM_FILES = 5
+REPEATS = 5
+PIPELINE = "canonicalize"
+
+# Host devices on which the communication lit inputs are executed, meshes with
+# more devices are only timed.
+HOST_DEVICES = 16
+os.environ["XLA_FLAGS"] = (
+    os.environ.get("XLA_FLAGS", "")
+    + f" --xla_force_host_platform_device_count={HOST_DEVICES}"
+)
+
+
+def large_modules():
+    # The largest single-module lit inputs serve as benchmark modules.
+    files = glob.glob(os.path.join(os.path.dirname(__file__), "lit_tests", "*.mlir"))
+    files = [f for f in files if "split-input-file" not in open(f).read()]
+    files.sort(key=os.path.getsize, reverse=True)
+    return files[:NUM_FILES]
+
+
+def exported_modules():
+    # Modules exported from test/llama.py or test/maxtext.py, e.g. with
+    # jax.jit(f).lower(*args).as_text(), given as a glob.
+    pattern = os.environ.get("ENZYMEXLA_BENCH_MODULES")
+    return sorted(glob.glob(pattern)) if pattern else []
+
+
+def best_time(fn):
+    times = []
+    for _ in range(REPEATS):
+        start = time.perf_counter()
+        fn()
+        times.append(time.perf_counter() - start)
+    return min(times)
+
+
+class PassPipelineRoundTrip(absltest.TestCase):
+    def test_text_vs_bytecode(self):
+        from enzyme_ad.jax import enzyme_call
+
+        for path in large_modules():
+            with open(path) as f:
+                text = f.read()
+            try:
+                _, bytecode = enzyme_call.run_pass_pipeline_bytecode(
+                    [], text.encode(), PIPELINE
+                )
+            except ValueError:
+                continue
+
+            text_time = best_time(
+                lambda: enzyme_call.run_pass_pipeline([], text, PIPELINE)
+            )
+            bytecode_time = best_time(
+                lambda: enzyme_call.run_pass_pipeline_bytecode([], bytecode, PIPELINE)
+            )
+
+            # The bytecode result must round trip through the pipeline again.
+            _, again = enzyme_call.run_pass_pipeline_bytecode([], bytecode, PIPELINE)
+            self.assertGreater(len(again), 0)
+
+            print(
+                f"{os.path.basename(path)}: {len(text)} bytes text, "
+                f"{len(bytecode)} bytes bytecode, text {text_time * 1e3:.2f}ms, "
+                f"bytecode {bytecode_time * 1e3:.2f}ms"
+            )
+
+
+class HLOOptDrivers(absltest.TestCase):
+    def test_greedy_vs_worklist(self):
+        from enzyme_ad.jax import enzyme_call
+
+        for path in large_modules() + exported_modules():
+            with open(path) as f:
+                text = f.read()
+            timings = {}
+            for driver in ("greedy", "worklist"):
+                pipeline = f"enzyme-hlo-opt{{driver={driver}}}"
+                try:
+                    enzyme_call.run_pass_pipeline([], text, pipeline)
+                except ValueError:
+                    break
+                timings[driver] = best_time(
+                    lambda: enzyme_call.run_pass_pipeline([], text, pipeline)
+                )
+            if len(timings) != 2:
+                continue
+
+            print(
+                f"{os.path.basename(path)}: greedy {timings['greedy'] * 1e3:.2f}ms, "
+                f"worklist {timings['worklist'] * 1e3:.2f}ms, speedup "
+                f"{timings['greedy'] / timings['worklist']:.2f}x"
+            )
+
+
+COLLECTIVES = (
+    "collective_permute",
+    "all_gather",
+    "all_reduce",
+    "all_to_all",
+    "reduce_scatter",
+    "_SPMDInternalOp_RotateRight",
+    "_SPMDEnzymeInternalOp_MultiRotate",
+)
+
+
+def collective_counts(text):
+    return {c: len(re.findall(c, text)) for c in COLLECTIVES if c in text}
+
+
+# Options layered on top of the baseline, which selects strategies by their
+# static benefit and neither overlaps nor packs halo exchanges.
+VARIANTS = (
+    ("benefits", ""),
+    ("auto_select", "auto_select=true"),
+    ("halo_overlap", "halo_overlap=1"),
+    ("pack_halo_exchanges", "pack_halo_exchanges=true"),
+)
+
+
+def parse_options(options):
+    return dict(option.split("=", 1) for option in options.split())
+
+
+def communication_pipeline(text, variant):
+    # The strategy options of the lit input's own RUN line, minus the ones the
+    # variants toggle.
+    match = re.search(r'optimize-communication(?:\{([^}]*)\}|="([^"]*)")?', text)
+    options = parse_options((match.group(1) or match.group(2) or "") if match else "")
+    for _, toggled in VARIANTS:
+        for key in parse_options(toggled):
+            options.pop(key, None)
+    options.update(parse_options(variant))
+    if not options:
+        return "optimize-communication"
+    return (
+        "optimize-communication{"
+        + " ".join(f"{key}={value}" for key, value in options.items())
+        + "}"
+    )
+
+
+def partition_spec(sharding):
+    from jax.sharding import PartitionSpec
+
+    if sharding is None:
+        return PartitionSpec()
+    dims = re.search(r"\[([^\]]*)\]", sharding).group(1)
+    spec = []
+    for dim in re.findall(r"\{([^}]*)\}", dims):
+        axes = re.findall(r'"(\w+)"', dim)
+        spec.append(tuple(axes) if len(axes) > 1 else (axes[0] if axes else None))
+    return PartitionSpec(*spec)
+
+
+def run_on_host_devices(text, seed=0):
+    """Runs the entry function of an optimized communication lit input on
+    random arguments, or returns None if it cannot run on the host devices."""
+    import jax
+    import jax.numpy as jnp
+    import numpy as np
+    from jax._src.interpreters import mlir as jax_mlir
+    from jax._src.lib.mlir import ir
+    from jax.sharding import Mesh, NamedSharding
+    from enzyme_ad.jax.primitives import to_jax_type
+
+    # Enzyme ops left in the module have no XLA lowering.
+    if "enzymexla." in text:
+        return None
+    meshes = re.findall(r"sdy\.mesh @\w+ = <\[([^\]]*)\]>", text)
+    if len(meshes) != 1:
+        return None
+    axes = re.findall(r'"(\w+)"=(\d+)', meshes[0])
+    shape = [int(size) for _, size in axes]
+    devices = jax.devices("cpu")
+    if math.prod(shape) > len(devices):
+        return None
+    mesh = Mesh(
+        np.array(devices[: math.prod(shape)]).reshape(shape),
+        [name for name, _ in axes],
+    )
+
+    def entry(module):
+        funcs = [
+            op for op in module.body.operations if op.operation.name == "func.func"
+        ]
+        for func in funcs:
+            if func.sym_name.value == "main":
+                return func
+        return funcs[0] if len(funcs) == 1 else None
+
+    with jax_mlir.make_ir_context():
+        func = entry(ir.Module.parse(text))
+        if func is None:
+            return None
+        in_avals = [to_jax_type(ir.RankedTensorType(t)) for t in func.type.inputs]
+        out_avals = [to_jax_type(ir.RankedTensorType(t)) for t in func.type.results]
+        shardings = [None] * len(in_avals)
+        if "arg_attrs" in func.attributes:
+            for i, attrs in enumerate(ir.ArrayAttr(func.attributes["arg_attrs"])):
+                attrs = ir.DictAttr(attrs)
+                if "sdy.sharding" in attrs:
+                    shardings[i] = str(attrs["sdy.sharding"])
+
+    rng = np.random.default_rng(seed)
+    args = []
+    for aval, sharding in zip(in_avals, shardings):
+        if jnp.issubdtype(aval.dtype, jnp.floating):
+            value = rng.standard_normal(aval.shape)
+        else:
+            value = rng.integers(0, 2, aval.shape)
+        args.append(
+            jax.device_put(
+                value.astype(aval.dtype),
+                NamedSharding(mesh, partition_spec(sharding)),
+            )
+        )
+
+    # Lower a placeholder with the same signature and shardings, then compile
+    # the optimized module in its place.
+    lowered = jax.jit(
+        lambda *args: tuple(jnp.zeros(a.shape, a.dtype) for a in out_avals),
+        in_shardings=tuple(arg.sharding for arg in args),
+        keep_unused=True,
+    ).lower(*args)
+    module = lowered.compiler_ir("stablehlo")
+    with module.context:
+        optimized = ir.Module.parse(text)
+        entry(optimized).attributes["sym_name"] = ir.StringAttr.get("main")
+        for op in list(module.body.operations):
+            op.erase()
+        for op in list(optimized.body.operations):
+            module.body.append(op)
+    return [np.asarray(out) for out in lowered.compile()(*args)]
+
+
+class OptimizeCommunicationSelection(absltest.TestCase):
+    def test_strategies_agree(self):
+        import jax
+        import numpy as np
+        from enzyme_ad.jax import enzyme_call
+
+        # Most communication lit inputs compute in f64.
+        jax.config.update("jax_enable_x64", True)
+
+        files = glob.glob(
+            os.path.join(
+                os.path.dirname(__file__), "lit_tests", "communication", "*.mlir"
+            )
+        )
+        executed = set()
+        for path in sorted(files):
+            with open(path) as f:
+                text = f.read()
+            results = {}
+            for name, variant in VARIANTS:
+                pipeline = communication_pipeline(text, variant)
+                try:
+                    _, out = enzyme_call.run_pass_pipeline([], text, pipeline)
+                except ValueError:
+                    break
+                elapsed = best_time(
+                    lambda: enzyme_call.run_pass_pipeline([], text, pipeline)
+                )
+                results[name] = (collective_counts(out), elapsed, out)
+            if len(results) != len(VARIANTS):
+                continue
+
+            # Every variant only moves or regroups communication, so it must
+            # compute what the baseline computes.
+            expected = run_on_host_devices(results["benefits"][2])
+            for name, (_, _, out) in results.items():
+                actual = run_on_host_devices(out) if expected is not None else None
+                if actual is None:
+                    continue
+                executed.add((os.path.basename(path), name))
+                self.assertEqual(len(actual), len(expected))
+                for a, e in zip(actual, expected):
+                    np.testing.assert_allclose(
+                        a, e, rtol=1e-6, err_msg=f"{os.path.basename(path)}: {name}"
+                    )
+
+            print(
+                f"{os.path.basename(path)}: "
+                + ", ".join(
+                    f"{name} {counts} in {elapsed * 1e3:.2f}ms"
+                    for name, (counts, elapsed, _) in results.items()
+                )
+            )
+
+        self.assertIn(("pack_halos.mlir", "pack_halo_exchanges"), executed)
+        self.assertIn(("halo_overlap.mlir", "halo_overlap"), executed)
+
+
+if __name__ == "__main__":
+    from test_utils import fix_paths
+
+    fix_paths()
+
+    absltest.main()
@@ -0,0 +1,181 @@
+import time
+from functools import partial
+
+from absl.testing import absltest
+
+SIZES = (1 << 20, 1 << 24)
+REPEATS = 5
+
+# (op, order, scipy reference); the scaled variants are compared against the
+# scaled scipy functions.
+FUNCTIONS = (
+    ("besselj", 0, "jv"),
+    ("besselj", 1, "jv"),
+    ("besselj", 5, "jv"),
+    ("bessely", 0, "yv"),
+    ("bessely", 3, "yv"),
+    ("besselix", 2, "ive"),
+    ("besselkx", 1, "kve"),
+    ("sphericalbesselj", 4, "spherical_jn"),
+)
+
+LOWER_PIPELINE = "lower-enzymexla-special,enzyme-hlo-opt,cse"
+
+
+def special_source(name, order, size, dtype="f32"):
+    ty = f"tensor<{size}x{dtype}>"
+    return f"""
+module {{
+  func.func @main(%arg0: {ty}) -> {ty} {{
+    %nu = stablehlo.constant dense<{order}.0> : {ty}
+    %0 = "enzymexla.special.{name}"(%nu, %arg0) : ({ty}, {ty}) -> {ty}
+    return %0 : {ty}
+  }}
+}}
+"""
+
+
+def best_time(fn, *args):
+    fn(*args)
+    times = []
+    for _ in range(REPEATS):
+        start = time.perf_counter()
+        fn(*args)
+        times.append(time.perf_counter() - start)
+    return min(times)
+
+
+class BesselFunctions(absltest.TestCase):
+    def test_sweep(self):
+        import jax
+        import jax.numpy as jnp
+        import numpy as np
+        import scipy.special
+        from enzyme_ad.jax import enzyme_call, hlo_call
+
+        for name, order, reference_name in FUNCTIONS:
+            reference = getattr(scipy.special, reference_name)
+            for size in SIZES:
+                _, lowered = enzyme_call.run_pass_pipeline(
+                    [], special_source(name, order, size), LOWER_PIPELINE
+                )
+                self.assertNotIn("enzymexla.special", lowered)
+
+                # Y and K are singular at 0, keep away from it.
+                x = jax.random.uniform(
+                    jax.random.PRNGKey(0),
+                    (size,),
+                    dtype=jnp.float32,
+                    minval=1e-2,
+                    maxval=50.0,
+                )
+                x_host = np.asarray(x, dtype=np.float64)
+                kernel = jax.jit(lambda a, src=lowered: hlo_call(a, source=src))
+
+                expected = reference(order, x_host)
+                np.testing.assert_allclose(
+                    np.asarray(kernel(x)),
+                    expected,
+                    atol=1e-5,
+                    rtol=1e-4 * (1 + order),
+                )
+                error = np.max(np.abs(np.asarray(kernel(x)) - expected))
+
+                kernel_time = best_time(lambda a: kernel(a).block_until_ready(), x)
+                reference_time = best_time(reference, order, x_host)
+                print(
+                    f"{name}({order}) size={size}: max error {error:.2e}, "
+                    f"kernel {kernel_time * 1e3:.2f}ms, "
+                    f"scipy {reference_time * 1e3:.2f}ms, "
+                    f"speedup {reference_time / kernel_time:.2f}x"
+                )
+
+    def test_besseli_orders(self):
+        import jax
+        import jax.numpy as jnp
+        import numpy as np
+        import scipy.special
+        from enzyme_ad.jax import enzyme_call, hlo_call
+
+        # I_n is computed by the backward recurrence for every argument below
+        # its asymptotic region, including those above the order.
+        size = SIZES[0]
+        x = jnp.linspace(1e-2, 100.0, size, dtype=jnp.float32)
+        x_host = np.asarray(x, dtype=np.float64)
+        for order in (2, 16, 32, 60, 64):
+            _, lowered = enzyme_call.run_pass_pipeline(
+                [], special_source("besselix", order, size), LOWER_PIPELINE
+            )
+            kernel = partial(hlo_call, source=lowered)
+            expected = scipy.special.ive(order, x_host)
+            actual = np.asarray(jax.jit(kernel)(x), dtype=np.float64)
+            # Compare where the result is a normal f32.
+            normal = expected > np.finfo(np.float32).tiny
+            error = np.max(np.abs(actual[normal] - expected[normal]) / expected[normal])
+            self.assertLess(error, 1e-5)
+            print(f"besselix({order}): max relative error {error:.2e}")
+
+    def test_half_precision(self):
+        import jax
+        import jax.numpy as jnp
+        import numpy as np
+        import scipy.special
+        from enzyme_ad.jax import enzyme_call, hlo_call
+
+        # Narrow types are computed in f32, since they cannot represent the
+        # rescaling constants of the recurrences.
+        size = SIZES[0]
+        x = jnp.linspace(0.5, 10.0, size, dtype=jnp.float16)
+        x_host = np.asarray(x, dtype=np.float64)
+        for name, order, reference_name in FUNCTIONS:
+            _, lowered = enzyme_call.run_pass_pipeline(
+                [], special_source(name, order, size, "f16"), LOWER_PIPELINE
+            )
+            self.assertNotIn("enzymexla.special", lowered)
+            kernel = partial(hlo_call, source=lowered)
+            actual = np.asarray(jax.jit(kernel)(x), dtype=np.float64)
+            expected = getattr(scipy.special, reference_name)(order, x_host)
+            self.assertTrue(np.all(np.isfinite(actual)), name)
+            np.testing.assert_allclose(actual, expected, atol=1e-3, rtol=1e-2)
+
+    def test_double_precision(self):
+        import jax
+        import jax.numpy as jnp
+        import numpy as np
+        import scipy.special
+        from enzyme_ad.jax import enzyme_call, hlo_call
+
+        # The lowering is only accurate to single precision, so f64 ops must
+        # be left for a precise implementation. Sweep the f32 lowering against
+        # the f64 reference for the error an f64 lowering would carry.
+        size = SIZES[0]
+        for name, order, reference_name in FUNCTIONS:
+            _, kept = enzyme_call.run_pass_pipeline(
+                [], special_source(name, order, size, "f64"), LOWER_PIPELINE
+            )
+            self.assertIn(f"enzymexla.special.{name}", kept)
+
+            _, lowered = enzyme_call.run_pass_pipeline(
+                [], special_source(name, order, size), LOWER_PIPELINE
+            )
+            x = jnp.linspace(1e-2, 50.0, size, dtype=jnp.float32)
+            kernel = jax.jit(lambda a, src=lowered: hlo_call(a, source=src))
+            # Evaluate the reference at the f32 inputs, so only the error of
+            # the approximation is measured.
+            expected = getattr(scipy.special, reference_name)(
+                order, np.asarray(x, dtype=np.float64)
+            )
+            actual = np.asarray(kernel(x), dtype=np.float64)
+            error = np.max(
+                np.abs(actual - expected) / np.maximum(1.0, np.abs(expected))
+            )
+            self.assertLess(error, 1e-4 * (1 + order))
+            print(f"{name}({order}): max error against f64 {error:.2e}")
+
+
+if __name__ == "__main__":
+    from test_utils import fix_paths
+
+    fix_paths()
+
+    absltest.main()
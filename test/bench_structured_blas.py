@@ -0,0 +1,67 @@
+from absl.testing import absltest
+from test_utils import EnzymeJaxTest, CurBackends, justjax, setup_backends
+
+# `x + x.T` is recognized as symmetric, so `structured_tensors_detection`
+# rewrites the product below into `enzymexla.blas.symm`, which is then lowered
+# by `lower-enzymexla-blas`. The CPU BLAS path calls `enzymexla_blas_?symm_`,
+# which has to be provided by the embedding runtime; the portable StableHLO
+# lowering is benchmarked here against the plain `dot_general`.
+STRUCTURED_PIPELINE = (
+    "inline{default-pipeline=canonicalize inlining-threshold=4294967295 max-iterations=4},"
+    + "canonicalize,cse,enzyme-hlo-opt{structured_tensors_detection=true},"
+    + "lower-enzymexla-blas{backend=tpu},enzyme-hlo-opt,cse"
+)
+
+DOT_PIPELINE = (
+    "inline{default-pipeline=canonicalize inlining-threshold=4294967295 max-iterations=4},"
+    + "canonicalize,cse,enzyme-hlo-opt,cse"
+)
+
+
+def structured_pipelines():
+    from enzyme_ad.jax import JaXPipeline
+
+    setup_backends()
+    return [
+        ("Jax", None, CurBackends),
+        ("DotGeneral", JaXPipeline(DOT_PIPELINE), CurBackends),
+        ("Symm", JaXPipeline(STRUCTURED_PIPELINE), CurBackends),
+    ]
+
+
+class SymmMatmul(EnzymeJaxTest):
+    def setUp(self):
+        import jax.numpy as jnp
+        import jax.random
+
+        n = 512
+        k1, k2 = jax.random.split(jax.random.PRNGKey(0))
+        self.ins = [
+            jax.random.normal(k1, (n, n), dtype=jnp.float32),
+            jax.random.normal(k2, (n, n), dtype=jnp.float32),
+        ]
+        self.dins = [jnp.ones((n, n), dtype=jnp.float32)] * 2
+        self.douts = jnp.ones((n, n), dtype=jnp.float32)
+
+        self.AllPipelines = structured_pipelines()
+        self.fwdfilter = justjax
+        self.revfilter = justjax
+        self.mlirad_fwd = False
+        self.mlirad_rev = False
+        self.atol = 1e-3
+        self.rtol = 1e-4
+
+        def symm(x, b):
+            s = x + x.T
+            return s @ b
+
+        self.fn = symm
+        self.name = "symm"
+
+
+if __name__ == "__main__":
+    from test_utils import fix_paths
+
+    fix_paths()
+
+    absltest.main()
@@ -1,6 +1,9 @@
 // RUN: enzymexlamlir-opt --pass-pipeline="builtin.module(enzyme-hlo-opt{no_nan=true})" %s | FileCheck %s --check-prefix=NONAN
 // RUN: enzymexlamlir-opt --enzyme-hlo-generate-td="patterns=no_nan_add_sub_simplify(1)" --transform-interpreter --enzyme-hlo-remove-transform %s | FileCheck %s --check-prefix=NONAN
+// RUN: enzymexlamlir-opt --pass-pipeline="builtin.module(enzyme-hlo-opt{no_nan=true driver=worklist})" %s | FileCheck %s --check-prefix=NONAN
+// RUN: enzymexlamlir-opt --pass-pipeline="builtin.module(enzyme-hlo-opt{no_nan=true cost_model_selection=true})" %s | FileCheck %s --check-prefix=NONAN
 // RUN: enzymexlamlir-opt --pass-pipeline="builtin.module(enzyme-hlo-opt{no_nan=false})" %s | FileCheck %s --check-prefix=NAN
+// RUN: enzymexlamlir-opt --pass-pipeline="builtin.module(enzyme-hlo-opt{no_nan=false driver=worklist})" %s | FileCheck %s --check-prefix=NAN
 // RUN: enzymexlamlir-opt --enzyme-hlo-generate-td="patterns=no_nan_add_sub_simplify(0)" --transform-interpreter --enzyme-hlo-remove-transform %s | FileCheck %s --check-prefix=NAN
 
 
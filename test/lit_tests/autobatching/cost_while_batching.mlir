@@ -0,0 +1,47 @@
+// RUN: enzymexlamlir-opt --auto-batching="while_loop_batching_mode=cost" %s | FileCheck %s
+// RUN: enzymexlamlir-opt --auto-batching="while_loop_batching_mode=cost while_loop_batching_memory_ratio=0.25" %s | FileCheck %s --check-prefix=BUDGET
+// RUN: enzymexlamlir-opt --auto-batching="while_loop_batching_mode=cost while_loop_batching_launch_cost=1" %s | FileCheck %s --check-prefix=BUDGET
+// RUN: enzymexlamlir-opt --auto-batching="while_loop_batching_mode=greedy" %s | FileCheck %s --check-prefix=GREEDY
+
+module {
+  func.func @main(%arg0: tensor<10xf64>, %arg1: tensor<1xf64>) -> (tensor<10xf64>, tensor<10xf64>) {
+    %c_0 = stablehlo.constant dense<0> : tensor<i64>
+    %c_1 = stablehlo.constant dense<10> : tensor<i64>
+    %c_2 = stablehlo.constant dense<1> : tensor<i64>
+    %cst = stablehlo.constant dense<0.000000e+00> : tensor<10xf64>
+    %0:3 = stablehlo.while(%iterArg = %c_0, %iterArg_3 = %cst, %iterArg_4 = %cst) : tensor<i64>, tensor<10xf64>, tensor<10xf64>
+    cond {
+      %1 = stablehlo.compare  LT, %iterArg, %c_1 : (tensor<i64>, tensor<i64>) -> tensor<i1>
+      stablehlo.return %1 : tensor<i1>
+    } do {
+      %1 = stablehlo.add %iterArg, %c_2 : tensor<i64>
+      %2 = stablehlo.dynamic_slice %arg0, %iterArg, sizes = [1] : (tensor<10xf64>, tensor<i64>) -> tensor<1xf64>
+      %3 = stablehlo.sine %2 : tensor<1xf64>
+      %4 = stablehlo.multiply %2, %arg1 : tensor<1xf64>
+      %5 = stablehlo.dynamic_update_slice %iterArg_3, %3, %iterArg : (tensor<10xf64>, tensor<1xf64>, tensor<i64>) -> tensor<10xf64>
+      %6 = stablehlo.dynamic_update_slice %iterArg_4, %4, %iterArg : (tensor<10xf64>, tensor<1xf64>, tensor<i64>) -> tensor<10xf64>
+      stablehlo.return %1, %5, %6 : tensor<i64>, tensor<10xf64>, tensor<10xf64>
+    }
+    return %0#1, %0#2 : tensor<10xf64>, tensor<10xf64>
+  }
+}
+
+// Batching the sine materializes 80 bytes, while batching the multiply also
+// broadcasts %arg1 for 160 bytes. Only the sine fits in the default budget of
+// the 168 bytes of loop-carried state.
+
+// CHECK: stablehlo.sine
+// CHECK: stablehlo.while
+// CHECK-NOT: stablehlo.sine
+// CHECK: stablehlo.multiply %{{.+}}, %arg1 : tensor<1xf64>
+// CHECK-NOT: enzymexla.batched_bytes
+
+// BUDGET: stablehlo.while
+// BUDGET: stablehlo.sine %{{.+}} : tensor<1xf64>
+// BUDGET: stablehlo.multiply %{{.+}}, %arg1 : tensor<1xf64>
+// BUDGET-NOT: enzymexla.batched_bytes
+
+// GREEDY-DAG: stablehlo.sine
+// GREEDY-DAG: stablehlo.multiply
+// GREEDY: stablehlo.while
+// GREEDY-NOT: stablehlo.multiply %{{.+}}, %arg1 : tensor<1xf64>
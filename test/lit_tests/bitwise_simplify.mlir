@@ -1,4 +1,5 @@
 // RUN: enzymexlamlir-opt --enzyme-hlo-opt %s | FileCheck %s
+// RUN: enzymexlamlir-opt --enzyme-hlo-opt="driver=worklist" %s | FileCheck %s
 
 module {
   func.func @and_i64_with_one(%arg0: tensor<i64>) -> tensor<i64> {
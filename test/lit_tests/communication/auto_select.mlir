@@ -0,0 +1,29 @@
+// RUN: enzymexlamlir-opt --pass-pipeline="builtin.module(optimize-communication{auto_select=true})" %s | FileCheck %s
+// RUN: enzymexlamlir-opt --pass-pipeline="builtin.module(optimize-communication{auto_select=true axis_links=x=100:5,y=25:10})" %s | FileCheck %s
+
+sdy.mesh @mesh1 = <["z"=1, "x"=4, "y"=4]>
+
+// A rotate along a sharded dimension only needs its wrapped-around rows sent
+// to the neighbor, which is cheaper than realigning whole shards.
+func.func @rotate(%arg0: tensor<20x24x96xf64> {sdy.sharding = #sdy.sharding<@mesh1, [{"z"}, {"y"}, {"x"}]>}) -> (tensor<4x8x80xf64> {sdy.sharding = #sdy.sharding<@mesh1, [{"z"}, {"y"}, {"x"}]>}) {
+    %0 = stablehlo.slice %arg0 [8:12, 8:16, 8:88] {sdy.sharding = #sdy.sharding_per_value<[<@mesh1, [{"z"}, {"y"}, {"x"}]>]>} : (tensor<20x24x96xf64>) -> tensor<4x8x80xf64>
+    %1 = "enzymexla.rotate"(%0) <{amount = 2 : i32, dimension = 2 : i32}> {sdy.sharding = #sdy.sharding_per_value<[<@mesh1, [{"z"}, {"y"}, {"x"}]>]>} : (tensor<4x8x80xf64>) -> tensor<4x8x80xf64>
+    return %1 : tensor<4x8x80xf64>
+}
+
+// CHECK-LABEL: func.func @rotate
+// CHECK: sdy.manual_computation
+// CHECK: "stablehlo.collective_permute"
+// CHECK-NOT: enzymexla.rotate
+// CHECK: return
+
+// Nothing crosses a shard boundary along an unsharded dimension, so the op is
+// left alone.
+func.func @rotate_unsharded(%arg0: tensor<4x8x80xf64> {sdy.sharding = #sdy.sharding<@mesh1, [{"z"}, {"y"}, {"x"}]>}) -> (tensor<4x8x80xf64> {sdy.sharding = #sdy.sharding<@mesh1, [{"z"}, {"y"}, {"x"}]>}) {
+    %0 = "enzymexla.rotate"(%arg0) <{amount = 2 : i32, dimension = 0 : i32}> {sdy.sharding = #sdy.sharding_per_value<[<@mesh1, [{"z"}, {"y"}, {"x"}]>]>} : (tensor<4x8x80xf64>) -> tensor<4x8x80xf64>
+    return %0 : tensor<4x8x80xf64>
+}
+
+// CHECK-LABEL: func.func @rotate_unsharded
+// CHECK-NOT: sdy.manual_computation
+// CHECK: enzymexla.rotate
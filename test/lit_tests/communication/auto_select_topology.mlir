@@ -0,0 +1,26 @@
+// RUN: enzymexlamlir-opt --pass-pipeline="builtin.module(optimize-communication{auto_select=true link_bandwidth=1000000000 link_latency=0})" %s | FileCheck %s --check-prefix=FAST
+// RUN: enzymexlamlir-opt --pass-pipeline="builtin.module(optimize-communication{auto_select=true link_bandwidth=1000000000 link_latency=0 axis_links=y=1:0})" %s | FileCheck %s --check-prefix=FAST
+// RUN: enzymexlamlir-opt --pass-pipeline="builtin.module(optimize-communication{auto_select=true link_bandwidth=1000000000 link_latency=0 axis_links=x=1:0})" %s | FileCheck %s --check-prefix=SLOWX
+
+sdy.mesh @mesh1 = <["z"=1, "x"=4, "y"=4]>
+
+// On fast links, sending only the wrapped-around rows does not pay for the
+// extra slices and concat, so the rotate is left to the partitioner. It is
+// only worth it when the links along "x", the axis the rotate crosses, are
+// slow; slow links along "y" do not matter.
+func.func @rotate(%arg0: tensor<20x24x96xf64> {sdy.sharding = #sdy.sharding<@mesh1, [{"z"}, {"y"}, {"x"}]>}) -> (tensor<4x8x80xf64> {sdy.sharding = #sdy.sharding<@mesh1, [{"z"}, {"y"}, {"x"}]>}) {
+    %0 = stablehlo.slice %arg0 [8:12, 8:16, 8:88] {sdy.sharding = #sdy.sharding_per_value<[<@mesh1, [{"z"}, {"y"}, {"x"}]>]>} : (tensor<20x24x96xf64>) -> tensor<4x8x80xf64>
+    %1 = "enzymexla.rotate"(%0) <{amount = 2 : i32, dimension = 2 : i32}> {sdy.sharding = #sdy.sharding_per_value<[<@mesh1, [{"z"}, {"y"}, {"x"}]>]>} : (tensor<4x8x80xf64>) -> tensor<4x8x80xf64>
+    return %1 : tensor<4x8x80xf64>
+}
+
+// FAST-LABEL: func.func @rotate
+// FAST-NOT: sdy.manual_computation
+// FAST: enzymexla.rotate
+// FAST: return
+
+// SLOWX-LABEL: func.func @rotate
+// SLOWX: sdy.manual_computation
+// SLOWX: "stablehlo.collective_permute"
+// SLOWX-NOT: enzymexla.rotate
+// SLOWX: return
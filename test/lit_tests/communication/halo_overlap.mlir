@@ -0,0 +1,33 @@
+// RUN: enzymexlamlir-opt --pass-pipeline="builtin.module(optimize-communication{halo_overlap=1})" %s | FileCheck %s
+
+sdy.mesh @mesh = <["x"=4]>
+
+func.func @stencil(%arg0: tensor<4x2x80xf64> {sdy.sharding = #sdy.sharding<@mesh, [{}, {}, {"x"}]>}) -> (tensor<4x2x80xf64> {sdy.sharding = #sdy.sharding<@mesh, [{}, {}, {"x"}]>}) {
+    %0 = sdy.manual_computation(%arg0) in_shardings=[<@mesh, [{}, {}, {"x"}]>] out_shardings=[<@mesh, [{}, {}, {"x"}]>] manual_axes={"x"} (%arg1: tensor<4x2x20xf64>) {
+      %1 = stablehlo.slice %arg1 [0:4, 0:2, 19:20] : (tensor<4x2x20xf64>) -> tensor<4x2x1xf64>
+      %2 = stablehlo.slice %arg1 [0:4, 0:2, 0:1] : (tensor<4x2x20xf64>) -> tensor<4x2x1xf64>
+      %3 = stablehlo.multiply %arg1, %arg1 : tensor<4x2x20xf64>
+      %4 = "stablehlo.collective_permute"(%1) <{channel_handle = #stablehlo.channel_handle<handle = 1, type = 0>, source_target_pairs = dense<[[0, 1], [1, 2], [2, 3], [3, 0]]> : tensor<4x2xi64>}> : (tensor<4x2x1xf64>) -> tensor<4x2x1xf64>
+      %5 = "stablehlo.collective_permute"(%2) <{channel_handle = #stablehlo.channel_handle<handle = 2, type = 0>, source_target_pairs = dense<[[1, 0], [2, 1], [3, 2], [0, 3]]> : tensor<4x2xi64>}> : (tensor<4x2x1xf64>) -> tensor<4x2x1xf64>
+      %6 = stablehlo.concatenate %4, %arg1, %5, dim = 2 : (tensor<4x2x1xf64>, tensor<4x2x20xf64>, tensor<4x2x1xf64>) -> tensor<4x2x22xf64>
+      %7 = stablehlo.slice %6 [0:4, 0:2, 0:20] : (tensor<4x2x22xf64>) -> tensor<4x2x20xf64>
+      %8 = stablehlo.slice %6 [0:4, 0:2, 2:22] : (tensor<4x2x22xf64>) -> tensor<4x2x20xf64>
+      %9 = stablehlo.add %7, %8 : tensor<4x2x20xf64>
+      %10 = stablehlo.add %9, %3 : tensor<4x2x20xf64>
+      sdy.return %10 : tensor<4x2x20xf64>
+    } : (tensor<4x2x80xf64>) -> tensor<4x2x80xf64>
+    return %0 : tensor<4x2x80xf64>
+}
+
+// The halo exchanges are issued before the local work, and only the outermost
+// column on each side reads a received halo.
+
+// CHECK-LABEL: func.func @stencil
+// CHECK: sdy.manual_computation
+// CHECK: "stablehlo.collective_permute"
+// CHECK: "stablehlo.collective_permute"
+// CHECK: stablehlo.multiply
+// CHECK-DAG: stablehlo.add {{.*}} : tensor<4x2x18xf64>
+// CHECK-DAG: stablehlo.add {{.*}} : tensor<4x2x1xf64>
+// CHECK: %[[R:.+]] = stablehlo.concatenate {{.*}}, dim = 2 : (tensor<4x2x1xf64>, tensor<4x2x18xf64>, tensor<4x2x1xf64>) -> tensor<4x2x20xf64>
+// CHECK-NEXT: sdy.return %[[R]]
@@ -0,0 +1,20 @@
+// RUN: enzymexlamlir-opt --pass-pipeline="builtin.module(optimize-communication{rotate_comm=1 rotate_to_pad_comm=0 rotate_spmd=0 pack_halo_exchanges=true})" %s | FileCheck %s
+
+sdy.mesh @mesh1 = <["z"=1, "x"=4, "y"=4]>
+func.func @main(%arg0: tensor<4x8x80xf64> {sdy.sharding = #sdy.sharding<@mesh1, [{"z"}, {"y"}, {"x"}]>}, %arg1: tensor<4x8x80xf64> {sdy.sharding = #sdy.sharding<@mesh1, [{"z"}, {"y"}, {"x"}]>}) -> (tensor<4x8x80xf64> {sdy.sharding = #sdy.sharding<@mesh1, [{"z"}, {"y"}, {"x"}]>}, tensor<4x8x80xf64> {sdy.sharding = #sdy.sharding<@mesh1, [{"z"}, {"y"}, {"x"}]>}) {
+    %0 = "enzymexla.rotate"(%arg0) <{amount = 2 : i32, dimension = 2 : i32}> {sdy.sharding = #sdy.sharding_per_value<[<@mesh1, [{"z"}, {"y"}, {"x"}]>]>} : (tensor<4x8x80xf64>) -> tensor<4x8x80xf64>
+    %1 = "enzymexla.rotate"(%arg1) <{amount = 2 : i32, dimension = 2 : i32}> {sdy.sharding = #sdy.sharding_per_value<[<@mesh1, [{"z"}, {"y"}, {"x"}]>]>} : (tensor<4x8x80xf64>) -> tensor<4x8x80xf64>
+    return %0, %1 : tensor<4x8x80xf64>, tensor<4x8x80xf64>
+}
+
+// Both halos travel in one message.
+
+// CHECK-LABEL: func.func @main
+// CHECK: sdy.manual_computation(%arg0, %arg1)
+// CHECK-NOT: "stablehlo.collective_permute"
+// CHECK: stablehlo.concatenate {{.*}}, dim = 0 : (tensor<16xf64>, tensor<16xf64>) -> tensor<32xf64>
+// CHECK-NEXT: "stablehlo.collective_permute"({{.*}}) {{.*}} : (tensor<32xf64>) -> tensor<32xf64>
+// CHECK-NOT: "stablehlo.collective_permute"
+// CHECK: sdy.return
+// CHECK-NOT: sdy.manual_computation
+// CHECK: return
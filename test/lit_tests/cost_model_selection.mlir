@@ -0,0 +1,21 @@
+// RUN: enzymexlamlir-opt --enzyme-hlo-opt %s | FileCheck %s --check-prefix=DEFAULT
+// RUN: enzymexlamlir-opt --enzyme-hlo-opt="cost_model_selection=true" %s | FileCheck %s --check-prefix=COST
+// With a single run only the baseline is optimized and nothing is disabled.
+// RUN: enzymexlamlir-opt --enzyme-hlo-opt="cost_model_selection=true cost_model_max_runs=1" %s | FileCheck %s --check-prefix=DEFAULT
+
+// The concat is still needed for its other use, so pushing the slice through
+// it (SliceConcat) materializes a second concat instead of a fused slice.
+func.func @main(%a: tensor<4x8xf32>, %b: tensor<4x8xf32>) -> (tensor<8x8xf32>, tensor<4x8xf32>) {
+  %c = stablehlo.concatenate %a, %b, dim = 0 : (tensor<4x8xf32>, tensor<4x8xf32>) -> tensor<8x8xf32>
+  %s = stablehlo.slice %c [2:6, 0:8] : (tensor<8x8xf32>) -> tensor<4x8xf32>
+  return %c, %s : tensor<8x8xf32>, tensor<4x8xf32>
+}
+
+// DEFAULT-LABEL: func.func @main
+// DEFAULT-COUNT-2: stablehlo.concatenate
+// DEFAULT-NOT:     stablehlo.concatenate
+
+// COST-LABEL: func.func @main
+// COST-NEXT:    %[[C:.+]] = stablehlo.concatenate %arg0, %arg1, dim = 0
+// COST-NEXT:    %[[S:.+]] = stablehlo.slice %[[C]] [2:6, 0:8]
+// COST-NEXT:    return %[[C]], %[[S]]
@@ -0,0 +1,153 @@
+// RUN: enzymexlamlir-opt %s --enzyme --canonicalize --remove-unnecessary-enzyme-ops --canonicalize | FileCheck %s
+// RUN: enzymexlamlir-opt %s --mark-cache-storage="storage=bf16" --enzyme --canonicalize --remove-unnecessary-enzyme-ops --canonicalize | FileCheck %s --check-prefix=MODULE
+
+module {
+  func.func @plain(%x: tensor<4xf64>) -> tensor<4xf64> {
+    %c0 = stablehlo.constant dense<0> : tensor<i64>
+    %c1 = stablehlo.constant dense<1> : tensor<i64>
+    %c3 = stablehlo.constant dense<3> : tensor<i64>
+    %0:2 = stablehlo.while(%i = %c0, %v = %x) : tensor<i64>, tensor<4xf64> attributes {enzyme.disable_mincut}
+     cond {
+      %1 = stablehlo.compare  LT, %i, %c3 : (tensor<i64>, tensor<i64>) -> tensor<i1>
+      stablehlo.return %1 : tensor<i1>
+    } do {
+      %1 = stablehlo.sine %v : tensor<4xf64>
+      %2 = stablehlo.add %i, %c1 : tensor<i64>
+      stablehlo.return %2, %1 : tensor<i64>, tensor<4xf64>
+    }
+    return %0#1 : tensor<4xf64>
+  }
+
+  // The cached value is widened from f32, so the f32 value is stacked.
+  func.func @lossless(%x: tensor<4xf32>, %y: tensor<4xf64>) -> tensor<4xf64> attributes {enzymexla.cache_storage = "lossless"} {
+    %c0 = stablehlo.constant dense<0> : tensor<i64>
+    %c1 = stablehlo.constant dense<1> : tensor<i64>
+    %c3 = stablehlo.constant dense<3> : tensor<i64>
+    %0:3 = stablehlo.while(%i = %c0, %s = %x, %v = %y) : tensor<i64>, tensor<4xf32>, tensor<4xf64> attributes {enzyme.disable_mincut}
+     cond {
+      %1 = stablehlo.compare  LT, %i, %c3 : (tensor<i64>, tensor<i64>) -> tensor<i1>
+      stablehlo.return %1 : tensor<i1>
+    } do {
+      %1 = stablehlo.convert %s : (tensor<4xf32>) -> tensor<4xf64>
+      %2 = stablehlo.multiply %v, %1 : tensor<4xf64>
+      %3 = stablehlo.add %i, %c1 : tensor<i64>
+      stablehlo.return %3, %s, %2 : tensor<i64>, tensor<4xf32>, tensor<4xf64>
+    }
+    return %0#2 : tensor<4xf64>
+  }
+
+  func.func @bf16(%x: tensor<4xf64>) -> tensor<4xf64> attributes {enzymexla.cache_storage = "bf16"} {
+    %c0 = stablehlo.constant dense<0> : tensor<i64>
+    %c1 = stablehlo.constant dense<1> : tensor<i64>
+    %c3 = stablehlo.constant dense<3> : tensor<i64>
+    %0:2 = stablehlo.while(%i = %c0, %v = %x) : tensor<i64>, tensor<4xf64> attributes {enzyme.disable_mincut}
+     cond {
+      %1 = stablehlo.compare  LT, %i, %c3 : (tensor<i64>, tensor<i64>) -> tensor<i1>
+      stablehlo.return %1 : tensor<i1>
+    } do {
+      %1 = stablehlo.sine %v : tensor<4xf64>
+      %2 = stablehlo.add %i, %c1 : tensor<i64>
+      stablehlo.return %2, %1 : tensor<i64>, tensor<4xf64>
+    }
+    return %0#1 : tensor<4xf64>
+  }
+
+  func.func @fp8(%x: tensor<4xf64>) -> tensor<4xf64> {
+    %c0 = stablehlo.constant dense<0> : tensor<i64>
+    %c1 = stablehlo.constant dense<1> : tensor<i64>
+    %c3 = stablehlo.constant dense<3> : tensor<i64>
+    %0:2 = stablehlo.while(%i = %c0, %v = %x) : tensor<i64>, tensor<4xf64> attributes {enzyme.disable_mincut, enzymexla.cache_storage = "f8E4M3FN"}
+     cond {
+      %1 = stablehlo.compare  LT, %i, %c3 : (tensor<i64>, tensor<i64>) -> tensor<i1>
+      stablehlo.return %1 : tensor<i1>
+    } do {
+      %1 = stablehlo.sine %v : tensor<4xf64>
+      %2 = stablehlo.add %i, %c1 : tensor<i64>
+      stablehlo.return %2, %1 : tensor<i64>, tensor<4xf64>
+    }
+    return %0#1 : tensor<4xf64>
+  }
+
+  // The index is cached as the f32 it is converted from, which must not be
+  // rounded since the cache holds integers.
+  func.func @index(%x: tensor<4xf64>, %f: tensor<f32>) -> tensor<1xf64> attributes {enzymexla.cache_storage = "bf16"} {
+    %c0 = stablehlo.constant dense<0> : tensor<i64>
+    %c1 = stablehlo.constant dense<1> : tensor<i64>
+    %c3 = stablehlo.constant dense<3> : tensor<i64>
+    %one = stablehlo.constant dense<1.000000e+00> : tensor<f32>
+    %zero = stablehlo.constant dense<0.000000e+00> : tensor<1xf64>
+    %0:4 = stablehlo.while(%i = %c0, %g = %f, %v = %x, %r = %zero) : tensor<i64>, tensor<f32>, tensor<4xf64>, tensor<1xf64> attributes {enzyme.disable_mincut}
+     cond {
+      %1 = stablehlo.compare  LT, %i, %c3 : (tensor<i64>, tensor<i64>) -> tensor<i1>
+      stablehlo.return %1 : tensor<i1>
+    } do {
+      %1 = stablehlo.convert %g : (tensor<f32>) -> tensor<i64>
+      %2 = stablehlo.dynamic_slice %v, %1, sizes = [1] : (tensor<4xf64>, tensor<i64>) -> tensor<1xf64>
+      %3 = stablehlo.add %r, %2 : tensor<1xf64>
+      %4 = stablehlo.add %g, %one : tensor<f32>
+      %5 = stablehlo.add %i, %c1 : tensor<i64>
+      stablehlo.return %5, %4, %v, %3 : tensor<i64>, tensor<f32>, tensor<4xf64>, tensor<1xf64>
+    }
+    return %0#3 : tensor<1xf64>
+  }
+
+  func.func @main(%x: tensor<4xf64>, %s: tensor<4xf32>, %d: tensor<4xf64>, %f: tensor<f32>, %d1: tensor<1xf64>) -> (tensor<4xf64>, tensor<4xf64>, tensor<4xf64>, tensor<4xf64>, tensor<4xf64>) {
+    %0 = enzyme.autodiff @plain(%x, %d) {
+      activity=[#enzyme<activity enzyme_active>],
+      ret_activity=[#enzyme<activity enzyme_activenoneed>]
+    } : (tensor<4xf64>, tensor<4xf64>) -> tensor<4xf64>
+    %1 = enzyme.autodiff @lossless(%s, %x, %d) {
+      activity=[#enzyme<activity enzyme_const>, #enzyme<activity enzyme_active>],
+      ret_activity=[#enzyme<activity enzyme_activenoneed>]
+    } : (tensor<4xf32>, tensor<4xf64>, tensor<4xf64>) -> tensor<4xf64>
+    %2 = enzyme.autodiff @bf16(%x, %d) {
+      activity=[#enzyme<activity enzyme_active>],
+      ret_activity=[#enzyme<activity enzyme_activenoneed>]
+    } : (tensor<4xf64>, tensor<4xf64>) -> tensor<4xf64>
+    %3 = enzyme.autodiff @fp8(%x, %d) {
+      activity=[#enzyme<activity enzyme_active>],
+      ret_activity=[#enzyme<activity enzyme_activenoneed>]
+    } : (tensor<4xf64>, tensor<4xf64>) -> tensor<4xf64>
+    %4 = enzyme.autodiff @index(%x, %f, %d1) {
+      activity=[#enzyme<activity enzyme_active>, #enzyme<activity enzyme_const>],
+      ret_activity=[#enzyme<activity enzyme_activenoneed>]
+    } : (tensor<4xf64>, tensor<f32>, tensor<1xf64>) -> tensor<4xf64>
+    return %0, %1, %2, %3, %4 : tensor<4xf64>, tensor<4xf64>, tensor<4xf64>, tensor<4xf64>, tensor<4xf64>
+  }
+}
+
+// CHECK-LABEL: func.func private @diffeplain
+// CHECK: stablehlo.dynamic_update_slice {{.*}} : (tensor<3x4xf64>, tensor<1x4xf64>, tensor<i64>, tensor<i64>) -> tensor<3x4xf64>
+
+// CHECK-LABEL: func.func private @diffelossless
+// CHECK: stablehlo.dynamic_update_slice {{.*}} : (tensor<3x4xf32>, tensor<1x4xf32>, tensor<i64>, tensor<i64>) -> tensor<3x4xf32>
+// CHECK: stablehlo.dynamic_slice {{.*}} : (tensor<3x4xf32>, tensor<i64>, tensor<i64>) -> tensor<1x4xf32>
+// CHECK: stablehlo.convert {{.*}} : (tensor<4xf32>) -> tensor<4xf64>
+
+// CHECK-LABEL: func.func private @diffebf16
+// CHECK: stablehlo.convert {{.*}} : (tensor<4xf64>) -> tensor<4xbf16>
+// CHECK: stablehlo.dynamic_update_slice {{.*}} -> tensor<3x4xbf16>
+// CHECK: stablehlo.dynamic_slice {{.*}} : (tensor<3x4xbf16>, tensor<i64>, tensor<i64>) -> tensor<1x4xbf16>
+// CHECK: stablehlo.convert {{.*}} : (tensor<4xbf16>) -> tensor<4xf64>
+
+// Each cached value is stored with its own scale.
+// CHECK-LABEL: func.func private @diffefp8
+// CHECK: stablehlo.reduce
+// CHECK: stablehlo.convert {{.*}} : (tensor<4xf64>) -> tensor<4xf8E4M3FN>
+// CHECK-DAG: stablehlo.dynamic_update_slice {{.*}} -> tensor<3x4xf8E4M3FN>
+// CHECK-DAG: stablehlo.dynamic_update_slice {{.*}} -> tensor<3xf64>
+// CHECK: stablehlo.convert {{.*}} : (tensor<4xf8E4M3FN>) -> tensor<4xf64>
+// CHECK: stablehlo.multiply
+
+// CHECK-LABEL: func.func private @diffeindex
+// CHECK-NOT: bf16
+// CHECK: stablehlo.dynamic_update_slice {{.*}} -> tensor<3xf32>
+// CHECK-NOT: bf16
+// CHECK: stablehlo.convert {{.*}} : (tensor<f32>) -> tensor<i64>
+
+// MODULE-LABEL: func.func private @diffeplain
+// MODULE: stablehlo.dynamic_update_slice {{.*}} -> tensor<3x4xbf16>
+
+// A storage set on a loop takes precedence over the module.
+// MODULE-LABEL: func.func private @diffefp8
+// MODULE: stablehlo.dynamic_update_slice {{.*}} -> tensor<3x4xf8E4M3FN>
@@ -0,0 +1,170 @@
+// RUN: enzymexlamlir-opt %s --enzyme --canonicalize --remove-unnecessary-enzyme-ops --enzyme-simplify-math --canonicalize | FileCheck %s
+// RUN: enzymexlamlir-opt %s --enzyme --canonicalize --remove-unnecessary-enzyme-ops --enzyme-simplify-math --arith-raise --canonicalize | stablehlo-translate --interpret
+// RUN: enzymexlamlir-opt %s --enzyme 2>&1 >/dev/null | FileCheck %s --check-prefix=REMARK
+
+// The loop runs until its state reaches %limit, so its trip count is only
+// known at runtime: none for a limit of 0.1, a handful for 10 and about
+// twenty for 1000. The latter two overflow the snapshot buffers, which are
+// thinned out once and several times respectively.
+module {
+  func.func @without_checkpointing(%arg0: tensor<f64>, %limit: tensor<f64>) -> tensor<f64> {
+    %c = stablehlo.constant dense<1.5> : tensor<f64>
+    %0 = stablehlo.while(%iterArg = %arg0) : tensor<f64> attributes {enzyme.disable_mincut}
+     cond {
+      %1 = stablehlo.compare  LT, %iterArg, %limit : (tensor<f64>, tensor<f64>) -> tensor<i1>
+      stablehlo.return %1 : tensor<i1>
+    } do {
+      %1 = stablehlo.multiply %iterArg, %c : tensor<f64>
+      %2 = stablehlo.sine %iterArg : tensor<f64>
+      %3 = stablehlo.add %1, %2 : tensor<f64>
+      stablehlo.return %3 : tensor<f64>
+    }
+    return %0 : tensor<f64>
+  }
+
+  func.func @with_snapshots(%arg0: tensor<f64>, %limit: tensor<f64>) -> tensor<f64> {
+    %c = stablehlo.constant dense<1.5> : tensor<f64>
+    %0 = stablehlo.while(%iterArg = %arg0) : tensor<f64> attributes {enzyme.disable_mincut, enzymexla.checkpoint_snapshots = 4 : i64}
+     cond {
+      %1 = stablehlo.compare  LT, %iterArg, %limit : (tensor<f64>, tensor<f64>) -> tensor<i1>
+      stablehlo.return %1 : tensor<i1>
+    } do {
+      %1 = stablehlo.multiply %iterArg, %c : tensor<f64>
+      %2 = stablehlo.sine %iterArg : tensor<f64>
+      %3 = stablehlo.add %1, %2 : tensor<f64>
+      stablehlo.return %3 : tensor<f64>
+    }
+    return %0 : tensor<f64>
+  }
+
+  // Two snapshots of the f64 state plus the scratch slot.
+  func.func @with_memory(%arg0: tensor<f64>, %limit: tensor<f64>) -> tensor<f64> {
+    %c = stablehlo.constant dense<1.5> : tensor<f64>
+    %0 = stablehlo.while(%iterArg = %arg0) : tensor<f64> attributes {enzyme.disable_mincut, enzymexla.checkpoint_memory = 24 : i64}
+     cond {
+      %1 = stablehlo.compare  LT, %iterArg, %limit : (tensor<f64>, tensor<f64>) -> tensor<i1>
+      stablehlo.return %1 : tensor<i1>
+    } do {
+      %1 = stablehlo.multiply %iterArg, %c : tensor<f64>
+      %2 = stablehlo.sine %iterArg : tensor<f64>
+      %3 = stablehlo.add %1, %2 : tensor<f64>
+      stablehlo.return %3 : tensor<f64>
+    }
+    return %0 : tensor<f64>
+  }
+
+  // Only one snapshot fits, which online checkpointing cannot work with.
+  func.func @with_small_memory(%arg0: tensor<f64>, %limit: tensor<f64>) -> tensor<f64> {
+    %c = stablehlo.constant dense<1.5> : tensor<f64>
+    %0 = stablehlo.while(%iterArg = %arg0) : tensor<f64> attributes {enzyme.disable_mincut, enzymexla.checkpoint_memory = 16 : i64}
+     cond {
+      %1 = stablehlo.compare  LT, %iterArg, %limit : (tensor<f64>, tensor<f64>) -> tensor<i1>
+      stablehlo.return %1 : tensor<i1>
+    } do {
+      %1 = stablehlo.multiply %iterArg, %c : tensor<f64>
+      %2 = stablehlo.sine %iterArg : tensor<f64>
+      %3 = stablehlo.add %1, %2 : tensor<f64>
+      stablehlo.return %3 : tensor<f64>
+    }
+    return %0 : tensor<f64>
+  }
+
+  func.func @main() {
+    %input = stablehlo.constant dense<0.3> : tensor<f64>
+    %diffe = stablehlo.constant dense<1.0> : tensor<f64>
+    %limit_0 = stablehlo.constant dense<0.1> : tensor<f64>
+    %limit_1 = stablehlo.constant dense<10.0> : tensor<f64>
+    %limit_2 = stablehlo.constant dense<1000.0> : tensor<f64>
+
+    %without_checkpointing_0:2 = enzyme.autodiff @without_checkpointing(%input, %limit_0, %diffe) {
+      activity=[#enzyme<activity enzyme_active>, #enzyme<activity enzyme_const>],
+      ret_activity=[#enzyme<activity enzyme_active>]
+    } : (tensor<f64>, tensor<f64>, tensor<f64>) -> (tensor<f64>, tensor<f64>)
+    %with_snapshots_0:2 = enzyme.autodiff @with_snapshots(%input, %limit_0, %diffe) {
+      activity=[#enzyme<activity enzyme_active>, #enzyme<activity enzyme_const>],
+      ret_activity=[#enzyme<activity enzyme_active>]
+    } : (tensor<f64>, tensor<f64>, tensor<f64>) -> (tensor<f64>, tensor<f64>)
+    %with_memory_0:2 = enzyme.autodiff @with_memory(%input, %limit_0, %diffe) {
+      activity=[#enzyme<activity enzyme_active>, #enzyme<activity enzyme_const>],
+      ret_activity=[#enzyme<activity enzyme_active>]
+    } : (tensor<f64>, tensor<f64>, tensor<f64>) -> (tensor<f64>, tensor<f64>)
+    %with_small_memory_0:2 = enzyme.autodiff @with_small_memory(%input, %limit_0, %diffe) {
+      activity=[#enzyme<activity enzyme_active>, #enzyme<activity enzyme_const>],
+      ret_activity=[#enzyme<activity enzyme_active>]
+    } : (tensor<f64>, tensor<f64>, tensor<f64>) -> (tensor<f64>, tensor<f64>)
+    check.expect_almost_eq %with_snapshots_0#0, %without_checkpointing_0#0 : tensor<f64>
+    check.expect_almost_eq %with_snapshots_0#1, %without_checkpointing_0#1 : tensor<f64>
+    check.expect_almost_eq %with_memory_0#0, %without_checkpointing_0#0 : tensor<f64>
+    check.expect_almost_eq %with_memory_0#1, %without_checkpointing_0#1 : tensor<f64>
+    check.expect_almost_eq %with_small_memory_0#0, %without_checkpointing_0#0 : tensor<f64>
+    check.expect_almost_eq %with_small_memory_0#1, %without_checkpointing_0#1 : tensor<f64>
+
+    %without_checkpointing_1:2 = enzyme.autodiff @without_checkpointing(%input, %limit_1, %diffe) {
+      activity=[#enzyme<activity enzyme_active>, #enzyme<activity enzyme_const>],
+      ret_activity=[#enzyme<activity enzyme_active>]
+    } : (tensor<f64>, tensor<f64>, tensor<f64>) -> (tensor<f64>, tensor<f64>)
+    %with_snapshots_1:2 = enzyme.autodiff @with_snapshots(%input, %limit_1, %diffe) {
+      activity=[#enzyme<activity enzyme_active>, #enzyme<activity enzyme_const>],
+      ret_activity=[#enzyme<activity enzyme_active>]
+    } : (tensor<f64>, tensor<f64>, tensor<f64>) -> (tensor<f64>, tensor<f64>)
+    %with_memory_1:2 = enzyme.autodiff @with_memory(%input, %limit_1, %diffe) {
+      activity=[#enzyme<activity enzyme_active>, #enzyme<activity enzyme_const>],
+      ret_activity=[#enzyme<activity enzyme_active>]
+    } : (tensor<f64>, tensor<f64>, tensor<f64>) -> (tensor<f64>, tensor<f64>)
+    %with_small_memory_1:2 = enzyme.autodiff @with_small_memory(%input, %limit_1, %diffe) {
+      activity=[#enzyme<activity enzyme_active>, #enzyme<activity enzyme_const>],
+      ret_activity=[#enzyme<activity enzyme_active>]
+    } : (tensor<f64>, tensor<f64>, tensor<f64>) -> (tensor<f64>, tensor<f64>)
+    check.expect_almost_eq %with_snapshots_1#0, %without_checkpointing_1#0 : tensor<f64>
+    check.expect_almost_eq %with_snapshots_1#1, %without_checkpointing_1#1 : tensor<f64>
+    check.expect_almost_eq %with_memory_1#0, %without_checkpointing_1#0 : tensor<f64>
+    check.expect_almost_eq %with_memory_1#1, %without_checkpointing_1#1 : tensor<f64>
+    check.expect_almost_eq %with_small_memory_1#0, %without_checkpointing_1#0 : tensor<f64>
+    check.expect_almost_eq %with_small_memory_1#1, %without_checkpointing_1#1 : tensor<f64>
+
+    %without_checkpointing_2:2 = enzyme.autodiff @without_checkpointing(%input, %limit_2, %diffe) {
+      activity=[#enzyme<activity enzyme_active>, #enzyme<activity enzyme_const>],
+      ret_activity=[#enzyme<activity enzyme_active>]
+    } : (tensor<f64>, tensor<f64>, tensor<f64>) -> (tensor<f64>, tensor<f64>)
+    %with_snapshots_2:2 = enzyme.autodiff @with_snapshots(%input, %limit_2, %diffe) {
+      activity=[#enzyme<activity enzyme_active>, #enzyme<activity enzyme_const>],
+      ret_activity=[#enzyme<activity enzyme_active>]
+    } : (tensor<f64>, tensor<f64>, tensor<f64>) -> (tensor<f64>, tensor<f64>)
+    %with_memory_2:2 = enzyme.autodiff @with_memory(%input, %limit_2, %diffe) {
+      activity=[#enzyme<activity enzyme_active>, #enzyme<activity enzyme_const>],
+      ret_activity=[#enzyme<activity enzyme_active>]
+    } : (tensor<f64>, tensor<f64>, tensor<f64>) -> (tensor<f64>, tensor<f64>)
+    %with_small_memory_2:2 = enzyme.autodiff @with_small_memory(%input, %limit_2, %diffe) {
+      activity=[#enzyme<activity enzyme_active>, #enzyme<activity enzyme_const>],
+      ret_activity=[#enzyme<activity enzyme_active>]
+    } : (tensor<f64>, tensor<f64>, tensor<f64>) -> (tensor<f64>, tensor<f64>)
+    check.expect_almost_eq %with_snapshots_2#0, %without_checkpointing_2#0 : tensor<f64>
+    check.expect_almost_eq %with_snapshots_2#1, %without_checkpointing_2#1 : tensor<f64>
+    check.expect_almost_eq %with_memory_2#0, %without_checkpointing_2#0 : tensor<f64>
+    check.expect_almost_eq %with_memory_2#1, %without_checkpointing_2#1 : tensor<f64>
+    check.expect_almost_eq %with_small_memory_2#0, %without_checkpointing_2#0 : tensor<f64>
+    check.expect_almost_eq %with_small_memory_2#1, %without_checkpointing_2#1 : tensor<f64>
+
+    return
+  }
+}
+
+// CHECK-LABEL: func.func private @diffewith_snapshots
+// CHECK: stablehlo.while
+// CHECK: stablehlo.remainder
+// CHECK: "stablehlo.if"
+// CHECK: stablehlo.slice {{.*}} [0:4:2]
+// CHECK: stablehlo.dynamic_update_slice {{.*}} : (tensor<5xf64>
+// CHECK: stablehlo.while
+// CHECK: stablehlo.dynamic_slice {{.*}} : (tensor<5xf64>
+// CHECK: stablehlo.while
+// CHECK: "stablehlo.if"
+
+// CHECK-LABEL: func.func private @diffewith_memory
+// CHECK: stablehlo.dynamic_update_slice {{.*}} : (tensor<3xf64>
+
+// CHECK-LABEL: func.func private @diffewith_small_memory
+// CHECK-NOT: stablehlo.remainder
+// CHECK: return
+
+// REMARK: remark: snapshot budget only fits one snapshot but online checkpointing needs two, caching every iteration instead
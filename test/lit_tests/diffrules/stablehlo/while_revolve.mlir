@@ -0,0 +1,134 @@
+// RUN: enzymexlamlir-opt %s --enzyme --canonicalize --remove-unnecessary-enzyme-ops --enzyme-simplify-math --canonicalize | FileCheck %s
+// RUN: enzymexlamlir-opt %s --enzyme --canonicalize --remove-unnecessary-enzyme-ops --enzyme-simplify-math --arith-raise --canonicalize | stablehlo-translate --interpret
+
+module {
+  func.func @without_checkpointing(%arg0: tensor<f64>) -> tensor<f64> {
+    %c = stablehlo.constant dense<1> : tensor<i64>
+    %c_0 = stablehlo.constant dense<9> : tensor<i64>
+    %c_1 = stablehlo.constant dense<0> : tensor<i64>
+    %0:2 = stablehlo.while(%iterArg = %c_1, %iterArg_2 = %arg0) : tensor<i64>, tensor<f64> attributes {enzyme.disable_mincut}
+     cond {
+      %1 = stablehlo.compare  LT, %iterArg, %c_0 : (tensor<i64>, tensor<i64>) -> tensor<i1>
+      stablehlo.return %1 : tensor<i1>
+    } do {
+      %1 = stablehlo.add %iterArg, %c : tensor<i64>
+      %2 = stablehlo.convert %1 : (tensor<i64>) -> tensor<f64>
+      %3 = stablehlo.multiply %iterArg_2, %2 : tensor<f64>
+      %4 = stablehlo.sine %3 : tensor<f64>
+      stablehlo.return %1, %4 : tensor<i64>, tensor<f64>
+    }
+    return %0#1 : tensor<f64>
+  }
+
+  func.func @with_snapshots(%arg0: tensor<f64>) -> tensor<f64> {
+    %c = stablehlo.constant dense<1> : tensor<i64>
+    %c_0 = stablehlo.constant dense<9> : tensor<i64>
+    %c_1 = stablehlo.constant dense<0> : tensor<i64>
+    %0:2 = stablehlo.while(%iterArg = %c_1, %iterArg_2 = %arg0) : tensor<i64>, tensor<f64> attributes {enzyme.disable_mincut, enzymexla.checkpoint_snapshots = 3 : i64}
+     cond {
+      %1 = stablehlo.compare  LT, %iterArg, %c_0 : (tensor<i64>, tensor<i64>) -> tensor<i1>
+      stablehlo.return %1 : tensor<i1>
+    } do {
+      %1 = stablehlo.add %iterArg, %c : tensor<i64>
+      %2 = stablehlo.convert %1 : (tensor<i64>) -> tensor<f64>
+      %3 = stablehlo.multiply %iterArg_2, %2 : tensor<f64>
+      %4 = stablehlo.sine %3 : tensor<f64>
+      stablehlo.return %1, %4 : tensor<i64>, tensor<f64>
+    }
+    return %0#1 : tensor<f64>
+  }
+
+  // 24 bytes hold two f64 snapshots and the scratch slot.
+  func.func @with_memory(%arg0: tensor<f64>) -> tensor<f64> {
+    %c = stablehlo.constant dense<1> : tensor<i64>
+    %c_0 = stablehlo.constant dense<9> : tensor<i64>
+    %c_1 = stablehlo.constant dense<0> : tensor<i64>
+    %0:2 = stablehlo.while(%iterArg = %c_1, %iterArg_2 = %arg0) : tensor<i64>, tensor<f64> attributes {enzyme.disable_mincut, enzymexla.checkpoint_memory = 24 : i64}
+     cond {
+      %1 = stablehlo.compare  LT, %iterArg, %c_0 : (tensor<i64>, tensor<i64>) -> tensor<i1>
+      stablehlo.return %1 : tensor<i1>
+    } do {
+      %1 = stablehlo.add %iterArg, %c : tensor<i64>
+      %2 = stablehlo.convert %1 : (tensor<i64>) -> tensor<f64>
+      %3 = stablehlo.multiply %iterArg_2, %2 : tensor<f64>
+      %4 = stablehlo.sine %3 : tensor<f64>
+      stablehlo.return %1, %4 : tensor<i64>, tensor<f64>
+    }
+    return %0#1 : tensor<f64>
+  }
+
+  // The loop starts at its limit and never runs.
+  func.func @zero_trip(%arg0: tensor<f64>) -> tensor<f64> {
+    %c = stablehlo.constant dense<1> : tensor<i64>
+    %c_0 = stablehlo.constant dense<9> : tensor<i64>
+    %0:2 = stablehlo.while(%iterArg = %c_0, %iterArg_2 = %arg0) : tensor<i64>, tensor<f64> attributes {enzyme.disable_mincut, enzymexla.checkpoint_snapshots = 3 : i64}
+     cond {
+      %1 = stablehlo.compare  LT, %iterArg, %c_0 : (tensor<i64>, tensor<i64>) -> tensor<i1>
+      stablehlo.return %1 : tensor<i1>
+    } do {
+      %1 = stablehlo.add %iterArg, %c : tensor<i64>
+      %2 = stablehlo.convert %1 : (tensor<i64>) -> tensor<f64>
+      %3 = stablehlo.multiply %iterArg_2, %2 : tensor<f64>
+      %4 = stablehlo.sine %3 : tensor<f64>
+      stablehlo.return %1, %4 : tensor<i64>, tensor<f64>
+    }
+    return %0#1 : tensor<f64>
+  }
+
+  func.func @main() {
+    %input = stablehlo.constant dense<0.3> : tensor<f64>
+    %diffe = stablehlo.constant dense<1.0> : tensor<f64>
+
+    %expected:2 = enzyme.autodiff @without_checkpointing(%input, %diffe) {
+      activity=[#enzyme<activity enzyme_active>],
+      ret_activity=[#enzyme<activity enzyme_active>]
+    } : (tensor<f64>, tensor<f64>) -> (tensor<f64>, tensor<f64>)
+
+    %snapshots:2 = enzyme.autodiff @with_snapshots(%input, %diffe) {
+      activity=[#enzyme<activity enzyme_active>],
+      ret_activity=[#enzyme<activity enzyme_active>]
+    } : (tensor<f64>, tensor<f64>) -> (tensor<f64>, tensor<f64>)
+
+    %memory:2 = enzyme.autodiff @with_memory(%input, %diffe) {
+      activity=[#enzyme<activity enzyme_active>],
+      ret_activity=[#enzyme<activity enzyme_active>]
+    } : (tensor<f64>, tensor<f64>) -> (tensor<f64>, tensor<f64>)
+
+    check.expect_almost_eq %snapshots#0, %expected#0 : tensor<f64>
+    check.expect_almost_eq %snapshots#1, %expected#1 : tensor<f64>
+    check.expect_almost_eq %memory#0, %expected#0 : tensor<f64>
+    check.expect_almost_eq %memory#1, %expected#1 : tensor<f64>
+
+    %zero:2 = enzyme.autodiff @zero_trip(%input, %diffe) {
+      activity=[#enzyme<activity enzyme_active>],
+      ret_activity=[#enzyme<activity enzyme_active>]
+    } : (tensor<f64>, tensor<f64>) -> (tensor<f64>, tensor<f64>)
+
+    check.expect_almost_eq %zero#0, %input : tensor<f64>
+    check.expect_almost_eq %zero#1, %diffe : tensor<f64>
+
+    return
+  }
+}
+
+// Reversing 9 iterations with 3 snapshots takes 17 actions, and the snapshot
+// buffer has a scratch slot on top.
+
+// CHECK-LABEL: func.func private @diffewith_snapshots
+// CHECK: stablehlo.constant dense<{{.*}}> : tensor<17x5xi64>
+// CHECK: stablehlo.broadcast_in_dim {{.*}} -> tensor<4xf64>
+// CHECK: stablehlo.while
+// CHECK: stablehlo.dynamic_slice {{.*}} sizes = [1, 5]
+// CHECK: stablehlo.while
+// CHECK: stablehlo.dynamic_update_slice
+// CHECK: "stablehlo.if"
+
+// CHECK-LABEL: func.func private @diffewith_memory
+// CHECK: stablehlo.constant dense<{{.*}}> : tensor<17x5xi64>
+// CHECK: stablehlo.broadcast_in_dim {{.*}} -> tensor<3xf64>
+
+// Without iterations there is no schedule, the adjoint is passed through.
+
+// CHECK-LABEL: func.func private @diffezero_trip
+// CHECK-NOT: stablehlo.dynamic_slice
+// CHECK: return
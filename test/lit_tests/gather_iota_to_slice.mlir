@@ -1,4 +1,5 @@
 // RUN: enzymexlamlir-opt --enzyme-hlo-opt %s | FileCheck %s
+// RUN: enzymexlamlir-opt --enzyme-hlo-opt="driver=worklist" %s | FileCheck %s
 
 // ============================================================================
 // Tests for gather with iota-like indexing that converts to slice
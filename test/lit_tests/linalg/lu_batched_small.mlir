@@ -0,0 +1,21 @@
+// RUN: enzymexlamlir-opt --pass-pipeline="builtin.module(lower-enzymexla-linalg{backend=cpu blas_int_width=64},lower-enzymexla-lapack{backend=cpu blas_int_width=64 batched_kernel_max_size=4},enzyme-hlo-opt)" %s | FileCheck %s --check-prefix=KERNEL
+// RUN: enzymexlamlir-opt --pass-pipeline="builtin.module(lower-enzymexla-linalg{backend=cpu blas_int_width=64},lower-enzymexla-lapack{backend=cpu blas_int_width=64 batched_kernel_max_size=2},enzyme-hlo-opt)" %s | FileCheck %s --check-prefix=LAPACK
+
+module {
+  func.func @main(%arg0: tensor<128x4x4xf32>) -> (tensor<128x4x4xf32>, tensor<128x4xi32>, tensor<128x4xi32>, tensor<128xi32>) {
+    %0:4 = enzymexla.linalg.lu %arg0 : (tensor<128x4x4xf32>) -> (tensor<128x4x4xf32>, tensor<128x4xi32>, tensor<128x4xi32>, tensor<128xi32>)
+    return %0#0, %0#1, %0#2, %0#3 : tensor<128x4x4xf32>, tensor<128x4xi32>, tensor<128x4xi32>, tensor<128xi32>
+  }
+}
+
+// KERNEL-NOT: llvm.func
+// KERNEL:     func.func @main(%arg0: tensor<128x4x4xf32>)
+// KERNEL-NOT: enzymexla.jit_call
+// KERNEL-NOT: stablehlo.while
+// KERNEL:     stablehlo.reduce
+// KERNEL:     stablehlo.divide
+// KERNEL:     stablehlo.concatenate
+// KERNEL-NOT: enzymexla.jit_call
+
+// LAPACK: llvm.func @enzymexla_lapack_sgetrf_
+// LAPACK: enzymexla.jit_call @enzymexla_lapack_sgetrf_wrapper
@@ -0,0 +1,50 @@
+// RUN: enzymexlamlir-opt --lower-enzymexla-blas="backend=cpu" %s | FileCheck %s --check-prefix=CPU
+// RUN: enzymexlamlir-opt --lower-enzymexla-blas="backend=tpu" %s | FileCheck %s --check-prefix=TPU
+
+module {
+  func.func @left(%arg0: tensor<4x4xf32>, %arg1: tensor<5x4xf32>, %arg2: tensor<4x5xf32>) -> tensor<4x5xf32> {
+    %alpha = stablehlo.constant dense<2.0> : tensor<f32>
+    %beta = stablehlo.constant dense<3.0> : tensor<f32>
+    %0 = enzymexla.blas.symm %arg0, %arg1, %arg2, %alpha, %beta {side = #enzymexla.side<left>, uplo = #enzymexla.uplo<U>} : (tensor<4x4xf32>, tensor<5x4xf32>, tensor<4x5xf32>, tensor<f32>, tensor<f32>) -> tensor<4x5xf32>
+    return %0 : tensor<4x5xf32>
+  }
+
+  func.func @right(%arg0: tensor<5x4xf32>, %arg1: tensor<4x4xf32>) -> tensor<5x4xf32> {
+    %c = stablehlo.constant dense<0.0> : tensor<5x4xf32>
+    %alpha = stablehlo.constant dense<1.0> : tensor<f32>
+    %beta = stablehlo.constant dense<0.0> : tensor<f32>
+    %0 = enzymexla.blas.symm %arg0, %arg1, %c, %alpha, %beta {side = #enzymexla.side<right>, uplo = #enzymexla.uplo<F>} : (tensor<5x4xf32>, tensor<4x4xf32>, tensor<5x4xf32>, tensor<f32>, tensor<f32>) -> tensor<5x4xf32>
+    return %0 : tensor<5x4xf32>
+  }
+}
+
+// CPU: func.func private @enzymexla_blas_ssymm_wrapper_{{[0-9]+}}(%arg0: tensor<5x4xf32>, %arg1: tensor<4x4xf32>, %arg2: tensor<5x4xf32>, %arg3: tensor<f32>, %arg4: tensor<f32>) -> tensor<5x4xf32> {
+// CPU-NOT:   stablehlo.transpose
+// CPU:       enzymexla.jit_call @enzymexla_blas_ssymm_wrapper (%{{.+}}, %{{.+}}, %{{.+}}, %{{.+}}, %arg3, %arg1, %{{.+}}, %arg0, %{{.+}}, %arg4, %arg2, %{{.+}}) {{.*}}output_operand_aliases = [#stablehlo.output_operand_alias<output_tuple_indices = [], operand_index = 10, operand_tuple_indices = []>]
+
+// CPU: func.func private @enzymexla_blas_ssymm_wrapper_{{[0-9]+}}(%arg0: tensor<4x4xf32>, %arg1: tensor<5x4xf32>, %arg2: tensor<4x5xf32>, %arg3: tensor<f32>, %arg4: tensor<f32>) -> tensor<4x5xf32> {
+// CPU-DAG:   %[[BT:.+]] = stablehlo.transpose %arg1, dims = [1, 0] : (tensor<5x4xf32>) -> tensor<4x5xf32>
+// CPU-DAG:   %[[SIDE:.+]] = stablehlo.constant dense<82> : tensor<ui8>
+// CPU-DAG:   %[[UPLO:.+]] = stablehlo.constant dense<76> : tensor<ui8>
+// CPU:       enzymexla.jit_call @enzymexla_blas_ssymm_wrapper (%[[SIDE]], %[[UPLO]], %{{.+}}, %{{.+}}, %arg3, %arg0, %{{.+}}, %[[BT]], %{{.+}}, %arg4, %arg2, %{{.+}})
+
+// CPU: llvm.func private @enzymexla_blas_ssymm_wrapper(%arg0: !llvm.ptr, %arg1: !llvm.ptr, %arg2: !llvm.ptr, %arg3: !llvm.ptr, %arg4: !llvm.ptr, %arg5: !llvm.ptr, %arg6: !llvm.ptr, %arg7: !llvm.ptr, %arg8: !llvm.ptr, %arg9: !llvm.ptr, %arg10: !llvm.ptr, %arg11: !llvm.ptr) {
+// CPU:   llvm.func @enzymexla_blas_ssymm_(!llvm.ptr, !llvm.ptr, !llvm.ptr, !llvm.ptr, !llvm.ptr, !llvm.ptr, !llvm.ptr, !llvm.ptr, !llvm.ptr, !llvm.ptr, !llvm.ptr, !llvm.ptr, i64, i64)
+
+// CPU-LABEL: func.func @left
+// CPU:         call @enzymexla_blas_ssymm_wrapper_{{[0-9]+}}(%arg0, %arg1, %arg2, %{{.+}}, %{{.+}})
+// CPU-LABEL: func.func @right
+// CPU:         call @enzymexla_blas_ssymm_wrapper_{{[0-9]+}}(%arg0, %arg1, %{{.+}}, %{{.+}}, %{{.+}})
+
+// TPU-LABEL: func.func @left
+// TPU:         %[[SYM:.+]] = stablehlo.select
+// TPU:         %[[AB:.+]] = stablehlo.dot_general %[[SYM]], %arg1, contracting_dims = [1] x [1] : (tensor<4x4xf32>, tensor<5x4xf32>) -> tensor<4x5xf32>
+// TPU:         stablehlo.multiply %{{.+}}, %[[AB]]
+// TPU:         stablehlo.add
+
+// TPU-LABEL: func.func @right
+// TPU-NOT:     stablehlo.select
+// TPU:         %[[AB:.+]] = stablehlo.dot_general %arg0, %arg1, contracting_dims = [1] x [1] : (tensor<5x4xf32>, tensor<4x4xf32>) -> tensor<5x4xf32>
+// TPU:         %[[RES:.+]] = stablehlo.multiply %{{.+}}, %[[AB]]
+// TPU-NOT:     stablehlo.add
+// TPU:         return %[[RES]]
@@ -0,0 +1,27 @@
+// RUN: enzymexlamlir-opt --lower-enzymexla-blas="backend=cpu" %s | FileCheck %s --check-prefix=CPU
+// RUN: enzymexlamlir-opt --lower-enzymexla-blas="backend=tpu" %s | FileCheck %s --check-prefix=TPU
+
+module {
+  func.func @main(%arg0: tensor<4x4xf32>, %arg1: tensor<4x5xf32>) -> tensor<4x5xf32> {
+    %alpha = stablehlo.constant dense<2.0> : tensor<f32>
+    %0 = enzymexla.blas.trmm %arg0, %arg1, %alpha, {side = #enzymexla.side<left>, uplo = #enzymexla.uplo<L>, transpose = #enzymexla.transpose<none>} : (tensor<4x4xf32>, tensor<4x5xf32>, tensor<f32>) -> tensor<4x5xf32>
+    return %0 : tensor<4x5xf32>
+  }
+}
+
+// CPU: func.func private @enzymexla_blas_strmm_wrapper_{{[0-9]+}}(%arg0: tensor<4x4xf32>, %arg1: tensor<4x5xf32>, %arg2: tensor<f32>) -> tensor<4x5xf32> {
+// CPU-DAG:   %[[SIDE:.+]] = stablehlo.constant dense<82> : tensor<ui8>
+// CPU-DAG:   %[[UPLO:.+]] = stablehlo.constant dense<85> : tensor<ui8>
+// CPU-DAG:   %[[TRANS:.+]] = stablehlo.constant dense<78> : tensor<ui8>
+// CPU:       enzymexla.jit_call @enzymexla_blas_strmm_wrapper (%[[SIDE]], %[[UPLO]], %[[TRANS]], %{{.+}}, %{{.+}}, %{{.+}}, %arg2, %arg0, %{{.+}}, %arg1, %{{.+}}) {{.*}}output_operand_aliases = [#stablehlo.output_operand_alias<output_tuple_indices = [], operand_index = 9, operand_tuple_indices = []>]
+// CPU: llvm.func @enzymexla_blas_strmm_(!llvm.ptr, !llvm.ptr, !llvm.ptr, !llvm.ptr, !llvm.ptr, !llvm.ptr, !llvm.ptr, !llvm.ptr, !llvm.ptr, !llvm.ptr, !llvm.ptr, i64, i64, i64, i64)
+// CPU-LABEL: func.func @main
+// CPU:         call @enzymexla_blas_strmm_wrapper_{{[0-9]+}}(%arg0, %arg1, %{{.+}})
+
+// TPU-LABEL: func.func @main
+// TPU-DAG:     %[[ROW:.+]] = stablehlo.iota dim = 0 : tensor<4x4xi32>
+// TPU-DAG:     %[[COL:.+]] = stablehlo.iota dim = 1 : tensor<4x4xi32>
+// TPU:         %[[MASK:.+]] = stablehlo.compare  GE, %[[ROW]], %[[COL]]
+// TPU:         %[[TRI:.+]] = stablehlo.select %[[MASK]], %arg0, %{{.+}}
+// TPU:         %[[PROD:.+]] = stablehlo.dot_general %[[TRI]], %arg1, contracting_dims = [1] x [0] : (tensor<4x4xf32>, tensor<4x5xf32>) -> tensor<4x5xf32>
+// TPU:         stablehlo.multiply %{{.+}}, %[[PROD]]
@@ -0,0 +1,116 @@
+// RUN: enzymexlamlir-opt --cpuify="method=distribute.simd" --split-input-file %s | FileCheck %s
+
+module {
+  func.func @kernel(%n: index, %a: memref<?xf32>, %b: memref<?xf32>, %c: memref<?xf32>, %d: memref<?xf32>) {
+    %c0 = arith.constant 0 : index
+    %c1 = arith.constant 1 : index
+    %c4 = arith.constant 4 : index
+    %c32 = arith.constant 32 : index
+    %cst = arith.constant 0.000000e+00 : f32
+    scf.parallel (%bx, %tx) = (%c0, %c0) to (%n, %c32) step (%c1, %c1) {
+      %0 = arith.muli %bx, %c32 : index
+      %1 = arith.addi %0, %tx : index
+      %2 = memref.load %a[%1] : memref<?xf32>
+      %3 = arith.muli %tx, %c4 : index
+      %4 = memref.load %b[%3] : memref<?xf32>
+      %5 = arith.addf %2, %4 : f32
+      %6 = arith.cmpf ogt, %5, %cst : f32
+      %7 = scf.if %6 -> (f32) {
+        memref.store %5, %c[%1] : memref<?xf32>
+        scf.yield %5 : f32
+      } else {
+        %8 = arith.negf %5 : f32
+        scf.yield %8 : f32
+      }
+      memref.store %7, %d[%3] : memref<?xf32>
+      scf.reduce
+    }
+    return
+  }
+}
+
+// CHECK-LABEL: func.func @kernel
+// CHECK:         %[[C8:.+]] = arith.constant 8 : index
+// CHECK:         scf.parallel (%{{.+}}, %[[TX:.+]]) = {{.*}} step (%{{.+}}, %{{.+}})
+// CHECK:           %[[A:.+]] = vector.load %{{.+}}[%{{.+}}] : memref<?xf32>, vector<8xf32>
+// CHECK:           %[[B:.+]] = vector.gather %{{.+}}[%{{.+}}] [%{{.+}}], %{{.+}}, %{{.+}} : memref<?xf32>, vector<8xindex>, vector<8xi1>, vector<8xf32> into vector<8xf32>
+// CHECK:           %[[S:.+]] = arith.addf %[[A]], %[[B]] : vector<8xf32>
+// CHECK:           %[[COND:.+]] = arith.cmpf ogt, %[[S]], %{{.+}} : vector<8xf32>
+// CHECK:           vector.maskedstore %{{.+}}[%{{.+}}], %[[COND]], %[[S]] : memref<?xf32>, vector<8xi1>, vector<8xf32>
+// CHECK:           %[[NEG:.+]] = arith.negf %[[S]] : vector<8xf32>
+// CHECK:           %[[SEL:.+]] = arith.select %[[COND]], %[[S]], %[[NEG]] : vector<8xi1>, vector<8xf32>
+// CHECK:           vector.scatter %{{.+}}[%{{.+}}] [%{{.+}}], %{{.+}}, %[[SEL]] : memref<?xf32>, vector<8xindex>, vector<8xi1>, vector<8xf32>
+// CHECK-NOT:       scf.if
+
+// -----
+
+module {
+  func.func @tail(%n: index, %a: memref<?xi32>) {
+    %c0 = arith.constant 0 : index
+    %c1 = arith.constant 1 : index
+    %c3 = arith.constant 3 : i32
+    scf.parallel (%tx) = (%c0) to (%n) step (%c1) {
+      %0 = memref.load %a[%tx] : memref<?xi32>
+      %1 = arith.muli %0, %c3 : i32
+      memref.store %1, %a[%tx] : memref<?xi32>
+      scf.reduce
+    }
+    return
+  }
+}
+
+// CHECK-LABEL: func.func @tail
+// CHECK:         scf.parallel (%[[TX:.+]]) =
+// CHECK:           %[[LANES:.+]] = arith.addi %{{.+}}, %{{.+}} : vector<8xindex>
+// CHECK:           %[[MASK:.+]] = arith.cmpi slt, %[[LANES]], %{{.+}} : vector<8xindex>
+// CHECK:           %[[V:.+]] = vector.maskedload %{{.+}}[%[[TX]]], %[[MASK]], %{{.+}} : memref<?xi32>, vector<8xi1>, vector<8xi32> into vector<8xi32>
+// CHECK:           %[[M:.+]] = arith.muli %[[V]], %{{.+}} : vector<8xi32>
+// CHECK:           vector.maskedstore %{{.+}}[%[[TX]]], %[[MASK]], %[[M]] : memref<?xi32>, vector<8xi1>, vector<8xi32>
+
+// -----
+
+module {
+  func.func @tail_div(%n: index, %a: memref<?xi32>) {
+    %c0 = arith.constant 0 : index
+    %c1 = arith.constant 1 : index
+    %c100 = arith.constant 100 : i32
+    scf.parallel (%tx) = (%c0) to (%n) step (%c1) {
+      %0 = memref.load %a[%tx] : memref<?xi32>
+      %1 = arith.divsi %c100, %0 : i32
+      memref.store %1, %a[%tx] : memref<?xi32>
+      scf.reduce
+    }
+    return
+  }
+}
+
+// Masked-off tail lanes load zero, so the division stays scalar.
+// CHECK-LABEL: func.func @tail_div
+// CHECK:         scf.parallel (%[[TX:.+]]) = (%{{.+}}) to (%{{.+}}) step (%{{.+}})
+// CHECK:           %[[V:.+]] = memref.load %{{.+}}[%[[TX]]] : memref<?xi32>
+// CHECK:           arith.divsi %{{.+}}, %[[V]] : i32
+// CHECK-NOT:       vector
+
+// -----
+
+module {
+  func.func @full_div(%a: memref<?xi32>) {
+    %c0 = arith.constant 0 : index
+    %c1 = arith.constant 1 : index
+    %c64 = arith.constant 64 : index
+    %c100 = arith.constant 100 : i32
+    scf.parallel (%tx) = (%c0) to (%c64) step (%c1) {
+      %0 = memref.load %a[%tx] : memref<?xi32>
+      %1 = arith.divsi %c100, %0 : i32
+      memref.store %1, %a[%tx] : memref<?xi32>
+      scf.reduce
+    }
+    return
+  }
+}
+
+// CHECK-LABEL: func.func @full_div
+// CHECK:         scf.parallel
+// CHECK:           %[[V:.+]] = vector.load %{{.+}}[%{{.+}}] : memref<?xi32>, vector<8xi32>
+// CHECK:           %[[D:.+]] = arith.divsi %{{.+}}, %[[V]] : vector<8xi32>
+// CHECK:           vector.store %[[D]], %{{.+}}[%{{.+}}] : memref<?xi32>, vector<8xi32>
@@ -0,0 +1,49 @@
+// RUN: enzymexlamlir-opt %s --pass-pipeline="builtin.module(lower-jit{backend=cpu autotune=true})" | FileCheck %s
+// RUN: enzymexlamlir-opt %s --pass-pipeline="builtin.module(lower-jit{backend=cpu autotune=true dump_final_module=true})" 2>&1 >/dev/null | FileCheck %s --check-prefix=LLVM
+
+module {
+  func.func private @foo(%arg0: !llvm.ptr<1>) {
+    %c0 = arith.constant 0 : index
+    %c1 = arith.constant 1 : index
+    %c2 = arith.constant 2 : index
+    %c64 = arith.constant 64 : index
+    "enzymexla.alternatives"() ({
+      scf.for %arg1 = %c0 to %c64 step %c1 {
+        %0 = arith.index_cast %arg1 : index to i64
+        %1 = llvm.getelementptr %arg0[%0] : (!llvm.ptr<1>, i64) -> !llvm.ptr<1>, i64
+        %2 = llvm.load %1 {alignment = 8 : i64} : !llvm.ptr<1> -> i64
+        %3 = llvm.mul %2, %2 : i64
+        llvm.store %3, %1 {alignment = 8 : i64} : i64, !llvm.ptr<1>
+      }
+      "enzymexla.polygeist_yield"() : () -> ()
+    }, {
+      scf.for %arg1 = %c0 to %c64 step %c2 {
+        %0 = arith.index_cast %arg1 : index to i64
+        %1 = llvm.getelementptr %arg0[%0] : (!llvm.ptr<1>, i64) -> !llvm.ptr<1>, i64
+        %2 = llvm.load %1 {alignment = 8 : i64} : !llvm.ptr<1> -> i64
+        %3 = llvm.mul %2, %2 : i64
+        llvm.store %3, %1 {alignment = 8 : i64} : i64, !llvm.ptr<1>
+        %4 = llvm.getelementptr %1[1] : (!llvm.ptr<1>) -> !llvm.ptr<1>, i64
+        %5 = llvm.load %4 {alignment = 8 : i64} : !llvm.ptr<1> -> i64
+        %6 = llvm.mul %5, %5 : i64
+        llvm.store %6, %4 {alignment = 8 : i64} : i64, !llvm.ptr<1>
+      }
+      "enzymexla.polygeist_yield"() : () -> ()
+    }) {"alternatives.descs" = ["unroll1", "unroll2"]} : () -> ()
+    return
+  }
+  func.func @main(%arg0: tensor<64xi64>) -> tensor<64xi64> {
+    %0 = enzymexla.jit_call @foo (%arg0) {output_operand_aliases = [#stablehlo.output_operand_alias<output_tuple_indices = [], operand_index = 0, operand_tuple_indices = []>]} : (tensor<64xi64>) -> tensor<64xi64>
+    return %0 : tensor<64xi64>
+  }
+}
+
+// CHECK-LABEL: @main
+// CHECK:         stablehlo.custom_call @enzymexla_compile_cpu(%arg0)
+
+// LLVM: final_llvm_module before jit:
+// LLVM-DAG: declare i32 @enzymexla_autotune_begin(ptr)
+// LLVM-DAG: declare void @enzymexla_autotune_end(ptr, i32)
+// LLVM-DAG: %[[CHOICE:.+]] = call i32 @enzymexla_autotune_begin(ptr
+// LLVM-DAG: icmp eq i32 %[[CHOICE]], 0
+// LLVM-DAG: call void @enzymexla_autotune_end(ptr {{.*}}, i32 %[[CHOICE]])
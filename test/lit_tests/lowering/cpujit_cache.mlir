@@ -0,0 +1,20 @@
+// RUN: rm -rf %t
+// RUN: enzymexlamlir-opt %s --pass-pipeline="builtin.module(lower-jit{backend=cpu object_cache_dir=%t})" | FileCheck %s
+// RUN: ls %t | FileCheck %s --check-prefix=CACHE
+// RUN: enzymexlamlir-opt %s --pass-pipeline="builtin.module(lower-jit{backend=cpu object_cache_dir=%t})" | FileCheck %s
+// RUN: ls %t | count 1
+
+module @reactant_throw attributes {mhlo.num_partitions = 1 : i64, mhlo.num_replicas = 1 : i64} {
+  llvm.mlir.global external constant @error_msg("my custom error msg") {addr_space = 0 : i32}
+  func.func @error() -> !llvm.ptr {
+    %0 = llvm.mlir.addressof @error_msg : !llvm.ptr
+    return %0 : !llvm.ptr
+  }
+  func.func @main() {
+    // CHECK: stablehlo.custom_call @enzymexla_compile_cpu_with_error()
+    enzymexla.jit_call @error () : () -> ()
+    return
+  }
+}
+
+// CACHE: {{^[0-9a-f]+}}.o
@@ -0,0 +1,33 @@
+// RUN: enzymexlamlir-opt %s --pass-pipeline="builtin.module(lower-jit{backend=cpu intra_op_parallel=true})" | FileCheck %s
+// RUN: enzymexlamlir-opt %s --pass-pipeline="builtin.module(lower-jit{backend=cpu intra_op_parallel=true dump_final_module=true})" 2>&1 >/dev/null | FileCheck %s --check-prefix=LLVM
+
+module {
+  func.func private @foo(%arg0: !llvm.ptr<1>) {
+    %c0 = arith.constant 0 : index
+    %c1 = arith.constant 1 : index
+    %c64 = arith.constant 64 : index
+    scf.parallel (%arg1) = (%c0) to (%c64) step (%c1) {
+      %0 = arith.index_cast %arg1 : index to i64
+      %1 = llvm.getelementptr %arg0[%0] : (!llvm.ptr<1>, i64) -> !llvm.ptr<1>, i64
+      %2 = llvm.load %1 {alignment = 8 : i64} : !llvm.ptr<1> -> i64
+      %3 = llvm.mul %2, %2 : i64
+      llvm.store %3, %1 {alignment = 8 : i64} : i64, !llvm.ptr<1>
+      scf.reduce
+    }
+    return
+  }
+  func.func @main(%arg0: tensor<64xi64>) -> tensor<64xi64> {
+    %0 = enzymexla.jit_call @foo (%arg0) {output_operand_aliases = [#stablehlo.output_operand_alias<output_tuple_indices = [], operand_index = 0, operand_tuple_indices = []>]} : (tensor<64xi64>) -> tensor<64xi64>
+    return %0 : tensor<64xi64>
+  }
+}
+
+// CHECK-LABEL: @main
+// CHECK:         stablehlo.custom_call @enzymexla_compile_cpu_ffi(%arg0)
+// CHECK-SAME:    api_version = 4 : i32
+
+// LLVM: final_llvm_module before jit:
+// LLVM-DAG: declare void @enzymexla_parallel_for(i64, ptr, ptr)
+// LLVM-DAG: call void @enzymexla_parallel_for(i64 {{.*}}, ptr @__enzymexla_parallel_trampoline_0, ptr
+// LLVM-DAG: define internal void @__enzymexla_parallel_trampoline_0(ptr
+// LLVM-DAG: call void @__enzymexla_parallel_body_0(
@@ -0,0 +1,39 @@
+// RUN: enzymexlamlir-opt --pass-pipeline="builtin.module(lower-enzymexla-mpi{backend=cpu})" %s | FileCheck %s --check-prefix=CPU
+
+module {
+  func.func @main(%color: tensor<i32>, %key: tensor<i32>) -> tensor<i32> {
+    %comm = enzymexla.mpi.comm_split(%color, %key) : (tensor<i32>, tensor<i32>) -> tensor<i64>
+    %dup = enzymexla.mpi.comm_dup(%comm) : (tensor<i64>) -> tensor<i64>
+    %rank = enzymexla.mpi.comm_rank(%dup : tensor<i64>) : tensor<i32>
+    enzymexla.mpi.comm_free(%dup) : tensor<i64>
+    enzymexla.mpi.comm_free(%comm) : tensor<i64>
+    return %rank : tensor<i32>
+  }
+}
+
+// CPU-DAG:  llvm.func @MPI_Comm_split(!llvm.ptr, i32, i32, !llvm.ptr) -> i32
+// CPU-DAG:  llvm.func @MPI_Comm_dup(!llvm.ptr, !llvm.ptr) -> i32
+// CPU-DAG:  llvm.func @MPI_Comm_free(!llvm.ptr) -> i32
+// CPU-DAG:  llvm.func @MPI_Comm_rank(!llvm.ptr, !llvm.ptr) -> i32
+
+// CPU:      llvm.func @enzymexla_wrapper_MPI_Comm_rank_comm(%arg0: !llvm.ptr {{.*}}, %arg1: !llvm.ptr {{.*}})
+// CPU:        %[[COMM:.+]] = llvm.load %arg1 : !llvm.ptr -> !llvm.ptr
+// CPU:        llvm.call @MPI_Comm_rank(%[[COMM]], %arg0)
+
+// CPU:      llvm.func @enzymexla_wrapper_MPI_Comm_dup_comm(%arg0: !llvm.ptr {{.*}}, %arg1: !llvm.ptr {{.*}})
+// CPU-NEXT:   %[[COMM:.+]] = llvm.load %arg0 : !llvm.ptr -> !llvm.ptr
+// CPU-NEXT:   llvm.call @MPI_Comm_dup(%[[COMM]], %arg1)
+
+// CPU:      llvm.func @enzymexla_wrapper_MPI_Comm_split(%arg0: !llvm.ptr {{.*}}, %arg1: !llvm.ptr {{.*}}, %arg2: !llvm.ptr {{.*}})
+// CPU-NEXT:   %[[COLOR:.+]] = llvm.load %arg0 : !llvm.ptr -> i32
+// CPU-NEXT:   %[[KEY:.+]] = llvm.load %arg1 : !llvm.ptr -> i32
+// CPU-NEXT:   %[[WORLD:.+]] = llvm.mlir.addressof @MPI_COMM_WORLD : !llvm.ptr
+// CPU-NEXT:   llvm.call @MPI_Comm_split(%[[WORLD]], %[[COLOR]], %[[KEY]], %arg2)
+
+// CPU:      func.func @main(%arg0: tensor<i32>, %arg1: tensor<i32>) -> tensor<i32> {
+// CPU:        %[[H:.+]] = stablehlo.constant dense<-1> : tensor<i64>
+// CPU:        %[[SPLIT:.+]] = enzymexla.jit_call @enzymexla_wrapper_MPI_Comm_split (%arg0, %arg1, %[[H]]) {{.*}}output_operand_aliases = [#stablehlo.output_operand_alias<output_tuple_indices = [], operand_index = 2, operand_tuple_indices = []>]{{.*}} -> tensor<i64>
+// CPU:        %[[DUP:.+]] = enzymexla.jit_call @enzymexla_wrapper_MPI_Comm_dup_comm (%[[SPLIT]], {{.*}}) {{.*}}operand_index = 1{{.*}} -> tensor<i64>
+// CPU:        enzymexla.jit_call @enzymexla_wrapper_MPI_Comm_rank_comm ({{.*}}, %[[DUP]])
+// CPU:        enzymexla.jit_call @enzymexla_wrapper_MPI_Comm_free (%[[DUP]])
+// CPU:        enzymexla.jit_call @enzymexla_wrapper_MPI_Comm_free (%[[SPLIT]])
@@ -0,0 +1,54 @@
+// RUN: enzymexlamlir-opt --pass-pipeline="builtin.module(lower-enzymexla-mpi{backend=cpu})" %s | FileCheck %s --check-prefix=CPU
+
+// Exchanges a value that changes in every iteration with the same peer. Only
+// the requests are created once, the data goes through start and wait.
+module {
+  func.func @main(%buf: tensor<5xf64>) -> tensor<5xf64> {
+    %c0 = stablehlo.constant dense<0> : tensor<i64>
+    %c1 = stablehlo.constant dense<1> : tensor<i64>
+    %c10 = stablehlo.constant dense<10> : tensor<i64>
+    %count = stablehlo.constant dense<5> : tensor<i32>
+    %peer = stablehlo.constant dense<1> : tensor<i32>
+    %tag = stablehlo.constant dense<42> : tensor<i32>
+    %res:2 = stablehlo.while(%iter = %c0, %acc = %buf) : tensor<i64>, tensor<5xf64>
+    cond {
+      %cmp = stablehlo.compare LT, %iter, %c10 : (tensor<i64>, tensor<i64>) -> tensor<i1>
+      stablehlo.return %cmp : tensor<i1>
+    } do {
+      %sreq = enzymexla.mpi.send_init(%count, %peer, %tag) {datatype = #enzymexla.datatype<MPI_DOUBLE>} : (tensor<i32>, tensor<i32>, tensor<i32>) -> tensor<i64>
+      %rreq = enzymexla.mpi.recv_init(%count, %peer, %tag) {datatype = #enzymexla.datatype<MPI_DOUBLE>} : (tensor<i32>, tensor<i32>, tensor<i32>) -> tensor<i64>
+      %send = stablehlo.multiply %acc, %acc : tensor<5xf64>
+      %rstarted = enzymexla.mpi.start(%rreq) : (tensor<i64>) -> tensor<i64>
+      %sstarted = enzymexla.mpi.start(%sreq, %send) : (tensor<i64>, tensor<5xf64>) -> tensor<i64>
+      %swaited = enzymexla.mpi.wait(%sstarted) : tensor<i64> -> tensor<i64>
+      %rwaited, %recv = enzymexla.mpi.wait(%rstarted) : tensor<i64> -> tensor<i64>, tensor<5xf64>
+      enzymexla.mpi.request_free(%swaited) : tensor<i64>
+      enzymexla.mpi.request_free(%rwaited) : tensor<i64>
+      %next = stablehlo.add %iter, %c1 : tensor<i64>
+      %sum = stablehlo.add %acc, %recv : tensor<5xf64>
+      stablehlo.return %next, %sum : tensor<i64>, tensor<5xf64>
+    }
+    return %res#1 : tensor<5xf64>
+  }
+}
+
+// The requests are carried through the loop, so that every start follows the
+// previous wait on the same request and the frees follow the last waits.
+// CPU:      func.func @main(%arg0: tensor<5xf64>) -> tensor<5xf64> {
+// CPU-DAG:    %[[SREQ:.+]] = enzymexla.jit_call @enzymexla_wrapper_MPI_Send_init_MPI_DOUBLE (
+// CPU-DAG:    %[[RREQ:.+]] = enzymexla.jit_call @enzymexla_wrapper_MPI_Recv_init_MPI_DOUBLE (
+// CPU:        %[[RES:.+]]:4 = stablehlo.while(%{{.+}} = %{{.+}}, %[[ACC:.+]] = %arg0, %[[SLOOP:.+]] = %[[SREQ]], %[[RLOOP:.+]] = %[[RREQ]])
+// CPU:        } do {
+// CPU-NOT:      _init_
+// CPU:          %[[SEND:.+]] = stablehlo.multiply %[[ACC]], %[[ACC]]
+// CPU:          %[[RSTARTED:.+]] = enzymexla.jit_call @enzymexla_wrapper_MPI_Start (%[[RLOOP]])
+// CPU:          %[[SSTARTED:.+]] = enzymexla.jit_call @enzymexla_wrapper_MPI_Start_buf (%[[SLOOP]], %[[SEND]])
+// CPU:          %[[SWAITED:.+]] = enzymexla.jit_call @enzymexla_wrapper_MPI_Wait_persistent (%[[SSTARTED]])
+// CPU:          %[[RWAITED:.+]]:2 = enzymexla.jit_call @enzymexla_wrapper_MPI_Wait_persistent_buf (%[[RSTARTED]],
+// CPU-NOT:      MPI_Request_free
+// CPU:          %[[SUM:.+]] = stablehlo.add %[[ACC]], %[[RWAITED]]#1
+// CPU:          stablehlo.return %{{.+}}, %[[SUM]], %[[SWAITED]], %[[RWAITED]]#0
+// CPU:        }
+// CPU-DAG:    enzymexla.jit_call @enzymexla_wrapper_MPI_Request_free (%[[RES]]#2)
+// CPU-DAG:    enzymexla.jit_call @enzymexla_wrapper_MPI_Request_free (%[[RES]]#3)
+// CPU:        return %[[RES]]#1
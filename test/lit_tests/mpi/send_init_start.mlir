@@ -0,0 +1,75 @@
+// RUN: enzymexlamlir-opt --pass-pipeline="builtin.module(lower-enzymexla-mpi{backend=cpu})" %s | FileCheck %s --check-prefix=CPU
+// RUN: enzymexlamlir-opt --pass-pipeline="builtin.module(lower-enzymexla-mpi{backend=cpu})" %s | FileCheck %s --check-prefix=INIT
+// RUN: enzymexlamlir-opt --pass-pipeline="builtin.module(lower-enzymexla-mpi{backend=cpu})" %s | FileCheck %s --check-prefix=START
+// RUN: enzymexlamlir-opt --pass-pipeline="builtin.module(lower-enzymexla-mpi{backend=cpu})" %s | FileCheck %s --check-prefix=WAIT
+// RUN: enzymexlamlir-opt --pass-pipeline="builtin.module(lower-enzymexla-mpi{backend=cpu})" %s | FileCheck %s --check-prefix=FREE
+
+module {
+  func.func @main(%buf: tensor<5xf64>, %comm: tensor<i64>) -> tensor<5xf64> {
+    %count = stablehlo.constant dense<5> : tensor<i32>
+    %peer = stablehlo.constant dense<1> : tensor<i32>
+    %tag = stablehlo.constant dense<42> : tensor<i32>
+    %sreq = enzymexla.mpi.send_init(%count, %peer, %tag, %comm) {datatype = #enzymexla.datatype<MPI_DOUBLE>} : (tensor<i32>, tensor<i32>, tensor<i32>, tensor<i64>) -> tensor<i64>
+    %rreq = enzymexla.mpi.recv_init(%count, %peer, %tag, %comm) {datatype = #enzymexla.datatype<MPI_DOUBLE>} : (tensor<i32>, tensor<i32>, tensor<i32>, tensor<i64>) -> tensor<i64>
+    %rstarted = enzymexla.mpi.start(%rreq) : (tensor<i64>) -> tensor<i64>
+    %sstarted = enzymexla.mpi.start(%sreq, %buf) : (tensor<i64>, tensor<5xf64>) -> tensor<i64>
+    %swaited = enzymexla.mpi.wait(%sstarted) : tensor<i64> -> tensor<i64>
+    %rwaited, %out = enzymexla.mpi.wait(%rstarted) : tensor<i64> -> tensor<i64>, tensor<5xf64>
+    enzymexla.mpi.request_free(%swaited) : tensor<i64>
+    enzymexla.mpi.request_free(%rwaited) : tensor<i64>
+    return %out : tensor<5xf64>
+  }
+}
+
+// CPU-DAG:  llvm.func @MPI_Send_init(!llvm.ptr, i32, !llvm.ptr, i32, i32, !llvm.ptr, !llvm.ptr) -> i32
+// CPU-DAG:  llvm.func @MPI_Recv_init(!llvm.ptr, i32, !llvm.ptr, i32, i32, !llvm.ptr, !llvm.ptr) -> i32
+// CPU-DAG:  llvm.func @MPI_Type_size(!llvm.ptr, !llvm.ptr) -> i32
+// CPU-DAG:  llvm.func @MPI_Start(!llvm.ptr) -> i32
+// CPU-DAG:  llvm.func @MPI_Wait(!llvm.ptr, !llvm.ptr) -> i32
+// CPU-DAG:  llvm.func @MPI_Request_free(!llvm.ptr) -> i32
+// CPU-DAG:  llvm.func @malloc(i64) -> !llvm.ptr
+// CPU-DAG:  llvm.func @free(!llvm.ptr)
+
+// The data sent and received goes through the buffers owned by the request,
+// never through the XLA buffers given to mpi.start and returned by mpi.wait.
+// CPU:      func.func @main(%arg0: tensor<5xf64>, %arg1: tensor<i64>) -> tensor<5xf64> {
+// CPU:        %[[SREQ:.+]] = enzymexla.jit_call @enzymexla_wrapper_MPI_Send_init_MPI_DOUBLE_comm (%{{.+}}, %{{.+}}, %{{.+}}, %arg1, %{{.+}}) {{.*}}operand_index = 4{{.*}} -> tensor<i64>
+// CPU:        %[[RREQ:.+]] = enzymexla.jit_call @enzymexla_wrapper_MPI_Recv_init_MPI_DOUBLE_comm (%{{.+}}, %{{.+}}, %{{.+}}, %arg1, %{{.+}}) {{.*}}operand_index = 4{{.*}} -> tensor<i64>
+// CPU:        %[[RSTARTED:.+]] = enzymexla.jit_call @enzymexla_wrapper_MPI_Start (%[[RREQ]]) {{.*}}operand_index = 0{{.*}} : (tensor<i64>) -> tensor<i64>
+// CPU:        %[[SSTARTED:.+]] = enzymexla.jit_call @enzymexla_wrapper_MPI_Start_buf (%[[SREQ]], %arg0) {{.*}}operand_index = 0{{.*}} : (tensor<i64>, tensor<5xf64>) -> tensor<i64>
+// CPU:        %[[SWAITED:.+]] = enzymexla.jit_call @enzymexla_wrapper_MPI_Wait_persistent (%[[SSTARTED]]) {{.*}}operand_index = 0{{.*}} : (tensor<i64>) -> tensor<i64>
+// CPU:        %[[RWAITED:.+]]:2 = enzymexla.jit_call @enzymexla_wrapper_MPI_Wait_persistent_buf (%[[RSTARTED]], %{{.+}}) {{.*}}output_tuple_indices = [0], operand_index = 0{{.*}}output_tuple_indices = [1], operand_index = 1{{.*}} -> (tensor<i64>, tensor<5xf64>)
+// CPU:        enzymexla.jit_call @enzymexla_wrapper_MPI_Request_free (%[[SWAITED]])
+// CPU:        enzymexla.jit_call @enzymexla_wrapper_MPI_Request_free (%[[RWAITED]]#0)
+// CPU:        return %[[RWAITED]]#1
+
+// INIT:      llvm.func @enzymexla_wrapper_MPI_Send_init_MPI_DOUBLE_comm(%arg0: !llvm.ptr {{.*}}, %arg1: !llvm.ptr {{.*}}, %arg2: !llvm.ptr {{.*}}, %arg3: !llvm.ptr {{.*}}, %arg4: !llvm.ptr {{.*}})
+// INIT:        %[[COUNT:.+]] = llvm.load %arg0 : !llvm.ptr -> i32
+// INIT:        %[[DTYPE:.+]] = llvm.mlir.addressof @MPI_DOUBLE
+// INIT:        %[[COMM:.+]] = llvm.load %arg3 : !llvm.ptr -> !llvm.ptr
+// INIT:        %[[RECORD:.+]] = llvm.call @malloc(
+// INIT:        llvm.call @MPI_Type_size(%[[DTYPE]],
+// INIT:        %[[SEND:.+]] = llvm.call @malloc(
+// INIT:        llvm.store %[[RECORD]], %arg4 : !llvm.ptr, !llvm.ptr
+// INIT:        %[[REQ:.+]] = llvm.getelementptr %[[RECORD]][0, 0]
+// INIT-NEXT:   llvm.call @MPI_Send_init(%[[SEND]], %[[COUNT]], %[[DTYPE]], %{{.+}}, %{{.+}}, %[[COMM]], %[[REQ]])
+
+// START:      llvm.func @enzymexla_wrapper_MPI_Start_buf(%arg0: !llvm.ptr {{.*}}, %arg1: !llvm.ptr {{.*}})
+// START:        %[[RECORD:.+]] = llvm.load %arg0 : !llvm.ptr -> !llvm.ptr
+// START-NEXT:   %[[FIELD:.+]] = llvm.getelementptr %[[RECORD]][0, 1]
+// START-NEXT:   %[[SEND:.+]] = llvm.load %[[FIELD]] : !llvm.ptr -> !llvm.ptr
+// START:        "llvm.intr.memcpy"(%[[SEND]], %arg1, %{{.+}})
+// START:        llvm.call @MPI_Start(
+
+// WAIT:      llvm.func @enzymexla_wrapper_MPI_Wait_persistent_buf(%arg0: !llvm.ptr {{.*}}, %arg1: !llvm.ptr {{.*}})
+// WAIT:        llvm.call @MPI_Wait(
+// WAIT:        %[[RECORD:.+]] = llvm.load %arg0 : !llvm.ptr -> !llvm.ptr
+// WAIT-NEXT:   %[[FIELD:.+]] = llvm.getelementptr %[[RECORD]][0, 2]
+// WAIT-NEXT:   %[[RECV:.+]] = llvm.load %[[FIELD]] : !llvm.ptr -> !llvm.ptr
+// WAIT:        "llvm.intr.memcpy"(%arg1, %[[RECV]], %{{.+}})
+// WAIT-NEXT:   llvm.return
+
+// FREE:      llvm.func @enzymexla_wrapper_MPI_Request_free(%arg0: !llvm.ptr {{.*}})
+// FREE:        llvm.call @MPI_Request_free(
+// FREE-COUNT-3: llvm.call @free(
+// FREE-NEXT:   llvm.return
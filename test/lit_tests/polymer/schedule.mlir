@@ -0,0 +1,120 @@
+// RUN: enzymexlamlir-opt %s --polymer-schedule | FileCheck %s
+// RUN: enzymexlamlir-opt %s --polymer-schedule="tile-size=0 parallelize=false" | FileCheck %s --check-prefix=SEQ
+
+module {
+  func.func @matmul(%A: memref<64x64xf32>, %B: memref<64x64xf32>, %C: memref<64x64xf32>) {
+    affine.for %i = 0 to 64 {
+      affine.for %j = 0 to 64 {
+        affine.for %k = 0 to 64 {
+          %a = affine.load %A[%i, %k] : memref<64x64xf32>
+          %b = affine.load %B[%k, %j] : memref<64x64xf32>
+          %c = affine.load %C[%i, %j] : memref<64x64xf32>
+          %m = arith.mulf %a, %b : f32
+          %s = arith.addf %c, %m : f32
+          affine.store %s, %C[%i, %j] : memref<64x64xf32>
+        }
+      }
+    }
+    return
+  }
+
+  func.func @producer_consumer(%A: memref<64xf32>, %B: memref<64xf32>, %C: memref<64xf32>) {
+    affine.for %i = 0 to 64 {
+      %a = affine.load %A[%i] : memref<64xf32>
+      %m = arith.mulf %a, %a : f32
+      affine.store %m, %B[%i] : memref<64xf32>
+    }
+    affine.for %i = 0 to 64 {
+      %b = affine.load %B[%i] : memref<64xf32>
+      %s = arith.addf %b, %b : f32
+      affine.store %s, %C[%i] : memref<64xf32>
+    }
+    return
+  }
+
+  func.func private @use(f32)
+
+  func.func @unsupported(%A: memref<64xf32>) {
+    affine.for %i = 0 to 64 {
+      %a = affine.load %A[%i] : memref<64xf32>
+      func.call @use(%a) : (f32) -> ()
+    }
+    return
+  }
+
+  // Passes the up front checks, so the statements are wrapped before the
+  // SCoP builder rejects the llvm.alloca. The wrapping must be undone.
+  func.func @restored(%A: memref<64xf32>) {
+    %c1 = llvm.mlir.constant(1 : i64) : i64
+    %p = llvm.alloca %c1 x f32 : (i64) -> !llvm.ptr
+    affine.for %i = 0 to 64 {
+      %a = affine.load %A[%i] : memref<64xf32>
+      %s = arith.addf %a, %a : f32
+      affine.store %s, %A[%i] : memref<64xf32>
+    }
+    return
+  }
+}
+
+// The i, j, k band is tiled by 32: three loops over the two tiles of each
+// dimension, of which the outermost is parallel, around three point loops.
+// CHECK-LABEL: func.func @matmul
+// CHECK-NOT:     affine.for
+// CHECK:         scf.parallel ({{.+}}) = (%c0) to (%c2) step (%c1)
+// CHECK:           scf.for {{.+}} = %c0_i64 to %c2_i64 step %c1_i64
+// CHECK:             scf.for {{.+}} = %c0_i64 to %c2_i64 step %c1_i64
+// CHECK:               scf.for {{.+}} = %c0_i64 to %c32_i64 step %c1_i64
+// CHECK:                 scf.for {{.+}} = %c0_i64 to %c32_i64 step %c1_i64
+// CHECK:                   scf.for {{.+}} = %c0_i64 to %c32_i64 step %c1_i64
+// CHECK:                     memref.load
+// CHECK:                     memref.load
+// CHECK:                     memref.load
+// CHECK:                     arith.mulf
+// CHECK:                     arith.addf
+// CHECK:                     memref.store
+// CHECK-NOT:     scf.for
+// CHECK:         return
+
+// CHECK-LABEL: func.func @producer_consumer
+// CHECK:         scf.parallel ({{.+}}) = (%c0) to (%c64) step (%c1)
+// CHECK-NOT:     scf.{{for|parallel}}
+// CHECK:           arith.mulf
+// CHECK:           memref.store %{{.+}}, %arg1
+// CHECK-NOT:     scf.{{for|parallel}}
+// CHECK:           arith.addf
+// CHECK:           memref.store %{{.+}}, %arg2
+// CHECK-NOT:     scf.{{for|parallel}}
+// CHECK:         return
+
+// CHECK-LABEL: func.func @unsupported
+// CHECK:         affine.for
+// CHECK:           affine.load
+// CHECK:           func.call @use
+
+// CHECK-LABEL: func.func @restored
+// CHECK-NEXT:    llvm.mlir.constant
+// CHECK-NEXT:    llvm.alloca
+// CHECK-NEXT:    affine.for %[[I:.+]] = 0 to 64 {
+// CHECK-NEXT:      %[[A:.+]] = affine.load %arg0[%[[I]]] : memref<64xf32>
+// CHECK-NEXT:      %[[S:.+]] = arith.addf %[[A]], %[[A]] : f32
+// CHECK-NEXT:      affine.store %[[S]], %arg0[%[[I]]] : memref<64xf32>
+// CHECK-NEXT:    }
+// CHECK-NEXT:    return
+
+// SEQ-LABEL: func.func @matmul
+// SEQ-NOT:     scf.parallel
+// SEQ:         scf.for
+// SEQ:           scf.for
+// SEQ:             scf.for
+// SEQ:               memref.load
+// SEQ:               memref.store
+// SEQ:         return
+
+// The consumer is fused into the producer's loop.
+// SEQ-LABEL: func.func @producer_consumer
+// SEQ:         scf.for
+// SEQ-NOT:     scf.for
+// SEQ:           memref.store %{{.+}}, %arg1
+// SEQ-NOT:     scf.for
+// SEQ:           memref.store %{{.+}}, %arg2
+// SEQ:         return
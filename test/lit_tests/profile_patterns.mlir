@@ -0,0 +1,24 @@
+// RUN: enzymexlamlir-opt --pass-pipeline="builtin.module(enzyme-hlo-opt{no_nan=true profile_patterns=true})" %s -o /dev/null 2>&1 | FileCheck %s
+// RUN: enzymexlamlir-opt --pass-pipeline="builtin.module(enzyme-hlo-opt{no_nan=true profile_patterns=true profile_output=%t})" %s | FileCheck %s --check-prefix=IR
+// RUN: cat %t | FileCheck %s
+
+func.func @t1(%arg0: tensor<3xf64>, %arg1: tensor<3xf64>) -> tensor<3xf64> {
+  %0 = stablehlo.add %arg0, %arg1 : tensor<3xf64>
+  %1 = stablehlo.subtract %arg1, %0 : tensor<3xf64>
+  return %1 : tensor<3xf64>
+}
+
+// IR-LABEL:   @t1(
+// IR-SAME:    %[[ARG0:.+]]: tensor<3xf64>, %[[ARG1:.+]]: tensor<3xf64>) -> tensor<3xf64> {
+// IR-NEXT:    %[[NEG:.+]] = stablehlo.negate %[[ARG0]] : tensor<3xf64>
+// IR-NEXT:    return %[[NEG]] : tensor<3xf64>
+
+// CHECK:      "iterations": 2,
+// CHECK-NEXT: "converged": true,
+// CHECK-NEXT: "total_ms": {{.*}},
+// CHECK-NEXT: "patterns": [
+// CHECK:      "name": "{{.*}}NoNanAddSubSimplify",
+// CHECK-NEXT: "attempts": {{[1-9][0-9]*}},
+// CHECK-NEXT: "successes": 1,
+// CHECK-NEXT: "time_ms": {{.*}},
+// CHECK-NEXT: "success_time_ms": {{.*}}
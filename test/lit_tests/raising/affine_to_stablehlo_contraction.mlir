@@ -0,0 +1,104 @@
+// RUN: enzymexlamlir-opt %s --raise-affine-to-stablehlo --canonicalize --enzyme-hlo-opt=max_constant_expansion=0 --canonicalize | FileCheck %s
+
+module {
+  func.func private @gemm(%A: memref<64x32xf32>, %B: memref<32x48xf32>, %C: memref<64x48xf32>) {
+    %cst = arith.constant 0.000000e+00 : f32
+    affine.parallel (%i, %j) = (0, 0) to (64, 48) {
+      %r = affine.for %k = 0 to 32 iter_args(%acc = %cst) -> (f32) {
+        %a = affine.load %A[%i, %k] : memref<64x32xf32>
+        %b = affine.load %B[%k, %j] : memref<32x48xf32>
+        %m = arith.mulf %a, %b : f32
+        %s = arith.addf %acc, %m : f32
+        affine.yield %s : f32
+      }
+      affine.store %r, %C[%i, %j] : memref<64x48xf32>
+    }
+    return
+  }
+  func.func private @gemm_memory(%A: memref<64x32xf32>, %B: memref<32x48xf32>, %C: memref<64x48xf32> {llvm.noalias}) {
+    affine.for %i = 0 to 64 {
+      affine.for %j = 0 to 48 {
+        affine.for %k = 0 to 32 {
+          %c = affine.load %C[%i, %j] : memref<64x48xf32>
+          %a = affine.load %A[%i, %k] : memref<64x32xf32>
+          %b = affine.load %B[%k, %j] : memref<32x48xf32>
+          %m = arith.mulf %a, %b : f32
+          %s = arith.addf %c, %m : f32
+          affine.store %s, %C[%i, %j] : memref<64x48xf32>
+        }
+      }
+    }
+    return
+  }
+  func.func private @rowsum(%A: memref<16x100xf64>, %out: memref<16xf64>) {
+    %cst = arith.constant 0.000000e+00 : f64
+    affine.parallel (%i) = (0) to (16) {
+      %r = affine.for %k = 0 to 100 iter_args(%acc = %cst) -> (f64) {
+        %a = affine.load %A[%i, %k] : memref<16x100xf64>
+        %s = arith.addf %acc, %a : f64
+        affine.yield %s : f64
+      }
+      affine.store %r, %out[%i] : memref<16xf64>
+    }
+    return
+  }
+  func.func private @rowmax(%A: memref<16x100xf64>, %out: memref<16xf64>) {
+    affine.parallel (%i) = (0) to (16) {
+      %init = affine.load %out[%i] : memref<16xf64>
+      %r = affine.for %k = 0 to 100 iter_args(%acc = %init) -> (f64) {
+        %a = affine.load %A[%i, %k] : memref<16x100xf64>
+        %s = arith.maximumf %acc, %a : f64
+        affine.yield %s : f64
+      }
+      affine.store %r, %out[%i] : memref<16xf64>
+    }
+    return
+  }
+  func.func private @rowprod(%A: memref<16x100xi32>, %out: memref<16xi32>) {
+    %c1 = arith.constant 1 : i32
+    affine.parallel (%i) = (0) to (16) {
+      %r = affine.for %k = 0 to 100 iter_args(%acc = %c1) -> (i32) {
+        %a = affine.load %A[%i, %k] : memref<16x100xi32>
+        %s = arith.muli %a, %acc : i32
+        affine.yield %s : i32
+      }
+      affine.store %r, %out[%i] : memref<16xi32>
+    }
+    return
+  }
+}
+
+// CHECK-LABEL: func.func private @gemm_raised
+// CHECK-NOT: stablehlo.reduce_window
+// CHECK-NOT: batching_dims
+// CHECK: stablehlo.dot_general %arg0, %arg1, contracting_dims = [1] x [0]
+// CHECK-SAME: : (tensor<64x32xf32>, tensor<32x48xf32>) -> tensor<64x48xf32>
+// CHECK-NOT: stablehlo.reduce_window
+// CHECK: return
+
+// CHECK-LABEL: func.func private @gemm_memory_raised
+// CHECK-NOT: stablehlo.reduce_window
+// CHECK-NOT: batching_dims
+// CHECK: %[[DOT:.+]] = stablehlo.dot_general %arg0, %arg1, contracting_dims = [1] x [0]
+// CHECK-SAME: : (tensor<64x32xf32>, tensor<32x48xf32>) -> tensor<64x48xf32>
+// CHECK: stablehlo.add {{.*}}%[[DOT]]{{.*}} : tensor<64x48xf32>
+// CHECK-NOT: stablehlo.reduce_window
+// CHECK: return
+
+// CHECK-LABEL: func.func private @rowsum_raised
+// CHECK-NOT: stablehlo.reduce_window
+// CHECK: stablehlo.reduce(%{{.*}} init: %{{.*}}) applies stablehlo.add across dimensions = [{{[0-9]}}] : (tensor<{{.*}}xf64>, tensor<f64>) -> tensor<16xf64>
+// CHECK-NOT: stablehlo.reduce_window
+// CHECK: return
+
+// CHECK-LABEL: func.func private @rowmax_raised
+// CHECK-NOT: stablehlo.reduce_window
+// CHECK: stablehlo.reduce(%{{.*}} init: %{{.*}}) applies stablehlo.maximum across dimensions = [{{[0-9]}}] : (tensor<{{.*}}xf64>, tensor<f64>) -> tensor<16xf64>
+// CHECK: stablehlo.maximum %{{.*}}, %{{.*}} : tensor<16xf64>
+// CHECK: return
+
+// CHECK-LABEL: func.func private @rowprod_raised
+// CHECK-NOT: stablehlo.reduce_window
+// CHECK: stablehlo.reduce(%{{.*}} init: %{{.*}}) applies stablehlo.multiply across dimensions = [{{[0-9]}}] : (tensor<{{.*}}xi32>, tensor<i32>) -> tensor<16xi32>
+// CHECK-NOT: stablehlo.reduce_window
+// CHECK: return
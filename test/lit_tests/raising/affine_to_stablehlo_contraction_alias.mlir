@@ -0,0 +1,40 @@
+// RUN: enzymexlamlir-opt %s --raise-affine-to-stablehlo --canonicalize --enzyme-hlo-opt=max_constant_expansion=0 --canonicalize | FileCheck %s
+
+// The accumulator C may alias the matrices read in the loop, so it must stay
+// in memory and the nests must not be raised to a contraction.
+module {
+  func.func private @gemm_may_alias(%A: memref<64x32xf32>, %B: memref<32x48xf32>, %C: memref<64x48xf32>) {
+    affine.for %i = 0 to 64 {
+      affine.for %j = 0 to 48 {
+        affine.for %k = 0 to 32 {
+          %c = affine.load %C[%i, %j] : memref<64x48xf32>
+          %a = affine.load %A[%i, %k] : memref<64x32xf32>
+          %b = affine.load %B[%k, %j] : memref<32x48xf32>
+          %m = arith.mulf %a, %b : f32
+          %s = arith.addf %c, %m : f32
+          affine.store %s, %C[%i, %j] : memref<64x48xf32>
+        }
+      }
+    }
+    return
+  }
+  func.func private @gemm_subview(%B: memref<32x48xf32>, %C: memref<64x48xf32> {llvm.noalias}) {
+    %A = memref.subview %C[0, 0] [64, 32] [1, 1] : memref<64x48xf32> to memref<64x32xf32, strided<[48, 1]>>
+    affine.for %i = 0 to 64 {
+      affine.for %j = 0 to 48 {
+        affine.for %k = 0 to 32 {
+          %c = affine.load %C[%i, %j] : memref<64x48xf32>
+          %a = affine.load %A[%i, %k] : memref<64x32xf32, strided<[48, 1]>>
+          %b = affine.load %B[%k, %j] : memref<32x48xf32>
+          %m = arith.mulf %a, %b : f32
+          %s = arith.addf %c, %m : f32
+          affine.store %s, %C[%i, %j] : memref<64x48xf32>
+        }
+      }
+    }
+    return
+  }
+}
+
+// CHECK-NOT: stablehlo.dot_general
+// CHECK-NOT: stablehlo.reduce
@@ -0,0 +1,90 @@
+// RUN: enzymexlamlir-opt --lower-enzymexla-special %s | FileCheck %s
+
+func.func @besselj0(%arg0: tensor<8xf32>) -> tensor<8xf32> {
+    %nu = stablehlo.constant dense<0.0> : tensor<8xf32>
+    %0 = "enzymexla.special.besselj"(%nu, %arg0) : (tensor<8xf32>, tensor<8xf32>) -> tensor<8xf32>
+    return %0 : tensor<8xf32>
+}
+
+// CHECK-LABEL: func.func @besselj0
+// CHECK-NOT:     enzymexla.special
+// CHECK-DAG:     %[[AX:.+]] = stablehlo.abs %arg0 : tensor<8xf32>
+// CHECK-DAG:     stablehlo.cosine
+// CHECK-DAG:     %[[PRED:.+]] = stablehlo.compare {{.*}}LE, %[[AX]], %{{.+}} : (tensor<8xf32>, tensor<8xf32>) -> tensor<8xi1>
+// CHECK:         %[[RES:.+]] = stablehlo.select %[[PRED]], %{{.+}}, %{{.+}} : tensor<8xi1>, tensor<8xf32>
+// CHECK-NEXT:    return %[[RES]]
+
+func.func @bessely3(%arg0: tensor<8xf32>) -> tensor<8xf32> {
+    %nu = stablehlo.constant dense<3> : tensor<8xi64>
+    %0 = "enzymexla.special.bessely"(%nu, %arg0) : (tensor<8xi64>, tensor<8xf32>) -> tensor<8xf32>
+    return %0 : tensor<8xf32>
+}
+
+// CHECK-LABEL: func.func @bessely3
+// CHECK-NOT:     enzymexla.special
+// CHECK:         stablehlo.log
+// CHECK:         stablehlo.sine
+// CHECK:         return
+
+func.func @besselkx2(%arg0: tensor<8xf32>) -> tensor<8xf32> {
+    %nu = stablehlo.constant dense<-2.0> : tensor<8xf32>
+    %0 = "enzymexla.special.besselkx"(%nu, %arg0) : (tensor<8xf32>, tensor<8xf32>) -> tensor<8xf32>
+    return %0 : tensor<8xf32>
+}
+
+// CHECK-LABEL: func.func @besselkx2
+// CHECK-NOT:     enzymexla.special
+// CHECK:         stablehlo.exponential
+// CHECK:         return
+
+func.func @jinc(%arg0: tensor<8xf32>) -> tensor<8xf32> {
+    %0 = "enzymexla.special.jinc"(%arg0) : (tensor<8xf32>) -> tensor<8xf32>
+    return %0 : tensor<8xf32>
+}
+
+// CHECK-LABEL: func.func @jinc
+// CHECK-NOT:     enzymexla.special
+// CHECK:         return
+
+func.func @fractional(%arg0: tensor<8xf32>) -> tensor<8xf32> {
+    %nu = stablehlo.constant dense<0.5> : tensor<8xf32>
+    %0 = "enzymexla.special.besselj"(%nu, %arg0) : (tensor<8xf32>, tensor<8xf32>) -> tensor<8xf32>
+    return %0 : tensor<8xf32>
+}
+
+// CHECK-LABEL: func.func @fractional
+// CHECK:         enzymexla.special.besselj
+
+func.func @dynamic_order(%nu: tensor<8xf32>, %arg0: tensor<8xf32>) -> tensor<8xf32> {
+    %0 = "enzymexla.special.besseli"(%nu, %arg0) : (tensor<8xf32>, tensor<8xf32>) -> tensor<8xf32>
+    return %0 : tensor<8xf32>
+}
+
+// CHECK-LABEL: func.func @dynamic_order
+// CHECK:         enzymexla.special.besseli
+
+// Narrow types are computed in f32.
+func.func @half_precision(%arg0: tensor<8xf16>) -> tensor<8xf16> {
+    %nu = stablehlo.constant dense<16> : tensor<8xi64>
+    %0 = "enzymexla.special.besseli"(%nu, %arg0) : (tensor<8xi64>, tensor<8xf16>) -> tensor<8xf16>
+    return %0 : tensor<8xf16>
+}
+
+// CHECK-LABEL: func.func @half_precision
+// CHECK-NOT:     enzymexla.special
+// CHECK:         %[[X:.+]] = stablehlo.convert %arg0 : (tensor<8xf16>) -> tensor<8xf32>
+// CHECK:         stablehlo.abs %[[X]] : tensor<8xf32>
+// CHECK:         %[[RES:.+]] = stablehlo.convert %{{.+}} : (tensor<8xf32>) -> tensor<8xf16>
+// CHECK-NEXT:    return %[[RES]]
+
+// The approximations are only accurate to single precision.
+func.func @double_precision(%arg0: tensor<8xf64>) -> (tensor<8xf64>, tensor<8xf64>) {
+    %nu = stablehlo.constant dense<3> : tensor<8xi64>
+    %0 = "enzymexla.special.bessely"(%nu, %arg0) : (tensor<8xi64>, tensor<8xf64>) -> tensor<8xf64>
+    %1 = "enzymexla.special.jinc"(%arg0) : (tensor<8xf64>) -> tensor<8xf64>
+    return %0, %1 : tensor<8xf64>, tensor<8xf64>
+}
+
+// CHECK-LABEL: func.func @double_precision
+// CHECK:         enzymexla.special.bessely
+// CHECK:         enzymexla.special.jinc
@@ -0,0 +1,78 @@
+// RUN: enzymexlamlir-opt --enzyme-hlo-unroll="max-num-iterations=1 unroll-factor=3 peel-first=1 peel-last=1" %s | FileCheck %s
+// RUN: enzymexlamlir-opt --enzyme-hlo-unroll="max-num-iterations=1 unroll-factor=2 unroll-and-jam=true" %s | FileCheck %s --check-prefix=JAM
+
+func.func @peel(%a : tensor<2x2xf32>) -> tensor<2x2xf32> {
+  %start = stablehlo.constant dense<0> : tensor<i32>
+  %lim = stablehlo.constant dense<12> : tensor<i32>
+  %step = stablehlo.constant dense<1> : tensor<i32>
+  %w:2 = stablehlo.while(%iterArg = %a, %iterArg_0 = %start) : tensor<2x2xf32>, tensor<i32>
+   cond {
+    %c = stablehlo.compare  LT, %iterArg_0, %lim,  SIGNED : (tensor<i32>, tensor<i32>) -> tensor<i1>
+    stablehlo.return %c : tensor<i1>
+  } do {
+    %next = stablehlo.add %iterArg, %iterArg : tensor<2x2xf32>
+    %ni = stablehlo.add %iterArg_0, %step : tensor<i32>
+    stablehlo.return %next, %ni : tensor<2x2xf32>, tensor<i32>
+  }
+  return %w#0 : tensor<2x2xf32>
+}
+
+// The first iteration is peeled, the next nine run three at a time, the one
+// left over runs in a remainder loop and the last one is peeled.
+
+// CHECK-LABEL: func.func @peel
+// CHECK: %[[X0:.+]] = stablehlo.add %arg0, %arg0 : tensor<2x2xf32>
+// CHECK: %[[MAIN:.+]]:2 = stablehlo.while(%{{.+}} = %[[X0]], %{{.+}} = %{{.+}})
+// CHECK: stablehlo.constant dense<10> : tensor<i32>
+// CHECK: do {
+// CHECK-COUNT-3: stablehlo.add %{{.+}}, %{{.+}} : tensor<2x2xf32>
+// CHECK-NOT: stablehlo.add %{{.+}}, %{{.+}} : tensor<2x2xf32>
+// CHECK: stablehlo.return
+// CHECK: %[[REM:.+]]:2 = stablehlo.while(%{{.+}} = %[[MAIN]]#0, %{{.+}} = %[[MAIN]]#1)
+// CHECK: stablehlo.constant dense<11> : tensor<i32>
+// CHECK: do {
+// CHECK-NEXT: stablehlo.add %{{.+}}, %{{.+}} : tensor<2x2xf32>
+// CHECK-NEXT: stablehlo.add %{{.+}}, %{{.+}} : tensor<i32>
+// CHECK-NEXT: stablehlo.return
+// CHECK: %[[LAST:.+]] = stablehlo.add %[[REM]]#0, %[[REM]]#0 : tensor<2x2xf32>
+// CHECK: return %[[LAST]]
+
+func.func @jam(%x : tensor<8x4xf32>) -> tensor<8x4xf32> {
+  %zero = stablehlo.constant dense<0> : tensor<i64>
+  %one = stablehlo.constant dense<1> : tensor<i64>
+  %four = stablehlo.constant dense<4> : tensor<i64>
+  %eight = stablehlo.constant dense<8> : tensor<i64>
+  %init = stablehlo.constant dense<0.0> : tensor<8x4xf32>
+  %w:2 = stablehlo.while(%acc = %init, %i = %zero) : tensor<8x4xf32>, tensor<i64>
+   cond {
+    %c = stablehlo.compare  LT, %i, %eight,  SIGNED : (tensor<i64>, tensor<i64>) -> tensor<i1>
+    stablehlo.return %c : tensor<i1>
+  } do {
+    %row = stablehlo.dynamic_slice %x, %i, %zero, sizes = [1, 4] : (tensor<8x4xf32>, tensor<i64>, tensor<i64>) -> tensor<1x4xf32>
+    %inner:2 = stablehlo.while(%r = %row, %j = %zero) : tensor<1x4xf32>, tensor<i64>
+     cond {
+      %c = stablehlo.compare  LT, %j, %four,  SIGNED : (tensor<i64>, tensor<i64>) -> tensor<i1>
+      stablehlo.return %c : tensor<i1>
+    } do {
+      %sq = stablehlo.multiply %r, %r : tensor<1x4xf32>
+      %nj = stablehlo.add %j, %one : tensor<i64>
+      stablehlo.return %sq, %nj : tensor<1x4xf32>, tensor<i64>
+    }
+    %upd = stablehlo.dynamic_update_slice %acc, %inner#0, %i, %zero : (tensor<8x4xf32>, tensor<1x4xf32>, tensor<i64>, tensor<i64>) -> tensor<8x4xf32>
+    %ni = stablehlo.add %i, %one : tensor<i64>
+    stablehlo.return %upd, %ni : tensor<8x4xf32>, tensor<i64>
+  }
+  return %w#0 : tensor<8x4xf32>
+}
+
+// Each trip of the outer loop handles two rows, whose inner loops are
+// independent and run in lockstep inside a single fused loop.
+
+// JAM-LABEL: func.func @jam
+// JAM: stablehlo.while(%{{.+}} = %{{.+}}, %{{.+}} = %{{.+}}) : tensor<8x4xf32>, tensor<i64>
+// JAM: do {
+// JAM-COUNT-2: stablehlo.dynamic_slice
+// JAM: %[[FUSED:.+]]:4 = stablehlo.while({{.+}}) : tensor<1x4xf32>, tensor<i64>, tensor<1x4xf32>, tensor<i64>
+// JAM-NOT: stablehlo.while
+// JAM: %[[U0:.+]] = stablehlo.dynamic_update_slice %{{.+}}, %[[FUSED]]#0
+// JAM: stablehlo.dynamic_update_slice %[[U0]], %[[FUSED]]#2
@@ -0,0 +1,134 @@
+import glob
+import os
+import subprocess
+import sys
+
+from absl.testing import absltest
+
+RUNS = 3
+NUM_ALTERNATIVES = 2
+
+# Squares every element of its argument, once element by element and once
+# unrolled by two.
+SOURCE = """
+module {
+  func.func private @kernel(%arg0: !llvm.ptr) {
+    %c0 = arith.constant 0 : index
+    %c1 = arith.constant 1 : index
+    %c2 = arith.constant 2 : index
+    %c64 = arith.constant 64 : index
+    "enzymexla.alternatives"() ({
+      scf.for %iv = %c0 to %c64 step %c1 {
+        %idx = arith.index_cast %iv : index to i64
+        %ptr = llvm.getelementptr %arg0[%idx] : (!llvm.ptr, i64) -> !llvm.ptr, i32
+        %v = llvm.load %ptr : !llvm.ptr -> i32
+        %m = llvm.mul %v, %v : i32
+        llvm.store %m, %ptr : i32, !llvm.ptr
+      }
+      "enzymexla.polygeist_yield"() : () -> ()
+    }, {
+      scf.for %iv = %c0 to %c64 step %c2 {
+        %idx = arith.index_cast %iv : index to i64
+        %ptr = llvm.getelementptr %arg0[%idx] : (!llvm.ptr, i64) -> !llvm.ptr, i32
+        %v = llvm.load %ptr : !llvm.ptr -> i32
+        %m = llvm.mul %v, %v : i32
+        llvm.store %m, %ptr : i32, !llvm.ptr
+        %ptr1 = llvm.getelementptr %ptr[1] : (!llvm.ptr) -> !llvm.ptr, i32
+        %v1 = llvm.load %ptr1 : !llvm.ptr -> i32
+        %m1 = llvm.mul %v1, %v1 : i32
+        llvm.store %m1, %ptr1 : i32, !llvm.ptr
+      }
+      "enzymexla.polygeist_yield"() : () -> ()
+    }) {"alternatives.descs" = ["unroll1", "unroll2"]} : () -> ()
+    return
+  }
+  func.func @main(%arg0: tensor<64xi32>) -> tensor<64xi32> {
+    %0 = enzymexla.jit_call @kernel (%arg0) {output_operand_aliases = [#stablehlo.output_operand_alias<output_tuple_indices = [], operand_index = 0, operand_tuple_indices = []>]} : (tensor<64xi32>) -> tensor<64xi32>
+    return %0 : tensor<64xi32>
+  }
+}
+"""
+
+# Lowers the module on stdin with the pipeline given as argument, such that
+# the final module is dumped to the stderr of a fresh process.
+LOWER_SCRIPT = """
+import sys
+from enzyme_ad.jax import enzyme_call
+
+enzyme_call.run_pass_pipeline([], sys.stdin.read(), sys.argv[1])
+"""
+
+
+def pipeline(cache_dir, dump=False):
+    return (
+        f"lower-jit{{backend=cpu openmp=false autotune=true "
+        f"autotune_runs={RUNS} object_cache_dir={cache_dir} "
+        f"dump_final_module={str(dump).lower()}}}"
+    )
+
+
+class LowerJITAutotune(absltest.TestCase):
+    def test_choice_is_stored_and_reused(self):
+        import jax
+        import jax.numpy as jnp
+        import numpy as np
+        from enzyme_ad.jax import enzyme_call, hlo_call
+
+        cache_dir = self.create_tempdir().full_path
+
+        _, lowered = enzyme_call.run_pass_pipeline([], SOURCE, pipeline(cache_dir))
+        self.assertIn("enzymexla_compile_cpu", lowered)
+        kernel = jax.jit(lambda x: hlo_call(x, source=lowered))
+
+        x = jnp.arange(64, dtype=jnp.int32)
+        expected = np.asarray(x) * np.asarray(x)
+
+        # Every alternative is warmed up once and then timed RUNS times before
+        # a winner is picked, the remaining calls dispatch to the winner.
+        for _ in range((RUNS + 1) * NUM_ALTERNATIVES + 4):
+            np.testing.assert_array_equal(np.asarray(kernel(x)), expected)
+
+        tunes = glob.glob(os.path.join(cache_dir, "*.tune"))
+        self.assertLen(tunes, 1)
+        with open(tunes[0]) as f:
+            choice, count = f.read().split()
+        self.assertIn(int(choice), range(NUM_ALTERNATIVES))
+        self.assertEqual(int(count), NUM_ALTERNATIVES)
+        mtime = os.path.getmtime(tunes[0])
+
+        # The kernel compiled for tuning refers to its in-process state, so it
+        # is not persisted.
+        objects = os.path.join(cache_dir, "*.o")
+        self.assertEmpty(glob.glob(objects))
+
+        def lower_in_fresh_process():
+            proc = subprocess.run(
+                [sys.executable, "-c", LOWER_SCRIPT, pipeline(cache_dir, dump=True)],
+                input=SOURCE,
+                capture_output=True,
+                text=True,
+                env=dict(os.environ, PYTHONPATH=os.pathsep.join(sys.path)),
+            )
+            self.assertEqual(proc.returncode, 0, proc.stderr)
+            return proc.stderr
+
+        # A fresh process compiles the stored choice only, without dispatching
+        # through the tuning entry points, and caches the object.
+        stderr = lower_in_fresh_process()
+        self.assertIn("final_llvm_module before jit", stderr)
+        self.assertNotIn("enzymexla_autotune_begin", stderr)
+        self.assertEqual(os.path.getmtime(tunes[0]), mtime)
+        self.assertLen(glob.glob(objects), 1)
+
+        # The next process loads that object instead of compiling again.
+        stderr = lower_in_fresh_process()
+        self.assertNotIn("final_llvm_module before jit", stderr)
+        self.assertLen(glob.glob(objects), 1)
+
+
+if __name__ == "__main__":
+    from test_utils import fix_paths
+
+    fix_paths()
+
+    absltest.main()
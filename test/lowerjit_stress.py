@@ -0,0 +1,76 @@
+import time
+from concurrent.futures import ThreadPoolExecutor
+
+from absl.testing import absltest
+
+NUM_MODULES = 16
+
+
+def make_module(i):
+    # Each module scales its input by a distinct constant so that no two
+    # kernels share a JIT cache entry.
+    return f"""
+module {{
+  func.func private @kernel(%arg0: !llvm.ptr) {{
+    %c0 = arith.constant 0 : index
+    %c1 = arith.constant 1 : index
+    %c64 = arith.constant 64 : index
+    %scale = llvm.mlir.constant({i + 2} : i64) : i64
+    scf.for %iv = %c0 to %c64 step %c1 {{
+      %idx = arith.index_cast %iv : index to i64
+      %ptr = llvm.getelementptr %arg0[%idx] : (!llvm.ptr, i64) -> !llvm.ptr, i64
+      %v = llvm.load %ptr : !llvm.ptr -> i64
+      %m = llvm.mul %v, %scale : i64
+      llvm.store %m, %ptr : i64, !llvm.ptr
+    }}
+    return
+  }}
+  func.func @main(%arg0: tensor<64xi64>) -> tensor<64xi64> {{
+    %0 = enzymexla.jit_call @kernel (%arg0) {{output_operand_aliases = [#stablehlo.output_operand_alias<output_tuple_indices = [], operand_index = 0, operand_tuple_indices = []>]}} : (tensor<64xi64>) -> tensor<64xi64>
+    return %0 : tensor<64xi64>
+  }}
+}}
+"""
+
+
+def lower(mod):
+    from enzyme_ad.jax import enzyme_call
+
+    _, out = enzyme_call.run_pass_pipeline(
+        [], mod, "lower-jit{backend=cpu openmp=false}"
+    )
+    return out
+
+
+class LowerJITStress(absltest.TestCase):
+    def test_concurrent_lowering(self):
+        serial = [make_module(i) for i in range(NUM_MODULES)]
+        # Distinct offsets keep the parallel run from hitting kernels that
+        # were already compiled by the serial run.
+        parallel = [make_module(NUM_MODULES + i) for i in range(NUM_MODULES)]
+
+        start = time.perf_counter()
+        for mod in serial:
+            self.assertIn("enzymexla_compile_cpu", lower(mod))
+        serial_time = time.perf_counter() - start
+
+        start = time.perf_counter()
+        with ThreadPoolExecutor(max_workers=NUM_MODULES) as pool:
+            outs = list(pool.map(lower, parallel))
+        parallel_time = time.perf_counter() - start
+
+        for out in outs:
+            self.assertIn("enzymexla_compile_cpu", out)
+
+        print(
+            f"lower-jit {NUM_MODULES} modules: serial {serial_time:.3f}s, "
+            f"{NUM_MODULES} threads {parallel_time:.3f}s"
+        )
+
+
+if __name__ == "__main__":
+    from test_utils import fix_paths
+
+    fix_paths()
+
+    absltest.main()